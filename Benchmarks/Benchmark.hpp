@@ -0,0 +1,142 @@
+//
+//  Benchmark.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+//
+// • Benchmark harness
+//
+//  - Each benchmark is a plain function registered with BENCHMARK(name) and
+//    run by PlayBenchmarks, optionally filtered by name on the command line
+//
+//  - Every report is also kept as a Result, which PlayBenchmarks can write
+//    as JSON and compare against a baseline (see Results.hpp)
+//
+//===------------------------------------------------------------------------===
+
+namespace bench
+{
+
+struct Benchmark
+{
+    const char* name;
+    void      (*run)(void);
+};
+
+inline std::vector<Benchmark>& registry(void)
+{
+    static std::vector<Benchmark> benchmarks;
+
+    return benchmarks;
+}
+
+// • One report of one benchmark
+//
+struct Result
+{
+    std::string benchmark;
+    std::string name;
+    double      seconds;
+    uint64_t    items;
+};
+
+inline std::vector<Result>& results(void)
+{
+    static std::vector<Result> reported;
+
+    return reported;
+}
+
+// • Name of the benchmark running, set by PlayBenchmarks
+//
+inline std::string& current_benchmark(void)
+{
+    static std::string name;
+
+    return name;
+}
+
+struct Registration
+{
+    Registration(const char* name, void (*run)(void))
+    {
+        registry().push_back( { name, run } );
+    }
+};
+
+//===------------------------------------------------------------------------===
+// • Measurement
+//===------------------------------------------------------------------------===
+
+// • Keep `value` alive so that the work producing it is not optimized away
+//
+template <typename Type_>
+inline void do_not_optimize(const Type_& value)
+{
+    asm volatile ("" : : "r,m"(value) : "memory");
+}
+
+// • Best wall time of `repetitions` calls, in seconds
+//
+template <typename Function_>
+double measure(Function_&& function, uint32_t repetitions = 7)
+{
+    auto best = 0.0;
+
+    for (uint32_t repetition = 0; repetition < repetitions; ++repetition) {
+
+        const auto start = std::chrono::steady_clock::now();
+
+        function();
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        best = (0 == repetition) ? elapsed.count() : std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+inline void report(const char* name, double seconds, uint64_t items)
+{
+    results().push_back( { current_benchmark(), name, seconds, items } );
+
+    const auto rate = (0.0 < seconds) ? static_cast<double>(items)/seconds : 0.0;
+
+    if (rate < 1e6) {
+        std::printf( "  %-32s %10.3f ms %10.2f k/s\n", name, 1e3*seconds, 1e-3*rate );
+    } else {
+        std::printf( "  %-32s %10.3f ms %10.2f M/s\n", name, 1e3*seconds, 1e-6*rate );
+    }
+}
+
+} // namespace bench
+
+#define BENCHMARK(function_)                                                             \
+    static void function_(void);                                                         \
+    static const bench::Registration function_##_registration { #function_, function_ }; \
+    static void function_(void)
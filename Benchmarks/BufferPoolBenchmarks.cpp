@@ -0,0 +1,252 @@
+//
+//  BufferPoolBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Data/BufferPool.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//
+//  - The same random sequence of allocations for the pool and for malloc:
+//    each replaces one of a fixed number of live buffers with a new one,
+//    mostly small with the odd large one, tagged at both ends so that a
+//    block handed out twice shows up when it's freed
+//
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t live_count      = 4096;
+constexpr uint32_t operation_count = 1 << 20;
+
+struct Operation
+{
+    uint32_t    slot;
+    uint32_t    size;
+};
+
+std::vector<Operation> make_operations(void)
+{
+    std::mt19937 generator { 27 };
+
+    std::uniform_int_distribution<uint32_t> slot       { 0, live_count - 1 };
+    std::uniform_int_distribution<uint32_t> small_size { 1, 1024 };
+    std::uniform_int_distribution<uint32_t> large_size { 1, 64 << 10 };
+    std::bernoulli_distribution             is_large   { 1.0/64 };
+
+    std::vector<Operation> operations(operation_count);
+
+    for (auto& operation : operations) {
+        operation = {
+            .slot = slot(generator),
+            .size = is_large(generator) ? large_size(generator) : small_size(generator)
+        };
+    }
+
+    return operations;
+}
+
+struct Block
+{
+    uint8_t*    memory;
+    uint32_t    size;
+};
+
+inline void tag(const Block& block, uint8_t value)
+{
+    block.memory[0]              = value;
+    block.memory[block.size - 1] = value;
+}
+
+inline bool is_tagged(const Block& block, uint8_t value)
+{
+    return value == block.memory[0] && value == block.memory[block.size - 1];
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(buffer_pool_churn)
+{
+    const auto operations = make_operations();
+
+    uint32_t corrupted = 0;
+
+    // • malloc
+    //
+    std::vector<Block> blocks(live_count);
+
+    const auto malloc_seconds = bench::measure( [&] {
+
+        for (uint32_t slot = 0; slot < live_count; ++slot) {
+            blocks[slot] = { static_cast<uint8_t*>( std::malloc(16) ), 16 };
+            tag(blocks[slot], static_cast<uint8_t>(slot));
+        }
+
+        for (const auto& operation : operations) {
+
+            auto& block = blocks[operation.slot];
+
+            corrupted += is_tagged(block, static_cast<uint8_t>(operation.slot)) ? 0 : 1;
+            std::free(block.memory);
+
+            block = { static_cast<uint8_t*>( std::malloc(operation.size) ), operation.size };
+            tag(block, static_cast<uint8_t>(operation.slot));
+        }
+
+        for (const auto& block : blocks) {
+            std::free(block.memory);
+        }
+    }, 3 );
+
+    // • BufferPool, kept across repetitions as malloc keeps its heap, with
+    //   the statistics of the busiest moment: before the last frees
+    //
+    data::BufferPool                  pool;
+    std::vector<data::PoolAllocation> allocations(live_count);
+    data::PoolStatistics              statistics = {};
+
+    const auto pool_seconds = bench::measure( [&] {
+
+        const auto allocate = [&](uint32_t slot, uint32_t size) {
+            allocations[slot] = pool.allocate(size).value();
+            blocks[slot]      = { pool.contents(allocations[slot]), size };
+            tag(blocks[slot], static_cast<uint8_t>(slot));
+        };
+
+        for (uint32_t slot = 0; slot < live_count; ++slot) {
+            allocate(slot, 16);
+        }
+
+        for (const auto& operation : operations) {
+
+            corrupted += is_tagged(blocks[operation.slot], static_cast<uint8_t>(operation.slot)) ? 0 : 1;
+            corrupted += pool.free(allocations[operation.slot]) ? 0 : 1;
+
+            allocate(operation.slot, operation.size);
+        }
+
+        statistics = pool.statistics();
+
+        for (const auto& allocation : allocations) {
+            pool.free(allocation);
+        }
+    }, 3 );
+
+    bench::report("malloc", malloc_seconds, operation_count);
+    bench::report("pool", pool_seconds, operation_count);
+
+    std::printf( "  %u live in %u slabs (%.1f MB); internal fragmentation %.1f%%, external %.1f%%\n",
+                 statistics.allocation_count, statistics.slab_count, 1e-6*statistics.slab_bytes,
+                 1e2*internal_fragmentation(statistics), 1e2*external_fragmentation(statistics) );
+    std::printf( "  %s, speedup %.2fx\n", bench::verdict(0 == corrupted, "blocks intact", "CORRUPTED"),
+                 malloc_seconds / pool_seconds );
+}
+
+BENCHMARK(buffer_pool_frames)
+{
+    // • 256 transient buffers a frame, three frames in flight, as a ring of
+    //   frame buffers would use them
+    //
+    constexpr uint32_t frame_count       = 1024;
+    constexpr uint32_t buffers_per_frame = 256;
+    constexpr uint32_t frames_in_flight  = 3;
+
+    std::mt19937                            generator { 5 };
+    std::uniform_int_distribution<uint32_t> size_of   { 64, 4096 };
+    std::vector<uint32_t>                   sizes(buffers_per_frame);
+
+    for (auto& size : sizes) {
+        size = size_of(generator);
+    }
+
+    const auto allocations = frame_count * buffers_per_frame;
+
+    std::vector<std::vector<void*>> frames(frames_in_flight);
+
+    const auto malloc_seconds = bench::measure( [&] {
+
+        for (uint32_t frame = 0; frame < frame_count; ++frame) {
+
+            auto& buffers = frames[frame % frames_in_flight];
+
+            for (const auto buffer : buffers) {
+                std::free(buffer);
+            }
+
+            buffers.clear();
+
+            for (const auto size : sizes) {
+                buffers.push_back( std::malloc(size) );
+                bench::do_not_optimize(buffers.back());
+            }
+        }
+
+        for (auto& buffers : frames) {
+            for (const auto buffer : buffers) {
+                std::free(buffer);
+            }
+            buffers.clear();
+        }
+    }, 3 );
+
+    uint32_t failed = 0;
+    uint32_t slabs  = 0;
+
+    const auto pool_seconds = bench::measure( [&] {
+
+        data::BufferPool pool;
+
+        for (uint32_t frame = 0; frame < frame_count; ++frame) {
+
+            if (frames_in_flight <= frame) {
+                pool.release_frames(frame - frames_in_flight + 1);
+            }
+
+            for (const auto size : sizes) {
+
+                const auto allocation = pool.allocate_for_frame(size);
+
+                failed += allocation ? 0 : 1;
+                bench::do_not_optimize(allocation);
+            }
+
+            failed += (pool.end_frame() == frame) ? 0 : 1;
+        }
+
+        slabs = pool.statistics().slab_count;
+    }, 3 );
+
+    bench::report("malloc", malloc_seconds, allocations);
+    bench::report("pool, frame scoped", pool_seconds, allocations);
+
+    std::printf( "  %s, %u slabs at the end, speedup %.2fx\n",
+                 bench::verdict(0 == failed, "frames released", "FAILED"), slabs, malloc_seconds / pool_seconds );
+}
@@ -0,0 +1,150 @@
+//
+//  CullingBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/Culling.hpp>
+#include <Composition/Pattern.hpp>
+
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    pattern_count  = 1000;
+constexpr uint32_t    instance_count = 1000;
+constexpr simd::uint2 grid_size      = { 3840, 2160 };
+
+struct FreeArena
+{
+    void operator () (Arena* arena) const noexcept
+    {
+        std::free(arena);
+    }
+};
+
+using ArenaPointer = std::unique_ptr<Arena, FreeArena>;
+
+ArenaPointer make_scene(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, grid_size.x };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, grid_size.y };
+    std::uniform_int_distribution<uint32_t> extent       { 4, 48 };
+    std::uniform_int_distribution<int32_t>  step         { -8, 8 };
+
+    const auto memory = std::aligned_alloc( 16, arena_size(pattern_count) );
+    const auto arena  = make_arena(memory, pattern_count);
+
+    // • Lattices that leave the grid are rejected (see validate); draw
+    //   others until pattern_count fit
+    //
+    while (arena->patterns.count < pattern_count) {
+
+        const auto left = x_coordinate(generator);
+        const auto top  = y_coordinate(generator);
+
+        append( *arena, {
+            .grid_size   = grid_size,
+            .base_region = { left, top, left + extent(generator), top + extent(generator) },
+            .offset      = { step(generator), step(generator) },
+            .count       = instance_count,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        } );
+    }
+
+    return ArenaPointer { arena };
+}
+
+// • As cull_instances in Shaders.metal: every instance of the arena, each
+//   finding its pattern with a binary search
+//
+void cull_every_instance( const Arena& arena, geometry::TextureRect viewport,
+                          std::vector<uint32_t>& visible_instances )
+{
+    visible_instances.clear();
+
+    const auto records = patterns(arena);
+    const auto first   = first_instances(arena);
+
+    for (uint32_t iid = 0; iid < arena.instance_count; ++iid) {
+
+        const auto  index   = pattern_index(arena, iid);
+        const auto& pattern = records[index];
+
+        if (is_visible(instance_region(pattern, iid - first[index]), pattern.grid_size, viewport)) {
+            visible_instances.push_back(iid);
+        }
+    }
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(culling)
+{
+    std::mt19937 generator { 11 };
+
+    const auto arena = make_scene(generator);
+
+    // • Zoomed in on an eighth of the view in each dimension
+    //
+    const geometry::TextureRect viewport = { 0.4375f, 0.4375f, 0.5625f, 0.5625f };
+
+    std::vector<uint32_t> expected;
+    std::vector<uint32_t> visible;
+
+    expected.reserve(arena->instance_count);
+    visible.reserve(arena->instance_count);
+
+    const auto every_seconds = bench::measure( [&] {
+        cull_every_instance(*arena, viewport, expected);
+        bench::do_not_optimize(expected.data());
+    }, 3 );
+
+    DrawPrimitivesArguments arguments = {};
+
+    const auto ranged_seconds = bench::measure( [&] {
+        arguments = cull_instances(*arena, viewport, visible);
+        bench::do_not_optimize(visible.data());
+    } );
+
+    const auto is_match = expected == visible && arguments.instance_count == visible.size()
+                       && 4 == arguments.vertex_count;
+
+    bench::report("every instance", every_seconds, arena->instance_count);
+    bench::report("instance ranges", ranged_seconds, arena->instance_count);
+
+    std::printf( "  %s, %zu of %u visible, speedup %.0fx\n", bench::verdict(is_match),
+                 visible.size(), arena->instance_count, every_seconds / ranged_seconds );
+}
@@ -0,0 +1,172 @@
+//
+//  DirtyRegionBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/DirtyRegions.hpp>
+#include <Composition/Rasterizer.hpp>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    pattern_count     = 2000;
+constexpr uint32_t    instance_count    = 32;
+constexpr uint32_t    changes_per_frame = 4;
+constexpr uint32_t    frame_count       = 32;
+constexpr simd::uint2 grid_size         = { 3840, 2160 };
+constexpr simd::uint2 target_size       = { 1920, 1080 };
+
+Pattern make_pattern(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, grid_size.x };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, grid_size.y };
+    std::uniform_int_distribution<uint32_t> extent       { 4, 24 };
+    std::uniform_int_distribution<int32_t>  step         { -4, 4 };
+
+    const auto left = x_coordinate(generator);
+    const auto top  = y_coordinate(generator);
+
+    return {
+        .grid_size   = grid_size,
+        .base_region = { left, top, left + extent(generator), top + extent(generator) },
+        .offset      = { step(generator), step(generator) },
+        .count       = instance_count,
+        .row_count   = 1,
+        .row_offset  = { 0, 0 },
+        .nested      = 0,
+        .reserved    = 0
+    };
+}
+
+struct Frame
+{
+    std::vector<uint8_t> pixels;
+    raster::Bitmap       bitmap;
+
+    Frame(void)
+        : pixels( raster::buffer_size(target_size.x, target_size.y) ),
+          bitmap { pixels.data(), target_size.x, target_size.y, raster::bytes_per_row(target_size.x) }
+    {
+    }
+};
+
+// • Move a pattern by a few grid units, as when dragging it
+//
+Pattern nudge(Pattern pattern, std::mt19937& generator)
+{
+    std::uniform_int_distribution<int32_t> step { -8, 8 };
+
+    const simd::int2 offset = { step(generator), step(generator) };
+    const auto       moved  = pattern.base_region + offset;
+
+    if (moved.left < moved.right && moved.top < moved.bottom) {
+        pattern.base_region = moved;
+    }
+
+    return pattern;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+// • Each frame moves a few patterns, then redraws only the dirty regions of
+//   the previous frame and checks the result against a full draw
+//
+BENCHMARK(dirty_regions)
+{
+    std::mt19937 generator { 17 };
+    std::uniform_int_distribution<uint32_t> which { 0, pattern_count - 1 };
+
+    std::vector<Pattern> patterns(pattern_count);
+
+    for (auto& pattern : patterns) {
+        pattern = make_pattern(generator);
+    }
+
+    raster::Rasterizer rasterizer;
+    Frame              incremental;
+    Frame              full;
+
+    rasterizer.draw(patterns, incremental.bitmap);
+
+    DirtyRegions                  dirty;
+    std::vector<geometry::Region> dirty_pixels;
+
+    auto is_match       = true;
+    auto full_seconds   = 0.0;
+    auto redraw_seconds = 0.0;
+    auto full_pixels    = uint64_t { 0 };
+    auto redraw_pixels  = uint64_t { 0 };
+
+    for (uint32_t frame = 0; frame < frame_count; ++frame) {
+
+        // • Change a few patterns, recording them before and after
+        //
+        dirty.clear();
+
+        for (uint32_t change = 0; change < changes_per_frame; ++change) {
+
+            auto& pattern = patterns[ which(generator) ];
+
+            dirty.add(pattern);
+            pattern = nudge(pattern, generator);
+            dirty.add(pattern);
+        }
+
+        dirty.pixel_regions(target_size, dirty_pixels);
+
+        // • Redraw the dirty regions over the previous frame
+        //
+        redraw_seconds += bench::measure( [&] {
+            rasterizer.redraw(patterns, incremental.bitmap, dirty_pixels);
+        }, 1 );
+
+        redraw_pixels += rasterizer.touched_pixels();
+
+        full_seconds += bench::measure( [&] {
+            rasterizer.draw(patterns, full.bitmap);
+        }, 1 );
+
+        full_pixels += rasterizer.touched_pixels();
+
+        is_match = is_match && 0 == std::memcmp( incremental.pixels.data(), full.pixels.data(),
+                                                 full.pixels.size() );
+    }
+
+    bench::report("full draw", full_seconds, frame_count);
+    bench::report("dirty regions", redraw_seconds, frame_count);
+
+    std::printf( "  %s, %.1f%% of the pixels touched, speedup %.1fx\n",
+                 bench::verdict(is_match, "bit-identical"),
+                 100.0 * static_cast<double>(redraw_pixels) / static_cast<double>(full_pixels),
+                 full_seconds / redraw_seconds );
+}
@@ -0,0 +1,190 @@
+//
+//  FrameExportBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/FrameExport.hpp>
+
+#include <random>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    frame_count = 30;
+constexpr simd::uint2 frame_size  = { 1920, 1080 };
+
+std::vector<Pattern> make_patterns(void)
+{
+    std::mt19937 generator { 43 };
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, frame_size.x - 120 };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, frame_size.y - 120 };
+    std::uniform_int_distribution<uint32_t> extent       { 4, 80 };
+
+    std::vector<Pattern> patterns(200);
+
+    for (auto& pattern : patterns) {
+
+        const auto left = x_coordinate(generator);
+        const auto top  = y_coordinate(generator);
+
+        pattern = {
+            .grid_size   = frame_size,
+            .base_region = { left, top, left + extent(generator), top + extent(generator) },
+            .offset      = { 1, 0 },
+            .count       = 20,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        };
+    }
+
+    return patterns;
+}
+
+// • Draw frame_count frames and write them to `descriptor`, one after the
+//   other on this thread
+//
+bool export_serially(raster::Rasterizer& rasterizer, std::span<const Pattern> patterns,
+                     raster::FrameEncoding encoding, int descriptor)
+{
+    const auto width  = frame_size.x;
+    const auto height = frame_size.y;
+
+    std::vector<uint8_t> pixels( raster::buffer_size(width, height) );
+    std::vector<uint8_t> encoded( raster::png_size(width, height) );
+
+    const raster::Bitmap frame = { pixels.data(), width, height, raster::bytes_per_row(width) };
+
+    auto is_written = true;
+
+    for (uint32_t index = 0; index < frame_count; ++index) {
+
+        rasterizer.draw(patterns, frame);
+
+        if (raster::FrameEncoding::png == encoding) {
+            raster::encode_png(frame, encoded.data());
+            is_written &= static_cast<ssize_t>( encoded.size() ) == ::write(descriptor, encoded.data(), encoded.size());
+        } else {
+            for (uint32_t y = 0; y < height; ++y) {
+                is_written &= static_cast<ssize_t>(4 * width) == ::write(descriptor, raster::row(frame, y), 4 * width);
+            }
+        }
+    }
+
+    return is_written;
+}
+
+// • As export_serially, through a FrameExporter
+//
+bool export_pipelined(raster::Rasterizer& rasterizer, std::span<const Pattern> patterns,
+                      raster::FrameEncoding encoding, int descriptor)
+{
+    raster::FrameExporter exporter { descriptor, frame_size, raster::PixelFormat::bgra8Unorm, encoding };
+
+    for (uint32_t index = 0; index < frame_count; ++index) {
+
+        rasterizer.draw( patterns, exporter.begin_frame() );
+        exporter.end_frame();
+    }
+
+    return exporter.finish() && frame_count == exporter.frames_written();
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+// • PNG encoding of a 1080p frame, per pixel
+//
+BENCHMARK(png_encode)
+{
+    const auto width  = frame_size.x;
+    const auto height = frame_size.y;
+
+    std::vector<uint8_t> pixels( raster::buffer_size(width, height), 0x80 );
+    std::vector<uint8_t> encoded( raster::png_size(width, height) );
+
+    const raster::Bitmap frame = { pixels.data(), width, height, raster::bytes_per_row(width) };
+
+    const auto seconds = bench::measure( [&] {
+        raster::encode_png(frame, encoded.data());
+    }, 5 );
+
+    bench::report("1080p", seconds, uint64_t { width } * height);
+}
+
+// • 1080p frames drawn by the CPU rasterizer and written to /dev/null, per
+//   frame: drawing then writing each frame, against writing each on the
+//   exporter's thread while the next is drawn
+//
+BENCHMARK(frame_export)
+{
+    const auto patterns   = make_patterns();
+    const auto descriptor = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+    if (descriptor < 0) {
+        std::printf("  unable to open /dev/null\n");
+        return;
+    }
+
+    raster::Rasterizer rasterizer;
+
+    constexpr std::pair<const char*, raster::FrameEncoding> encodings[] = {
+        { "png", raster::FrameEncoding::png },
+        { "raw", raster::FrameEncoding::raw }
+    };
+
+    for (const auto& [name, encoding] : encodings) {
+
+        auto is_written = true;
+
+        const auto serial_seconds = bench::measure( [&] {
+            is_written &= export_serially(rasterizer, patterns, encoding, descriptor);
+        }, 3 );
+
+        const auto pipelined_seconds = bench::measure( [&] {
+            is_written &= export_pipelined(rasterizer, patterns, encoding, descriptor);
+        }, 3 );
+
+        char label[32];
+
+        std::snprintf(label, sizeof(label), "%s: serial", name);
+        bench::report(label, serial_seconds, frame_count);
+
+        std::snprintf(label, sizeof(label), "%s: pipelined", name);
+        bench::report(label, pipelined_seconds, frame_count);
+
+        std::printf( "  %s: %s, speedup %.2fx\n", name, bench::verdict(is_written, "written", "WRITE FAILED"),
+                     serial_seconds / pipelined_seconds );
+    }
+
+    ::close(descriptor);
+}
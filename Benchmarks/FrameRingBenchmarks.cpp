@@ -0,0 +1,145 @@
+//
+//  FrameRingBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/Arena.hpp>
+#include <Data/FrameRing.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+//===------------------------------------------------------------------------===
+// • Frames (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t pattern_capacity = 16 * 1024;
+constexpr uint32_t frame_count      = 400;
+
+// • Time the consumer spends on each frame after reading it, standing in
+//   for the GPU
+//
+constexpr auto gpu_time = std::chrono::microseconds { 400 };
+
+// • Every pattern of frame `frame` records the frame, so a slot overwritten
+//   while in flight shows up as a mixture
+//
+void write_frame(uint8_t* memory, uint32_t frame)
+{
+    const auto arena = make_arena(memory, pattern_capacity);
+
+    for (uint32_t index = 0; index < pattern_capacity; ++index) {
+
+        append( *arena, {
+            .grid_size   = { pattern_capacity + frame_count, 2 * frame_count },
+            .base_region = { index, frame, index + 1, frame + 1 },
+            .offset      = { 1, 1 },
+            .count       = frame + 1,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        } );
+    }
+}
+
+bool read_frame(const uint8_t* memory, uint32_t frame)
+{
+    const auto& arena   = *reinterpret_cast<const Arena*>(memory);
+    const auto  records = patterns(arena);
+
+    auto is_valid = pattern_capacity == arena.patterns.count;
+
+    for (uint32_t index = 0; is_valid && index < arena.patterns.count; ++index) {
+        is_valid = frame + 1 == records[index].count && frame == records[index].base_region.top;
+    }
+
+    return is_valid;
+}
+
+// • One producer writing frames, one consumer reading them and completing
+//   each after gpu_time. Returns whether every frame arrived intact and in
+//   order
+//
+template <uint32_t Count_>
+bool run_frames(void)
+{
+    data::FrameRing<Count_>    ring;
+    data::FrameBuffers<Count_> buffers { arena_size(pattern_capacity) };
+
+    std::atomic<bool> is_valid = buffers.is_valid();
+
+    std::thread consumer { [&] {
+        for (uint32_t frame = 0; frame < frame_count; ++frame) {
+
+            const auto slot = ring.consume();
+
+            if (!read_frame(buffers[slot], frame)) {
+                is_valid = false;
+            }
+
+            std::this_thread::sleep_for(gpu_time);
+
+            ring.complete();
+        }
+    } };
+
+    for (uint32_t frame = 0; frame < frame_count; ++frame) {
+
+        const auto slot = ring.acquire();
+
+        write_frame(buffers[slot], frame);
+
+        ring.commit();
+    }
+
+    consumer.join();
+
+    return is_valid && frame_count == ring.completed_frames();
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+// • A single buffer stalls the host for every frame in flight; three let it
+//   write the next frame while earlier ones are read
+//
+BENCHMARK(frame_ring)
+{
+    auto single_valid = false;
+    auto triple_valid = false;
+
+    const auto single_seconds = bench::measure( [&] { single_valid = run_frames<1>(); }, 3 );
+    const auto triple_seconds = bench::measure( [&] { triple_valid = run_frames<3>(); }, 3 );
+
+    bench::report("single buffer", single_seconds, frame_count);
+    bench::report("triple buffer", triple_seconds, frame_count);
+
+    std::printf( "  %s, speedup %.2fx\n", bench::verdict(single_valid && triple_valid, "frames intact", "CORRUPTED"),
+                 single_seconds / triple_seconds );
+}
@@ -0,0 +1,278 @@
+//
+//  GeometryBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Graphics/GeometryBatch.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr size_t      rect_count  = 1 << 20;
+constexpr simd::uint2 target_size = { 3840, 2160 };
+
+const std::vector<geometry::Region>& regions(void)
+{
+    static const auto values = [] {
+
+        std::mt19937 generator { 7 };
+        std::uniform_int_distribution<uint32_t> x_coordinate { 0, target_size.x };
+        std::uniform_int_distribution<uint32_t> y_coordinate { 0, target_size.y };
+
+        std::vector<geometry::Region> result(rect_count);
+
+        for (auto& region : result) {
+
+            const auto x0 = x_coordinate(generator), x1 = x_coordinate(generator);
+            const auto y0 = y_coordinate(generator), y1 = y_coordinate(generator);
+
+            region = {
+                .left   = std::min(x0, x1),
+                .top    = std::min(y0, y1),
+                .right  = std::max(x0, x1),
+                .bottom = std::max(y0, y1)
+            };
+        }
+
+        return result;
+    }();
+
+    return values;
+}
+
+template <typename Type_>
+bool is_identical(const std::vector<Type_>& lhs, const std::vector<Type_>& rhs)
+{
+    return lhs.size() == rhs.size()
+        && 0 == std::memcmp(lhs.data(), rhs.data(), lhs.size()*sizeof(Type_));
+}
+
+// • Time the scalar loop against both batch precisions and check that the
+//   exact batch matches the scalar results bit for bit
+//
+template <typename Rect_, typename Scalar_, typename Batch_>
+void compare(Scalar_&& scalar, Batch_&& batch)
+{
+    std::vector<Rect_> expected(rect_count);
+    std::vector<Rect_> exact(rect_count);
+    std::vector<Rect_> fast(rect_count);
+
+    const auto scalar_seconds = bench::measure( [&] { scalar(expected); bench::do_not_optimize(expected[0]); } );
+    const auto exact_seconds  = bench::measure( [&] { batch(exact, geometry::BatchPrecision::exact); bench::do_not_optimize(exact[0]); } );
+    const auto fast_seconds   = bench::measure( [&] { batch(fast, geometry::BatchPrecision::fast); bench::do_not_optimize(fast[0]); } );
+
+    bench::report("scalar", scalar_seconds, rect_count);
+    bench::report(geometry::batch_implementation(), exact_seconds, rect_count);
+    bench::report("fast", fast_seconds, rect_count);
+
+    std::printf( "  exact %s, speedup %.2fx (fast %.2fx)\n",
+                 bench::verdict(is_identical(expected, exact), "bit-identical"),
+                 scalar_seconds / exact_seconds, scalar_seconds / fast_seconds );
+}
+
+// • Coverage through float device coordinates, as the CPU rasterizer
+//   computed it before geometry::covered_pixels
+//
+uint32_t float_first_pixel_at(float edge, uint32_t extent)
+{
+    const auto first = std::ceil(edge - 0.5f);
+
+    if (!(0.0f < first)) {
+        return 0;
+    }
+
+    return (static_cast<float>(extent) < first) ? extent : static_cast<uint32_t>(first);
+}
+
+geometry::Region float_covered_pixels(geometry::Region region, simd::uint2 grid_size, simd::uint2 pixel_size)
+{
+    const auto rect   = geometry::make_device_rect(region, grid_size);
+    const auto pixels = geometry::make_rectangle(rect, pixel_size);
+
+    const auto left   = float_first_pixel_at(pixels.left,   pixel_size.x);
+    const auto top    = float_first_pixel_at(pixels.top,    pixel_size.y);
+    const auto right  = float_first_pixel_at(pixels.right,  pixel_size.x);
+    const auto bottom = float_first_pixel_at(pixels.bottom, pixel_size.y);
+
+    return { left, top, std::max(left, right), std::max(top, bottom) };
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(geometry_device_rects)
+{
+    compare<geometry::DeviceRect>(
+        [](std::vector<geometry::DeviceRect>& rects) {
+            for (size_t index = 0; index < rect_count; ++index) {
+                rects[index] = geometry::make_device_rect(regions()[index], target_size);
+            }
+        },
+        [](std::vector<geometry::DeviceRect>& rects, geometry::BatchPrecision precision) {
+            geometry::make_device_rects(regions(), target_size, rects, precision);
+        } );
+}
+
+BENCHMARK(geometry_texture_rects)
+{
+    compare<geometry::TextureRect>(
+        [](std::vector<geometry::TextureRect>& rects) {
+            for (size_t index = 0; index < rect_count; ++index) {
+                rects[index] = geometry::make_texture_rect(regions()[index], target_size);
+            }
+        },
+        [](std::vector<geometry::TextureRect>& rects, geometry::BatchPrecision precision) {
+            geometry::make_texture_rects(regions(), target_size, rects, precision);
+        } );
+}
+
+BENCHMARK(geometry_rectangles)
+{
+    std::vector<geometry::DeviceRect> device_rects(rect_count);
+
+    geometry::make_device_rects(regions(), target_size, device_rects);
+
+    compare<geometry::Rectangle>(
+        [&](std::vector<geometry::Rectangle>& rects) {
+            for (size_t index = 0; index < rect_count; ++index) {
+                rects[index] = geometry::make_rectangle(device_rects[index], target_size);
+            }
+        },
+        [&](std::vector<geometry::Rectangle>& rects, geometry::BatchPrecision) {
+            geometry::make_rectangles(device_rects, target_size, rects);
+        } );
+}
+
+BENCHMARK(geometry_size_to_fit)
+{
+    constexpr simd::float2 aspect = { 16.0f, 9.0f };
+
+    std::vector<geometry::Rectangle> rects(rect_count);
+
+    geometry::make_rectangles(regions(), rects);
+
+    compare<geometry::Rectangle>(
+        [&](std::vector<geometry::Rectangle>& fitted) {
+            for (size_t index = 0; index < rect_count; ++index) {
+                fitted[index] = geometry::size_to_fit(aspect, rects[index]);
+            }
+        },
+        [&](std::vector<geometry::Rectangle>& fitted, geometry::BatchPrecision) {
+            geometry::size_to_fit(aspect, rects, fitted);
+        } );
+}
+
+// • Per-pattern transforms: divides per coordinate against one
+//   multiply-add, which the fast batch matches bit for bit
+//
+BENCHMARK(geometry_device_transform)
+{
+    std::vector<geometry::DeviceRect> divided(rect_count);
+    std::vector<geometry::DeviceRect> transformed(rect_count);
+    std::vector<geometry::DeviceRect> fast(rect_count);
+
+    const auto divide_seconds = bench::measure( [&] {
+
+        for (size_t index = 0; index < rect_count; ++index) {
+            divided[index] = geometry::make_device_rect(regions()[index], target_size);
+        }
+
+        bench::do_not_optimize(divided[0]);
+    } );
+
+    const auto transform_seconds = bench::measure( [&] {
+
+        const auto transform = geometry::make_device_transform(target_size);
+
+        for (size_t index = 0; index < rect_count; ++index) {
+            transformed[index] = geometry::make_device_rect(regions()[index], transform);
+        }
+
+        bench::do_not_optimize(transformed[0]);
+    } );
+
+    geometry::make_device_rects(regions(), target_size, fast, geometry::BatchPrecision::fast);
+
+    size_t rounded = 0;
+
+    for (size_t index = 0; index < rect_count; ++index) {
+        rounded += (divided[index] == transformed[index]) ? 0 : 1;
+    }
+
+    bench::report("scalar: divide", divide_seconds, rect_count);
+    bench::report("scalar: transform", transform_seconds, rect_count);
+
+    std::printf( "  fast batch %s, %zu of %zu rects differ from dividing in the last bit\n",
+                 bench::verdict(is_identical(transformed, fast), "bit-identical"), rounded, rect_count );
+}
+
+// • Pixel edges placed through float device coordinates, as the CPU
+//   rasterizer used to, against fixed point. At 2:1 every odd coordinate
+//   puts an edge exactly on a pixel centre, where float rounding decides
+//
+BENCHMARK(geometry_pixel_coverage)
+{
+    constexpr simd::uint2 pixel_size = { 1920, 1080 };
+
+    std::vector<geometry::Region> float_pixels(rect_count);
+    std::vector<geometry::Region> fixed_pixels(rect_count);
+
+    const auto float_seconds = bench::measure( [&] {
+
+        for (size_t index = 0; index < rect_count; ++index) {
+            float_pixels[index] = float_covered_pixels(regions()[index], target_size, pixel_size);
+        }
+
+        bench::do_not_optimize(float_pixels[0]);
+    } );
+
+    const auto fixed_seconds = bench::measure( [&] {
+
+        for (size_t index = 0; index < rect_count; ++index) {
+            fixed_pixels[index] = geometry::covered_pixels(regions()[index], target_size, pixel_size);
+        }
+
+        bench::do_not_optimize(fixed_pixels[0]);
+    } );
+
+    size_t moved = 0;
+
+    for (size_t index = 0; index < rect_count; ++index) {
+        moved += (float_pixels[index] == fixed_pixels[index]) ? 0 : 1;
+    }
+
+    bench::report("float", float_seconds, rect_count);
+    bench::report("fixed point", fixed_seconds, rect_count);
+
+    std::printf( "  %zu of %zu regions have an edge placed differently by float rounding\n",
+                 moved, rect_count );
+}
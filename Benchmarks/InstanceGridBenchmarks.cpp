@@ -0,0 +1,267 @@
+//
+//  InstanceGridBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/InstanceGrid.hpp>
+
+#include <cmath>
+#include <optional>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    pattern_count         = 1000;
+constexpr uint32_t    instances_per_pattern = 1000;
+constexpr uint32_t    query_count           = 1000;
+constexpr simd::uint2 grid_size             = { 3840, 2160 };
+
+std::vector<Pattern> make_patterns(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, grid_size.x };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, grid_size.y };
+    std::uniform_int_distribution<uint32_t> extent       { 4, 48 };
+    std::uniform_int_distribution<int32_t>  step         { -8, 8 };
+
+    std::vector<Pattern> patterns(pattern_count);
+
+    for (auto& pattern : patterns) {
+
+        const auto left = x_coordinate(generator);
+        const auto top  = y_coordinate(generator);
+
+        pattern = {
+            .grid_size   = grid_size,
+            .base_region = { left, top, left + extent(generator), top + extent(generator) },
+            .offset      = { step(generator), step(generator) },
+            .count       = instances_per_pattern,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        };
+    }
+
+    return patterns;
+}
+
+std::vector<simd::float2> make_points(std::mt19937& generator)
+{
+    std::uniform_real_distribution<float> coordinate { 0.0f, 1.0f };
+
+    std::vector<simd::float2> points(query_count);
+
+    for (auto& point : points) {
+        point = { coordinate(generator), coordinate(generator) };
+    }
+
+    return points;
+}
+
+//===------------------------------------------------------------------------===
+// • Brute force: every instance of every pattern
+//===------------------------------------------------------------------------===
+
+std::optional<uint32_t> linear_hit_test(std::span<const Pattern> patterns, simd::float2 point)
+{
+    std::optional<uint32_t> topmost;
+    uint32_t                first = 0;
+
+    for (const auto& pattern : patterns) {
+
+        const auto x = point.x * static_cast<float>(pattern.grid_size.x);
+        const auto y = point.y * static_cast<float>(pattern.grid_size.y);
+
+        if ( 0.0f <= x && x < static_cast<float>(pattern.grid_size.x)
+             && 0.0f <= y && y < static_cast<float>(pattern.grid_size.y) ) {
+
+            const simd::uint2 grid_point = { static_cast<uint32_t>(x), static_cast<uint32_t>(y) };
+
+            for (uint32_t index = 0; index < pattern.count; ++index) {
+                if (geometry::contains(instance_region(pattern, index), grid_point)) {
+                    topmost = first + index;
+                }
+            }
+        }
+
+        first += pattern.count;
+    }
+
+    return topmost;
+}
+
+void linear_instances_in( std::span<const Pattern> patterns, geometry::TextureRect rect,
+                          std::vector<uint32_t>& instances )
+{
+    instances.clear();
+
+    uint32_t first = 0;
+
+    for (const auto& pattern : patterns) {
+
+        const auto grid   = geometry::make_float2(pattern.grid_size);
+        const auto bounds = geometry::Region { 0, 0, pattern.grid_size.x, pattern.grid_size.y };
+        const auto query  = geometry::intersection( bounds, {
+            .left   = static_cast<uint32_t>( std::max(0.0f, std::floor(rect.left * grid.x)) ),
+            .top    = static_cast<uint32_t>( std::max(0.0f, std::floor(rect.top * grid.y)) ),
+            .right  = static_cast<uint32_t>( std::max(0.0f, std::ceil(rect.right * grid.x)) ),
+            .bottom = static_cast<uint32_t>( std::max(0.0f, std::ceil(rect.bottom * grid.y)) )
+        } );
+
+        for (uint32_t index = 0; index < pattern.count; ++index) {
+
+            const auto region = geometry::intersection(instance_region(pattern, index), bounds);
+
+            if (!geometry::is_empty( geometry::intersection(region, query) )) {
+                instances.push_back(first + index);
+            }
+        }
+
+        first += pattern.count;
+    }
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(instance_grid_hit_test)
+{
+    std::mt19937 generator { 5 };
+
+    auto       patterns = make_patterns(generator);
+    const auto points   = make_points(generator);
+
+    InstanceGrid grid;
+
+    const auto build_seconds = bench::measure( [&] { grid.build(patterns); }, 1 );
+
+    std::vector<std::optional<uint32_t>> linear_hits(query_count);
+    std::vector<std::optional<uint32_t>> grid_hits(query_count);
+
+    const auto linear_seconds = bench::measure( [&] {
+        for (uint32_t index = 0; index < query_count; ++index) {
+            linear_hits[index] = linear_hit_test(patterns, points[index]);
+        }
+    }, 1 );
+
+    const auto grid_seconds = bench::measure( [&] {
+        for (uint32_t index = 0; index < query_count; ++index) {
+            grid_hits[index] = grid.hit_test(points[index]);
+        }
+    } );
+
+    // • Move a tenth of the patterns, then check the updated index again
+    //
+    std::uniform_int_distribution<int32_t> step { -8, 8 };
+
+    const auto update_seconds = bench::measure( [&] {
+        for (uint32_t index = 0; index < pattern_count; index += 10) {
+
+            patterns[index].offset = { step(generator), step(generator) };
+            grid.update(index, patterns[index]);
+        }
+    }, 1 );
+
+    auto is_match = (linear_hits == grid_hits);
+
+    for (uint32_t index = 0; index < query_count; ++index) {
+        is_match = is_match && linear_hit_test(patterns, points[index]) == grid.hit_test(points[index]);
+    }
+
+    bench::report("build", build_seconds, grid.instance_count());
+    bench::report("linear hit test", linear_seconds, query_count);
+    bench::report("grid hit test", grid_seconds, query_count);
+    bench::report("update 100 patterns", update_seconds, 100 * instances_per_pattern);
+
+    std::printf( "  %s, speedup %.0fx\n", bench::verdict(is_match),
+                 linear_seconds / grid_seconds );
+}
+
+BENCHMARK(instance_grid_rect_query)
+{
+    std::mt19937 generator { 9 };
+
+    const auto   patterns = make_patterns(generator);
+    const auto   corners  = make_points(generator);
+    InstanceGrid grid { patterns };
+
+    // • Viewports an eighth of the view on each side
+    //
+    const auto viewport = [&corners](uint32_t index) -> geometry::TextureRect {
+
+        const auto corner = corners[index] * 0.875f;
+
+        return { corner.x, corner.y, corner.x + 0.125f, corner.y + 0.125f };
+    };
+
+    constexpr uint32_t viewport_count = query_count / 10;
+
+    std::vector<uint32_t> linear_instances, grid_instances;
+
+    size_t linear_total = 0;
+    size_t grid_total   = 0;
+    auto   is_match     = true;
+
+    const auto linear_seconds = bench::measure( [&] {
+
+        linear_total = 0;
+
+        for (uint32_t index = 0; index < viewport_count; ++index) {
+
+            linear_instances_in(patterns, viewport(index), linear_instances);
+            linear_total += linear_instances.size();
+        }
+    }, 1 );
+
+    const auto grid_seconds = bench::measure( [&] {
+
+        grid_total = 0;
+
+        for (uint32_t index = 0; index < viewport_count; ++index) {
+
+            grid.instances_in(viewport(index), grid_instances);
+            grid_total += grid_instances.size();
+        }
+    } );
+
+    for (uint32_t index = 0; index < viewport_count; ++index) {
+
+        linear_instances_in(patterns, viewport(index), linear_instances);
+        grid.instances_in(viewport(index), grid_instances);
+
+        is_match = is_match && linear_instances == grid_instances;
+    }
+
+    bench::report("linear rect query", linear_seconds, viewport_count);
+    bench::report("grid rect query", grid_seconds, viewport_count);
+
+    std::printf( "  %s (%zu instances), speedup %.0fx\n",
+                 bench::verdict(is_match && linear_total == grid_total),
+                 grid_total, linear_seconds / grid_seconds );
+}
@@ -0,0 +1,250 @@
+//
+//  JobSystemBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/Rasterizer.hpp>
+#include <Composition/TileBinning.hpp>
+#include <Data/JobSystem.hpp>
+
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    pattern_count         = 2000;
+constexpr uint32_t    instances_per_pattern = 500;
+constexpr simd::uint2 grid_size             = { 3840, 2160 };
+constexpr simd::uint2 target_size           = { 3840, 2160 };
+
+std::vector<Pattern> make_patterns(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, grid_size.x - 100 };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, grid_size.y - 100 };
+    std::uniform_int_distribution<uint32_t> extent       { 2, 24 };
+    std::uniform_int_distribution<int32_t>  step         { -9, 9 };
+
+    std::vector<Pattern> patterns(pattern_count);
+
+    for (auto& pattern : patterns) {
+
+        const auto left = x_coordinate(generator);
+        const auto top  = y_coordinate(generator);
+
+        pattern = {
+            .grid_size   = grid_size,
+            .base_region = { left, top, left + extent(generator), top + extent(generator) },
+            .offset      = { step(generator), step(generator) },
+            .count       = instances_per_pattern,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        };
+    }
+
+    return patterns;
+}
+
+// • Fork / join down to n < 16
+//
+constexpr uint32_t fibonacci_leaf = 16;
+
+constexpr uint64_t fork_count(uint32_t n)
+{
+    return (n < fibonacci_leaf) ? 0 : 1 + fork_count(n - 1) + fork_count(n - 2);
+}
+
+uint64_t fibonacci(data::JobSystem& jobs, uint32_t n)
+{
+    if (n < fibonacci_leaf) {
+
+        uint64_t a = 0, b = 1;
+
+        for (uint32_t i = 0; i < n; ++i) {
+            b = a + b;
+            a = b - a;
+        }
+
+        return a;
+    }
+
+    uint64_t first = 0, second = 0;
+
+    jobs.fork_join( [&] { first  = fibonacci(jobs, n - 1); },
+                    [&] { second = fibonacci(jobs, n - 2); } );
+
+    return first + second;
+}
+
+// • Worker counts to measure: powers of two up to the hardware threads,
+//   and the hardware threads themselves
+//
+std::vector<uint32_t> worker_counts(void)
+{
+    const auto hardware = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<uint32_t> counts;
+
+    for (uint32_t count = 1; count < hardware; count *= 2) {
+        counts.push_back(count);
+    }
+
+    counts.push_back(hardware);
+
+    return counts;
+}
+
+struct Totals
+{
+    double      busy;
+    double      idle;
+    uint64_t    jobs;
+    uint64_t    steals;
+    uint64_t    failed_steals;
+};
+
+Totals totals(const data::JobSystem& jobs)
+{
+    Totals result = { };
+
+    for (uint32_t worker = 0; worker < jobs.worker_count(); ++worker) {
+
+        const auto statistics = jobs.statistics(worker);
+
+        result.busy          += 1e-9 * statistics.busy_nanoseconds;
+        result.idle          += 1e-9 * statistics.idle_nanoseconds;
+        result.jobs          += statistics.jobs;
+        result.steals        += statistics.steals;
+        result.failed_steals += statistics.failed_steals;
+    }
+
+    return result;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(job_system_overhead)
+{
+    // • At least two workers, since one runs everything inline
+    //
+    data::JobSystem jobs { std::max(2u, std::thread::hardware_concurrency()) };
+
+    constexpr size_t count = 1 << 20;
+
+    const auto for_seconds = bench::measure( [&] {
+        jobs.parallel_for( count, 1, [](size_t first, size_t last) {
+            bench::do_not_optimize(first + last);
+        } );
+    }, 3 );
+
+    uint64_t result = 0;
+
+    const auto fork_seconds = bench::measure( [&] {
+        result = fibonacci(jobs, 32);
+    }, 3 );
+
+    bench::do_not_optimize(result);
+
+    bench::report("parallel_for: 1 index per job", for_seconds, count);
+    bench::report("fork_join: fibonacci(32)", fork_seconds, fork_count(32));
+
+    std::printf( "  %u workers, %.1f ns per job\n", jobs.worker_count(), 1e9 * for_seconds / count );
+}
+
+BENCHMARK(job_system_scaling)
+{
+    std::mt19937 generator { 29 };
+
+    const auto patterns = make_patterns(generator);
+
+    std::vector<uint8_t> reference_pixels( raster::buffer_size(target_size.x, target_size.y) );
+    std::vector<uint8_t> pixels( reference_pixels.size() );
+
+    const raster::Bitmap reference = {
+        reference_pixels.data(), target_size.x, target_size.y, raster::bytes_per_row(target_size.x)
+    };
+
+    const raster::Bitmap target = {
+        pixels.data(), target_size.x, target_size.y, raster::bytes_per_row(target_size.x)
+    };
+
+    std::printf( "  %u patterns x %u instances, %ux%u, expand + bin + shade per frame\n",
+                 pattern_count, instances_per_pattern, target_size.x, target_size.y );
+
+    auto baseline = 0.0;
+
+    for (const auto count : worker_counts()) {
+
+        data::JobSystem    jobs { count };
+        raster::Rasterizer rasterizer { jobs };
+        raster::TileBinner binner { jobs };
+
+        const auto frame_seconds = bench::measure( [&] {
+            binner.bin(patterns, target_size);
+            binner.draw(target);
+        }, 5 );
+
+        rasterizer.draw(patterns, reference);
+
+        const auto is_match = 0 == std::memcmp( reference_pixels.data(), pixels.data(), pixels.size() );
+
+        // • Counters from one more frame
+        //
+        jobs.reset_statistics();
+
+        binner.bin(patterns, target_size);
+        binner.draw(target);
+
+        const auto worker_totals = totals(jobs);
+        const auto total_time    = worker_totals.busy + worker_totals.idle;
+
+        baseline = (1 == count) ? frame_seconds : baseline;
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%u workers", count);
+
+        bench::report(name, frame_seconds, binner.statistics().instance_count);
+
+        if (1 == count) {
+            std::printf( "    %s, runs inline\n", bench::verdict(is_match, "bit-identical") );
+            continue;
+        }
+
+        std::printf( "    %s, speedup %.2fx (efficiency %.0f%%), busy %.0f%%, %llu jobs, %llu steals, %llu failed\n",
+                     bench::verdict(is_match, "bit-identical"),
+                     (0.0 < baseline) ? baseline / frame_seconds : 0.0,
+                     (0.0 < baseline) ? 100.0 * baseline / (frame_seconds * count) : 0.0,
+                     (0.0 < total_time) ? 100.0 * worker_totals.busy / total_time : 0.0,
+                     static_cast<unsigned long long>(worker_totals.jobs),
+                     static_cast<unsigned long long>(worker_totals.steals),
+                     static_cast<unsigned long long>(worker_totals.failed_steals) );
+    }
+}
@@ -0,0 +1,242 @@
+//
+//  LatticeBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/Culling.hpp>
+#include <Composition/Pattern.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//
+//  - The same million 3x2 tiles of a 4000x4000 grid three ways: a single
+//    1000x1000 lattice, a thousand one-row patterns, and a 100x100 lattice
+//    of cells each nesting a 10x10 lattice
+//
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    tiles_across = 1000;
+constexpr simd::uint2 grid_size    = { 4000, 4000 };
+
+struct FreeArena
+{
+    void operator () (Arena* arena) const noexcept
+    {
+        std::free(arena);
+    }
+};
+
+using ArenaPointer = std::unique_ptr<Arena, FreeArena>;
+
+ArenaPointer allocate_arena(uint32_t capacity, uint32_t nested_capacity = 0)
+{
+    const auto memory = std::aligned_alloc( 16, arena_size(capacity, nested_capacity) );
+
+    return ArenaPointer { make_arena(memory, capacity, nested_capacity) };
+}
+
+ArenaPointer make_lattice(void)
+{
+    auto arena = allocate_arena(1);
+
+    append( *arena, {
+        .grid_size   = grid_size,
+        .base_region = { 1, 1, 4, 3 },
+        .offset      = { 4, 0 },
+        .count       = tiles_across,
+        .row_count   = tiles_across,
+        .row_offset  = { 0, 4 },
+        .nested      = 0,
+        .reserved    = 0
+    } );
+
+    return arena;
+}
+
+ArenaPointer make_rows(void)
+{
+    auto arena = allocate_arena(tiles_across);
+
+    for (uint32_t row = 0; row < tiles_across; ++row) {
+        append( *arena, {
+            .grid_size   = grid_size,
+            .base_region = { 1, 1 + 4*row, 4, 3 + 4*row },
+            .offset      = { 4, 0 },
+            .count       = tiles_across,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        } );
+    }
+
+    return arena;
+}
+
+ArenaPointer make_nested(void)
+{
+    auto arena = allocate_arena(1, 1);
+
+    const auto tile = append_nested( *arena, {
+        .grid_size   = { 40, 40 },
+        .base_region = { 1, 1, 4, 3 },
+        .offset      = { 4, 0 },
+        .count       = 10,
+        .row_count   = 10,
+        .row_offset  = { 0, 4 },
+        .nested      = 0,
+        .reserved    = 0
+    } );
+
+    append( *arena, {
+        .grid_size   = grid_size,
+        .base_region = { 0, 0, 40, 40 },
+        .offset      = { 40, 0 },
+        .count       = 100,
+        .row_count   = 100,
+        .row_offset  = { 0, 40 },
+        .nested      = tile.value_or(0),
+        .reserved    = 0
+    } );
+
+    return arena;
+}
+
+// • As pattern_vertex: every instance of the arena, each finding its
+//   pattern with a binary search and decoding its index
+//
+template <typename Visit_>
+void decode_instances(const Arena& arena, Visit_&& visit)
+{
+    const auto records = patterns(arena);
+    const auto first   = first_instances(arena);
+
+    for (uint32_t iid = 0; iid < arena.instance_count; ++iid) {
+
+        const auto index = pattern_index(arena, iid);
+
+        visit( iid, instance_region(records, records[index], iid - first[index]) );
+    }
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(lattice_tiling)
+{
+    const auto lattice = make_lattice();
+    const auto rows    = make_rows();
+    const auto nested  = make_nested();
+
+    const auto instances = rows->instance_count;
+
+    // • Per-frame upload, as Composition copies the arena to a frame buffer
+    //
+    std::vector<ArenaPointer> targets;
+
+    for (const auto& arena : { lattice.get(), rows.get(), nested.get() }) {
+        targets.push_back( allocate_arena(arena->patterns.count, arena->nested_patterns.count) );
+    }
+
+    const auto copy_seconds = [&](const Arena& arena, Arena& target) {
+        return bench::measure( [&] {
+            copy_arena(target, arena);
+            bench::do_not_optimize(&target);
+        } );
+    };
+
+    const auto rows_copy    = copy_seconds(*rows, *targets[1]);
+    const auto lattice_copy = copy_seconds(*lattice, *targets[0]);
+    const auto nested_copy  = copy_seconds(*nested, *targets[2]);
+
+    // • Decoding every instance, checked against the rows
+    //
+    std::vector<geometry::Region> expected(instances);
+    std::vector<geometry::Region> decoded(instances);
+
+    const auto rows_decode = bench::measure( [&] {
+        decode_instances(*rows, [&](uint32_t iid, geometry::Region region) { expected[iid] = region; });
+        bench::do_not_optimize(expected.data());
+    }, 3 );
+
+    const auto lattice_decode = bench::measure( [&] {
+        decode_instances(*lattice, [&](uint32_t iid, geometry::Region region) { decoded[iid] = region; });
+        bench::do_not_optimize(decoded.data());
+    }, 3 );
+
+    auto is_match = lattice->instance_count == instances && nested->instance_count == instances
+                 && expected == decoded;
+
+    const auto nested_decode = bench::measure( [&] {
+        decode_instances(*nested, [&](uint32_t iid, geometry::Region region) { decoded[iid] = region; });
+        bench::do_not_optimize(decoded.data());
+    }, 3 );
+
+    // • The nested tiles come cell by cell, so compare them as a set
+    //
+    const auto by_position = [](const geometry::Region& lhs, const geometry::Region& rhs) {
+        return (lhs.top != rhs.top) ? lhs.top < rhs.top : lhs.left < rhs.left;
+    };
+
+    std::sort(decoded.begin(), decoded.end(), by_position);
+    std::sort(expected.begin(), expected.end(), by_position);
+
+    is_match = is_match && expected == decoded;
+
+    // • Culling to a zoomed-in view
+    //
+    const geometry::TextureRect viewport = { 0.4375f, 0.4375f, 0.5625f, 0.5625f };
+
+    std::vector<uint32_t> rows_visible;
+    std::vector<uint32_t> lattice_visible;
+    std::vector<uint32_t> nested_visible;
+
+    const auto rows_cull    = bench::measure( [&] { cull_instances(*rows, viewport, rows_visible); } );
+    const auto lattice_cull = bench::measure( [&] { cull_instances(*lattice, viewport, lattice_visible); } );
+    const auto nested_cull  = bench::measure( [&] { cull_instances(*nested, viewport, nested_visible); } );
+
+    is_match = is_match && rows_visible == lattice_visible && rows_visible.size() == nested_visible.size();
+
+    std::printf( "  %u instances; arena of 1000 rows %u bytes, lattice %u, nested %u\n", instances,
+                 arena_size(tiles_across), arena_size(1), arena_size(1, 1) );
+
+    bench::report("copy, 1000 rows", rows_copy, instances);
+    bench::report("copy, lattice", lattice_copy, instances);
+    bench::report("copy, nested", nested_copy, instances);
+    bench::report("decode, 1000 rows", rows_decode, instances);
+    bench::report("decode, lattice", lattice_decode, instances);
+    bench::report("decode, nested", nested_decode, instances);
+    bench::report("cull, 1000 rows", rows_cull, instances);
+    bench::report("cull, lattice", lattice_cull, instances);
+    bench::report("cull, nested", nested_cull, instances);
+
+    std::printf( "  %s, %zu visible\n", bench::verdict(is_match), lattice_visible.size() );
+}
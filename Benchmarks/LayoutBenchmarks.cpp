@@ -0,0 +1,177 @@
+//
+//  LayoutBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/Arena.hpp>
+
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    arena_count    = 4096;
+constexpr uint32_t    arena_capacity = 64;
+constexpr simd::uint2 grid_size      = { 1 << 16, 1 << 16 };
+
+using Storage = std::unique_ptr<uint8_t, decltype(&std::free)>;
+
+Pattern make_pattern(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> coordinate { 0, grid_size.x / 2 };
+    std::uniform_int_distribution<uint32_t> extent     { 1, 64 };
+    std::uniform_int_distribution<uint32_t> count      { 1, 100 };
+
+    const auto left = coordinate(generator);
+    const auto top  = coordinate(generator);
+
+    return {
+        .grid_size   = grid_size,
+        .base_region = { left, top, left + extent(generator), top + extent(generator) },
+        .offset      = { 8, 8 },
+        .count       = count(generator),
+        .row_count   = 1,
+        .row_offset  = { 0, 0 },
+        .nested      = 0,
+        .reserved    = 0
+    };
+}
+
+// • What a pass over the patterns of a frame does: total the instances and
+//   bound the base regions
+//
+struct Summary
+{
+    uint64_t            instance_count;
+    geometry::Region    bounds;
+
+    bool operator == (const Summary&) const = default;
+};
+
+void add(Summary& summary, const Pattern& pattern)
+{
+    summary.instance_count += pattern.count;
+    summary.bounds          = geometry::bounding_region(summary.bounds, pattern.base_region);
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+// • Arenas back to back in one buffer, reached through offset_by, against
+//   the same patterns in separately allocated vectors
+//
+BENCHMARK(arena_traversal)
+{
+    std::mt19937 generator { 31 };
+
+    const auto stride = arena_size(arena_capacity);
+
+    Storage buffer { static_cast<uint8_t*>( std::aligned_alloc( data::alignment, size_t { stride } * arena_count ) ),
+                     &std::free };
+
+    std::vector<std::vector<Pattern>> vectors(arena_count);
+
+    for (uint32_t index = 0; index < arena_count; ++index) {
+
+        const auto arena = make_arena(buffer.get() + size_t { stride } * index, arena_capacity);
+
+        for (uint32_t count = 0; count < arena_capacity; ++count) {
+
+            const auto pattern = make_pattern(generator);
+
+            append(*arena, pattern);
+            vectors[index].push_back(pattern);
+        }
+    }
+
+    Summary arena_summary  = { };
+    Summary vector_summary = { };
+
+    const auto arena_seconds = bench::measure( [&] {
+
+        arena_summary = { 0, vectors[0][0].base_region };
+
+        for (uint32_t index = 0; index < arena_count; ++index) {
+
+            const auto& arena = *reinterpret_cast<const Arena*>( buffer.get() + size_t { stride } * index );
+            const auto  first = patterns(arena);
+
+            for (uint32_t pattern = 0; pattern < arena.patterns.count; ++pattern) {
+                add(arena_summary, first[pattern]);
+            }
+        }
+
+        bench::do_not_optimize(arena_summary);
+    } );
+
+    const auto vector_seconds = bench::measure( [&] {
+
+        vector_summary = { 0, vectors[0][0].base_region };
+
+        for (const auto& patterns : vectors) {
+            for (const auto& pattern : patterns) {
+                add(vector_summary, pattern);
+            }
+        }
+
+        bench::do_not_optimize(vector_summary);
+    } );
+
+    // • Instance to pattern lookups through first_instances, one per pattern
+    //
+    uint64_t lookup_total = 0;
+
+    const auto lookup_seconds = bench::measure( [&] {
+
+        lookup_total = 0;
+
+        for (uint32_t index = 0; index < arena_count; ++index) {
+
+            const auto& arena = *reinterpret_cast<const Arena*>( buffer.get() + size_t { stride } * index );
+            const auto  step  = arena.instance_count / arena.patterns.count;
+
+            for (uint32_t instance = 0; instance < arena.instance_count; instance += step) {
+                lookup_total += pattern_index(arena, instance);
+            }
+        }
+
+        bench::do_not_optimize(lookup_total);
+    } );
+
+    constexpr auto pattern_total = uint64_t { arena_count } * arena_capacity;
+
+    bench::report("arenas: offset_by", arena_seconds, pattern_total);
+    bench::report("nested vectors", vector_seconds, pattern_total);
+    bench::report("arenas: pattern_index", lookup_seconds, pattern_total);
+
+    std::printf( "  %s, %u arenas of %u patterns in one %.1f MiB buffer\n",
+                 bench::verdict(arena_summary == vector_summary),
+                 arena_count, arena_capacity, size_t { stride } * arena_count / 1048576.0 );
+}
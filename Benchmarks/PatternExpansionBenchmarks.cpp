@@ -0,0 +1,106 @@
+//
+//  PatternExpansionBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+
+#include <Composition/PatternExpansion.hpp>
+#include <Composition/Rasterizer.hpp>
+
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    instances_per_pattern = 1000;
+constexpr simd::uint2 grid_size             = { 1 << 15, 1 << 15 };
+constexpr simd::uint2 target_size           = { 3840, 2160 };
+
+// • Rows of instances stacked down the grid, `instance_count` in all
+//
+std::vector<Pattern> make_patterns(uint32_t instance_count)
+{
+    std::vector<Pattern> patterns(instance_count / instances_per_pattern);
+
+    for (uint32_t index = 0; index < patterns.size(); ++index) {
+
+        const auto top = 3 * index;
+
+        patterns[index] = {
+            .grid_size   = grid_size,
+            .base_region = { 0, top, 24, top + 12 },
+            .offset      = { 32, 0 },
+            .count       = instances_per_pattern,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        };
+    }
+
+    return patterns;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+// • Instance regions in grid units, one pattern after another, and covered
+//   pixels in draw order on the job system
+//
+BENCHMARK(pattern_expansion)
+{
+    for (const uint32_t instance_count : { 1000u, 10000u, 100000u, 1000000u, 10000000u }) {
+
+        const auto patterns    = make_patterns(instance_count);
+        const auto repetitions = (instance_count < 1000000) ? 7u : 3u;
+
+        std::vector<geometry::Region> regions(instance_count);
+        std::vector<geometry::Region> pixel_regions;
+
+        const auto expand_seconds = bench::measure( [&] {
+
+            std::span<geometry::Region> rest = regions;
+
+            for (const auto& pattern : patterns) {
+                rest = rest.subspan( expand(pattern, rest) );
+            }
+
+            bench::do_not_optimize(regions.data());
+        }, repetitions );
+
+        const auto pixel_seconds = bench::measure( [&] {
+            raster::expand_pixel_regions(data::JobSystem::shared(), patterns, target_size, pixel_regions);
+            bench::do_not_optimize(pixel_regions.data());
+        }, repetitions );
+
+        char name[48];
+
+        std::snprintf(name, sizeof(name), "%u: regions", instance_count);
+        bench::report(name, expand_seconds, instance_count);
+
+        std::snprintf(name, sizeof(name), "%u: pixel regions", instance_count);
+        bench::report(name, pixel_seconds, instance_count);
+    }
+}
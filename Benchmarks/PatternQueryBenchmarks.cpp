@@ -0,0 +1,139 @@
+//
+//  PatternQueryBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/PatternQueries.hpp>
+
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+// • A diagonal run of a million instances through a large grid
+//
+constexpr Pattern long_pattern = {
+    .grid_size   = { 1 << 20, 1 << 20 },
+    .base_region = { 0, 0, 24, 16 },
+    .offset      = { 1, 1 },
+    .count       = 1 << 20,
+    .row_count   = 1,
+    .row_offset  = { 0, 0 },
+    .nested      = 0,
+    .reserved    = 0
+};
+
+constexpr uint32_t query_count = 64;
+
+InstanceRange expanded_instances_containing(const Pattern& pattern, simd::uint2 point)
+{
+    InstanceRange range = { 0, 0 };
+
+    for (uint32_t index = 0; index < pattern.count; ++index) {
+
+        if (geometry::contains(instance_region(pattern, index), point)) {
+
+            range.first = is_empty(range) ? index : range.first;
+            range.end   = index + 1;
+        }
+    }
+
+    return range;
+}
+
+InstanceRange expanded_instances_intersecting(const Pattern& pattern, geometry::Region viewport)
+{
+    InstanceRange range = { 0, 0 };
+
+    for (uint32_t index = 0; index < pattern.count; ++index) {
+
+        const auto overlap = geometry::intersection(instance_region(pattern, index), viewport);
+
+        if (!geometry::is_empty(overlap)) {
+
+            range.first = is_empty(range) ? index : range.first;
+            range.end   = index + 1;
+        }
+    }
+
+    return range;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(pattern_queries)
+{
+    std::mt19937 generator { 3 };
+    std::uniform_int_distribution<uint32_t> coordinate { 0, long_pattern.count };
+
+    std::vector<simd::uint2>      points(query_count);
+    std::vector<geometry::Region> viewports(query_count);
+
+    for (uint32_t index = 0; index < query_count; ++index) {
+
+        const auto x = coordinate(generator);
+        const auto y = x + coordinate(generator) % 32;
+
+        points[index]    = { x, y };
+        viewports[index] = { x, y, x + 1920, y + 1080 };
+    }
+
+    std::vector<InstanceRange> expanded(2 * query_count);
+    std::vector<InstanceRange> analytic(2 * query_count);
+
+    const auto expanded_seconds = bench::measure( [&] {
+        for (uint32_t index = 0; index < query_count; ++index) {
+
+            expanded[2*index]     = expanded_instances_containing(long_pattern, points[index]);
+            expanded[2*index + 1] = expanded_instances_intersecting(long_pattern, viewports[index]);
+        }
+    }, 1 );
+
+    const auto analytic_seconds = bench::measure( [&] {
+        for (uint32_t index = 0; index < query_count; ++index) {
+
+            analytic[2*index]     = row_instances_containing(long_pattern, points[index]);
+            analytic[2*index + 1] = row_instances_intersecting(long_pattern, viewports[index]);
+        }
+
+        bench::do_not_optimize(analytic[0]);
+    } );
+
+    auto is_match = true;
+
+    for (uint32_t index = 0; index < 2 * query_count; ++index) {
+        is_match = is_match && expanded[index] == analytic[index];
+    }
+
+    bench::report("expanded", expanded_seconds, 2 * query_count);
+    bench::report("analytic", analytic_seconds, 2 * query_count);
+
+    std::printf( "  %s, speedup %.0fx\n", bench::verdict(is_match),
+                 expanded_seconds / analytic_seconds );
+}
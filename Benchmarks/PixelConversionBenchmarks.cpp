@@ -0,0 +1,279 @@
+//
+//  PixelConversionBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/Rasterizer.hpp>
+#include <Graphics/PixelConversion.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr simd::uint2 frame_size  = { 1920, 1080 };
+constexpr size_t      pixel_count = size_t { frame_size.x } * frame_size.y;
+
+// • Linear channels of a 1080p frame, mostly in [0, 1] with some out of
+//   range, as an HDR canvas holds
+//
+const std::vector<float>& linear_channels(void)
+{
+    static const auto values = [] {
+
+        std::mt19937 generator { 11 };
+        std::uniform_real_distribution<float> channel { -0.125f, 1.25f };
+
+        std::vector<float> result(4 * pixel_count);
+
+        for (auto& value : result) {
+            value = channel(generator);
+        }
+
+        return result;
+    }();
+
+    return values;
+}
+
+template <typename Type_>
+bool is_identical(const std::vector<Type_>& lhs, const std::vector<Type_>& rhs)
+{
+    return lhs.size() == rhs.size()
+        && 0 == std::memcmp(lhs.data(), rhs.data(), lhs.size()*sizeof(Type_));
+}
+
+// • Time the scalar loop against the batch function and check that they
+//   match bit for bit
+//
+template <typename Output_, typename Scalar_, typename Batch_>
+void compare(const char* name, size_t count, size_t items, Scalar_&& scalar, Batch_&& batch)
+{
+    std::vector<Output_> expected(count);
+    std::vector<Output_> batched(count);
+
+    const auto scalar_seconds = bench::measure( [&] { scalar(expected); bench::do_not_optimize(expected[0]); } );
+    const auto batch_seconds  = bench::measure( [&] { batch(batched); bench::do_not_optimize(batched[0]); } );
+
+    char label[64];
+
+    std::snprintf(label, sizeof(label), "%s: scalar", name);
+    bench::report(label, scalar_seconds, items);
+
+    std::snprintf(label, sizeof(label), "%s: %s", name, pixels::conversion_implementation());
+    bench::report(label, batch_seconds, items);
+
+    std::printf( "  %s: %s, speedup %.2fx\n", name, bench::verdict(is_identical(expected, batched), "bit-identical"),
+                 scalar_seconds / batch_seconds );
+}
+
+struct Target
+{
+    std::vector<uint8_t> storage;
+    raster::Bitmap       bitmap;
+
+    explicit Target(raster::PixelFormat format)
+        : storage( raster::buffer_size(format, frame_size.x, frame_size.y) ),
+          bitmap { storage.data(), frame_size.x, frame_size.y, raster::bytes_per_row(format, frame_size.x), format }
+    {
+    }
+};
+
+std::vector<Pattern> make_patterns(void)
+{
+    std::mt19937 generator { 47 };
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, frame_size.x - 120 };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, frame_size.y - 120 };
+    std::uniform_int_distribution<uint32_t> extent       { 4, 80 };
+    std::uniform_int_distribution<int32_t>  step         { -1, 1 };
+
+    std::vector<Pattern> patterns(400);
+
+    for (auto& pattern : patterns) {
+
+        const auto left = x_coordinate(generator);
+        const auto top  = y_coordinate(generator);
+
+        pattern = {
+            .grid_size   = { 1280, 720 },
+            .base_region = { left * 2/3, top * 2/3, (left + extent(generator)) * 2/3, (top + extent(generator)) * 2/3 },
+            .offset      = { step(generator), step(generator) },
+            .count       = 100,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        };
+    }
+
+    return patterns;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+// • Float to half and back over the channels of a 1080p frame, per pixel
+//
+BENCHMARK(half_conversion)
+{
+    const auto& floats = linear_channels();
+
+    std::vector<uint16_t> halves(floats.size());
+
+    pixels::make_halves(floats, halves);
+
+    compare<uint16_t>( "to half", floats.size(), pixel_count,
+        [&](std::vector<uint16_t>& output) {
+            for (size_t index = 0; index < floats.size(); ++index) {
+                output[index] = pixels::make_half(floats[index]);
+            }
+        },
+        [&](std::vector<uint16_t>& output) { pixels::make_halves(floats, output); } );
+
+    compare<float>( "to float", halves.size(), pixel_count,
+        [&](std::vector<float>& output) {
+            for (size_t index = 0; index < halves.size(); ++index) {
+                output[index] = pixels::make_float(halves[index]);
+            }
+        },
+        [&](std::vector<float>& output) { pixels::make_floats(halves, output); } );
+}
+
+// • .rgba16Float to .bgra8Unorm (sRGB encoding, per channel with the
+//   transfer function, then by table; alpha stays linear) and back, per
+//   pixel of a 1080p frame
+//
+BENCHMARK(srgb_conversion)
+{
+    const auto& floats = linear_channels();
+
+    std::vector<uint16_t> halves(floats.size());
+    std::vector<uint32_t> encoded(pixel_count);
+
+    pixels::make_halves(floats, halves);
+
+    const auto function_seconds = bench::measure( [&] {
+        for (size_t index = 0; index < pixel_count; ++index) {
+
+            const auto channel = [&](size_t offset) {
+                const auto value = std::clamp( pixels::make_float(halves[4*index + offset]), 0.0f, 1.0f );
+                return static_cast<uint32_t>( pixels::encode_srgb(value) * 255.0f + 0.5f );
+            };
+
+            const auto alpha = std::clamp( pixels::make_float(halves[4*index + 3]), 0.0f, 1.0f );
+
+            encoded[index] = channel(2) | channel(1) << 8 | channel(0) << 16
+                           | static_cast<uint32_t>(alpha * 255.0f + 0.5f) << 24;
+        }
+        bench::do_not_optimize(encoded[0]);
+    }, 3 );
+
+    bench::report("encode: transfer function", function_seconds, pixel_count);
+
+    compare<uint32_t>( "encode", pixel_count, pixel_count,
+        [&](std::vector<uint32_t>& output) {
+            for (size_t index = 0; index < pixel_count; ++index) {
+
+                const auto channel = [&](size_t offset) {
+                    return uint32_t { pixels::encode_srgb8(halves[4*index + offset]) };
+                };
+
+                const auto alpha = std::clamp( pixels::make_float(halves[4*index + 3]), 0.0f, 1.0f );
+
+                output[index] = channel(2) | channel(1) << 8 | channel(0) << 16
+                              | static_cast<uint32_t>( std::lround(255.0f * alpha) ) << 24;
+            }
+        },
+        [&](std::vector<uint32_t>& output) { pixels::encode_bgra8(halves, output); } );
+
+    pixels::encode_bgra8(halves, encoded);
+
+    compare<uint16_t>( "decode", halves.size(), pixel_count,
+        [&](std::vector<uint16_t>& output) {
+            for (size_t index = 0; index < pixel_count; ++index) {
+                pixels::decode_bgra8( { &encoded[index], 1 }, { &output[4*index], 4 } );
+            }
+        },
+        [&](std::vector<uint16_t>& output) { pixels::decode_bgra8(encoded, output); } );
+}
+
+// • Drawing a 1080p frame into .bgra8Unorm against .rgba16Float, plus the
+//   8-bit sRGB preview of the latter, per frame
+//
+BENCHMARK(hdr_rasterization)
+{
+    const auto patterns = make_patterns();
+
+    Target standard { raster::PixelFormat::bgra8Unorm };
+    Target linear   { raster::PixelFormat::rgba16Float };
+    Target preview  { raster::PixelFormat::bgra8Unorm };
+
+    raster::Rasterizer rasterizer;
+
+    constexpr std::pair<const char*, raster::Coverage> coverages[] = {
+        { "binary",   raster::Coverage::binary },
+        { "analytic", raster::Coverage::analytic }
+    };
+
+    for (const auto& [name, coverage] : coverages) {
+
+        rasterizer.set_coverage(coverage);
+
+        const auto standard_seconds = bench::measure( [&] { rasterizer.draw(patterns, standard.bitmap); }, 5 );
+        const auto linear_seconds   = bench::measure( [&] { rasterizer.draw(patterns, linear.bitmap); }, 5 );
+        const auto preview_seconds  = bench::measure( [&] {
+            raster::convert(data::JobSystem::shared(), linear.bitmap, preview.bitmap);
+        }, 5 );
+
+        char label[64];
+
+        std::snprintf(label, sizeof(label), "%s: bgra8Unorm", name);
+        bench::report(label, standard_seconds, 1);
+
+        std::snprintf(label, sizeof(label), "%s: rgba16Float", name);
+        bench::report(label, linear_seconds, 1);
+
+        std::snprintf(label, sizeof(label), "%s: preview", name);
+        bench::report(label, preview_seconds, 1);
+
+        // • Binary coverage only writes black and white, which survive
+        //   the preview exactly
+        //
+        auto is_identical = true;
+
+        for (uint32_t y = 0; y < frame_size.y; ++y) {
+            is_identical &= 0 == std::memcmp( raster::row(standard.bitmap, y), raster::row(preview.bitmap, y),
+                                              4 * frame_size.x );
+        }
+
+        std::printf( "  %s: preview %s, rgba16Float %.2fx the time\n", name,
+                     is_identical ? "identical" : "differs (linear blending)", linear_seconds / standard_seconds );
+    }
+}
@@ -0,0 +1,207 @@
+//
+//  RegionBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Graphics/RegionSoA.hpp>
+
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr size_t      region_count = 1 << 20;
+constexpr simd::uint2 target_size  = { 3840, 2160 };
+constexpr simd::uint2 probe        = { 1920, 1080 };
+
+std::vector<geometry::Region> make_regions(void)
+{
+    std::mt19937 generator { 11 };
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, target_size.x };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, target_size.y };
+
+    std::vector<geometry::Region> regions(region_count);
+
+    for (auto& region : regions) {
+
+        const auto x0 = x_coordinate(generator), x1 = x_coordinate(generator);
+        const auto y0 = y_coordinate(generator), y1 = y_coordinate(generator);
+
+        region = {
+            .left   = std::min(x0, x1),
+            .top    = std::min(y0, y1),
+            .right  = std::max(x0, x1),
+            .bottom = std::max(y0, y1)
+        };
+    }
+
+    return regions;
+}
+
+void report_speedup(double aos_seconds, double soa_seconds, bool is_match)
+{
+    std::printf( "  %s, speedup %.2fx\n", bench::verdict(is_match),
+                 aos_seconds / soa_seconds );
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(region_hit_test)
+{
+    const auto regions = make_regions();
+    const geometry::RegionSoA lanes { regions };
+
+    std::vector<uint8_t> aos_hits(region_count);
+    std::vector<uint8_t> soa_hits(region_count);
+
+    size_t aos_count = 0;
+    size_t soa_count = 0;
+
+    const auto aos_seconds = bench::measure( [&] {
+
+        aos_count = 0;
+
+        for (size_t index = 0; index < region_count; ++index) {
+
+            aos_hits[index] = geometry::contains(regions[index], probe) ? 1 : 0;
+            aos_count      += aos_hits[index];
+        }
+
+        bench::do_not_optimize(aos_count);
+    } );
+
+    const auto soa_seconds = bench::measure( [&] {
+        soa_count = lanes.contains(probe, soa_hits);
+        bench::do_not_optimize(soa_count);
+    } );
+
+    bench::report("aos", aos_seconds, region_count);
+    bench::report("soa", soa_seconds, region_count);
+    report_speedup(aos_seconds, soa_seconds, aos_count == soa_count && aos_hits == soa_hits);
+}
+
+BENCHMARK(region_bounds)
+{
+    const auto regions = make_regions();
+    const geometry::RegionSoA lanes { regions };
+
+    geometry::Region aos_bounds = regions[0];
+    geometry::Region soa_bounds = {};
+
+    const auto aos_seconds = bench::measure( [&] {
+
+        aos_bounds = regions[0];
+
+        for (const auto& region : regions) {
+            aos_bounds = geometry::bounding_region(aos_bounds, region);
+        }
+
+        bench::do_not_optimize(aos_bounds);
+    } );
+
+    const auto soa_seconds = bench::measure( [&] {
+        soa_bounds = lanes.bounds();
+        bench::do_not_optimize(soa_bounds);
+    } );
+
+    bench::report("aos", aos_seconds, region_count);
+    bench::report("soa", soa_seconds, region_count);
+    report_speedup(aos_seconds, soa_seconds, aos_bounds == soa_bounds);
+}
+
+BENCHMARK(region_area)
+{
+    const auto regions = make_regions();
+    const geometry::RegionSoA lanes { regions };
+
+    uint64_t aos_area = 0;
+    uint64_t soa_area = 0;
+
+    const auto aos_seconds = bench::measure( [&] {
+
+        aos_area = 0;
+
+        for (const auto& region : regions) {
+            aos_area += static_cast<uint64_t>( geometry::width(region) ) * geometry::height(region);
+        }
+
+        bench::do_not_optimize(aos_area);
+    } );
+
+    const auto soa_seconds = bench::measure( [&] {
+        soa_area = lanes.total_area();
+        bench::do_not_optimize(soa_area);
+    } );
+
+    bench::report("aos", aos_seconds, region_count);
+    bench::report("soa", soa_seconds, region_count);
+    report_speedup(aos_seconds, soa_seconds, aos_area == soa_area);
+}
+
+BENCHMARK(region_offset)
+{
+    const auto regions = make_regions();
+    const simd::int2 offset = { 3, -2 };
+
+    std::vector<geometry::Region> aos_regions { regions };
+    geometry::RegionSoA           lanes { regions };
+
+    // • Alternate directions, so that repetitions stay near the originals
+    //
+    auto aos_sign = 1;
+    auto soa_sign = 1;
+
+    const auto aos_seconds = bench::measure( [&] {
+
+        const auto step = offset * aos_sign;
+
+        for (auto& region : aos_regions) {
+            region = region + step;
+        }
+
+        aos_sign = -aos_sign;
+        bench::do_not_optimize(aos_regions.data());
+    } );
+
+    const auto soa_seconds = bench::measure( [&] {
+
+        lanes.translate(offset * soa_sign);
+
+        soa_sign = -soa_sign;
+        bench::do_not_optimize(lanes);
+    } );
+
+    std::vector<geometry::Region> soa_regions(region_count);
+
+    lanes.store(soa_regions);
+
+    bench::report("aos", aos_seconds, region_count);
+    bench::report("soa", soa_seconds, region_count);
+    report_speedup(aos_seconds, soa_seconds, aos_regions == soa_regions);
+}
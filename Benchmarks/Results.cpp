@@ -0,0 +1,464 @@
+//
+//  Results.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include "Results.hpp"
+
+#include <Graphics/GeometryBatch.hpp>
+#include <Data/Trace.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+//===------------------------------------------------------------------------===
+// • namespace bench
+//===------------------------------------------------------------------------===
+
+namespace bench
+{
+
+namespace
+{
+
+//===------------------------------------------------------------------------===
+// • Writing
+//===------------------------------------------------------------------------===
+
+void append_string(std::string& json, const std::string& text)
+{
+    json += '"';
+
+    for (const auto character : text) {
+
+        if ('"' == character || '\\' == character) {
+            json += '\\';
+            json += character;
+        } else if (static_cast<unsigned char>(character) < 0x20) {
+            char escaped[8];
+            std::snprintf( escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(character) );
+            json += escaped;
+        } else {
+            json += character;
+        }
+    }
+
+    json += '"';
+}
+
+void append_number(std::string& json, double value)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", value);
+    json += text;
+}
+
+//===------------------------------------------------------------------------===
+// • Reading
+//
+//  - Enough of JSON to read the results back, skipping anything else
+//===------------------------------------------------------------------------===
+
+class Reader
+{
+public:
+
+    Reader(const char* first, const char* last)
+        : cursor { first },
+          end    { last }
+    {
+    }
+
+    bool read(std::vector<Result>& results)
+    {
+        return object( [&](const std::string& key) {
+            return ("results" == key) ? array( [&] { return result(results); } ) : skip();
+        } ) && (skip_space(), cursor == end);
+    }
+
+private:
+
+    bool result(std::vector<Result>& results)
+    {
+        Result entry = { };
+
+        const auto is_read = object( [&](const std::string& key) {
+
+            if ("benchmark" == key) {
+                return string(entry.benchmark);
+            }
+
+            if ("name" == key) {
+                return string(entry.name);
+            }
+
+            if ("seconds" == key) {
+                return number(entry.seconds);
+            }
+
+            if ("items" == key) {
+
+                auto items = 0.0;
+
+                if (!number(items)) {
+                    return false;
+                }
+
+                entry.items = static_cast<uint64_t>(items);
+                return true;
+            }
+
+            return skip();
+        } );
+
+        if (is_read) {
+            results.push_back(entry);
+        }
+
+        return is_read;
+    }
+
+    template <typename Member_>
+    bool object(Member_&& member)
+    {
+        if (!consume('{')) {
+            return false;
+        }
+
+        if (consume('}')) {
+            return true;
+        }
+
+        do {
+
+            std::string key;
+
+            if (!string(key) || !consume(':') || !member(key)) {
+                return false;
+            }
+
+        } while (consume(','));
+
+        return consume('}');
+    }
+
+    template <typename Element_>
+    bool array(Element_&& element)
+    {
+        if (!consume('[')) {
+            return false;
+        }
+
+        if (consume(']')) {
+            return true;
+        }
+
+        do {
+            if (!element()) {
+                return false;
+            }
+        } while (consume(','));
+
+        return consume(']');
+    }
+
+    bool string(std::string& text)
+    {
+        if (!consume('"')) {
+            return false;
+        }
+
+        text.clear();
+
+        while (cursor < end && '"' != *cursor) {
+
+            if ('\\' != *cursor) {
+                text += *cursor++;
+                continue;
+            }
+
+            if (end <= ++cursor) {
+                return false;
+            }
+
+            switch (const auto escaped = *cursor++) {
+
+                case 'b': text += '\b'; break;
+                case 'f': text += '\f'; break;
+                case 'n': text += '\n'; break;
+                case 'r': text += '\r'; break;
+                case 't': text += '\t'; break;
+
+                case 'u': {
+
+                    if (end - cursor < 4) {
+                        return false;
+                    }
+
+                    // • Only the control characters write_results escapes
+                    //
+                    const std::string digits { cursor, cursor + 4 };
+
+                    text   += static_cast<char>( std::strtoul(digits.c_str(), nullptr, 16) );
+                    cursor += 4;
+                    break;
+                }
+
+                default:
+                    text += escaped;
+                    break;
+            }
+        }
+
+        return consume('"');
+    }
+
+    bool number(double& value)
+    {
+        skip_space();
+
+        char* last = nullptr;
+
+        const std::string text { cursor, static_cast<size_t>( std::min<ptrdiff_t>(end - cursor, 64) ) };
+
+        value = std::strtod(text.c_str(), &last);
+
+        if (last == text.c_str()) {
+            return false;
+        }
+
+        cursor += last - text.c_str();
+
+        return true;
+    }
+
+    bool skip(void)
+    {
+        skip_space();
+
+        if (end <= cursor) {
+            return false;
+        }
+
+        switch (*cursor) {
+
+            case '{':
+                return object( [this](const std::string&) { return skip(); } );
+
+            case '[':
+                return array( [this] { return skip(); } );
+
+            case '"': {
+                std::string ignored;
+                return string(ignored);
+            }
+
+            case 't':
+                return literal("true");
+
+            case 'f':
+                return literal("false");
+
+            case 'n':
+                return literal("null");
+
+            default: {
+                auto ignored = 0.0;
+                return number(ignored);
+            }
+        }
+    }
+
+    bool literal(const char* text)
+    {
+        const auto length = std::strlen(text);
+
+        if (static_cast<size_t>(end - cursor) < length || 0 != std::strncmp(cursor, text, length)) {
+            return false;
+        }
+
+        cursor += length;
+
+        return true;
+    }
+
+    bool consume(char character)
+    {
+        skip_space();
+
+        if (cursor < end && character == *cursor) {
+            ++cursor;
+            return true;
+        }
+
+        return false;
+    }
+
+    void skip_space(void)
+    {
+        while (cursor < end && (' ' == *cursor || '\t' == *cursor || '\n' == *cursor || '\r' == *cursor)) {
+            ++cursor;
+        }
+    }
+
+    const char* cursor;
+    const char* end;
+};
+
+std::vector<std::string>& failed_benchmarks(void)
+{
+    static std::vector<std::string> names;
+
+    return names;
+}
+
+// • Time per item, or in all when either result has none
+//
+double cost(const Result& result, bool is_per_item)
+{
+    return is_per_item ? result.seconds / static_cast<double>(result.items) : result.seconds;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Results
+//===------------------------------------------------------------------------===
+
+bool write_results(const char* path, std::span<const Result> results)
+{
+    std::string json = "{\n";
+
+    json += "  \"compiler\": ";
+    append_string(json, __VERSION__);
+    json += ",\n  \"batch_implementation\": ";
+    append_string(json, geometry::batch_implementation());
+    json += ",\n  \"hardware_threads\": ";
+    json += std::to_string( std::thread::hardware_concurrency() );
+    json += ",\n  \"play_trace\": ";
+    json += std::to_string(PLAY_TRACE);
+    json += ",\n  \"results\": [";
+
+    for (size_t index = 0; index < results.size(); ++index) {
+
+        const auto& result = results[index];
+
+        json += (0 == index) ? "\n    { \"benchmark\": " : ",\n    { \"benchmark\": ";
+        append_string(json, result.benchmark);
+        json += ", \"name\": ";
+        append_string(json, result.name);
+        json += ", \"seconds\": ";
+        append_number(json, result.seconds);
+        json += ", \"items\": ";
+        json += std::to_string(result.items);
+        json += ", \"items_per_second\": ";
+        append_number( json, (0.0 < result.seconds) ? static_cast<double>(result.items) / result.seconds : 0.0 );
+        json += " }";
+    }
+
+    json += "\n  ]\n}\n";
+
+    std::ofstream file { path, std::ios::binary };
+
+    file.write( json.data(), static_cast<std::streamsize>( json.size() ) );
+
+    return static_cast<bool>(file.flush());
+}
+
+std::optional<std::vector<Result>> read_results(const char* path)
+{
+    std::ifstream file { path, std::ios::binary };
+
+    if (!file) {
+        return std::nullopt;
+    }
+
+    const std::string json { std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> { } };
+
+    std::vector<Result> results;
+
+    if (!Reader { json.data(), json.data() + json.size() }.read(results)) {
+        return std::nullopt;
+    }
+
+    return results;
+}
+
+uint32_t compare_results( std::span<const Result> results, std::span<const Result> baseline,
+                          double threshold )
+{
+    uint32_t regressions = 0;
+
+    std::vector<bool> is_matched(baseline.size(), false);
+
+    std::printf( "  %-52s %12s %12s %9s\n", "benchmark / name", "baseline", "current", "change" );
+
+    for (const auto& result : results) {
+
+        const auto key = result.benchmark + " / " + result.name;
+
+        // • The first baseline result of the same benchmark and name not yet
+        //   matched, so that repeated names pair up in order
+        //
+        size_t index = 0;
+
+        while ( index < baseline.size()
+                && (is_matched[index] || baseline[index].benchmark != result.benchmark
+                                      || baseline[index].name != result.name) ) {
+            ++index;
+        }
+
+        if (baseline.size() == index) {
+            std::printf( "  %-52s %12s %9.3f ms %9s\n", key.c_str(), "-", 1e3 * result.seconds, "new" );
+            continue;
+        }
+
+        is_matched[index] = true;
+
+        const auto& previous    = baseline[index];
+        const auto  is_per_item = 0 < result.items && 0 < previous.items;
+        const auto  change      = cost(result, is_per_item) / cost(previous, is_per_item) - 1.0;
+        const auto  is_slower   = threshold < change;
+
+        regressions += is_slower ? 1 : 0;
+
+        std::printf( "  %-52s %9.3f ms %9.3f ms %+8.1f%%%s\n", key.c_str(), 1e3 * previous.seconds,
+                     1e3 * result.seconds, 100.0 * change, is_slower ? "  REGRESSION" : "" );
+    }
+
+    return regressions;
+}
+
+const char* verdict(bool is_correct, const char* passed, const char* failed)
+{
+    auto& names = failed_benchmarks();
+
+    if (!is_correct && (names.empty() || names.back() != current_benchmark())) {
+        names.push_back( current_benchmark() );
+    }
+
+    return is_correct ? passed : failed;
+}
+
+std::span<const std::string> failed_checks(void)
+{
+    return failed_benchmarks();
+}
+
+} // namespace bench
@@ -0,0 +1,73 @@
+//
+//  Results.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#pragma once
+
+#include "Benchmark.hpp"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+//
+// • Results
+//
+//  - Benchmark results as JSON, to keep a history and to compare a build
+//    against a stored baseline:
+//
+//      PlayBenchmarks --json results.json
+//      PlayBenchmarks --baseline baseline.json [--threshold 10]
+//
+//  - The file holds details of the build and machine and one entry per
+//    report: { "benchmark", "name", "seconds", "items", "items_per_second" }
+//
+//===------------------------------------------------------------------------===
+
+namespace bench
+{
+
+bool write_results(const char* path, std::span<const Result> results);
+
+// • Results from a file written by write_results, or nullopt if it cannot
+//   be read or parsed
+//
+std::optional<std::vector<Result>> read_results(const char* path);
+
+// • Print each result against the baseline's result of the same benchmark
+//   and name, per item when both have items. Returns the number of
+//   regressions: results slower than the baseline by more than `threshold`
+//   (0.1 for 10%)
+//
+uint32_t compare_results( std::span<const Result> results, std::span<const Result> baseline,
+                          double threshold );
+
+// • Record the running benchmark's check of its own output, e.g. against
+//   a scalar or full reference, returning what to print: `passed`, or
+//   `failed`. A failed check makes PlayBenchmarks exit 1, as a regression
+//   does
+//
+const char* verdict( bool is_correct, const char* passed = "results match",
+                     const char* failed = "MISMATCH" );
+
+// • The benchmarks with a failed check, in the order they ran
+//
+std::span<const std::string> failed_checks(void);
+
+} // namespace bench
@@ -0,0 +1,193 @@
+//
+//  SpanBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/SpanSet.hpp>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr simd::uint2 mask_size = { 16384, 16384 };
+
+// • The default composition (Composition.mm): three 8x2 bars on a 10x10 grid
+//
+const Pattern default_pattern = {
+    .grid_size   = { 10, 10 },
+    .base_region = geometry::make_region({ 1, 1 }, { 8, 2 }),
+    .offset      = { 0, 3 },
+    .count       = 3,
+    .row_count   = 1,
+    .row_offset  = { 0, 0 },
+    .nested      = 0,
+    .reserved    = 0
+};
+
+// • A dense composition, as RasterizationBenchmarks draws, in 1080p grid
+//   units
+//
+std::vector<Pattern> make_patterns(uint32_t seed)
+{
+    constexpr simd::uint2 grid_size = { 1920, 1080 };
+
+    std::mt19937 generator { seed };
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, grid_size.x - 120 };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, grid_size.y - 120 };
+    std::uniform_int_distribution<uint32_t> extent       { 4, 80 };
+    std::uniform_int_distribution<int32_t>  step         { -1, 1 };
+
+    std::vector<Pattern> patterns(400);
+
+    for (auto& pattern : patterns) {
+
+        const auto left = x_coordinate(generator);
+        const auto top  = y_coordinate(generator);
+
+        pattern = {
+            .grid_size   = grid_size,
+            .base_region = { left, top, left + extent(generator), top + extent(generator) },
+            .offset      = { step(generator), step(generator) },
+            .count       = 100,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        };
+    }
+
+    return patterns;
+}
+
+void report_size(const char* name, const raster::SpanSet& spans, simd::uint2 size)
+{
+    const auto bitmap_bytes = static_cast<double>( raster::buffer_size(size.x, size.y) );
+
+    std::printf( "  %s: %zu bands, %zu spans, %zu bytes (%.3g%% of .bgra8Unorm), %llu pixels\n",
+                 name, spans.bands().size(), spans.spans().size(), spans.byte_size(),
+                 100.0 * static_cast<double>( spans.byte_size() ) / bitmap_bytes,
+                 static_cast<unsigned long long>( spans.area() ) );
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+// • Span coverage of the default and a dense composition, per mask: a
+//   16K x 16K mask of each, and the dense one at 1080p expanded into a
+//   bitmap against the rasterizer drawing it
+//
+BENCHMARK(span_coverage)
+{
+    raster::SpanRasterizer rasterizer;
+    raster::SpanSet        spans;
+
+    const auto default_seconds = bench::measure( [&] {
+        rasterizer.draw( { &default_pattern, 1 }, mask_size, spans );
+    } );
+
+    bench::report("default: 16K", default_seconds, 1);
+    report_size("default: 16K", spans, mask_size);
+
+    const auto patterns = make_patterns(41);
+
+    const auto dense_seconds = bench::measure( [&] {
+        rasterizer.draw(patterns, mask_size, spans);
+    }, 5 );
+
+    bench::report("dense: 16K", dense_seconds, 1);
+    report_size("dense: 16K", spans, mask_size);
+
+    // • Expanded at 1080p, against drawing the same pixels directly
+    //
+    constexpr simd::uint2 frame_size = { 1920, 1080 };
+
+    std::vector<uint8_t> expected( raster::buffer_size(frame_size.x, frame_size.y) );
+    std::vector<uint8_t> expanded( expected.size() );
+
+    const raster::Bitmap expected_bitmap = {
+        expected.data(), frame_size.x, frame_size.y, raster::bytes_per_row(frame_size.x)
+    };
+    const raster::Bitmap expanded_bitmap = {
+        expanded.data(), frame_size.x, frame_size.y, raster::bytes_per_row(frame_size.x)
+    };
+
+    raster::Rasterizer pixel_rasterizer;
+
+    const auto draw_seconds = bench::measure( [&] { pixel_rasterizer.draw(patterns, expected_bitmap); }, 5 );
+    const auto span_seconds = bench::measure( [&] { rasterizer.draw(patterns, frame_size, spans); }, 5 );
+
+    const auto expand_seconds = bench::measure( [&] {
+        raster::expand(data::JobSystem::shared(), spans, expanded_bitmap);
+    }, 5 );
+
+    bench::report("dense: 1080p rasterizer", draw_seconds, 1);
+    bench::report("dense: 1080p spans", span_seconds, 1);
+    bench::report("dense: 1080p expand", expand_seconds, 1);
+
+    std::printf( "  dense: 1080p %s, spans + expand %.2fx the rasterizer\n",
+                 bench::verdict(expected == expanded, "bit-identical"),
+                 (span_seconds + expand_seconds) / draw_seconds );
+}
+
+// • Merging, intersecting and subtracting two dense 4K masks, per operation
+//
+BENCHMARK(span_operations)
+{
+    constexpr simd::uint2 size = { 3840, 2160 };
+
+    raster::SpanRasterizer rasterizer;
+    raster::SpanSet        lhs;
+    raster::SpanSet        rhs;
+
+    rasterizer.draw(make_patterns(41), size, lhs);
+    rasterizer.draw(make_patterns(42), size, rhs);
+
+    const auto span_count = lhs.spans().size() + rhs.spans().size();
+
+    raster::SpanSet merged;
+    raster::SpanSet intersected;
+    raster::SpanSet subtracted;
+
+    const auto merge_seconds     = bench::measure( [&] { merged      = raster::merge(lhs, rhs); } );
+    const auto intersect_seconds = bench::measure( [&] { intersected = raster::intersect(lhs, rhs); } );
+    const auto subtract_seconds  = bench::measure( [&] { subtracted  = raster::subtract(lhs, rhs); } );
+
+    bench::report("merge", merge_seconds, span_count);
+    bench::report("intersect", intersect_seconds, span_count);
+    bench::report("subtract", subtract_seconds, span_count);
+
+    // • Inclusion-exclusion holds for any correct pair of results
+    //
+    const auto is_consistent = merged.area() + intersected.area() == lhs.area() + rhs.area()
+                            && subtracted.area() + intersected.area() == lhs.area();
+
+    std::printf( "  %zu + %zu spans, areas %s\n", lhs.spans().size(), rhs.spans().size(),
+                 bench::verdict(is_consistent, "consistent", "INCONSISTENT") );
+}
@@ -0,0 +1,130 @@
+//
+//  TileBinningBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <Composition/Rasterizer.hpp>
+#include <Composition/TileBinning.hpp>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    pattern_count  = 200;
+constexpr uint32_t    instance_count = 100;
+constexpr simd::uint2 grid_size      = { 1920, 1080 };
+constexpr simd::uint2 target_size    = { 1920, 1080 };
+
+// • Large instances a few pixels apart, so that most pixels are covered by
+//   many of them
+//
+std::vector<Pattern> make_patterns(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, grid_size.x - 200 };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, grid_size.y - 200 };
+    std::uniform_int_distribution<uint32_t> extent       { 40, 160 };
+    std::uniform_int_distribution<int32_t>  step         { -3, 3 };
+
+    std::vector<Pattern> patterns(pattern_count);
+
+    for (auto& pattern : patterns) {
+
+        const auto left = x_coordinate(generator);
+        const auto top  = y_coordinate(generator);
+
+        pattern = {
+            .grid_size   = grid_size,
+            .base_region = { left, top, left + extent(generator), top + extent(generator) },
+            .offset      = { step(generator), step(generator) },
+            .count       = instance_count,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        };
+    }
+
+    return patterns;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(tile_binning)
+{
+    std::mt19937 generator { 23 };
+
+    const auto patterns = make_patterns(generator);
+
+    std::vector<uint8_t> instanced_pixels( raster::buffer_size(target_size.x, target_size.y) );
+    std::vector<uint8_t> tiled_pixels( instanced_pixels.size() );
+
+    const raster::Bitmap instanced = {
+        instanced_pixels.data(), target_size.x, target_size.y, raster::bytes_per_row(target_size.x)
+    };
+
+    const raster::Bitmap tiled = {
+        tiled_pixels.data(), target_size.x, target_size.y, raster::bytes_per_row(target_size.x)
+    };
+
+    raster::Rasterizer rasterizer;
+    raster::TileBinner binner;
+
+    const auto instanced_seconds = bench::measure( [&] {
+        rasterizer.draw(patterns, instanced);
+    }, 3 );
+
+    const auto bin_seconds = bench::measure( [&] {
+        binner.bin(patterns, target_size);
+    }, 3 );
+
+    const auto shade_seconds = bench::measure( [&] {
+        binner.draw(tiled);
+    }, 3 );
+
+    const auto& statistics = binner.statistics();
+    const auto  is_match   = 0 == std::memcmp( instanced_pixels.data(), tiled_pixels.data(), tiled_pixels.size() );
+
+    bench::report("instanced", instanced_seconds, statistics.instance_count);
+    bench::report("tiled: bin", bin_seconds, statistics.instance_count);
+    bench::report("tiled: shade", shade_seconds, statistics.tile_count);
+
+    std::printf( "  %s, overdraw %.1fx (%llu instance pixels, %llu covered), %.1f bin entries per tile\n",
+                 bench::verdict(is_match, "bit-identical"), raster::overdraw(statistics),
+                 static_cast<unsigned long long>(statistics.instance_pixels),
+                 static_cast<unsigned long long>(statistics.covered_pixels),
+                 static_cast<double>(statistics.bin_entries) / static_cast<double>(statistics.tile_count) );
+
+    std::printf( "  pixels written: instanced %llu, tiled %llu, speedup %.2fx\n",
+                 static_cast<unsigned long long>(statistics.target_pixels + statistics.instance_pixels),
+                 static_cast<unsigned long long>(statistics.target_pixels),
+                 instanced_seconds / (bin_seconds + shade_seconds) );
+}
@@ -0,0 +1,154 @@
+//
+//  TraceBenchmarks.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include "Benchmark.hpp"
+
+#include <Composition/Rasterizer.hpp>
+#include <Composition/TileBinning.hpp>
+#include <Data/Trace.hpp>
+
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    pattern_count  = 1000;
+constexpr uint32_t    instance_count = 500;
+constexpr simd::uint2 grid_size      = { 1920, 1080 };
+constexpr simd::uint2 target_size    = { 1920, 1080 };
+
+std::vector<Pattern> make_patterns(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, grid_size.x - 100 };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, grid_size.y - 100 };
+    std::uniform_int_distribution<uint32_t> extent       { 2, 24 };
+    std::uniform_int_distribution<int32_t>  step         { -5, 5 };
+
+    std::vector<Pattern> patterns(pattern_count);
+
+    for (auto& pattern : patterns) {
+
+        const auto left = x_coordinate(generator);
+        const auto top  = y_coordinate(generator);
+
+        pattern = {
+            .grid_size   = grid_size,
+            .base_region = { left, top, left + extent(generator), top + extent(generator) },
+            .offset      = { step(generator), step(generator) },
+            .count       = instance_count,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        };
+    }
+
+    return patterns;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Benchmarks
+//===------------------------------------------------------------------------===
+
+BENCHMARK(trace_overhead)
+{
+    constexpr uint32_t event_count = 1 << 20;
+
+    trace::set_enabled(true);
+
+    const auto scope_seconds = bench::measure( [] {
+        for (uint32_t event = 0; event < event_count; ++event) {
+            PLAY_TRACE_SCOPE("scope", "benchmark");
+        }
+    } );
+
+    trace::set_enabled(false);
+
+    const auto disabled_seconds = bench::measure( [] {
+        for (uint32_t event = 0; event < event_count; ++event) {
+            PLAY_TRACE_SCOPE("scope", "benchmark");
+        }
+    } );
+
+    bench::report("scope, enabled", scope_seconds, event_count);
+    bench::report("scope, disabled", disabled_seconds, event_count);
+
+    // • A traced frame against an untraced one
+    //
+    std::mt19937 generator { 31 };
+
+    const auto patterns = make_patterns(generator);
+
+    std::vector<uint8_t> pixels( raster::buffer_size(target_size.x, target_size.y) );
+
+    const raster::Bitmap target = {
+        pixels.data(), target_size.x, target_size.y, raster::bytes_per_row(target_size.x)
+    };
+
+    raster::Rasterizer rasterizer;
+    raster::TileBinner binner;
+
+    const auto frame = [&] {
+        rasterizer.draw(patterns, target);
+        binner.bin(patterns, target_size);
+        binner.draw(target);
+    };
+
+    trace::set_enabled(false);
+
+    const auto untraced_seconds = bench::measure(frame, 11);
+
+    trace::set_enabled(true);
+
+    const auto traced_seconds = bench::measure(frame, 11);
+
+    // • Events of one frame, from its trace
+    //
+    trace::clear();
+
+    frame();
+
+    trace::set_enabled(false);
+
+    const auto json = trace::chrome_trace_json();
+
+    trace::clear();
+
+    size_t events = 0;
+
+    for (auto found = json.find("\"ph\":"); std::string::npos != found; found = json.find("\"ph\":", found + 1)) {
+        ++events;
+    }
+
+    bench::report("frame, untraced", untraced_seconds, 1);
+    bench::report("frame, traced", traced_seconds, 1);
+
+    // • Frame times vary by more than the cost of their events, so the
+    //   overhead is estimated from the cost of a scope
+    //
+    std::printf( "  PLAY_TRACE=%d, %.1f ns per scope, %zu events per frame (%zu bytes of JSON), overhead %.3f%%\n",
+                 PLAY_TRACE, 1e9 * scope_seconds / event_count, events, json.size(),
+                 100.0 * static_cast<double>(events) * scope_seconds / event_count / untraced_seconds );
+}
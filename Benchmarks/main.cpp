@@ -0,0 +1,136 @@
+//
+//  main.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Benchmark.hpp"
+#include "Results.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// • PlayBenchmarks [--json path] [--baseline path] [--threshold percent]
+//   [name ...]: run every benchmark, or those whose name contains one of
+//   the names. Results go to --json, and are compared with --baseline,
+//   failing if any is slower by more than --threshold (10% by default).
+//   A benchmark whose check of its own results fails (see verdict) fails
+//   the run too
+//
+int main(int argc, const char* argv[])
+{
+    const char* json_path     = nullptr;
+    const char* baseline_path = nullptr;
+    auto        threshold     = 10.0;
+
+    std::vector<const char*> names;
+
+    for (int index = 1; index < argc; ++index) {
+
+        const auto is_option = [&](const char* option) {
+            return 0 == std::strcmp(argv[index], option) && index + 1 < argc;
+        };
+
+        if (is_option("--json")) {
+            json_path = argv[++index];
+        } else if (is_option("--baseline")) {
+            baseline_path = argv[++index];
+        } else if (is_option("--threshold")) {
+            threshold = std::atof(argv[++index]);
+        } else {
+            names.push_back(argv[index]);
+        }
+    }
+
+    const auto is_selected = [&names](const char* name) {
+
+        if (names.empty()) {
+            return true;
+        }
+
+        for (const auto selected : names) {
+            if (nullptr != std::strstr(name, selected)) {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    // • Read the baseline first, so that a bad path fails before the run
+    //
+    std::vector<bench::Result> baseline;
+
+    if (nullptr != baseline_path) {
+
+        auto results = bench::read_results(baseline_path);
+
+        if (!results) {
+            std::fprintf(stderr, "Unable to read baseline %s\n", baseline_path);
+            return 2;
+        }
+
+        baseline = std::move(*results);
+    }
+
+    for (const auto& benchmark : bench::registry()) {
+
+        if (is_selected(benchmark.name)) {
+
+            std::printf("%s\n", benchmark.name);
+
+            bench::current_benchmark() = benchmark.name;
+            benchmark.run();
+        }
+    }
+
+    if (nullptr != json_path && !bench::write_results(json_path, bench::results())) {
+        std::fprintf(stderr, "Unable to write %s\n", json_path);
+        return 2;
+    }
+
+    auto is_failed = false;
+
+    if (nullptr != baseline_path) {
+
+        std::printf("comparison with %s (threshold %.1f%%)\n", baseline_path, threshold);
+
+        const auto regressions = bench::compare_results(bench::results(), baseline, 0.01 * threshold);
+
+        if (0 < regressions) {
+            std::printf("%u regressions\n", regressions);
+            is_failed = true;
+        }
+    }
+
+    // • A wrong result fails the run however fast it was
+    //
+    if (const auto failed = bench::failed_checks(); !failed.empty()) {
+
+        std::printf("%zu benchmarks failed their checks:", failed.size());
+
+        for (const auto& name : failed) {
+            std::printf(" %s", name.c_str());
+        }
+
+        std::printf("\n");
+        is_failed = true;
+    }
+
+    return is_failed ? 1 : 0;
+}
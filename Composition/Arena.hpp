@@ -0,0 +1,419 @@
+//
+//  Arena.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Pattern.hpp>
+#include <Data/Containers.hpp>
+#include <Data/Layout.hpp>
+
+#if !defined ( __METAL_VERSION__ )
+#include <Composition/PatternExpansion.hpp>
+#include <Data/BumpAllocator.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <optional>
+#endif
+
+//===------------------------------------------------------------------------===
+//
+// • Arena
+//
+//  - Any number of patterns in one 16-byte aligned block, drawn with a single
+//    instanced draw. The containers are offsets from the start of the arena
+//
+//    [ Arena | Pattern[capacity] | uint32_t first_instances[capacity] |
+//      DeviceTransform transforms[capacity] | Pattern nested[nested_capacity] ]
+//
+//  - first_instances[i] is the instance index at which pattern i begins, so
+//    an instance index maps back to its pattern with a binary search
+//
+//  - transforms[i] maps the grid of pattern i to device coordinates, so that
+//    pattern_vertex multiplies rather than divides. Both are kept in step
+//    with the patterns by the utilities below
+//
+//  - nested_patterns holds the patterns that others repeat in each cell
+//    (see Pattern.hpp), which are not drawn themselves. Their references
+//    are taken from patterns(arena). A nested pattern may only nest one
+//    appended before it, so references never form a cycle
+//
+//===------------------------------------------------------------------------===
+
+struct Arena
+{
+    data::vector<Pattern>                   patterns;
+    data::vector<uint32_t>                  first_instances;
+    data::vector<geometry::DeviceTransform> transforms;
+    data::vector<Pattern>                   nested_patterns;
+    uint32_t                                instance_count;
+    uint32_t                                reserved[2];
+};
+
+#if !defined ( __METAL_VERSION__ )
+
+static_assert( data::is_trivial_layout<Arena>(), "Unexpected layout" );
+
+//===------------------------------------------------------------------------===
+//
+// • Arena Utilities (Host)
+//
+//===------------------------------------------------------------------------===
+
+//===------------------------------------------------------------------------===
+// • Size
+//===------------------------------------------------------------------------===
+
+constexpr uint32_t arena_size(uint32_t capacity, uint32_t nested_capacity = 0)
+{
+    return data::aligned_size<Arena>()
+         + data::aligned_size<Pattern>(capacity)
+         + data::aligned_size<uint32_t>(capacity)
+         + data::aligned_size<geometry::DeviceTransform>(capacity)
+         + data::aligned_size<Pattern>(nested_capacity);
+}
+
+//===------------------------------------------------------------------------===
+// • Access
+//===------------------------------------------------------------------------===
+
+inline const Pattern* patterns(const Arena& arena)
+{
+    return data::offset_by<Pattern>(&arena, arena.patterns.offset);
+}
+
+inline Pattern* patterns(Arena& arena)
+{
+    return data::offset_by<Pattern>(&arena, arena.patterns.offset);
+}
+
+inline const Pattern* nested_patterns(const Arena& arena)
+{
+    return data::offset_by<Pattern>(&arena, arena.nested_patterns.offset);
+}
+
+inline Pattern* nested_patterns(Arena& arena)
+{
+    return data::offset_by<Pattern>(&arena, arena.nested_patterns.offset);
+}
+
+inline const uint32_t* first_instances(const Arena& arena)
+{
+    return data::offset_by<uint32_t>(&arena, arena.first_instances.offset);
+}
+
+inline uint32_t* first_instances(Arena& arena)
+{
+    return data::offset_by<uint32_t>(&arena, arena.first_instances.offset);
+}
+
+inline const geometry::DeviceTransform* transforms(const Arena& arena)
+{
+    return data::offset_by<geometry::DeviceTransform>(&arena, arena.transforms.offset);
+}
+
+inline geometry::DeviceTransform* transforms(Arena& arena)
+{
+    return data::offset_by<geometry::DeviceTransform>(&arena, arena.transforms.offset);
+}
+
+// • Reference to nested pattern `index`, from patterns(arena)
+//
+inline uint32_t nested_reference(const Arena& arena, uint32_t index)
+{
+    return arena.nested_patterns.offset - arena.patterns.offset + index*static_cast<uint32_t>( sizeof(Pattern) );
+}
+
+// • Index of the pattern drawing instance `instance` (< instance_count)
+//
+inline uint32_t pattern_index(const Arena& arena, uint32_t instance)
+{
+    const auto first = first_instances(arena);
+    const auto last  = first + arena.patterns.count;
+
+    return static_cast<uint32_t>( std::upper_bound(first, last, instance) - first ) - 1;
+}
+
+//===------------------------------------------------------------------------===
+// • Initialization
+//===------------------------------------------------------------------------===
+
+// • Initialize an empty arena at `memory`, which must be 16-byte aligned and
+//   at least arena_size(capacity, nested_capacity) bytes
+//
+inline Arena* make_arena(void* memory, uint32_t capacity, uint32_t nested_capacity = 0)
+{
+    data::BumpAllocator allocator(memory, arena_size(capacity, nested_capacity));
+
+    const auto arena           = allocator.allocate<Arena>();
+    const auto patterns        = allocator.allocate_vector<Pattern>(capacity);
+    const auto first_instances = allocator.allocate_vector<uint32_t>(capacity);
+    const auto transforms      = allocator.allocate_vector<geometry::DeviceTransform>(capacity);
+    const auto nested_patterns = allocator.allocate_vector<Pattern>(nested_capacity);
+
+    if (!arena || !patterns || !first_instances || !transforms || !nested_patterns) {
+        return nullptr;
+    }
+
+    const auto result = allocator.at(*arena);
+
+    result->patterns        = *patterns;
+    result->first_instances = *first_instances;
+    result->transforms      = *transforms;
+    result->nested_patterns = *nested_patterns;
+
+    return result;
+}
+
+// • Copy the patterns of `source` into an empty arena of sufficient capacity,
+//   e.g. when growing into a larger buffer. Nested references move by the
+//   change in distance between the tables
+//
+inline bool copy_arena(Arena& destination, const Arena& source)
+{
+    const auto count        = source.patterns.count;
+    const auto nested_count = source.nested_patterns.count;
+
+    if (destination.patterns.capacity < count || destination.nested_patterns.capacity < nested_count) {
+        return false;
+    }
+
+    std::memcpy( patterns(destination), patterns(source), count*sizeof(Pattern) );
+    std::memcpy( first_instances(destination), first_instances(source), count*sizeof(uint32_t) );
+    std::memcpy( transforms(destination), transforms(source), count*sizeof(geometry::DeviceTransform) );
+    std::memcpy( nested_patterns(destination), nested_patterns(source), nested_count*sizeof(Pattern) );
+
+    const auto distance = nested_reference(destination, 0) - nested_reference(source, 0);
+
+    if (0 != distance) {
+
+        const auto rebase = [distance](Pattern& pattern) {
+            if (0 != pattern.nested) {
+                pattern.nested += distance;
+            }
+        };
+
+        std::for_each( patterns(destination), patterns(destination) + count, rebase );
+        std::for_each( nested_patterns(destination), nested_patterns(destination) + nested_count, rebase );
+    }
+
+    destination.patterns.count        = count;
+    destination.first_instances.count = count;
+    destination.transforms.count      = count;
+    destination.nested_patterns.count = nested_count;
+    destination.instance_count        = source.instance_count;
+
+    return true;
+}
+
+//===------------------------------------------------------------------------===
+// • Nesting
+//===------------------------------------------------------------------------===
+
+// • Whether the reference of `pattern`, if any, is to one of the first
+//   `limit` nested patterns, whose grid is the size of base_region, without
+//   nesting deeper than max_pattern_depth in all. Nested patterns are
+//   checked by validate as they are added, so each cell holds its instances
+//
+inline bool is_valid_nesting(const Arena& arena, const Pattern& pattern, uint32_t limit)
+{
+    if (0 == pattern.nested) {
+        return true;
+    }
+
+    const auto start = nested_reference(arena, 0);
+
+    if ( pattern.nested < start || 0 != (pattern.nested - start) % sizeof(Pattern)
+         || limit <= (pattern.nested - start) / sizeof(Pattern) ) {
+
+        return false;
+    }
+
+    const auto& nested = *nested_pattern(patterns(arena), pattern);
+
+    if ( nested.grid_size.x != geometry::width(pattern.base_region)
+         || nested.grid_size.y != geometry::height(pattern.base_region) ) {
+
+        return false;
+    }
+
+    // • The nested pattern's own references were checked when it was added
+    //
+    uint32_t depth = 1;
+
+    for (auto level = &nested; nullptr != level; level = nested_pattern(patterns(arena), *level)) {
+        if (max_pattern_depth < ++depth) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// • Add a pattern for others to nest, returning its reference, or nullopt
+//   when the arena is full or the pattern is not valid (see validate)
+//
+inline std::optional<uint32_t> append_nested(Arena& arena, const Pattern& pattern)
+{
+    const auto index = arena.nested_patterns.count;
+
+    if ( PatternError::none != validate(pattern) || !is_valid_nesting(arena, pattern, index)
+         || std::numeric_limits<uint32_t>::max() < instance_count(patterns(arena), pattern) ) {
+
+        return std::nullopt;
+    }
+
+    if (!data::push_back(&arena, arena.nested_patterns, pattern)) {
+        return std::nullopt;
+    }
+
+    return nested_reference(arena, index);
+}
+
+//===------------------------------------------------------------------------===
+// • Modification
+//===------------------------------------------------------------------------===
+
+// • Whether a record of arena.patterns is valid (see validate). remove
+//   leaves a record without instances, which is valid if it was before
+//
+inline bool is_valid_record(const Pattern& pattern)
+{
+    auto record = pattern;
+
+    record.count = std::max(pattern.count, 1u);
+
+    return PatternError::none == validate(record);
+}
+
+// • Append a pattern, returning false when the arena is full, the pattern
+//   or its nesting is not valid, or its instances would not fit in the
+//   uint32_t instance indices of the draw
+//
+inline bool append(Arena& arena, const Pattern& pattern)
+{
+    const auto count = instance_count(patterns(arena), pattern);
+
+    if ( PatternError::none != validate(pattern) || !is_valid_nesting(arena, pattern, arena.nested_patterns.count)
+         || std::numeric_limits<uint32_t>::max() - arena.instance_count < count ) {
+
+        return false;
+    }
+
+    if (!data::push_back(&arena, arena.patterns, pattern)) {
+        return false;
+    }
+
+    data::push_back(&arena, arena.first_instances, arena.instance_count);
+    data::push_back(&arena, arena.transforms, geometry::make_device_transform(pattern.grid_size));
+
+    arena.instance_count += static_cast<uint32_t>(count);
+
+    return true;
+}
+
+// • Replace the pattern at `index`, e.g. with a new offset or count, keeping
+//   the first instances of the patterns after it in step. False, leaving
+//   it as it was, under the same conditions as append
+//
+inline bool update(Arena& arena, uint32_t index, const Pattern& pattern)
+{
+    if (arena.patterns.count <= index) {
+        return false;
+    }
+
+    auto&      record   = patterns(arena)[index];
+    const auto first    = first_instances(arena);
+    const auto previous = static_cast<uint32_t>( instance_count(patterns(arena), record) );
+    const auto count    = instance_count(patterns(arena), pattern);
+
+    if ( PatternError::none != validate(pattern) || !is_valid_nesting(arena, pattern, arena.nested_patterns.count)
+         || std::numeric_limits<uint32_t>::max() - (arena.instance_count - previous) < count ) {
+
+        return false;
+    }
+
+    for (auto following = index + 1; following < arena.patterns.count; ++following) {
+        first[following] = first[following] - previous + static_cast<uint32_t>(count);
+    }
+
+    arena.instance_count     = arena.instance_count - previous + static_cast<uint32_t>(count);
+    record                   = pattern;
+    transforms(arena)[index] = geometry::make_device_transform(pattern.grid_size);
+
+    return true;
+}
+
+// • Remove the instances of a pattern. The record keeps its index, with a
+//   count of zero, until the arena is compacted
+//
+inline bool remove(Arena& arena, uint32_t index)
+{
+    if (arena.patterns.count <= index) {
+        return false;
+    }
+
+    auto&      pattern = patterns(arena)[index];
+    const auto count   = static_cast<uint32_t>( instance_count(patterns(arena), pattern) );
+
+    if (0 < count) {
+
+        const auto first = first_instances(arena);
+
+        for (auto following = index + 1; following < arena.patterns.count; ++following) {
+            first[following] -= count;
+        }
+
+        arena.instance_count -= count;
+    }
+
+    pattern.count = 0;
+
+    return true;
+}
+
+// • Drop patterns without instances, preserving the order of the others.
+//   Nested patterns stay, since references to them are offsets
+//
+inline void compact(Arena& arena)
+{
+    const auto records   = patterns(arena);
+    const auto first     = first_instances(arena);
+    const auto transform = transforms(arena);
+
+    uint32_t kept = 0;
+
+    for (uint32_t index = 0; index < arena.patterns.count; ++index) {
+
+        if (0 < instance_count(records, records[index])) {
+
+            records[kept]   = records[index];
+            first[kept]     = first[index];
+            transform[kept] = transform[index];
+
+            ++kept;
+        }
+    }
+
+    arena.patterns.count        = kept;
+    arena.first_instances.count = kept;
+    arena.transforms.count      = kept;
+}
+
+#endif // !defined ( __METAL_VERSION__ )
@@ -33,10 +33,82 @@
 //
 - (nullable instancetype)initWithDevice:(nonnull id<MTLDevice>)device;
 
+- (nullable instancetype)initWithDevice:(nonnull id<MTLDevice>)device
+                          contentsOfURL:(nonnull NSURL*)url;
+
+// • Writing (scene file, see Scene.hpp)
+//
+- (BOOL)writeToURL:(nonnull NSURL*)url;
+
+// • Patterns
+//
+//  - Returns the index of the new pattern, or NSNotFound if the arena could
+//    not grow. Indices are stable until the composition is compacted
+//
+//  - rowCount rows of count instances, each row rowOffset from the last
+//    (see Pattern.hpp); a rowCount of 0 or 1 is a single row
+//
+- (NSInteger)appendPatternWithGridSize:(simd_uint2)gridSize
+                            baseOrigin:(simd_uint2)baseOrigin
+                              baseSize:(simd_uint2)baseSize
+                                offset:(simd_int2)offset
+                                 count:(uint32_t)count
+                             rowOffset:(simd_int2)rowOffset
+                              rowCount:(uint32_t)rowCount;
+
+- (BOOL)updatePatternAtIndex:(NSInteger)index
+                    gridSize:(simd_uint2)gridSize
+                  baseOrigin:(simd_uint2)baseOrigin
+                    baseSize:(simd_uint2)baseSize
+                      offset:(simd_int2)offset
+                       count:(uint32_t)count
+                   rowOffset:(simd_int2)rowOffset
+                    rowCount:(uint32_t)rowCount;
+
+- (BOOL)removePatternAtIndex:(NSInteger)index;
+- (void)compact;
+
+// • Frames
+//
+//  - The arena as of this call, in one of a ring of buffers (see
+//    FrameRing.hpp) for `commandBuffer` to read. Later edits go to the
+//    buffer of a later frame, so they never touch one the GPU may be
+//    reading. Waits while every buffer is in flight; the command buffer must
+//    be committed so that its buffer is released when it completes
+//
+//  - The buffers are blocks of pooled MTLBuffers (see BufferPool.hpp), so
+//    the arena starts at `offset`, where it must be bound
+//
+- (nullable id<MTLBuffer>)arenaBufferForCommandBuffer:(nonnull id<MTLCommandBuffer>)commandBuffer
+                                               offset:(nonnull NSInteger*)offset
+    NS_SWIFT_NAME(arenaBuffer(for:offset:));
+
+// • Tiled mode (see Tiles.hpp): an upper bound on the tile list entries of
+//   every instance in a `targetSize` target, for sizing the GPU's lists
+//
+- (NSInteger)tileEntryBoundForTargetSize:(simd_uint2)targetSize;
+
+// • Dirty regions (see DirtyRegions.hpp)
+//
+//  - Writes the pixel rects of a `targetSize` target that changed since the
+//    last call, at most maximumDirtyRectCount, and forgets them. Returns the
+//    number written
+//
+- (NSInteger)takeDirtyRectsForTargetSize:(simd_uint2)targetSize
+                                   rects:(nonnull MTLScissorRect*)rects;
+
+- (void)invalidate;
+
+@property (class, nonatomic, readonly) NSInteger maximumDirtyRectCount;
+
 // • Properties
 //
-@property (nonnull, nonatomic, readonly) id<MTLBuffer> patternBuffer;
+@property (nonatomic, readonly) NSInteger patternCount;
 @property (nonatomic, readonly) NSInteger instanceCount;
 @property (nonatomic, readonly) simd_uint2 aspectRatio;
 
+// • Changes with every edit of the patterns
+//
+@property (nonatomic, readonly) uint64_t generation;
+
 @end
@@ -18,9 +18,38 @@
 //
 
 #import "Composition.h"
-#import "Pattern.hpp"
+#import "Arena.hpp"
+#import "DirtyRegions.hpp"
+#import "MetalBufferPool.h"
+#import "PatternExpansion.hpp"
+#import "Scene.hpp"
+#import "Tiles.hpp"
+#import <Data/FrameRing.hpp>
+#import <Data/Trace.hpp>
 
+#import <algorithm>
+#import <cstdlib>
+#import <limits>
 #import <numeric>
+#import <optional>
+
+//===------------------------------------------------------------------------===
+//
+// • Frames
+//
+//  - The host edits its own copy of the arena. Each frame copies it, if it
+//    changed, into the next of a ring of buffers, so edits for the next frame
+//    never touch a buffer the GPU may still be reading
+//
+//  - The ring's buffers are blocks of a BufferPool over shared MTLBuffers,
+//    so small arenas share a slab rather than each taking a buffer
+//
+//===------------------------------------------------------------------------===
+
+enum : uint32_t
+{
+    frame_buffer_count = 3
+};
 
 //===------------------------------------------------------------------------===
 //
@@ -30,7 +59,13 @@
 
 @implementation Composition
 {
-    const Pattern* pattern;
+    Arena*                              arena;
+    DirtyRegions                        dirty;
+    data::FrameRing<frame_buffer_count> ring;
+    std::optional<data::BufferPool>     bufferPool;
+    std::optional<data::PoolAllocation> frameBuffers[frame_buffer_count];
+    uint64_t                            frameGenerations[frame_buffer_count];
+    uint64_t                            generation;
 }
 
 //===------------------------------------------------------------------------===
@@ -43,47 +78,366 @@
 
     if (nil != self) {
 
-        // • Pattern buffer
+        bufferPool.emplace( metal_slab_source(device, MTLResourceStorageModeShared) );
+
+        // • Arena buffer
         //
-        _patternBuffer = [device newBufferWithLength:data::aligned_size<Pattern>()
-                                             options:0];
-        if (nil == _patternBuffer) {
+        if (![self allocateArenaWithCapacity:16 nestedCapacity:0]) {
             return nil;
         }
 
-        auto pattern = static_cast<Pattern*>(_patternBuffer.contents);
-
-        *pattern = {
+        // • Checked at compile time (see PatternExpansion.hpp)
+        //
+        constexpr Pattern pattern = validated( {
             .grid_size   = { 10, 10 },
             .base_region = geometry::make_region({ 1, 1 }, { 8, 2 }),
             .offset      = { 0, 3 },
-            .count       = 3
-        };
+            .count       = 3,
+            .row_count   = 1,
+            .row_offset  = { 0, 0 },
+            .nested      = 0,
+            .reserved    = 0
+        } );
 
-        // • Aspect ratio
-        //
-        const auto aspect_gcd = std::gcd(pattern->grid_size.x, pattern->grid_size.y);
+        append(*arena, pattern);
 
-        _aspectRatio = {
-            pattern->grid_size.x / aspect_gcd,
-            pattern->grid_size.y / aspect_gcd
-        };
+        dirty.add_all();
+        ++generation;
+
+        [self updateAspectRatio];
+    }
+
+    return self;
+}
+
+- (nullable instancetype)initWithDevice:(nonnull id<MTLDevice>)device
+                          contentsOfURL:(nonnull NSURL*)url {
 
-        // • Keep a pointer
+    self = [super init];
+
+    if (nil != self) {
+
+        bufferPool.emplace( metal_slab_source(device, MTLResourceStorageModeShared) );
+
+        // • Map and validate the scene, then copy its arena into the buffer
         //
-        self->pattern = pattern;
+        const auto scene = MappedScene::open(url.fileSystemRepresentation);
+
+        if (!scene || SceneStatus::valid != validate_records(&scene->header(), scene->size())) {
+            return nil;
+        }
+
+        const auto capacity = std::max(16u, scene->arena().patterns.count);
+
+        if ( ![self allocateArenaWithCapacity:capacity nestedCapacity:scene->arena().nested_patterns.count]
+             || !copy_arena(*arena, scene->arena()) ) {
+            return nil;
+        }
+
+        dirty.add_all();
+        ++generation;
+
+        [self updateAspectRatio];
     }
 
     return self;
 }
 
+- (void)dealloc {
+
+    std::free(arena);
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Writing
+//===------------------------------------------------------------------------===
+
+- (BOOL)writeToURL:(nonnull NSURL*)url {
+
+    return write_scene(*arena, url.fileSystemRepresentation);
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Arena (Private)
+//===------------------------------------------------------------------------===
+
+- (BOOL)allocateArenaWithCapacity:(uint32_t)capacity nestedCapacity:(uint32_t)nestedCapacity {
+
+    auto memory = std::aligned_alloc( data::alignment, arena_size(capacity, nestedCapacity) );
+
+    if (nullptr == memory) {
+        return NO;
+    }
+
+    auto new_arena = make_arena(memory, capacity, nestedCapacity);
+
+    // • Offsets are relative to the arena, so the patterns copy as-is, bar
+    //   the nested references copy_arena moves
+    //
+    if (nullptr == new_arena || (nullptr != arena && !copy_arena(*new_arena, *arena))) {
+
+        std::free(memory);
+        return NO;
+    }
+
+    std::free(arena);
+
+    arena = new_arena;
+
+    return YES;
+}
+
+- (void)updateAspectRatio {
+
+    // • The aspect ratio of the first pattern's grid
+    //
+    if (0 == arena->patterns.count) {
+
+        _aspectRatio = { 1, 1 };
+        return;
+    }
+
+    const auto grid_size  = patterns(*arena)[0].grid_size;
+    const auto aspect_gcd = std::gcd(grid_size.x, grid_size.y);
+
+    _aspectRatio = {
+        grid_size.x / aspect_gcd,
+        grid_size.y / aspect_gcd
+    };
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Patterns
+//===------------------------------------------------------------------------===
+
+- (NSInteger)appendPatternWithGridSize:(simd_uint2)gridSize
+                            baseOrigin:(simd_uint2)baseOrigin
+                              baseSize:(simd_uint2)baseSize
+                                offset:(simd_int2)offset
+                                 count:(uint32_t)count
+                             rowOffset:(simd_int2)rowOffset
+                              rowCount:(uint32_t)rowCount {
+
+    if ( arena->patterns.capacity <= arena->patterns.count
+         && ![self allocateArenaWithCapacity:2*arena->patterns.capacity
+                              nestedCapacity:arena->nested_patterns.capacity] ) {
+
+        return NSNotFound;
+    }
+
+    const Pattern pattern = {
+        .grid_size   = gridSize,
+        .base_region = geometry::make_region(baseOrigin, baseSize),
+        .offset      = offset,
+        .count       = count,
+        .row_count   = rowCount,
+        .row_offset  = rowOffset,
+        .nested      = 0,
+        .reserved    = 0
+    };
+
+    const auto index = arena->patterns.count;
+
+    if (!append(*arena, pattern)) {
+        return NSNotFound;
+    }
+
+    dirty.add(pattern);
+    ++generation;
+
+    return index;
+}
+
+- (BOOL)updatePatternAtIndex:(NSInteger)index
+                    gridSize:(simd_uint2)gridSize
+                  baseOrigin:(simd_uint2)baseOrigin
+                    baseSize:(simd_uint2)baseSize
+                      offset:(simd_int2)offset
+                       count:(uint32_t)count
+                   rowOffset:(simd_int2)rowOffset
+                    rowCount:(uint32_t)rowCount {
+
+    if (index < 0 || arena->patterns.count <= index) {
+        return NO;
+    }
+
+    const Pattern pattern = {
+        .grid_size   = gridSize,
+        .base_region = geometry::make_region(baseOrigin, baseSize),
+        .offset      = offset,
+        .count       = count,
+        .row_count   = rowCount,
+        .row_offset  = rowOffset,
+        .nested      = 0,
+        .reserved    = 0
+    };
+
+    // • Both where the pattern was and where it is now
+    //
+    const auto previous = patterns(*arena)[index];
+
+    if (!update(*arena, static_cast<uint32_t>(index), pattern)) {
+        return NO;
+    }
+
+    dirty.add(previous);
+    dirty.add(pattern);
+    ++generation;
+
+    return YES;
+}
+
+- (BOOL)removePatternAtIndex:(NSInteger)index {
+
+    if (index < 0 || arena->patterns.count <= index) {
+        return NO;
+    }
+
+    dirty.add( patterns(*arena)[index] );
+    ++generation;
+
+    return remove(*arena, static_cast<uint32_t>(index));
+}
+
+- (void)compact {
+
+    compact(*arena);
+
+    ++generation;
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Frames
+//===------------------------------------------------------------------------===
+
+- (nullable id<MTLBuffer>)arenaBufferForCommandBuffer:(nonnull id<MTLCommandBuffer>)commandBuffer
+                                               offset:(nonnull NSInteger*)offset {
+
+    PLAY_TRACE_SCOPE("arena buffer", "composition");
+
+    const auto slot = [&] {
+        PLAY_TRACE_SCOPE("wait for frame buffer", "composition");
+        return ring.acquire();
+    }();
+
+    // • Copy the arena only if it changed since this buffer last held it
+    //
+    if (frameGenerations[slot] != generation) {
+
+        PLAY_TRACE_SCOPE("upload arena", "composition");
+
+        const auto capacity = arena->patterns.capacity;
+        const auto nested   = arena->nested_patterns.capacity;
+        const auto size     = arena_size(capacity, nested);
+
+        // • The slot's frame is done, so its block can go back to the pool
+        //
+        if (!frameBuffers[slot] || bufferPool->capacity(*frameBuffers[slot]) < size) {
+
+            if (frameBuffers[slot]) {
+                bufferPool->free(*frameBuffers[slot]);
+            }
+
+            frameBuffers[slot] = bufferPool->allocate(size);
+
+            if (!frameBuffers[slot]) {
+                return nil;
+            }
+        }
+
+        const auto frame_arena = make_arena(bufferPool->contents(*frameBuffers[slot]), capacity, nested);
+
+        if (nullptr == frame_arena || !copy_arena(*frame_arena, *arena)) {
+            return nil;
+        }
+
+        frameGenerations[slot] = generation;
+    }
+
+    ring.commit();
+
+    [commandBuffer addCompletedHandler:^(id<MTLCommandBuffer>) {
+        self->ring.complete();
+    }];
+
+    *offset = frameBuffers[slot]->offset;
+
+    return metal_buffer(*bufferPool, *frameBuffers[slot]);
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Tiles
+//===------------------------------------------------------------------------===
+
+- (NSInteger)tileEntryBoundForTargetSize:(simd_uint2)targetSize {
+
+    const auto records = patterns(*arena);
+
+    uint64_t bound = 0;
+
+    for (uint32_t index = 0; index < arena->patterns.count; ++index) {
+        bound += tile_entry_bound(records, records[index], targetSize);
+    }
+
+    return static_cast<NSInteger>( std::min<uint64_t>(bound, std::numeric_limits<uint32_t>::max()) );
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Dirty Regions
+//===------------------------------------------------------------------------===
+
+- (NSInteger)takeDirtyRectsForTargetSize:(simd_uint2)targetSize
+                                   rects:(nonnull MTLScissorRect*)rects {
+
+    PLAY_TRACE_SCOPE("dirty rects", "composition");
+
+    std::vector<geometry::Region> regions;
+
+    dirty.pixel_regions(targetSize, regions);
+    dirty.clear();
+
+    for (size_t index = 0; index < regions.size(); ++index) {
+
+        const auto& region = regions[index];
+
+        rects[index] = {
+            .x      = region.left,
+            .y      = region.top,
+            .width  = geometry::width(region),
+            .height = geometry::height(region)
+        };
+    }
+
+    return static_cast<NSInteger>( regions.size() );
+}
+
+- (void)invalidate {
+
+    dirty.add_all();
+}
+
++ (NSInteger)maximumDirtyRectCount {
+
+    return DirtyRegions::maximum_count;
+}
+
 //===------------------------------------------------------------------------===
 #pragma mark - Properties
 //===------------------------------------------------------------------------===
 
+- (NSInteger)patternCount {
+
+    return arena->patterns.count;
+}
+
 - (NSInteger)instanceCount {
 
-    return pattern->count;
+    return arena->instance_count;
+}
+
+- (uint64_t)generation {
+
+    return generation;
 }
 
 @end
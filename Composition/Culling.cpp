@@ -0,0 +1,98 @@
+//
+//  Culling.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Composition/Culling.hpp>
+#include <Composition/PatternQueries.hpp>
+#include <Data/Trace.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//===------------------------------------------------------------------------===
+// • Candidates (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+// • The viewport in grid units, widened by a unit on each side so that it
+//   includes every instance that is_visible could accept despite rounding
+//
+uint32_t grid_coordinate(double value)
+{
+    return static_cast<uint32_t>( std::clamp<double>( value, 0.0, std::numeric_limits<uint32_t>::max() ) );
+}
+
+geometry::Region candidate_region(geometry::TextureRect viewport, simd::uint2 grid_size)
+{
+    const auto width  = static_cast<double>(grid_size.x);
+    const auto height = static_cast<double>(grid_size.y);
+
+    return {
+        .left   = grid_coordinate( std::floor(viewport.left   * width)  - 1.0 ),
+        .top    = grid_coordinate( std::floor(viewport.top    * height) - 1.0 ),
+        .right  = grid_coordinate( std::ceil(viewport.right   * width)  + 1.0 ),
+        .bottom = grid_coordinate( std::ceil(viewport.bottom  * height) + 1.0 )
+    };
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Host culling
+//===------------------------------------------------------------------------===
+
+DrawPrimitivesArguments cull_instances( const Arena& arena, geometry::TextureRect viewport,
+                                        std::vector<uint32_t>& visible_instances )
+{
+    PLAY_TRACE_SCOPE("cull", "raster");
+
+    visible_instances.clear();
+
+    auto arguments = initial_draw_arguments();
+
+    if (!(viewport.left < viewport.right && viewport.top < viewport.bottom)) {
+        return arguments;
+    }
+
+    const auto records = patterns(arena);
+    const auto first   = first_instances(arena);
+
+    for (uint32_t index = 0; index < arena.patterns.count; ++index) {
+
+        const auto& pattern   = records[index];
+        const auto  candidate = candidate_region(viewport, pattern.grid_size);
+
+        for_each_intersecting( records, pattern, candidate, [&](InstanceRange candidates) {
+
+            for (auto instance = candidates.first; instance < candidates.end; ++instance) {
+                if (is_visible(instance_region(records, pattern, instance), pattern.grid_size, viewport)) {
+                    visible_instances.push_back(first[index] + instance);
+                }
+            }
+        } );
+    }
+
+    arguments.instance_count = static_cast<uint32_t>( visible_instances.size() );
+
+    PLAY_TRACE_COUNTER("visible instances", arguments.instance_count);
+
+    return arguments;
+}
@@ -0,0 +1,110 @@
+//
+//  Culling.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Arena.hpp>
+#include <Graphics/Geometry.hpp>
+#include <Data/Layout.hpp>
+
+#if !defined ( __METAL_VERSION__ )
+#include <vector>
+#endif
+
+//===------------------------------------------------------------------------===
+//
+// • Culling
+//
+//  - A pass before the instanced draw that writes the indices of the visible
+//    instances and the arguments for an indirect draw of just those, so that
+//    vertex work scales with visible rather than total instances
+//
+//  - cull_instances (Shaders.metal) runs the pass on the GPU; the host
+//    version below produces the same instances, in draw order. The one
+//    exception is an instance whose coordinates pass 2^32: the GPU wraps
+//    them, as pattern_vertex does, while the host takes them exactly, as the
+//    Rasterizer does (see PatternQueries.hpp)
+//
+//===------------------------------------------------------------------------===
+
+//===------------------------------------------------------------------------===
+// • DrawPrimitivesArguments
+//
+//  - Layout of MTLDrawPrimitivesIndirectArguments. The culling pass adds
+//    to instance_count, so it must be reset to zero before each pass
+//===------------------------------------------------------------------------===
+
+struct DrawPrimitivesArguments
+{
+    uint32_t    vertex_count;
+    uint32_t    instance_count;
+    uint32_t    vertex_start;
+    uint32_t    base_instance;
+};
+
+enum : uint32_t
+{
+    draw_arguments_instance_count_index = 1    // As a uint32_t array, for atomics
+};
+
+// • Arguments for the quad of pattern_vertex, before culling
+//
+constexpr DrawPrimitivesArguments initial_draw_arguments(void)
+{
+    return { .vertex_count = 4, .instance_count = 0, .vertex_start = 0, .base_instance = 0 };
+}
+
+#if !defined ( __METAL_VERSION__ )
+static_assert( data::is_trivial_layout<DrawPrimitivesArguments>(), "Unexpected layout" );
+static_assert( 16 == sizeof(DrawPrimitivesArguments), "Unexpected size" );
+#endif
+
+//===------------------------------------------------------------------------===
+// • Visibility
+//===------------------------------------------------------------------------===
+
+// • Whether an instance overlaps the viewport, in normalized view
+//   coordinates (the whole view is full_texture_rect()). Empty instances,
+//   and those with only one edge wrapped, are never visible
+//
+constexpr bool is_visible( const geometry::Region region, simd::uint2 grid_size,
+                           const geometry::TextureRect viewport )
+{
+    const auto rect = geometry::make_texture_rect(region, grid_size);
+
+    return rect.left < rect.right && rect.top < rect.bottom
+        && rect.left < viewport.right && viewport.left < rect.right
+        && rect.top < viewport.bottom && viewport.top < rect.bottom;
+}
+
+#if !defined ( __METAL_VERSION__ )
+
+//===------------------------------------------------------------------------===
+// • Host culling
+//
+//  - Tests only the instances of each pattern that can overlap the viewport
+//    (for_each_intersecting), so the cost scales with patterns and rows
+//    plus visible instances
+//
+//===------------------------------------------------------------------------===
+
+DrawPrimitivesArguments cull_instances( const Arena& arena, geometry::TextureRect viewport,
+                                        std::vector<uint32_t>& visible_instances );
+
+#endif // !defined ( __METAL_VERSION__ )
@@ -0,0 +1,188 @@
+//
+//  DirtyRegions.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <Composition/DirtyRegions.hpp>
+#include <Composition/PatternQueries.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//===------------------------------------------------------------------------===
+// • Rects (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+bool is_empty_rect(geometry::TextureRect rect)
+{
+    return !(rect.left < rect.right && rect.top < rect.bottom);
+}
+
+bool overlaps(geometry::TextureRect lhs, geometry::TextureRect rhs)
+{
+    return lhs.left <= rhs.right && rhs.left <= lhs.right
+        && lhs.top <= rhs.bottom && rhs.top <= lhs.bottom;
+}
+
+geometry::TextureRect bounding_rect(geometry::TextureRect lhs, geometry::TextureRect rhs)
+{
+    return {
+        .left   = std::min(lhs.left,   rhs.left),
+        .top    = std::min(lhs.top,    rhs.top),
+        .right  = std::max(lhs.right,  rhs.right),
+        .bottom = std::max(lhs.bottom, rhs.bottom)
+    };
+}
+
+float area(geometry::TextureRect rect)
+{
+    return geometry::width(rect) * geometry::height(rect);
+}
+
+// • Whether any cell has a coordinate outside [0, 2^32), where the GPU wraps
+//   it (see PatternQueries.hpp) and the bounding region does not hold it
+//
+bool has_wrapped_instances(const Pattern& pattern)
+{
+    const auto bounds = lattice_bounds(pattern);
+    const auto limit  = static_cast<int64_t>( std::numeric_limits<uint32_t>::max() );
+
+    return bounds.left < 0 || limit < bounds.right || bounds.top < 0 || limit < bounds.bottom;
+}
+
+uint32_t pixel_coordinate(float value, uint32_t extent)
+{
+    if (!(0.0f < value)) {
+        return 0;
+    }
+
+    return (static_cast<float>(extent) < value) ? extent : static_cast<uint32_t>(value);
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • DirtyRegions
+//===------------------------------------------------------------------------===
+
+void DirtyRegions::add(const Pattern& pattern)
+{
+    if (0 == pattern.count || geometry::is_empty(pattern.base_region)) {
+        return;
+    }
+
+    if (has_wrapped_instances(pattern)) {
+        add_all();
+        return;
+    }
+
+    add( geometry::make_texture_rect(bounding_region(pattern), pattern.grid_size) );
+}
+
+void DirtyRegions::add(geometry::TextureRect rect)
+{
+    rect = {
+        .left   = std::max(rect.left,   0.0f),
+        .top    = std::max(rect.top,    0.0f),
+        .right  = std::min(rect.right,  1.0f),
+        .bottom = std::min(rect.bottom, 1.0f)
+    };
+
+    if (is_empty_rect(rect)) {
+        return;
+    }
+
+    // • Absorb every region the new one overlaps, repeating while the merged
+    //   region grows into others
+    //
+    for (auto merged = true; merged; ) {
+
+        merged = false;
+
+        for (auto region = regions.begin(); region != regions.end(); ) {
+
+            if (overlaps(*region, rect)) {
+
+                rect   = bounding_rect(*region, rect);
+                region = regions.erase(region);
+                merged = true;
+
+            } else {
+                ++region;
+            }
+        }
+    }
+
+    regions.push_back(rect);
+
+    // • Too many: merge the pair whose bounding rect adds the least area
+    //
+    while (maximum_count < regions.size()) {
+
+        auto  best_first  = size_t { 0 };
+        auto  best_second = size_t { 1 };
+        auto  best_cost   = std::numeric_limits<float>::infinity();
+
+        for (size_t first = 0; first < regions.size(); ++first) {
+            for (auto second = first + 1; second < regions.size(); ++second) {
+
+                const auto bounds = bounding_rect(regions[first], regions[second]);
+                const auto cost   = area(bounds) - area(regions[first]) - area(regions[second]);
+
+                if (cost < best_cost) {
+                    best_first  = first;
+                    best_second = second;
+                    best_cost   = cost;
+                }
+            }
+        }
+
+        const auto bounds = bounding_rect(regions[best_first], regions[best_second]);
+
+        regions.erase( regions.begin() + best_second );
+        regions.erase( regions.begin() + best_first );
+
+        add(bounds);
+    }
+}
+
+void DirtyRegions::pixel_regions(simd::uint2 target_size, std::vector<geometry::Region>& pixels) const
+{
+    pixels.clear();
+
+    const auto width  = static_cast<float>(target_size.x);
+    const auto height = static_cast<float>(target_size.y);
+
+    for (const auto& rect : regions) {
+
+        const geometry::Region region = {
+            .left   = pixel_coordinate( std::floor(rect.left   * width)  - 1.0f, target_size.x ),
+            .top    = pixel_coordinate( std::floor(rect.top    * height) - 1.0f, target_size.y ),
+            .right  = pixel_coordinate( std::ceil(rect.right   * width)  + 1.0f, target_size.x ),
+            .bottom = pixel_coordinate( std::ceil(rect.bottom  * height) + 1.0f, target_size.y )
+        };
+
+        if (!geometry::is_empty(region)) {
+            pixels.push_back(region);
+        }
+    }
+}
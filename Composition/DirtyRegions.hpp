@@ -0,0 +1,86 @@
+//
+//  DirtyRegions.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Pattern.hpp>
+
+#include <cstdint>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+//
+// • DirtyRegions
+//
+//  - The parts of the view that changed since the last frame, so that only
+//    those are redrawn. A changed pattern dirties the union of the bounding
+//    regions of its instances before and after the change
+//
+//  - Regions are kept in normalized view coordinates (as TextureRect: 0 to
+//    1, y down), since patterns may have different grid sizes and the target
+//    size is only known when drawing. Overlapping regions are merged, and
+//    past maximum_count the two closest are, so the list stays short
+//
+//===------------------------------------------------------------------------===
+
+class DirtyRegions
+{
+public:
+
+    static constexpr uint32_t maximum_count = 16;
+
+    // • Record the instances of `pattern`: call with the old pattern before
+    //   a change, and with the new one after it
+    //
+    void add(const Pattern& pattern);
+
+    void add(geometry::TextureRect rect);
+
+    // • The whole view, e.g. after a resize
+    //
+    void add_all(void)
+    {
+        regions.assign( 1, geometry::full_texture_rect() );
+    }
+
+    void clear(void) noexcept
+    {
+        regions.clear();
+    }
+
+    bool is_empty(void) const noexcept
+    {
+        return regions.empty();
+    }
+
+    uint32_t count(void) const noexcept
+    {
+        return static_cast<uint32_t>( regions.size() );
+    }
+
+    // • Pixels of a `target_size` target that may have changed: each region
+    //   rounded out to whole pixels, with a pixel of margin for rounding in
+    //   the rasterizer, and clipped to the target
+    //
+    void pixel_regions(simd::uint2 target_size, std::vector<geometry::Region>& pixels) const;
+
+private:
+
+    std::vector<geometry::TextureRect> regions;
+};
@@ -0,0 +1,591 @@
+//
+//  FrameExport.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <Composition/FrameExport.hpp>
+#include <Data/Trace.hpp>
+#include <Graphics/PixelConversion.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <unistd.h>
+
+//===------------------------------------------------------------------------===
+// • namespace raster
+//===------------------------------------------------------------------------===
+
+namespace raster
+{
+
+namespace
+{
+
+static_assert( std::endian::little == std::endian::native, "Pixels are read as little-endian words" );
+
+//===------------------------------------------------------------------------===
+// • Checksums
+//===------------------------------------------------------------------------===
+
+// • CRC-32 (ISO 3309, as PNG chunks use), eight bytes at a time: table t
+//   holds the CRC of a byte followed by t zero bytes
+//
+constexpr auto crc_tables = [] {
+
+    std::array<std::array<uint32_t, 256>, 8> tables = { };
+
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+
+        auto crc = byte;
+
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1u) ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+        }
+
+        tables[0][byte] = crc;
+    }
+
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        for (size_t table = 1; table < tables.size(); ++table) {
+
+            const auto previous = tables[table - 1][byte];
+
+            tables[table][byte] = (previous >> 8) ^ tables[0][previous & 0xff];
+        }
+    }
+
+    return tables;
+}();
+
+uint32_t crc32(uint32_t crc, const uint8_t* bytes, size_t count)
+{
+    const auto& t = crc_tables;
+
+    crc = ~crc;
+
+    for (; 8 <= count; bytes += 8, count -= 8) {
+
+        uint32_t low, high;
+
+        std::memcpy(&low, bytes, 4);
+        std::memcpy(&high, bytes + 4, 4);
+
+        low ^= crc;
+
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24]
+            ^ t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+    }
+
+    for (; 0 < count; ++bytes, --count) {
+        crc = t[0][(crc ^ *bytes) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+// • Adler-32 (zlib), reducing once per 5552 bytes, the most before b can
+//   overflow
+//
+uint32_t adler32(uint32_t adler, const uint8_t* bytes, size_t count)
+{
+    constexpr uint32_t modulus = 65521;
+
+    auto a = adler & 0xffff;
+    auto b = adler >> 16;
+
+    while (0 < count) {
+
+        const auto chunk = std::min<size_t>(count, 5552);
+
+        for (size_t index = 0; index < chunk; ++index) {
+            a += bytes[index];
+            b += a;
+        }
+
+        a %= modulus;
+        b %= modulus;
+
+        bytes += chunk;
+        count -= chunk;
+    }
+
+    return (b << 16) | a;
+}
+
+//===------------------------------------------------------------------------===
+// • PNG layout
+//
+//  - Signature, IHDR, sRGB, one IDAT and IEND. IDAT holds a zlib stream of
+//    stored deflate blocks (at most 65535 bytes each) over rows of a filter
+//    byte (none) and RGB pixels. Blocks hold whole rows when a row fits;
+//    wider rows are split into several blocks at pixel boundaries
+//
+//===------------------------------------------------------------------------===
+
+constexpr uint8_t png_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+constexpr uint32_t chunk_overhead   = 12;       // Length, type and CRC
+constexpr uint32_t ihdr_size        = 13;
+constexpr uint32_t srgb_size        = 1;
+constexpr uint32_t zlib_overhead    = 6;        // Header and Adler-32
+constexpr uint32_t block_header     = 5;
+constexpr uint32_t max_block        = 65535;
+constexpr uint64_t max_chunk        = (uint64_t{ 1 } << 31) - 1;      // Data bytes of a chunk
+constexpr uint32_t first_pixels     = (max_block - 1) / 3;  // Of a split row, after its filter byte
+constexpr uint32_t pixels_per_block = max_block / 3;        // Of a split row, after the first block
+constexpr uint32_t encode_run       = 256;                  // Of .rgba16Float pixels encoded at a time
+
+constexpr uint64_t row_size(uint32_t width)
+{
+    return 1 + 3 * static_cast<uint64_t>(width);
+}
+
+constexpr uint64_t block_count(uint32_t width, uint32_t height)
+{
+    if (row_size(width) <= max_block) {
+
+        const auto rows_per_block = max_block / row_size(width);
+
+        return (height + rows_per_block - 1) / rows_per_block;
+    }
+
+    return height * ( 1 + (width - first_pixels + pixels_per_block - 1) / pixels_per_block );
+}
+
+constexpr uint64_t idat_size(uint32_t width, uint32_t height)
+{
+    return zlib_overhead + block_header * block_count(width, height) + row_size(width) * height;
+}
+
+uint8_t* put_u32(uint8_t* output, uint32_t value)
+{
+    value = __builtin_bswap32(value);
+
+    std::memcpy(output, &value, 4);
+
+    return output + 4;
+}
+
+uint8_t* put_chunk(uint8_t* output, const char (&type)[5], const uint8_t* data, uint32_t size)
+{
+    const auto start = put_u32(output, size);
+
+    std::memcpy(start, type, 4);
+    std::memcpy(start + 4, data, size);
+
+    return put_u32( start + 4 + size, crc32(0, start, 4 + size) );
+}
+
+uint8_t* put_block_header(uint8_t* output, uint32_t size, bool is_final)
+{
+    output[0] = is_final ? 1 : 0;
+    output[1] = static_cast<uint8_t>(size);
+    output[2] = static_cast<uint8_t>(size >> 8);
+    output[3] = static_cast<uint8_t>(~size);
+    output[4] = static_cast<uint8_t>(~size >> 8);
+
+    return output + block_header;
+}
+
+// • B, G, R, A pixels to R, G, B, four at a time: a byte-swapped pixel
+//   shifted right by 8 is R, G, B in its low three bytes, and four of those
+//   pack into twelve bytes
+//
+uint8_t* put_rgb(uint8_t* output, const uint8_t* pixels, uint32_t count)
+{
+    for (; 4 <= count; count -= 4, pixels += 16, output += 12) {
+
+        uint32_t bgra[4];
+        std::memcpy(bgra, pixels, 16);
+
+        const auto rgb0 = __builtin_bswap32(bgra[0]) >> 8;
+        const auto rgb1 = __builtin_bswap32(bgra[1]) >> 8;
+        const auto rgb2 = __builtin_bswap32(bgra[2]) >> 8;
+        const auto rgb3 = __builtin_bswap32(bgra[3]) >> 8;
+
+        const uint64_t low  = rgb0 | (uint64_t { rgb1 } << 24) | (uint64_t { rgb2 } << 48);
+        const uint32_t high = (rgb2 >> 16) | (rgb3 << 8);
+
+        std::memcpy(output, &low, 8);
+        std::memcpy(output + 8, &high, 4);
+    }
+
+    for (; 0 < count; --count, pixels += 4, output += 3) {
+        output[0] = pixels[2];
+        output[1] = pixels[1];
+        output[2] = pixels[0];
+    }
+
+    return output;
+}
+
+uint32_t page_size(void)
+{
+    return static_cast<uint32_t>( ::sysconf(_SC_PAGESIZE) );
+}
+
+// • Frames larger than FrameBuffers holds are not supported, nor PNG
+//   frames whose image data doesn't fit in one IDAT chunk
+//
+uint32_t frame_buffer_size(PixelFormat format, simd::uint2 size, FrameEncoding encoding)
+{
+    if ((1u << 24) <= size.x) {
+        return 0;
+    }
+
+    if (FrameEncoding::png == encoding && max_chunk < idat_size(size.x, size.y)) {
+        return 0;
+    }
+
+    const auto bytes = buffer_size(format, size.x, size.y);
+
+    return (bytes <= UINT32_MAX - data::alignment) ? static_cast<uint32_t>(bytes) : 0;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Writing
+//===------------------------------------------------------------------------===
+
+bool write_all(int descriptor, const uint8_t* bytes, size_t count)
+{
+    while (0 < count) {
+
+        const auto written = ::write(descriptor, bytes, count);
+
+        if (written < 0) {
+
+            if (EINTR == errno) {
+                continue;
+            }
+
+            return false;
+        }
+
+        bytes += written;
+        count -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+bool write_all(int descriptor, iovec* vectors, int count)
+{
+    while (0 < count) {
+
+        const auto written = ::writev(descriptor, vectors, count);
+
+        if (written < 0) {
+
+            if (EINTR == errno) {
+                continue;
+            }
+
+            return false;
+        }
+
+        auto rest = static_cast<size_t>(written);
+
+        for (; 0 < count && vectors->iov_len <= rest; ++vectors, --count) {
+            rest -= vectors->iov_len;
+        }
+
+        if (0 < count) {
+            vectors->iov_base  = static_cast<uint8_t*>(vectors->iov_base) + rest;
+            vectors->iov_len  -= rest;
+        }
+    }
+
+    return true;
+}
+
+//===------------------------------------------------------------------------===
+// • PNG
+//===------------------------------------------------------------------------===
+
+size_t png_size(uint32_t width, uint32_t height)
+{
+    return sizeof(png_signature) + 4 * chunk_overhead + ihdr_size + srgb_size + idat_size(width, height);
+}
+
+void encode_png(const Bitmap& frame, uint8_t* output)
+{
+    PLAY_TRACE_SCOPE("encode png", "export");
+
+    const auto width  = frame.width;
+    const auto height = frame.height;
+
+    std::memcpy(output, png_signature, sizeof(png_signature));
+
+    // • 8-bit RGB, no interlacing; perceptual sRGB
+    //
+    uint8_t header[ihdr_size] = { 0, 0, 0, 0, 0, 0, 0, 0, 8, 2, 0, 0, 0 };
+
+    put_u32(header, width);
+    put_u32(header + 4, height);
+
+    const uint8_t rendering_intent[srgb_size] = { 0 };
+
+    output = put_chunk(output + sizeof(png_signature), "IHDR", header, ihdr_size);
+    output = put_chunk(output, "sRGB", rendering_intent, srgb_size);
+
+    // • IDAT, checksummed a block at a time while it is in cache
+    //
+    const auto chunk = put_u32( output, static_cast<uint32_t>( idat_size(width, height) ) );
+
+    std::memcpy(chunk, "IDAT", 4);
+
+    output = chunk + 4;
+    output[0] = 0x78;   // Deflate, 32K window
+    output[1] = 0x01;   // No preset dictionary, fastest; 0x7801 % 31 == 0
+    output += 2;
+
+    auto crc   = crc32(0, chunk, 6);
+    auto adler = 1u;
+
+    // • .rgba16Float rows are sRGB encoded a run of pixels at a time, on the
+    //   stack, ahead of the reorder
+    //
+    const auto put_row = [&](uint8_t* data, uint32_t y, uint32_t x, uint32_t count) {
+
+        if (PixelFormat::bgra8Unorm == frame.format) {
+            return put_rgb( data, reinterpret_cast<const uint8_t*>( row(frame, y) + x ), count );
+        }
+
+        uint32_t encoded[encode_run];
+
+        for (auto halves = half_row(frame, y) + 4*static_cast<size_t>(x); 0 < count; ) {
+
+            const auto run = std::min(count, encode_run);
+
+            pixels::encode_bgra8( { halves, 4*static_cast<size_t>(run) }, { encoded, run } );
+
+            data    = put_rgb( data, reinterpret_cast<const uint8_t*>(encoded), run );
+            halves += 4*static_cast<size_t>(run);
+            count  -= run;
+        }
+
+        return data;
+    };
+
+    if (row_size(width) <= max_block) {
+
+        const auto rows_per_block = static_cast<uint32_t>( max_block / row_size(width) );
+
+        for (uint32_t top = 0; top < height; top += rows_per_block) {
+
+            const auto bottom = std::min(top + rows_per_block, height);
+            const auto size   = static_cast<uint32_t>( row_size(width) * (bottom - top) );
+            const auto data   = put_block_header(output, size, bottom == height);
+
+            auto end = data;
+
+            for (auto y = top; y < bottom; ++y) {
+                *end++ = 0;
+                end = put_row(end, y, 0, width);
+            }
+
+            adler  = adler32(adler, data, size);
+            crc    = crc32(crc, output, block_header + size);
+            output = end;
+        }
+    } else {
+
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ) {
+
+                const auto is_first = (0 == x);
+                const auto count    = std::min(width - x, is_first ? first_pixels : pixels_per_block);
+                const auto size     = 3 * count + (is_first ? 1 : 0);
+                const auto is_final = (y + 1 == height) && (x + count == width);
+                const auto data     = put_block_header(output, size, is_final);
+
+                auto end = data;
+
+                if (is_first) {
+                    *end++ = 0;
+                }
+
+                end = put_row(end, y, x, count);
+
+                adler  = adler32(adler, data, size);
+                crc    = crc32(crc, output, block_header + size);
+                output = end;
+                x     += count;
+            }
+        }
+    }
+
+    const auto checksum = put_u32(output, adler);
+
+    crc    = crc32(crc, output, 4);
+    output = put_u32(checksum, crc);
+
+    put_chunk(output, "IEND", nullptr, 0);
+}
+
+//===------------------------------------------------------------------------===
+// • FrameExporter
+//===------------------------------------------------------------------------===
+
+FrameExporter::FrameExporter(int descriptor, simd::uint2 size, PixelFormat format, FrameEncoding encoding)
+    : buffers    { frame_buffer_size(format, size, encoding), page_size() },
+      frame_size { size },
+      format     { format },
+      encoding   { encoding },
+      descriptor { descriptor }
+{
+    const auto is_supported = 0 < size.x && 0 < size.y && 0 <= descriptor
+                           && 0 < frame_buffer_size(format, size, encoding) && buffers.is_valid();
+
+    if (!is_supported) {
+        return;
+    }
+
+    if (FrameEncoding::png == encoding) {
+        encoded.resize( png_size(size.x, size.y) );
+    } else {
+        rows.resize( std::min<uint32_t>(size.y, IOV_MAX) );
+    }
+
+    writer = std::thread { [this] { write_frames(); } };
+}
+
+FrameExporter::~FrameExporter()
+{
+    finish();
+}
+
+Bitmap FrameExporter::begin_frame(void)
+{
+    {
+        PLAY_TRACE_SCOPE("wait for frame buffer", "export");
+
+        slot = ring.acquire();
+    }
+
+    is_last[slot] = false;
+
+    return { buffers[slot], frame_size.x, frame_size.y, bytes_per_row(format, frame_size.x), format };
+}
+
+void FrameExporter::end_frame(void)
+{
+    ring.commit();
+}
+
+bool FrameExporter::finish(void)
+{
+    if (writer.joinable()) {
+
+        // • A last frame with no pixels stops the writer after the others
+        //
+        slot          = ring.acquire();
+        is_last[slot] = true;
+
+        ring.commit();
+        writer.join();
+    }
+
+    return !has_failed.load(std::memory_order_acquire);
+}
+
+void FrameExporter::write_frames(void)
+{
+    for (;;) {
+
+        const auto frame_slot = ring.consume();
+
+        if (is_last[frame_slot]) {
+            ring.complete();
+            return;
+        }
+
+        if (!has_failed.load(std::memory_order_relaxed)) {
+
+            if (write_frame(frame_slot)) {
+                written_frames.fetch_add(1, std::memory_order_release);
+            } else {
+                has_failed.store(true, std::memory_order_release);
+            }
+        }
+
+        ring.complete();
+    }
+}
+
+bool FrameExporter::write_frame(uint32_t frame_slot)
+{
+    PLAY_TRACE_SCOPE("write frame", "export");
+
+    const Bitmap frame = {
+        buffers[frame_slot], frame_size.x, frame_size.y, bytes_per_row(format, frame_size.x), format
+    };
+
+    if (FrameEncoding::png == encoding) {
+
+        encode_png(frame, encoded.data());
+
+        if (!write_all(descriptor, encoded.data(), encoded.size())) {
+            return false;
+        }
+
+        written_bytes.fetch_add(encoded.size(), std::memory_order_relaxed);
+
+        return true;
+    }
+
+    // • Raw: the whole buffer when rows have no padding, else row by row
+    //
+    const auto row_bytes = frame.width * bytes_per_pixel(format);
+
+    if (row_bytes == frame.bytes_per_row) {
+
+        if (!write_all( descriptor, frame.data, static_cast<size_t>(row_bytes) * frame.height )) {
+            return false;
+        }
+    } else {
+
+        const auto batch = static_cast<uint32_t>( rows.size() );
+
+        for (uint32_t top = 0; top < frame.height; top += batch) {
+
+            const auto count = std::min(batch, frame.height - top);
+
+            for (uint32_t index = 0; index < count; ++index) {
+                rows[index] = { frame.data + static_cast<size_t>(top + index) * frame.bytes_per_row, row_bytes };
+            }
+
+            if (!write_all( descriptor, rows.data(), static_cast<int>(count) )) {
+                return false;
+            }
+        }
+    }
+
+    written_bytes.fetch_add(static_cast<uint64_t>(row_bytes) * frame.height, std::memory_order_relaxed);
+
+    return true;
+}
+
+} // namespace raster
@@ -0,0 +1,185 @@
+//
+//  FrameExport.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Rasterizer.hpp>
+#include <Data/FrameRing.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <sys/uio.h>
+
+//===------------------------------------------------------------------------===
+// • namespace raster
+//===------------------------------------------------------------------------===
+
+namespace raster
+{
+
+//===------------------------------------------------------------------------===
+// • PNG
+//
+//  - 8-bit RGB with the sRGB chunk, which matches the opaque .bgra8Unorm
+//    canvas; .rgba16Float frames are sRGB encoded to it, as convert does.
+//    The image data is stored rather than compressed: encoding is a copy
+//    plus the CRC-32 and Adler-32 checksums, and the size of every frame is
+//    known up front. The image data is one IDAT chunk, which holds under
+//    2^31 bytes, so a frame holds at most about 715 million pixels
+//===------------------------------------------------------------------------===
+
+// • Bytes of the PNG of a width x height frame
+//
+size_t png_size(uint32_t width, uint32_t height);
+
+// • Encode `frame` into `output`, png_size bytes
+//
+void encode_png(const Bitmap& frame, uint8_t* output);
+
+//===------------------------------------------------------------------------===
+// • Writing
+//
+//  - Every byte, retrying short and interrupted writes; false on any other
+//    error
+//===------------------------------------------------------------------------===
+
+bool write_all(int descriptor, const uint8_t* bytes, size_t count);
+
+// • `vectors` are advanced past what each write takes
+//
+bool write_all(int descriptor, iovec* vectors, int count);
+
+//===------------------------------------------------------------------------===
+// • FrameEncoding
+//
+//  - png writes each frame as a complete PNG, so a stream of them can be
+//    split again (e.g. ffmpeg -f image2pipe); raw writes the rows of each
+//    frame without their padding (ffmpeg -f rawvideo -pix_fmt bgra, or
+//    rgbaf16le for .rgba16Float)
+//===------------------------------------------------------------------------===
+
+enum class FrameEncoding
+{
+    png,
+    raw
+};
+
+//===------------------------------------------------------------------------===
+//
+// • FrameExporter
+//
+//  - Streams frames to a file descriptor (a file, a pipe or standard output)
+//    without drawing them on screen. begin_frame hands out one of
+//    frame_count pooled buffers to draw into and end_frame queues it; a
+//    writer thread encodes and writes queued frames in order, so the next
+//    frame is drawn while the last one is written
+//
+//  - The buffers, the PNG output and the row list for raw frames are all
+//    allocated up front: nothing is allocated per frame. Raw frames are
+//    written straight from the pooled buffer. Each buffer is page aligned,
+//    so the GPU can draw into it in place (see FrameExporter.h)
+//
+//  - One thread begins and ends frames. begin_frame waits while every
+//    buffer is queued. A failed write drops the remaining frames, and
+//    finish reports it. PNG frames past the size of a chunk aren't valid
+//
+//===------------------------------------------------------------------------===
+
+class FrameExporter
+{
+public:
+
+    static constexpr uint32_t frame_count = 3;
+
+    FrameExporter(int descriptor, simd::uint2 size, PixelFormat format, FrameEncoding encoding);
+
+    FrameExporter(const FrameExporter&) = delete;
+    FrameExporter& operator = (const FrameExporter&) = delete;
+
+    ~FrameExporter();
+
+    bool is_valid(void) const noexcept
+    {
+        return writer.joinable();
+    }
+
+    // • Buffer for the next frame, in the exporter's format
+    //
+    Bitmap begin_frame(void);
+
+    void end_frame(void);
+
+    // • The pooled buffer `index`, of buffer_size bytes; begin_frame hands
+    //   out the one in frame_slot
+    //
+    uint8_t* buffer(uint32_t index) const noexcept
+    {
+        return buffers[index];
+    }
+
+    uint32_t buffer_size(void) const noexcept
+    {
+        return buffers.size();
+    }
+
+    uint32_t frame_slot(void) const noexcept
+    {
+        return slot;
+    }
+
+    // • Write the queued frames and stop the writer; false if any write
+    //   failed. Further frames are not allowed
+    //
+    bool finish(void);
+
+    uint64_t frames_written(void) const noexcept
+    {
+        return written_frames.load(std::memory_order_acquire);
+    }
+
+    uint64_t bytes_written(void) const noexcept
+    {
+        return written_bytes.load(std::memory_order_acquire);
+    }
+
+private:
+
+    void write_frames(void);
+    bool write_frame(uint32_t slot);
+
+    data::FrameRing<frame_count>    ring;
+    data::FrameBuffers<frame_count> buffers;
+    std::vector<uint8_t>            encoded;        // PNG
+    std::vector<iovec>              rows;           // Raw rows, in batches
+    bool                            is_last[frame_count] = { };
+    uint32_t                        slot = 0;
+    simd::uint2                     frame_size;
+    PixelFormat                     format;
+    FrameEncoding                   encoding;
+    int                             descriptor;
+    std::atomic<bool>               has_failed     = false;
+    std::atomic<uint64_t>           written_frames = 0;
+    std::atomic<uint64_t>           written_bytes  = 0;
+    std::thread                     writer;
+};
+
+} // namespace raster
@@ -0,0 +1,84 @@
+//
+//  FrameExporter.h
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#import <Foundation/Foundation.h>
+#import <Metal/Metal.h>
+
+//===------------------------------------------------------------------------===
+//
+#pragma mark - FrameExporter Declaration
+//
+//  - The FrameExporter of FrameExport.hpp, for Swift: streams frames drawn on
+//    the GPU to a file or pipe, as PNG or raw rows. Each of its pooled
+//    buffers is wrapped once as a shared MTLBuffer, without a copy, so a
+//    frame is blitted from its texture straight into the memory the writer
+//    thread encodes and writes (see Renderer.export)
+//
+//  - Frames are .bgra8Unorm or .rgba16Float, bytesPerRow apart; see
+//    BitmapPixelDescription for their pixels. One thread begins and ends
+//    frames, and every frame begun is ended before the exporter is released
+//
+//===------------------------------------------------------------------------===
+
+typedef NS_ENUM(NSInteger, FrameExportEncoding) {
+    FrameExportEncodingPNG,
+    FrameExportEncodingRaw
+};
+
+@interface FrameExporter : NSObject
+
+// • Initialization
+//
+//  - nil for another pixel format, an empty size, or a frame larger than
+//    the buffers or, for PNG, its image data chunk hold. The exporter
+//    writes to `descriptor` but doesn't close it
+//
+- (nullable instancetype)initWithDevice:(nonnull id<MTLDevice>)device
+                         fileDescriptor:(int)descriptor
+                                  width:(NSInteger)width
+                                 height:(NSInteger)height
+                            pixelFormat:(MTLPixelFormat)pixelFormat
+                               encoding:(FrameExportEncoding)encoding;
+
+// • Frames
+//
+//  - The buffer of the next frame, at offset zero, waiting while every
+//    buffer is queued. Until endFrame, beginFrame returns it again
+//
+- (nonnull id<MTLBuffer>)beginFrame;
+
+//  - Queues the frame begun last once `commandBuffer`, committed, has
+//    completed drawing it. The writer encodes it while the next frame draws
+//
+- (void)endFrameAfterCommandBuffer:(nonnull id<MTLCommandBuffer>)commandBuffer NS_SWIFT_NAME(endFrame(after:));
+
+//  - Writes the queued frames and stops the writer; NO if any write failed.
+//    Further frames are not allowed
+//
+- (BOOL)finish;
+
+@property (nonatomic, readonly) NSInteger width;
+@property (nonatomic, readonly) NSInteger height;
+@property (nonatomic, readonly) NSInteger bytesPerRow;
+@property (nonatomic, readonly) MTLPixelFormat pixelFormat;
+
+@property (nonatomic, readonly) uint64_t framesWritten;
+@property (nonatomic, readonly) uint64_t bytesWritten;
+
+@end
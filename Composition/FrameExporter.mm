@@ -0,0 +1,142 @@
+//
+//  FrameExporter.mm
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#import "FrameExporter.h"
+#import "FrameExport.hpp"
+
+#import <optional>
+
+//===------------------------------------------------------------------------===
+//
+#pragma mark - FrameExporter Implementation
+//
+//===------------------------------------------------------------------------===
+
+@implementation FrameExporter
+{
+    std::optional<raster::FrameExporter>    exporter;
+    id<MTLBuffer>                           frameBuffers[raster::FrameExporter::frame_count];
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Initialization
+//===------------------------------------------------------------------------===
+
+- (nullable instancetype)initWithDevice:(nonnull id<MTLDevice>)device
+                         fileDescriptor:(int)descriptor
+                                  width:(NSInteger)width
+                                 height:(NSInteger)height
+                            pixelFormat:(MTLPixelFormat)pixelFormat
+                               encoding:(FrameExportEncoding)encoding {
+
+    self = [super init];
+
+    if (nil != self) {
+
+        if ( (MTLPixelFormatBGRA8Unorm != pixelFormat && MTLPixelFormatRGBA16Float != pixelFormat)
+             || width <= 0 || UINT32_MAX < width || height <= 0 || UINT32_MAX < height ) {
+            return nil;
+        }
+
+        const auto format = (MTLPixelFormatRGBA16Float == pixelFormat) ? raster::PixelFormat::rgba16Float
+                                                                       : raster::PixelFormat::bgra8Unorm;
+
+        exporter.emplace( descriptor, simd::uint2 { static_cast<uint32_t>(width), static_cast<uint32_t>(height) },
+                          format, (FrameExportEncodingRaw == encoding) ? raster::FrameEncoding::raw
+                                                                       : raster::FrameEncoding::png );
+
+        if (!exporter->is_valid()) {
+            return nil;
+        }
+
+        // • Page aligned, so wrapped in place. The exporter owns the memory
+        //   and outlives the buffers
+        //
+        for (uint32_t slot = 0; slot < raster::FrameExporter::frame_count; ++slot) {
+
+            frameBuffers[slot] = [device newBufferWithBytesNoCopy:exporter->buffer(slot)
+                                                           length:exporter->buffer_size()
+                                                          options:MTLResourceStorageModeShared
+                                                      deallocator:nil];
+
+            if (nil == frameBuffers[slot]) {
+                return nil;
+            }
+
+            frameBuffers[slot].label = @"Export Frame";
+        }
+
+        _width       = width;
+        _height      = height;
+        _bytesPerRow = raster::bytes_per_row(format, static_cast<uint32_t>(width));
+        _pixelFormat = pixelFormat;
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+
+    // • Release the buffers before the memory they wrap
+    //
+    for (auto& buffer : frameBuffers) {
+        buffer = nil;
+    }
+
+    exporter.reset();
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Frames
+//===------------------------------------------------------------------------===
+
+- (nonnull id<MTLBuffer>)beginFrame {
+
+    exporter->begin_frame();
+
+    return frameBuffers[exporter->frame_slot()];
+}
+
+- (void)endFrameAfterCommandBuffer:(nonnull id<MTLCommandBuffer>)commandBuffer {
+
+    [commandBuffer waitUntilCompleted];
+
+    exporter->end_frame();
+}
+
+- (BOOL)finish {
+
+    return exporter->finish();
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Properties
+//===------------------------------------------------------------------------===
+
+- (uint64_t)framesWritten {
+
+    return exporter->frames_written();
+}
+
+- (uint64_t)bytesWritten {
+
+    return exporter->bytes_written();
+}
+
+@end
@@ -0,0 +1,423 @@
+//
+//  InstanceGrid.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Composition/InstanceGrid.hpp>
+#include <Composition/PatternQueries.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+//===------------------------------------------------------------------------===
+// • Cells (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+// • Upper bound on cells per grid, relative to the instances it holds
+//
+constexpr uint64_t cells_per_instance = 2;
+constexpr uint64_t maximum_cells      = 1 << 20;
+
+bool is_same_size(simd::uint2 lhs, simd::uint2 rhs)
+{
+    return lhs.x == rhs.x && lhs.y == rhs.y;
+}
+
+geometry::Region grid_region(simd::uint2 grid_size)
+{
+    return { 0, 0, grid_size.x, grid_size.y };
+}
+
+// • First and last cell (inclusive) overlapped by a non-empty region
+//
+struct CellRange
+{
+    simd::uint2 first;
+    simd::uint2 last;
+};
+
+CellRange cell_range(geometry::Region region, simd::uint2 cell_size)
+{
+    return {
+        .first = { region.left / cell_size.x,        region.top / cell_size.y },
+        .last  = { (region.right - 1) / cell_size.x, (region.bottom - 1) / cell_size.y }
+    };
+}
+
+// • A normalized interval rounded out to whole grid units and clipped to
+//   [0, extent], or nullopt if it is empty (or not a number)
+//
+std::optional<std::pair<uint32_t, uint32_t>> grid_interval(float first, float last, uint32_t extent)
+{
+    const auto scale = static_cast<float>(extent);
+    const auto lower = std::clamp( std::floor(first * scale), 0.0f, scale );
+    const auto upper = std::clamp( std::ceil(last * scale),   0.0f, scale );
+
+    if (!(lower < upper)) {
+        return std::nullopt;
+    }
+
+    return std::pair { static_cast<uint32_t>(lower), static_cast<uint32_t>(upper) };
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Construction
+//===------------------------------------------------------------------------===
+
+InstanceGrid::InstanceGrid(std::span<const Pattern> patterns)
+{
+    build(patterns);
+}
+
+bool InstanceGrid::build(std::span<const Pattern> source)
+{
+    const auto is_valid = std::all_of(source.begin(), source.end(), is_indexable);
+
+    if (!is_valid) {
+        source = { };
+    }
+
+    patterns.assign(source.begin(), source.end());
+    pattern_groups.assign(patterns.size(), 0);
+    groups.clear();
+
+    // • One grid per distinct grid_size, sized for all of its patterns
+    //
+    std::vector<Pattern> members;
+
+    for (const auto& pattern : patterns) {
+
+        const auto is_indexed = std::any_of( groups.begin(), groups.end(), [&pattern](const auto& cells) {
+            return is_same_size(cells.grid_size, pattern.grid_size);
+        } );
+
+        if (is_indexed) {
+            continue;
+        }
+
+        members.clear();
+
+        std::copy_if( patterns.begin(), patterns.end(), std::back_inserter(members),
+                      [&pattern](const auto& member) {
+                          return is_same_size(member.grid_size, pattern.grid_size);
+                      } );
+
+        groups.push_back( make_cells(pattern.grid_size, members) );
+    }
+
+    for (uint32_t index = 0; index < patterns.size(); ++index) {
+
+        pattern_groups[index] = group_for(patterns[index]);
+        insert(index);
+    }
+
+    update_first_instances();
+
+    return is_valid;
+}
+
+// • Cells about the size of an average instance, so that most instances
+//   overlap few cells and most cells hold few instances
+//
+InstanceGrid::Cells InstanceGrid::make_cells(simd::uint2 grid_size, std::span<const Pattern> members) const
+{
+    uint64_t instances    = 0;
+    uint64_t total_width  = 0;
+    uint64_t total_height = 0;
+
+    for (const auto& pattern : members) {
+
+        instances    += cell_count(pattern);
+        total_width  += static_cast<uint64_t>( geometry::width(pattern.base_region) ) * cell_count(pattern);
+        total_height += static_cast<uint64_t>( geometry::height(pattern.base_region) ) * cell_count(pattern);
+    }
+
+    simd::uint2 cell_size = { 1, 1 };
+
+    if (0 < instances) {
+
+        cell_size.x = static_cast<uint32_t>( std::clamp<uint64_t>(total_width / instances, 1, std::max(1u, grid_size.x)) );
+        cell_size.y = static_cast<uint32_t>( std::clamp<uint64_t>(total_height / instances, 1, std::max(1u, grid_size.y)) );
+    }
+
+    const auto dimensions_for = [grid_size](simd::uint2 size) -> simd::uint2 {
+        return { (grid_size.x + size.x - 1) / size.x, (grid_size.y + size.y - 1) / size.y };
+    };
+
+    const auto cell_limit = std::clamp<uint64_t>(cells_per_instance * instances, 1, maximum_cells);
+
+    auto dimensions = dimensions_for(cell_size);
+
+    while (cell_limit < static_cast<uint64_t>(dimensions.x) * dimensions.y) {
+
+        cell_size.x = (1 < dimensions.x) ? 2*cell_size.x : cell_size.x;
+        cell_size.y = (1 < dimensions.y) ? 2*cell_size.y : cell_size.y;
+        dimensions  = dimensions_for(cell_size);
+    }
+
+    return {
+        .grid_size  = grid_size,
+        .cell_size  = cell_size,
+        .dimensions = dimensions,
+        .entries    = std::vector<std::vector<Entry>>( static_cast<size_t>(dimensions.x) * dimensions.y )
+    };
+}
+
+uint32_t InstanceGrid::group_for(const Pattern& pattern)
+{
+    const auto found = std::find_if( groups.begin(), groups.end(), [&pattern](const auto& cells) {
+        return is_same_size(cells.grid_size, pattern.grid_size);
+    } );
+
+    if (groups.end() != found) {
+        return static_cast<uint32_t>( found - groups.begin() );
+    }
+
+    groups.push_back( make_cells(pattern.grid_size, { &pattern, 1 }) );
+
+    return static_cast<uint32_t>(groups.size() - 1);
+}
+
+//===------------------------------------------------------------------------===
+// • Incremental updates
+//===------------------------------------------------------------------------===
+
+bool InstanceGrid::update(uint32_t index, const Pattern& pattern)
+{
+    if (patterns.size() <= index || !is_indexable(pattern)) {
+        return false;
+    }
+
+    erase(index);
+
+    patterns[index]       = pattern;
+    pattern_groups[index] = group_for(pattern);
+
+    insert(index);
+    update_first_instances();
+
+    return true;
+}
+
+bool InstanceGrid::append(const Pattern& pattern)
+{
+    if (!is_indexable(pattern)) {
+        return false;
+    }
+
+    patterns.push_back(pattern);
+    pattern_groups.push_back( group_for(pattern) );
+    first_instances.push_back(total_instances);
+
+    insert( static_cast<uint32_t>(patterns.size() - 1) );
+
+    total_instances += static_cast<uint32_t>( cell_count(pattern) );
+
+    return true;
+}
+
+void InstanceGrid::insert(uint32_t index)
+{
+    const auto& pattern = patterns[index];
+    auto&       cells   = groups[ pattern_groups[index] ];
+    const auto  bounds  = grid_region(cells.grid_size);
+
+    // • No pattern nests (see is_indexable), so the table is never read
+    //
+    for_each_visible( patterns.data(), pattern, [&](InstanceRange visible) {
+
+        for (auto instance = visible.first; instance < visible.end; ++instance) {
+
+            const auto region = geometry::intersection( instance_region(pattern, instance), bounds );
+
+            if (geometry::is_empty(region)) {
+                continue;
+            }
+
+            const auto range = cell_range(region, cells.cell_size);
+
+            for (auto y = range.first.y; y <= range.last.y; ++y) {
+                for (auto x = range.first.x; x <= range.last.x; ++x) {
+                    cells.entries[y*cells.dimensions.x + x].push_back( { index, instance } );
+                }
+            }
+        }
+    } );
+}
+
+void InstanceGrid::erase(uint32_t index)
+{
+    const auto& pattern = patterns[index];
+    auto&       cells   = groups[ pattern_groups[index] ];
+    const auto  bounds  = grid_region(cells.grid_size);
+
+    for_each_visible( patterns.data(), pattern, [&](InstanceRange visible) {
+
+        for (auto instance = visible.first; instance < visible.end; ++instance) {
+
+            const auto region = geometry::intersection( instance_region(pattern, instance), bounds );
+
+            if (geometry::is_empty(region)) {
+                continue;
+            }
+
+            const auto range = cell_range(region, cells.cell_size);
+
+            for (auto y = range.first.y; y <= range.last.y; ++y) {
+                for (auto x = range.first.x; x <= range.last.x; ++x) {
+                    std::erase_if( cells.entries[y*cells.dimensions.x + x],
+                                   [index](const Entry& entry) { return index == entry.pattern; } );
+                }
+            }
+        }
+    } );
+}
+
+void InstanceGrid::update_first_instances(void)
+{
+    first_instances.resize( patterns.size() );
+    total_instances = 0;
+
+    for (uint32_t index = 0; index < patterns.size(); ++index) {
+
+        first_instances[index] = total_instances;
+        total_instances       += static_cast<uint32_t>( cell_count(patterns[index]) );
+    }
+}
+
+//===------------------------------------------------------------------------===
+// • Point queries
+//===------------------------------------------------------------------------===
+
+std::optional<uint32_t> InstanceGrid::hit_test(simd::float2 point) const
+{
+    std::optional<uint32_t> topmost;
+
+    for (const auto& cells : groups) {
+
+        const auto x = point.x * static_cast<float>(cells.grid_size.x);
+        const auto y = point.y * static_cast<float>(cells.grid_size.y);
+
+        if ( !(0.0f <= x && x < static_cast<float>(cells.grid_size.x))
+             || !(0.0f <= y && y < static_cast<float>(cells.grid_size.y)) ) {
+
+            continue;
+        }
+
+        const simd::uint2 grid_point = { static_cast<uint32_t>(x), static_cast<uint32_t>(y) };
+        const auto        cell       = (grid_point.y / cells.cell_size.y) * cells.dimensions.x
+                                     + grid_point.x / cells.cell_size.x;
+
+        for (const auto& entry : cells.entries[cell]) {
+
+            const auto instance = first_instances[entry.pattern] + entry.instance;
+
+            if ( (!topmost || *topmost < instance)
+                 && geometry::contains(instance_region(patterns[entry.pattern], entry.instance), grid_point) ) {
+
+                topmost = instance;
+            }
+        }
+    }
+
+    return topmost;
+}
+
+void InstanceGrid::instances_at(simd::float2 point, std::vector<uint32_t>& instances) const
+{
+    instances.clear();
+
+    for (const auto& cells : groups) {
+
+        const auto x = point.x * static_cast<float>(cells.grid_size.x);
+        const auto y = point.y * static_cast<float>(cells.grid_size.y);
+
+        if ( !(0.0f <= x && x < static_cast<float>(cells.grid_size.x))
+             || !(0.0f <= y && y < static_cast<float>(cells.grid_size.y)) ) {
+
+            continue;
+        }
+
+        const simd::uint2 grid_point = { static_cast<uint32_t>(x), static_cast<uint32_t>(y) };
+        const auto        cell       = (grid_point.y / cells.cell_size.y) * cells.dimensions.x
+                                     + grid_point.x / cells.cell_size.x;
+
+        for (const auto& entry : cells.entries[cell]) {
+            if (geometry::contains(instance_region(patterns[entry.pattern], entry.instance), grid_point)) {
+                instances.push_back(first_instances[entry.pattern] + entry.instance);
+            }
+        }
+    }
+
+    std::sort(instances.begin(), instances.end());
+}
+
+//===------------------------------------------------------------------------===
+// • Rect query
+//===------------------------------------------------------------------------===
+
+void InstanceGrid::instances_in(geometry::TextureRect rect, std::vector<uint32_t>& instances) const
+{
+    instances.clear();
+
+    for (const auto& cells : groups) {
+
+        const auto columns = grid_interval(rect.left, rect.right, cells.grid_size.x);
+        const auto rows    = grid_interval(rect.top, rect.bottom, cells.grid_size.y);
+
+        if (!columns || !rows) {
+            continue;
+        }
+
+        const geometry::Region query  = { columns->first, rows->first, columns->second, rows->second };
+        const auto             bounds = grid_region(cells.grid_size);
+        const auto             range  = cell_range(query, cells.cell_size);
+
+        for (auto y = range.first.y; y <= range.last.y; ++y) {
+            for (auto x = range.first.x; x <= range.last.x; ++x) {
+
+                for (const auto& entry : cells.entries[y*cells.dimensions.x + x]) {
+
+                    const auto region  = instance_region(patterns[entry.pattern], entry.instance);
+                    const auto overlap = geometry::intersection( geometry::intersection(region, bounds), query );
+
+                    if (geometry::is_empty(overlap)) {
+                        continue;
+                    }
+
+                    // • Report each instance once, from the cell holding the
+                    //   top-left corner of its overlap with the query
+                    //
+                    const auto corner = cell_range(overlap, cells.cell_size).first;
+
+                    if (corner.x == x && corner.y == y) {
+                        instances.push_back(first_instances[entry.pattern] + entry.instance);
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort(instances.begin(), instances.end());
+}
@@ -0,0 +1,137 @@
+//
+//  InstanceGrid.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Arena.hpp>
+#include <Composition/Pattern.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+//
+// • InstanceGrid
+//
+//  - Spatial index over the expanded instances of a list of patterns, for
+//    hit testing and culling without testing every instance
+//
+//  - Patterns sharing a grid_size share a uniform grid of cells in that
+//    grid's units. Each cell lists the instances that overlap it, clipped to
+//    the grid; instances entirely outside the grid are never visible and are
+//    not indexed
+//
+//  - Queries are in normalized view coordinates (as TextureRect: 0 to 1,
+//    y down) so that patterns with different grid sizes can be queried
+//    together. Results are instance indices in draw order, as for the
+//    instanced draw of an Arena
+//
+//  - The grid keeps its own copy of the patterns, without the table their
+//    nested references are taken from, so it doesn't index patterns that
+//    nest: build, update and append refuse them, and a grid of an Arena with
+//    nested patterns is empty
+//
+//===------------------------------------------------------------------------===
+
+class InstanceGrid
+{
+public:
+
+    InstanceGrid(void) = default;
+
+    explicit InstanceGrid(std::span<const Pattern> patterns);
+
+    explicit InstanceGrid(const Arena& arena)
+        : InstanceGrid { (0 == arena.nested_patterns.count)
+                         ? std::span<const Pattern> { ::patterns(arena), arena.patterns.count }
+                         : std::span<const Pattern> { } }
+    {
+    }
+
+    // • Rebuild from scratch, choosing new cell sizes. False, leaving the
+    //   grid empty, if any pattern nests
+    //
+    bool build(std::span<const Pattern> patterns);
+
+    // • Incremental updates: replace pattern `index` (e.g. a new offset or
+    //   count) or append a pattern. Only the cells its instances overlap are
+    //   touched. A pattern removed from an Arena is updated to count 0. False,
+    //   changing nothing, if the pattern nests or `index` is out of range
+    //
+    bool update(uint32_t index, const Pattern& pattern);
+    bool append(const Pattern& pattern);
+
+    // • Point queries: the topmost (last drawn) instance containing `point`,
+    //   or all of them in draw order
+    //
+    std::optional<uint32_t> hit_test(simd::float2 point) const;
+
+    void instances_at(simd::float2 point, std::vector<uint32_t>& instances) const;
+
+    // • Rect query: instances that overlap `rect`, in draw order. Rect edges
+    //   are rounded out to whole grid cells of each pattern
+    //
+    void instances_in(geometry::TextureRect rect, std::vector<uint32_t>& instances) const;
+
+    uint32_t pattern_count(void) const noexcept
+    {
+        return static_cast<uint32_t>( patterns.size() );
+    }
+
+    uint32_t instance_count(void) const noexcept
+    {
+        return total_instances;
+    }
+
+private:
+
+    struct Entry
+    {
+        uint32_t    pattern;
+        uint32_t    instance;
+    };
+
+    struct Cells
+    {
+        simd::uint2                         grid_size;
+        simd::uint2                         cell_size;
+        simd::uint2                         dimensions;
+        std::vector<std::vector<Entry>>     entries;
+    };
+
+    static bool is_indexable(const Pattern& pattern) noexcept
+    {
+        return 0 == pattern.nested;
+    }
+
+    Cells make_cells(simd::uint2 grid_size, std::span<const Pattern> members) const;
+    uint32_t group_for(const Pattern& pattern);
+
+    void insert(uint32_t index);
+    void erase(uint32_t index);
+    void update_first_instances(void);
+
+    std::vector<Pattern>    patterns;
+    std::vector<uint32_t>   first_instances;
+    std::vector<uint32_t>   pattern_groups;
+    std::vector<Cells>      groups;
+    uint32_t                total_instances = 0;
+};
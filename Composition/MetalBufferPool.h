@@ -0,0 +1,40 @@
+//
+//  MetalBufferPool.h
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#import <Metal/Metal.h>
+#import <Data/BufferPool.hpp>
+
+//===------------------------------------------------------------------------===
+//
+#pragma mark - MetalBufferPool
+//
+//  - data::BufferPool over MTLBuffers (Objective-C++ only): each slab is a
+//    buffer of `device`, made with `options`, and each allocation is bound
+//    as its slab's buffer at the allocation's offset. Slabs in private
+//    storage have no contents
+//
+//===------------------------------------------------------------------------===
+
+data::SlabSource metal_slab_source(id<MTLDevice> device, MTLResourceOptions options);
+
+// • The buffer holding `allocation`, to bind at allocation.offset
+//
+id<MTLBuffer> metal_buffer(const data::BufferPool& pool, const data::PoolAllocation& allocation);
@@ -0,0 +1,57 @@
+//
+//  MetalBufferPool.mm
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#import "MetalBufferPool.h"
+
+//===------------------------------------------------------------------------===
+#pragma mark - MetalBufferPool
+//===------------------------------------------------------------------------===
+
+data::SlabSource metal_slab_source(id<MTLDevice> device, MTLResourceOptions options) {
+
+    const auto is_private = MTLResourceStorageModePrivate == (options & MTLResourceStorageModeMask);
+
+    return {
+        .allocate = [device, options, is_private](uint32_t size) -> std::optional<data::Slab> {
+
+            id<MTLBuffer> buffer = [device newBufferWithLength:size options:options];
+
+            if (nil == buffer) {
+                return std::nullopt;
+            }
+
+            buffer.label = @"Buffer Pool Slab";
+
+            // • The pool holds the reference until it releases the slab
+            //
+            return data::Slab {
+                .contents = is_private ? nullptr : static_cast<uint8_t*>(buffer.contents),
+                .handle   = (__bridge_retained void*)buffer
+            };
+        },
+        .release = [](const data::Slab& slab) {
+            CFRelease(slab.handle);
+        }
+    };
+}
+
+id<MTLBuffer> metal_buffer(const data::BufferPool& pool, const data::PoolAllocation& allocation) {
+
+    return (__bridge id<MTLBuffer>)pool.handle(allocation);
+}
@@ -20,12 +20,33 @@
 #pragma once
 
 #include <Graphics/Geometry.hpp>
-#include <simd/simd.h>
+#include <Data/Layout.hpp>
+#include <Data/SIMD.hpp>
+
+#if !defined ( __METAL_VERSION__ )
+#include <algorithm>
+#include <cstdint>
+#endif
 
 //===------------------------------------------------------------------------===
 //
 // • Pattern
 //
+//  - A lattice of cells: row_count rows (0 is taken as 1) of count cells.
+//    Cell c of row r is base_region displaced by offset*c + row_offset*r,
+//    and is numbered r*count + c
+//
+//  - Without nesting (nested == 0), each cell is one instance. Otherwise
+//    every cell repeats the pattern at data::offset_by(table, nested), where
+//    table is the first pattern of the table holding this one, e.g.
+//    patterns(arena). Its grid is the cell, so its grid_size is the size of
+//    base_region, and instance i of the cell is instance i of the nested
+//    pattern, moved to the cell's origin. Instance numbering is cell-major
+//
+//  - Nesting is at most max_pattern_depth levels deep, so decoding an
+//    instance index is a bounded number of divisions. Arena utilities and
+//    validate_records (Scene.hpp) check the references
+//
 //===------------------------------------------------------------------------===
 
 struct Pattern
@@ -34,8 +55,163 @@ struct Pattern
     geometry::Region    base_region;
     simd::int2          offset;
     uint32_t            count;
+    uint32_t            row_count;
+    simd::int2          row_offset;
+    uint32_t            nested;         // from the table, 0 for none
+    uint32_t            reserved;
+};
+
+enum : uint32_t
+{
+    max_pattern_depth = 4
 };
 
 #if !defined ( __METAL_VERSION__ )
+
 static_assert( data::is_trivial_layout<Pattern>(), "Unexpected layout" );
+static_assert( 56 == sizeof(Pattern), "Unexpected size" );
+
+//===------------------------------------------------------------------------===
+// • Pattern Utilities (Host)
+//===------------------------------------------------------------------------===
+
+constexpr uint32_t rows(const Pattern& pattern)
+{
+    return (0 == pattern.row_count) ? 1u : pattern.row_count;
+}
+
+// • Cells of the lattice: the instances of a pattern without nesting
+//
+constexpr uint64_t cell_count(const Pattern& pattern)
+{
+    return static_cast<uint64_t>(pattern.count) * rows(pattern);
+}
+
+// • Cell `index` (< cell_count) of a pattern, as computed by pattern_vertex
+//
+constexpr geometry::Region cell_region(const Pattern& pattern, uint32_t index)
+{
+    const auto column = static_cast<int32_t>(index % pattern.count);
+    const auto row    = static_cast<int32_t>(index / pattern.count);
+
+    return pattern.base_region + pattern.offset * column + pattern.row_offset * row;
+}
+
+// • Instance `index` of a pattern without nesting
+//
+constexpr geometry::Region instance_region(const Pattern& pattern, uint32_t index)
+{
+    return cell_region(pattern, index);
+}
+
+// • Exact extremes of the cells in 64 bits, where cell_region wraps any
+//   coordinate outside [0, 2^32). Cells are linear in column and row, so the
+//   extremes are at the corners of the lattice. count must not be zero
+//
+struct LatticeBounds
+{
+    int64_t left;
+    int64_t top;
+    int64_t right;
+    int64_t bottom;
+};
+
+constexpr LatticeBounds lattice_bounds(const Pattern& pattern)
+{
+    const auto columns = static_cast<int64_t>(pattern.count) - 1;
+    const auto steps   = static_cast<int64_t>( rows(pattern) ) - 1;
+
+    const auto low  = [](int64_t first, int64_t second) { return (first < 0 ? first : 0) + (second < 0 ? second : 0); };
+    const auto high = [](int64_t first, int64_t second) { return (first < 0 ? 0 : first) + (second < 0 ? 0 : second); };
+
+    const auto dx = columns * pattern.offset.x;
+    const auto dy = columns * pattern.offset.y;
+    const auto rx = steps * pattern.row_offset.x;
+    const auto ry = steps * pattern.row_offset.y;
+
+    const auto& base = pattern.base_region;
+
+    return {
+        .left   = base.left   + low(dx, rx),
+        .top    = base.top    + low(dy, ry),
+        .right  = base.right  + high(dx, rx),
+        .bottom = base.bottom + high(dy, ry)
+    };
+}
+
+//===------------------------------------------------------------------------===
+// • Nesting (Host)
+//
+//  - `table` is the first pattern of the table holding `pattern`, from
+//    which nested references are taken
+//
+//===------------------------------------------------------------------------===
+
+inline const Pattern* nested_pattern(const Pattern* table, const Pattern& pattern)
+{
+    return (0 == pattern.nested) ? nullptr : data::offset_by<Pattern>(table, pattern.nested);
+}
+
+// • The pattern and the patterns nested in it, outermost first. Returns the
+//   depth, at most max_pattern_depth; deeper nesting is cut off, as by
+//   pattern_vertex, and rejected by the Arena utilities
+//
+inline uint32_t pattern_levels(const Pattern* table, const Pattern& pattern, const Pattern* (&levels)[max_pattern_depth])
+{
+    uint32_t depth = 0;
+
+    for (auto level = &pattern; nullptr != level && depth < max_pattern_depth; level = nested_pattern(table, *level)) {
+        levels[depth++] = level;
+    }
+
+    return depth;
+}
+
+// • Instances of `pattern`: its cells times the instances of each
+//
+inline uint64_t instance_count(const Pattern* table, const Pattern& pattern)
+{
+    const Pattern* levels[max_pattern_depth];
+
+    const auto depth = pattern_levels(table, pattern, levels);
+
+    uint64_t count = 1;
+
+    for (uint32_t level = 0; level < depth && 0 < count; ++level) {
+        count = std::min<uint64_t>( count * cell_count(*levels[level]), uint64_t{1} << 32 );
+    }
+
+    return count;
+}
+
+// • Instance `index` (< instance_count) of `pattern`, as computed by
+//   pattern_vertex: one division per level
+//
+inline geometry::Region instance_region(const Pattern* table, const Pattern& pattern, uint32_t index)
+{
+    const Pattern* levels[max_pattern_depth];
+    uint32_t       instances[max_pattern_depth];    // of each cell of a level
+
+    const auto depth = pattern_levels(table, pattern, levels);
+
+    instances[depth - 1] = 1;
+
+    for (auto level = depth - 1; 0 < level; --level) {
+        instances[level - 1] = instances[level] * static_cast<uint32_t>( cell_count(*levels[level]) );
+    }
+
+    simd::int2 origin = { 0, 0 };
+
+    for (uint32_t level = 0; level + 1 < depth; ++level) {
+
+        const auto cell   = cell_region( *levels[level], index / instances[level] );
+        const auto corner = simd::int2 { static_cast<int32_t>(cell.left), static_cast<int32_t>(cell.top) };
+
+        origin = origin + corner;
+        index  = index % instances[level];
+    }
+
+    return cell_region(*levels[depth - 1], index) + origin;
+}
+
 #endif
@@ -0,0 +1,225 @@
+//
+//  PatternExpansion.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Pattern.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+//===------------------------------------------------------------------------===
+//
+// • Pattern expansion (Host)
+//
+//  - Expands patterns into their instance regions in constant expressions,
+//    so that a static scene can be baked into a read-only table at compile
+//    time, and validates them so that a pattern whose instances would be
+//    computed wrongly is a compile error rather than a silent wraparound
+//
+//  - operator + (Region, int2) adds an int2 to uint32_t coordinates, which
+//    wraps modulo 2^32 for an instance left of or above the origin; and
+//    cell_region multiplies the offsets by the column and row in int32_t.
+//    Cell coordinates are linear in both, so checking the corners of the
+//    lattice (exactly, in 64 bits) covers every cell between them
+//
+//  - Nested patterns are resolved from their table at run time, so they
+//    are validated by the Arena utilities rather than here; validate checks
+//    the cells of a pattern, which are its instances without nesting
+//
+//===------------------------------------------------------------------------===
+
+//===------------------------------------------------------------------------===
+// • Validation
+//===------------------------------------------------------------------------===
+
+enum class PatternError
+{
+    none,
+    no_instances,           // count is zero
+    empty_region,           // base_region has no area
+    too_many_instances,     // count * rows does not fit in uint32_t
+    offset_overflows,       // a cell's displacement does not fit in int32_t
+    coordinates_wrap,       // an instance coordinate is outside [0, 2^32)
+    outside_grid            // an instance extends past grid_size
+};
+
+constexpr PatternError validate(const Pattern& pattern)
+{
+    if (0 == pattern.count) {
+        return PatternError::no_instances;
+    }
+
+    const auto& base = pattern.base_region;
+
+    if (geometry::is_empty(base)) {
+        return PatternError::empty_region;
+    }
+
+    if (std::numeric_limits<uint32_t>::max() < cell_count(pattern)) {
+        return PatternError::too_many_instances;
+    }
+
+    const auto columns = static_cast<int64_t>(pattern.count) - 1;
+    const auto steps   = static_cast<int64_t>( rows(pattern) ) - 1;
+
+    constexpr auto int32_min = static_cast<int64_t>( std::numeric_limits<int32_t>::min() );
+    constexpr auto int32_max = static_cast<int64_t>( std::numeric_limits<int32_t>::max() );
+
+    // • Every product and sum cell_region forms lies between the extremes
+    //   of the displacements, at the corners of the lattice
+    //
+    const auto dx = columns * pattern.offset.x;
+    const auto dy = columns * pattern.offset.y;
+    const auto rx = steps * pattern.row_offset.x;
+    const auto ry = steps * pattern.row_offset.y;
+
+    const auto low_x  = std::min<int64_t>(dx, 0) + std::min<int64_t>(rx, 0);
+    const auto low_y  = std::min<int64_t>(dy, 0) + std::min<int64_t>(ry, 0);
+    const auto high_x = std::max<int64_t>(dx, 0) + std::max<int64_t>(rx, 0);
+    const auto high_y = std::max<int64_t>(dy, 0) + std::max<int64_t>(ry, 0);
+
+    if (low_x < int32_min || low_y < int32_min || int32_max < high_x || int32_max < high_y) {
+        return PatternError::offset_overflows;
+    }
+
+    // • Extremes over all cells
+    //
+    const auto bounds = lattice_bounds(pattern);
+
+    constexpr auto uint32_max = static_cast<int64_t>( std::numeric_limits<uint32_t>::max() );
+
+    if (bounds.left < 0 || bounds.top < 0 || uint32_max < bounds.right || uint32_max < bounds.bottom) {
+        return PatternError::coordinates_wrap;
+    }
+
+    if (pattern.grid_size.x < bounds.right || pattern.grid_size.y < bounds.bottom) {
+        return PatternError::outside_grid;
+    }
+
+    return PatternError::none;
+}
+
+// • Calls to these are not constant expressions, so reaching one in a
+//   consteval function fails compilation with its name in the diagnostic
+//
+namespace detail
+{
+
+void pattern_has_no_instances(void);
+void pattern_base_region_is_empty(void);
+void pattern_has_too_many_instances(void);
+void pattern_offset_overflows_int32(void);
+void pattern_coordinates_wrap_uint32(void);
+void pattern_extends_outside_grid(void);
+void pattern_instance_count_mismatch(void);
+void pattern_nesting_needs_a_table(void);
+
+} // namespace detail
+
+// • `pattern`, if valid and without nesting; otherwise a compile error
+//   naming the problem
+//
+consteval Pattern validated(const Pattern& pattern)
+{
+    if (0 != pattern.nested) {
+        detail::pattern_nesting_needs_a_table();
+    }
+
+    switch (validate(pattern))
+    {
+        case PatternError::none:               break;
+        case PatternError::no_instances:       detail::pattern_has_no_instances();         break;
+        case PatternError::empty_region:       detail::pattern_base_region_is_empty();     break;
+        case PatternError::too_many_instances: detail::pattern_has_too_many_instances();   break;
+        case PatternError::offset_overflows:   detail::pattern_offset_overflows_int32();   break;
+        case PatternError::coordinates_wrap:   detail::pattern_coordinates_wrap_uint32();  break;
+        case PatternError::outside_grid:       detail::pattern_extends_outside_grid();     break;
+    }
+
+    return pattern;
+}
+
+//===------------------------------------------------------------------------===
+// • Expansion
+//===------------------------------------------------------------------------===
+
+// • Instance regions of `pattern`, without nesting, into `regions`, as
+//   many as fit. Returns the number written
+//
+constexpr uint32_t expand(const Pattern& pattern, std::span<geometry::Region> regions)
+{
+    const auto count = static_cast<uint32_t>( std::min<uint64_t>(regions.size(), cell_count(pattern)) );
+
+    for (uint32_t index = 0; index < count; ++index) {
+        regions[index] = instance_region(pattern, index);
+    }
+
+    return count;
+}
+
+// • Instances of patterns without nesting
+//
+constexpr uint64_t instance_count(std::span<const Pattern> patterns)
+{
+    uint64_t count = 0;
+
+    for (const auto& pattern : patterns) {
+        count += cell_count(pattern);
+    }
+
+    return count;
+}
+
+//===------------------------------------------------------------------------===
+// • Baking
+//
+//  - The instance regions of a static scene, validated and expanded in draw
+//    order at compile time:
+//
+//      constexpr std::array scene = { Pattern { ... }, Pattern { ... } };
+//      constexpr auto       table = bake_instances<instance_count(scene)>(scene);
+//
+//===------------------------------------------------------------------------===
+
+template <size_t InstanceCount_, size_t PatternCount_>
+consteval std::array<geometry::Region, InstanceCount_>
+bake_instances(const std::array<Pattern, PatternCount_>& patterns)
+{
+    if (InstanceCount_ != instance_count(patterns)) {
+        detail::pattern_instance_count_mismatch();
+    }
+
+    std::array<geometry::Region, InstanceCount_> regions = {};
+
+    size_t first = 0;
+
+    for (const auto& pattern : patterns) {
+
+        validated(pattern);
+
+        first += expand( pattern, std::span { regions }.subspan(first) );
+    }
+
+    return regions;
+}
@@ -0,0 +1,449 @@
+//
+//  PatternQueries.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Pattern.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+//===------------------------------------------------------------------------===
+//
+// • Pattern queries (Host)
+//
+//  - Closed-form queries on the instances of the first row, base_region +
+//    offset*i for i < count, in O(1) regardless of count; their names start
+//    with row_. For a pattern of one row without nesting, these are all of
+//    its instances
+//
+//  - Instance coordinates are taken exactly (as 64-bit integers), so the
+//    results match instance_region for every instance whose coordinates
+//    lie in [0, 2^32), which includes every instance visible in its grid.
+//    instance_region wraps the coordinates of other instances
+//
+//  - Along each axis an instance covers [a + i*d, b + i*d). Each condition
+//    on it is a linear inequality in i, so the instances meeting all of
+//    them form one contiguous range of indices
+//
+//  - Rows are the first row displaced by row_offset*r, so the same holds
+//    for the rows whose bounds meet a condition, and the for_each_ queries
+//    visit the cells meeting it as one run per row. A nested pattern is
+//    queried inside each such cell, in the cell's coordinates
+//
+//===------------------------------------------------------------------------===
+
+//===------------------------------------------------------------------------===
+// • InstanceRange: instance indices first, first + 1, ..., end - 1
+//===------------------------------------------------------------------------===
+
+struct InstanceRange
+{
+    uint32_t    first;
+    uint32_t    end;
+};
+
+constexpr uint32_t size(const InstanceRange range)
+{
+    return range.end - range.first;
+}
+
+constexpr bool is_empty(const InstanceRange range)
+{
+    return range.end <= range.first;
+}
+
+constexpr bool operator == (const InstanceRange lhs, const InstanceRange rhs)
+{
+    return lhs.first == rhs.first && lhs.end == rhs.end;
+}
+
+//===------------------------------------------------------------------------===
+// • Index intervals (Private)
+//===------------------------------------------------------------------------===
+
+namespace detail
+{
+
+// • Inclusive, empty if upper < lower
+//
+struct IndexInterval
+{
+    int64_t lower;
+    int64_t upper;
+};
+
+constexpr int64_t floor_divide(int64_t numerator, int64_t denominator)
+{
+    // • denominator > 0
+    //
+    const auto quotient = numerator / denominator;
+
+    return (numerator % denominator < 0) ? quotient - 1 : quotient;
+}
+
+constexpr int64_t ceil_divide(int64_t numerator, int64_t denominator)
+{
+    return -floor_divide(-numerator, denominator);
+}
+
+constexpr IndexInterval no_instances(void)
+{
+    return { 0, -1 };
+}
+
+// • Restrict to indices i with i*step > bound
+//
+constexpr IndexInterval where_above(IndexInterval interval, int64_t step, int64_t bound)
+{
+    if (0 < step) {
+        interval.lower = std::max( interval.lower, floor_divide(bound, step) + 1 );
+    } else if (step < 0) {
+        interval.upper = std::min( interval.upper, ceil_divide(-bound, -step) - 1 );
+    } else if (!(0 > bound)) {
+        return no_instances();
+    }
+
+    return interval;
+}
+
+// • Restrict to indices i with i*step < bound
+//
+constexpr IndexInterval where_below(IndexInterval interval, int64_t step, int64_t bound)
+{
+    if (0 < step) {
+        interval.upper = std::min( interval.upper, ceil_divide(bound, step) - 1 );
+    } else if (step < 0) {
+        interval.lower = std::max( interval.lower, floor_divide(-bound, -step) + 1 );
+    } else if (!(0 < bound)) {
+        return no_instances();
+    }
+
+    return interval;
+}
+
+// • Indices i < count with `region` + step*i overlapping `window`: a < q.b
+//   and b > q.a along each axis, all exact
+//
+constexpr IndexInterval overlapping(const LatticeBounds& region, simd::int2 step, uint32_t count,
+                                    const LatticeBounds& window)
+{
+    auto interval = IndexInterval { 0, static_cast<int64_t>(count) - 1 };
+
+    interval = where_below( interval, step.x, window.right - region.left );
+    interval = where_above( interval, step.x, window.left - region.right );
+    interval = where_below( interval, step.y, window.bottom - region.top );
+    interval = where_above( interval, step.y, window.top - region.bottom );
+
+    return interval;
+}
+
+constexpr LatticeBounds exact(const geometry::Region region)
+{
+    return { region.left, region.top, region.right, region.bottom };
+}
+
+constexpr InstanceRange make_instance_range(IndexInterval interval)
+{
+    if (interval.upper < interval.lower) {
+        return { 0, 0 };
+    }
+
+    return { static_cast<uint32_t>(interval.lower), static_cast<uint32_t>(interval.upper + 1) };
+}
+
+} // namespace detail
+
+//===------------------------------------------------------------------------===
+// • Hit testing
+//===------------------------------------------------------------------------===
+
+// • Instances of the first row that contain `point` (grid units): a <= p < b
+//   along each axis
+//
+constexpr InstanceRange row_instances_containing(const Pattern& pattern, simd::uint2 point)
+{
+    const auto pixel = LatticeBounds { point.x, point.y, int64_t{point.x} + 1, int64_t{point.y} + 1 };
+
+    return detail::make_instance_range(
+        detail::overlapping(detail::exact(pattern.base_region), pattern.offset, pattern.count, pixel) );
+}
+
+//===------------------------------------------------------------------------===
+// • Culling
+//===------------------------------------------------------------------------===
+
+// • Instances of the first row that overlap `viewport` (grid units): a < q.b
+//   and b > q.a along each axis. Empty instances overlap nothing
+//
+constexpr InstanceRange row_instances_intersecting(const Pattern& pattern, geometry::Region viewport)
+{
+    const auto& base = pattern.base_region;
+
+    if (geometry::is_empty(base) || geometry::is_empty(viewport)) {
+        return { 0, 0 };
+    }
+
+    return detail::make_instance_range(
+        detail::overlapping(detail::exact(base), pattern.offset, pattern.count, detail::exact(viewport)) );
+}
+
+// • Instances of the first row that overlap the pattern's grid, i.e. that can
+//   be visible
+//
+constexpr InstanceRange row_visible_instances(const Pattern& pattern)
+{
+    return row_instances_intersecting( pattern, { 0, 0, pattern.grid_size.x, pattern.grid_size.y } );
+}
+
+//===------------------------------------------------------------------------===
+// • Runs of instances (Private)
+//===------------------------------------------------------------------------===
+
+namespace detail
+{
+
+struct PatternLevels
+{
+    const Pattern*  levels[max_pattern_depth];
+    uint32_t        instances[max_pattern_depth];   // of each cell of a level
+    uint32_t        depth;
+};
+
+inline PatternLevels make_pattern_levels(const Pattern* table, const Pattern& pattern)
+{
+    PatternLevels result;
+
+    result.depth = pattern_levels(table, pattern, result.levels);
+
+    result.instances[result.depth - 1] = 1;
+
+    for (auto level = result.depth - 1; 0 < level; --level) {
+        result.instances[level - 1] = result.instances[level]
+                                    * static_cast<uint32_t>( cell_count(*result.levels[level]) );
+    }
+
+    return result;
+}
+
+// • Cells of `level` overlapping `window` (in the level's coordinates), as
+//   one run per row, numbered from `first`
+//
+template <typename Visit_>
+void visit_runs(const PatternLevels& levels, uint32_t level, const LatticeBounds& window, uint32_t first, Visit_& visit)
+{
+    const auto& pattern = *levels.levels[level];
+    const auto  base    = exact(pattern.base_region);
+
+    if (0 == pattern.count || !(base.left < base.right && base.top < base.bottom)) {
+        return;
+    }
+
+    // • Bounds of the first row, whose displacements are the rows
+    //
+    const auto columns = static_cast<int64_t>(pattern.count) - 1;
+    const auto dx      = columns * pattern.offset.x;
+    const auto dy      = columns * pattern.offset.y;
+
+    const auto first_row = LatticeBounds {
+        .left   = base.left   + std::min<int64_t>(dx, 0),
+        .top    = base.top    + std::min<int64_t>(dy, 0),
+        .right  = base.right  + std::max<int64_t>(dx, 0),
+        .bottom = base.bottom + std::max<int64_t>(dy, 0)
+    };
+
+    const auto row_range = overlapping(first_row, pattern.row_offset, rows(pattern), window);
+    const auto per_cell  = levels.instances[level];
+    const auto is_leaf   = level + 1 == levels.depth;
+
+    for (auto row = row_range.lower; row <= row_range.upper; ++row) {
+
+        const auto row_base = LatticeBounds {
+            .left   = base.left   + row * pattern.row_offset.x,
+            .top    = base.top    + row * pattern.row_offset.y,
+            .right  = base.right  + row * pattern.row_offset.x,
+            .bottom = base.bottom + row * pattern.row_offset.y
+        };
+
+        const auto cells      = overlapping(row_base, pattern.offset, pattern.count, window);
+        const auto first_cell = static_cast<uint32_t>(row) * pattern.count;
+
+        if (cells.upper < cells.lower) {
+            continue;
+        }
+
+        if (is_leaf) {
+            visit( InstanceRange { first + first_cell + static_cast<uint32_t>(cells.lower),
+                                   first + first_cell + static_cast<uint32_t>(cells.upper + 1) } );
+            continue;
+        }
+
+        for (auto column = cells.lower; column <= cells.upper; ++column) {
+
+            const auto left = row_base.left + column * pattern.offset.x;
+            const auto top  = row_base.top  + column * pattern.offset.y;
+
+            const auto cell_window = LatticeBounds {
+                window.left - left, window.top - top, window.right - left, window.bottom - top
+            };
+
+            visit_runs( levels, level + 1, cell_window,
+                        first + (first_cell + static_cast<uint32_t>(column)) * per_cell, visit );
+        }
+    }
+}
+
+} // namespace detail
+
+//===------------------------------------------------------------------------===
+// • Runs of instances
+//
+//  - Call visit(InstanceRange) for each run of consecutive instances of
+//    `pattern`, in increasing order, with nesting resolved from `table` (see
+//    Pattern.hpp). O(rows visited) for a pattern without nesting, plus the
+//    same for each nested cell visited
+//
+//===------------------------------------------------------------------------===
+
+// • Instances that overlap `viewport` (grid units), as
+//   row_instances_intersecting does for the first row
+//
+template <typename Visit_>
+void for_each_intersecting(const Pattern* table, const Pattern& pattern, geometry::Region viewport, Visit_&& visit)
+{
+    if (geometry::is_empty(viewport)) {
+        return;
+    }
+
+    detail::visit_runs( detail::make_pattern_levels(table, pattern), 0, detail::exact(viewport), 0, visit );
+}
+
+// • Instances that contain `point` (grid units), as row_instances_containing
+//   does for the first row
+//
+template <typename Visit_>
+void for_each_containing(const Pattern* table, const Pattern& pattern, simd::uint2 point, Visit_&& visit)
+{
+    const auto pixel = LatticeBounds { point.x, point.y, int64_t{point.x} + 1, int64_t{point.y} + 1 };
+
+    detail::visit_runs( detail::make_pattern_levels(table, pattern), 0, pixel, 0, visit );
+}
+
+// • Instances that overlap the pattern's grid, i.e. that can be visible
+//
+template <typename Visit_>
+void for_each_visible(const Pattern* table, const Pattern& pattern, Visit_&& visit)
+{
+    for_each_intersecting( table, pattern, { 0, 0, pattern.grid_size.x, pattern.grid_size.y }, visit );
+}
+
+//===------------------------------------------------------------------------===
+// • Bounds
+//===------------------------------------------------------------------------===
+
+// • Bounding region of all cells, clamped to [0, 2^32 - 1], which bounds
+//   the instances of nested patterns too, since they lie in their cells.
+//   Empty if the pattern has no cells
+//
+constexpr geometry::Region bounding_region(const Pattern& pattern)
+{
+    if (0 == pattern.count) {
+        return { 0, 0, 0, 0 };
+    }
+
+    const auto bounds = lattice_bounds(pattern);
+
+    const auto clamp = [](int64_t value) {
+        return static_cast<uint32_t>( std::clamp<int64_t>(value, 0, std::numeric_limits<uint32_t>::max()) );
+    };
+
+    return {
+        .left   = clamp(bounds.left),
+        .top    = clamp(bounds.top),
+        .right  = clamp(bounds.right),
+        .bottom = clamp(bounds.bottom)
+    };
+}
+
+//===------------------------------------------------------------------------===
+// • Area
+//
+//  - Results saturate at the largest uint64_t
+//
+//===------------------------------------------------------------------------===
+
+namespace detail
+{
+
+constexpr uint64_t saturate(unsigned __int128 value)
+{
+    return (value < std::numeric_limits<uint64_t>::max()) ? static_cast<uint64_t>(value)
+                                                          : std::numeric_limits<uint64_t>::max();
+}
+
+constexpr unsigned __int128 region_area(const geometry::Region region)
+{
+    return geometry::is_empty(region) ? 0 : static_cast<unsigned __int128>( geometry::width(region) )
+                                              * geometry::height(region);
+}
+
+} // namespace detail
+
+// • Sum of the areas of all cells, every row included, counting overlap as
+//   many times as it occurs
+//
+constexpr uint64_t instance_area(const Pattern& pattern)
+{
+    return detail::saturate( detail::region_area(pattern.base_region) * cell_count(pattern) );
+}
+
+// • Sum of the areas of the instances of the first row
+//
+constexpr uint64_t row_instance_area(const Pattern& pattern)
+{
+    return detail::saturate( detail::region_area(pattern.base_region) * pattern.count );
+}
+
+// • Area of the union of the instances of the first row; compare it with
+//   row_instance_area. Rectangles are convex, so anything covered by both
+//   instances i and i + k is also covered by every instance between them:
+//   each instance after the first adds its area less its overlap with the
+//   one before
+//
+constexpr uint64_t row_covered_area(const Pattern& pattern)
+{
+    const auto area = detail::region_area(pattern.base_region);
+
+    if (0 == pattern.count || 0 == area) {
+        return 0;
+    }
+
+    const auto overlap_extent = [](uint32_t extent, int32_t step) -> uint64_t {
+
+        const auto distance = (step < 0) ? -static_cast<int64_t>(step) : static_cast<int64_t>(step);
+
+        return (distance < extent) ? extent - distance : 0;
+    };
+
+    const auto overlap = static_cast<unsigned __int128>( overlap_extent(geometry::width(pattern.base_region), pattern.offset.x) )
+                       * overlap_extent(geometry::height(pattern.base_region), pattern.offset.y);
+
+    return detail::saturate( area + (area - overlap) * (pattern.count - 1) );
+}
@@ -0,0 +1,350 @@
+//
+//  PatternStream.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Composition/PatternStream.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+//===------------------------------------------------------------------------===
+// • I/O (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+// • Read until `size` bytes, end of file or error. Pipes return short reads
+//
+ssize_t read_fully(int descriptor, uint8_t* buffer, size_t size)
+{
+    size_t total = 0;
+
+    while (total < size) {
+
+        const auto count = ::read(descriptor, buffer + total, size - total);
+
+        if (count < 0) {
+
+            if (EINTR == errno) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        if (0 == count) {
+            break;
+        }
+
+        total += static_cast<size_t>(count);
+    }
+
+    return static_cast<ssize_t>(total);
+}
+
+bool write_fully(int descriptor, const uint8_t* buffer, size_t size)
+{
+    while (0 < size) {
+
+        const auto count = ::write(descriptor, buffer, size);
+
+        if (count < 0) {
+
+            if (EINTR == errno) {
+                continue;
+            }
+
+            return false;
+        }
+
+        buffer += count;
+        size   -= static_cast<size_t>(count);
+    }
+
+    return true;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Writing
+//===------------------------------------------------------------------------===
+
+bool write_pattern_stream(int descriptor, std::span<const Pattern> patterns)
+{
+    const auto is_nested = [](const Pattern& pattern) { return 0 != pattern.nested; };
+
+    if (std::any_of(patterns.begin(), patterns.end(), is_nested)) {
+        return false;
+    }
+
+    const PatternStreamHeader header = {
+        .magic       = pattern_stream_magic,
+        .version     = pattern_stream_version,
+        .record_size = pattern_stream_record_size,
+        .reserved    = 0
+    };
+
+    if (!write_fully(descriptor, reinterpret_cast<const uint8_t*>(&header), sizeof(header))) {
+        return false;
+    }
+
+    // • Frame records through a small buffer, padding zeroed
+    //
+    constexpr size_t batch_size = 1024;
+
+    alignas(data::alignment) uint8_t batch[batch_size * pattern_stream_record_size] = {};
+
+    for (size_t first = 0; first < patterns.size(); first += batch_size) {
+
+        const auto count = std::min(batch_size, patterns.size() - first);
+
+        for (size_t index = 0; index < count; ++index) {
+            std::memcpy( batch + index*pattern_stream_record_size, &patterns[first + index],
+                         sizeof(Pattern) );
+        }
+
+        if (!write_fully(descriptor, batch, count*pattern_stream_record_size)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//===------------------------------------------------------------------------===
+// • PatternStreamReader
+//===------------------------------------------------------------------------===
+
+PatternStreamReader::PatternStreamReader(int descriptor, uint32_t chunk_patterns, uint32_t chunk_count)
+    : descriptor     { descriptor },
+      chunk_patterns { std::max(1u, chunk_patterns) },
+      chunk_count    { std::max(2u, chunk_count) }
+{
+}
+
+PatternStreamStatistics PatternStreamReader::read(const Consumer& consume)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    PatternStreamStatistics statistics = {
+        .status        = PatternStreamStatus::complete,
+        .pattern_count = 0,
+        .chunk_count   = 0,
+        .seconds       = 0.0
+    };
+
+    const auto finish = [&statistics, start](PatternStreamStatus status) {
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        statistics.status  = status;
+        statistics.seconds = elapsed.count();
+
+        return statistics;
+    };
+
+    // • Header
+    //
+    PatternStreamHeader header;
+
+    const auto header_size = read_fully(descriptor, reinterpret_cast<uint8_t*>(&header), sizeof(header));
+
+    if (header_size < 0) {
+        return finish(PatternStreamStatus::read_error);
+    }
+
+    if ( sizeof(header) != static_cast<size_t>(header_size)
+         || pattern_stream_magic != header.magic
+         || pattern_stream_version != header.version
+         || pattern_stream_record_size != header.record_size ) {
+
+        return finish(PatternStreamStatus::bad_header);
+    }
+
+    // • Chunks, reused in order
+    //
+    const size_t chunk_size = static_cast<size_t>(chunk_patterns) * pattern_stream_record_size;
+
+    std::vector<std::unique_ptr<uint8_t, decltype(&std::free)>> chunks;
+    std::vector<uint32_t> chunk_records(chunk_count, 0);
+
+    chunks.reserve(chunk_count);
+
+    for (uint32_t index = 0; index < chunk_count; ++index) {
+
+        chunks.emplace_back( static_cast<uint8_t*>(std::aligned_alloc(data::alignment, chunk_size)),
+                             &std::free );
+
+        if (nullptr == chunks.back()) {
+            return finish(PatternStreamStatus::out_of_memory);
+        }
+    }
+
+    std::mutex              mutex;
+    std::condition_variable condition;
+    uint64_t                produced    = 0;
+    uint64_t                consumed    = 0;
+    bool                    is_finished = false;
+    bool                    is_stopped  = false;       // The consumer has left
+    PatternStreamStatus     status      = PatternStreamStatus::complete;
+
+    // • Prefetch thread: fill the next free chunk, then unframe its records
+    //   in place so that they form a contiguous Pattern array, ending the
+    //   chunk before a record with a nested reference the stream has no
+    //   table for
+    //
+    std::thread prefetch { [&] {
+
+        for (uint64_t sequence = 0; ; ++sequence) {
+
+            {
+                std::unique_lock lock { mutex };
+                condition.wait( lock, [&] { return produced - consumed < chunk_count || is_stopped; } );
+
+                if (is_stopped) {
+                    return;
+                }
+            }
+
+            const auto slot  = static_cast<uint32_t>(sequence % chunk_count);
+            const auto chunk = chunks[slot].get();
+            const auto size  = read_fully(descriptor, chunk, chunk_size);
+
+            auto result = PatternStreamStatus::complete;
+
+            if (size < 0) {
+                result = PatternStreamStatus::read_error;
+            } else if (0 != size % pattern_stream_record_size) {
+                result = PatternStreamStatus::truncated;
+            }
+
+            auto records = static_cast<uint32_t>( std::max<ssize_t>(size, 0) / pattern_stream_record_size );
+
+            for (uint32_t record = 0; record < records; ++record) {
+
+                if (0 < record) {
+                    std::memmove( chunk + record*sizeof(Pattern),
+                                  chunk + record*pattern_stream_record_size, sizeof(Pattern) );
+                }
+
+                if (0 != reinterpret_cast<const Pattern*>(chunk)[record].nested) {
+
+                    records = record;
+                    result  = PatternStreamStatus::invalid_record;
+                    break;
+                }
+            }
+
+            {
+                std::lock_guard lock { mutex };
+
+                chunk_records[slot] = records;
+
+                if (0 < records) {
+                    ++produced;
+                }
+
+                if (records < chunk_patterns || PatternStreamStatus::complete != result) {
+
+                    status      = result;
+                    is_finished = true;
+                }
+            }
+
+            condition.notify_all();
+
+            if (records < chunk_patterns || PatternStreamStatus::complete != result) {
+                return;
+            }
+        }
+    } };
+
+    // • Stop the prefetch thread however the consumer leaves, including by
+    //   throwing, rather than leave it waiting for a chunk to be consumed. A
+    //   read it has started finishes first
+    //
+    struct Stop
+    {
+        std::mutex&              mutex;
+        std::condition_variable& condition;
+        bool&                    is_stopped;
+        std::thread&             thread;
+
+        ~Stop()
+        {
+            {
+                std::lock_guard lock { mutex };
+                is_stopped = true;
+            }
+
+            condition.notify_all();
+            thread.join();
+        }
+    };
+
+    {
+        const Stop stop { mutex, condition, is_stopped, prefetch };
+
+        // • Consume on the calling thread
+        //
+        for (;;) {
+
+            uint32_t slot    = 0;
+            uint32_t records = 0;
+
+            {
+                std::unique_lock lock { mutex };
+                condition.wait( lock, [&] { return consumed < produced || is_finished; } );
+
+                if (consumed == produced) {
+                    break;
+                }
+
+                slot    = static_cast<uint32_t>(consumed % chunk_count);
+                records = chunk_records[slot];
+            }
+
+            consume( { reinterpret_cast<const Pattern*>(chunks[slot].get()), records } );
+
+            statistics.pattern_count += records;
+            statistics.chunk_count   += 1;
+
+            {
+                std::lock_guard lock { mutex };
+                ++consumed;
+            }
+
+            condition.notify_all();
+        }
+
+    }
+
+    return finish(status);
+}
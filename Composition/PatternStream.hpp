@@ -0,0 +1,129 @@
+//
+//  PatternStream.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Pattern.hpp>
+#include <Data/Layout.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <span>
+
+//===------------------------------------------------------------------------===
+//
+// • Pattern stream
+//
+//  - For scenes too large to hold in memory: a header followed by any number
+//    of Pattern records, each framed in data::aligned_size<Pattern>() bytes.
+//    The record count is not known up front, so a stream can come from a pipe
+//
+//    [ PatternStreamHeader | Pattern + padding | Pattern + padding | ... ]
+//
+//  - A stream has no table of nested patterns, so records must not nest
+//    (see Pattern.hpp): the writer refuses them and the reader stops at the
+//    first one with invalid_record. Version 2 records have rows and nesting
+//
+//===------------------------------------------------------------------------===
+
+struct PatternStreamHeader
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    record_size;
+    uint32_t    reserved;
+};
+
+static_assert( data::is_trivial_layout<PatternStreamHeader>(), "Unexpected layout" );
+static_assert( 16 == sizeof(PatternStreamHeader), "Unexpected size" );
+
+enum : uint32_t
+{
+    pattern_stream_magic       = 0x52594c50,   // "PLYR"
+    pattern_stream_version     = 2,
+    pattern_stream_record_size = data::aligned_size<Pattern>()
+};
+
+// • Write a complete stream to a file descriptor. False, writing nothing, if
+//   any pattern nests
+//
+bool write_pattern_stream(int descriptor, std::span<const Pattern> patterns);
+
+//===------------------------------------------------------------------------===
+// • PatternStreamReader
+//
+//  - Reads fixed-size chunks of records on a prefetch thread while the
+//    consumer processes the previous chunk on the calling thread. Memory is
+//    bounded by chunk_count chunks regardless of the length of the stream
+//
+//===------------------------------------------------------------------------===
+
+enum class PatternStreamStatus
+{
+    complete,
+    bad_header,
+    truncated,
+    read_error,
+    out_of_memory,
+    invalid_record      // A record nests; the records before it were read
+};
+
+struct PatternStreamStatistics
+{
+    PatternStreamStatus status;
+    uint64_t            pattern_count;
+    uint64_t            chunk_count;
+    double              seconds;
+
+    double patterns_per_second(void) const noexcept
+    {
+        return (0.0 < seconds) ? static_cast<double>(pattern_count) / seconds : 0.0;
+    }
+};
+
+class PatternStreamReader
+{
+public:
+
+    using Consumer = std::function<void(std::span<const Pattern>)>;
+
+    // • chunk_patterns records per chunk, and at least two chunks so that
+    //   one can be read while the other is consumed
+    //
+    PatternStreamReader(int descriptor, uint32_t chunk_patterns = 16384, uint32_t chunk_count = 3);
+
+    // • Peak memory used for chunks
+    //
+    size_t chunk_memory(void) const noexcept
+    {
+        return static_cast<size_t>(chunk_count) * chunk_patterns * pattern_stream_record_size;
+    }
+
+    // • Read to the end of the stream, passing each chunk to `consume`. The
+    //   span is valid only during the call. If `consume` throws, the
+    //   exception leaves read once the prefetch thread has stopped
+    //
+    PatternStreamStatistics read(const Consumer& consume);
+
+private:
+
+    int         descriptor;
+    uint32_t    chunk_patterns;
+    uint32_t    chunk_count;
+};
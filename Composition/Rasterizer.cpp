@@ -0,0 +1,713 @@
+//
+//  Rasterizer.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Composition/Rasterizer.hpp>
+#include <Composition/PatternQueries.hpp>
+#include <Data/Trace.hpp>
+#include <Graphics/PixelConversion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+//===------------------------------------------------------------------------===
+// • namespace raster
+//===------------------------------------------------------------------------===
+
+namespace raster
+{
+
+namespace
+{
+
+//===------------------------------------------------------------------------===
+// • Four .bgra8Unorm or two .rgba16Float pixels per store; the compiler
+//   lowers this to SSE2 / NEON
+//===------------------------------------------------------------------------===
+
+typedef uint32_t pixel4 __attribute__(( vector_size(16), may_alias ));
+typedef uint64_t pixel2 __attribute__(( vector_size(16), may_alias ));
+
+//===------------------------------------------------------------------------===
+// • Instances for a region of pixels
+//===------------------------------------------------------------------------===
+
+// • A region of pixels in grid units, widened by a unit on each side so that
+//   it holds every instance that can cover one of those pixels
+//
+uint32_t grid_coordinate(double value)
+{
+    return static_cast<uint32_t>( std::clamp<double>( value, 0.0, std::numeric_limits<uint32_t>::max() ) );
+}
+
+geometry::Region candidate_region(geometry::Region pixels, simd::uint2 target_size, simd::uint2 grid_size)
+{
+    const auto scale_x = static_cast<double>(grid_size.x) / target_size.x;
+    const auto scale_y = static_cast<double>(grid_size.y) / target_size.y;
+
+    return {
+        .left   = grid_coordinate( std::floor(pixels.left   * scale_x) - 1.0 ),
+        .top    = grid_coordinate( std::floor(pixels.top    * scale_y) - 1.0 ),
+        .right  = grid_coordinate( std::ceil(pixels.right   * scale_x) + 1.0 ),
+        .bottom = grid_coordinate( std::ceil(pixels.bottom  * scale_y) + 1.0 )
+    };
+}
+
+//===------------------------------------------------------------------------===
+// • Analytic coverage
+//===------------------------------------------------------------------------===
+
+// • Sixteen 8-bit channels, and the same widened for blending
+//
+typedef uint8_t  channels8  __attribute__(( vector_size(16) ));
+typedef uint16_t channels16 __attribute__(( vector_size(32) ));
+
+// • Blending white over channel c by alpha gives c + (255 - c) * alpha / 255,
+//   rounded: t / 255 rounds to (t + 128 + ((t + 128) >> 8)) >> 8 for t up
+//   to 255 * 255, so 16 bits hold every step
+//
+uint32_t blend_white_pixel(uint32_t pixel, uint32_t alpha)
+{
+    uint32_t blended = 0;
+
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+
+        const auto channel = (pixel >> shift) & 0xff;
+        const auto product = (255 - channel) * alpha + 128;
+
+        blended |= ( channel + ((product + (product >> 8)) >> 8) ) << shift;
+    }
+
+    return blended;
+}
+
+uint32_t coverage_alpha(float coverage)
+{
+    return static_cast<uint32_t>(coverage * 255.0f + 0.5f);
+}
+
+geometry::Rectangle clip(geometry::Rectangle rect, geometry::Region region)
+{
+    return {
+        .left   = std::max( rect.left,   static_cast<float>(region.left) ),
+        .top    = std::max( rect.top,    static_cast<float>(region.top) ),
+        .right  = std::min( rect.right,  static_cast<float>(region.right) ),
+        .bottom = std::min( rect.bottom, static_cast<float>(region.bottom) )
+    };
+}
+
+bool has_area(geometry::Rectangle rect)
+{
+    return rect.left < rect.right && rect.top < rect.bottom;
+}
+
+// • Pixels a clipped rect touches
+//
+geometry::Region pixel_bounds(geometry::Rectangle rect)
+{
+    return {
+        .left   = static_cast<uint32_t>( std::floor(rect.left) ),
+        .top    = static_cast<uint32_t>( std::floor(rect.top) ),
+        .right  = static_cast<uint32_t>( std::ceil(rect.right) ),
+        .bottom = static_cast<uint32_t>( std::ceil(rect.bottom) )
+    };
+}
+
+uint64_t area(geometry::Region region)
+{
+    return static_cast<uint64_t>( geometry::width(region) ) * geometry::height(region);
+}
+
+// • Append the parts of `region` outside `hole`: at most a band above and
+//   below it, and a piece left and right of it in between
+//
+void append_difference(geometry::Region region, geometry::Region hole, std::vector<geometry::Region>& pieces)
+{
+    const auto overlap = geometry::intersection(region, hole);
+
+    if (geometry::is_empty(overlap)) {
+        pieces.push_back(region);
+        return;
+    }
+
+    const geometry::Region candidates[] = {
+        { region.left,   region.top,     region.right,  overlap.top    },
+        { region.left,   overlap.bottom, region.right,  region.bottom  },
+        { region.left,   overlap.top,    overlap.left,  overlap.bottom },
+        { overlap.right, overlap.top,    region.right,  overlap.bottom }
+    };
+
+    for (const auto& piece : candidates) {
+        if (!geometry::is_empty(piece)) {
+            pieces.push_back(piece);
+        }
+    }
+}
+
+// • The .rgba16Float pixel of a .bgra8Unorm one
+//
+uint64_t half_pixel(uint32_t value)
+{
+    switch (value) {
+        case black_pixel: return black_half_pixel;
+        case white_pixel: return white_half_pixel;
+    }
+
+    uint16_t halves[4];
+    uint64_t pixel;
+
+    pixels::decode_bgra8( { &value, 1 }, halves );
+    std::memcpy(&pixel, halves, sizeof(pixel));
+
+    return pixel;
+}
+
+// • Blend white over `count` pixels of row `y` of `target` from `x`:
+//   coverage rounded to 8 bits over sRGB values for .bgra8Unorm, exact over
+//   linear values for .rgba16Float
+//
+void blend_row(const Bitmap& target, uint32_t x, uint32_t y, uint32_t count, float coverage)
+{
+    if (PixelFormat::bgra8Unorm == target.format) {
+        blend_span( row(target, y) + x, count, coverage_alpha(coverage) );
+    }
+    else if (1.0f <= coverage) {
+        fill_span( reinterpret_cast<uint64_t*>( half_row(target, y) ) + x, count, white_half_pixel );
+    }
+    else if (0.0f < coverage) {
+        pixels::blend_white( { half_row(target, y) + 4*static_cast<size_t>(x), 4*static_cast<size_t>(count) }, coverage );
+    }
+}
+
+// • Instances per expansion run, and bands per worker, and rows per
+//   conversion run
+//
+constexpr size_t expansion_grain  = 4096;
+constexpr uint32_t bands_per_worker = 4;
+constexpr size_t conversion_grain = 16;
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Coverage
+//===------------------------------------------------------------------------===
+
+void fill_span(uint32_t* pixels, uint32_t count, uint32_t value)
+{
+    // • Scalar head up to 16-byte alignment
+    //
+    while (0 < count && !data::is_aligned(pixels)) {
+        *pixels++ = value;
+        --count;
+    }
+
+    // • Aligned vector body, 64 bytes per iteration
+    //
+    const pixel4 value4 = { value, value, value, value };
+
+    auto vector = reinterpret_cast<pixel4*>(pixels);
+
+    for ( ; 16 <= count; count -= 16, vector += 4) {
+        vector[0] = value4;
+        vector[1] = value4;
+        vector[2] = value4;
+        vector[3] = value4;
+    }
+
+    for ( ; 4 <= count; count -= 4) {
+        *vector++ = value4;
+    }
+
+    // • Scalar tail
+    //
+    pixels = reinterpret_cast<uint32_t*>(vector);
+
+    while (0 < count--) {
+        *pixels++ = value;
+    }
+}
+
+void fill_span(uint64_t* pixels, uint32_t count, uint64_t value)
+{
+    // • Scalar head up to 16-byte alignment
+    //
+    if (0 < count && !data::is_aligned(pixels)) {
+        *pixels++ = value;
+        --count;
+    }
+
+    // • Aligned vector body, 64 bytes per iteration
+    //
+    const pixel2 value2 = { value, value };
+
+    auto vector = reinterpret_cast<pixel2*>(pixels);
+
+    for ( ; 8 <= count; count -= 8, vector += 4) {
+        vector[0] = value2;
+        vector[1] = value2;
+        vector[2] = value2;
+        vector[3] = value2;
+    }
+
+    for ( ; 2 <= count; count -= 2) {
+        *vector++ = value2;
+    }
+
+    // • Scalar tail
+    //
+    if (0 < count) {
+        *reinterpret_cast<uint64_t*>(vector) = value;
+    }
+}
+
+void fill_row(const Bitmap& target, uint32_t x, uint32_t y, uint32_t count, uint32_t value)
+{
+    if (PixelFormat::bgra8Unorm == target.format) {
+        fill_span(row(target, y) + x, count, value);
+    } else {
+        fill_span(reinterpret_cast<uint64_t*>( half_row(target, y) ) + x, count, half_pixel(value));
+    }
+}
+
+void blend_span(uint32_t* pixels, uint32_t count, uint32_t alpha)
+{
+    if (0 == alpha) {
+        return;
+    }
+
+    if (255 <= alpha) {
+        fill_span(pixels, count, white_pixel);
+        return;
+    }
+
+    const auto weight = static_cast<uint16_t>(alpha);
+
+    // • Four pixels per iteration, widened to 16 bits; the compiler lowers
+    //   this to SSE2 / NEON
+    //
+    for ( ; 4 <= count; count -= 4, pixels += 4) {
+
+        channels8 channels;
+
+        std::memcpy(&channels, pixels, sizeof(channels));
+
+        auto wide = __builtin_convertvector(channels, channels16);
+
+        const channels16 product = (255 - wide) * weight + 128;
+
+        wide    += (product + (product >> 8)) >> 8;
+        channels = __builtin_convertvector(wide, channels8);
+
+        std::memcpy(pixels, &channels, sizeof(channels));
+    }
+
+    for ( ; 0 < count; --count, ++pixels) {
+        *pixels = blend_white_pixel(*pixels, alpha);
+    }
+}
+
+//===------------------------------------------------------------------------===
+// • Conversion
+//===------------------------------------------------------------------------===
+
+bool convert(data::JobSystem& jobs, const Bitmap& source, const Bitmap& target)
+{
+    if (source.width != target.width || source.height != target.height) {
+        return false;
+    }
+
+    PLAY_TRACE_SCOPE("convert", "raster");
+
+    const auto row_size = static_cast<size_t>( source.width ) * bytes_per_pixel(source.format);
+    const auto count    = 4 * static_cast<size_t>( source.width );
+
+    jobs.parallel_for( source.height, conversion_grain, [&](size_t first, size_t last)
+    {
+        for (auto y = static_cast<uint32_t>(first); y < last; ++y) {
+
+            if (source.format == target.format) {
+                std::memcpy( target.data + static_cast<size_t>(y)*target.bytes_per_row,
+                             source.data + static_cast<size_t>(y)*source.bytes_per_row, row_size );
+            }
+            else if (PixelFormat::rgba16Float == source.format) {
+                pixels::encode_bgra8( { half_row(source, y), count }, { row(target, y), source.width } );
+            }
+            else {
+                pixels::decode_bgra8( { row(source, y), source.width }, { half_row(target, y), count } );
+            }
+        }
+    } );
+
+    return true;
+}
+
+//===------------------------------------------------------------------------===
+// • Expansion
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+// • The visible instances of `patterns` in draw order, each converted by
+//   convert(pattern, instance_region, value), which returns false to drop
+//   the instance. Runs of instances are converted in parallel on `jobs`
+//
+template <typename Output_, typename Convert_>
+void expand_instances( data::JobSystem& jobs, std::span<const Pattern> patterns,
+                       std::vector<Output_>& output, Convert_&& convert )
+{
+    // • Runs of visible instances (for_each_visible), numbered across all of
+    //   them. Nested patterns are resolved from the table `patterns` views
+    //
+    const auto table = patterns.data();
+
+    std::vector<uint32_t>      visible_patterns;
+    std::vector<InstanceRange> visible;
+    std::vector<uint64_t>      first_visible;
+
+    uint64_t visible_count = 0;
+
+    for (size_t index = 0; index < patterns.size(); ++index) {
+
+        for_each_visible( table, patterns[index], [&](InstanceRange run) {
+
+            visible_patterns.push_back( static_cast<uint32_t>(index) );
+            visible.push_back(run);
+            first_visible.push_back(visible_count);
+
+            visible_count += size(run);
+        } );
+    }
+
+    first_visible.push_back(visible_count);
+
+    // • Each run of visible instances to its own list, since instances
+    //   that convert to nothing are dropped
+    //
+    const auto run_count = (visible_count + expansion_grain - 1) / expansion_grain;
+
+    std::vector<std::vector<Output_>> runs(run_count);
+
+    jobs.parallel_for( run_count, 1, [&](size_t first_run, size_t last_run) {
+
+        for (auto run = first_run; run < last_run; ++run) {
+
+            const auto first = run * expansion_grain;
+            const auto last  = std::min<uint64_t>(first + expansion_grain, visible_count);
+
+            auto& values = runs[run];
+
+            values.reserve(last - first);
+
+            auto visible_index = static_cast<size_t>( std::upper_bound( first_visible.begin(), first_visible.end(), first )
+                                                      - first_visible.begin() ) - 1;
+
+            for (auto position = first; position < last; ++visible_index) {
+
+                const auto& pattern = patterns[ visible_patterns[visible_index] ];
+                const auto  end     = std::min(last, first_visible[visible_index + 1]);
+
+                for ( ; position < end; ++position) {
+
+                    const auto index = visible[visible_index].first
+                                     + static_cast<uint32_t>( position - first_visible[visible_index] );
+
+                    Output_ value = { };
+
+                    if ( convert(pattern, instance_region(table, pattern, index), value) ) {
+                        values.push_back(value);
+                    }
+                }
+            }
+        }
+    } );
+
+    // • Join the runs in order
+    //
+    std::vector<size_t> run_offsets(run_count + 1, 0);
+
+    for (size_t run = 0; run < run_count; ++run) {
+        run_offsets[run + 1] = run_offsets[run] + runs[run].size();
+    }
+
+    output.resize(run_offsets[run_count]);
+
+    jobs.parallel_for( run_count, 4, [&](size_t first_run, size_t last_run) {
+
+        for (auto run = first_run; run < last_run; ++run) {
+            std::copy( runs[run].begin(), runs[run].end(), output.begin() + run_offsets[run] );
+        }
+    } );
+}
+
+} // namespace
+
+void expand_pixel_regions( data::JobSystem& jobs, std::span<const Pattern> patterns,
+                           simd::uint2 target_size, std::vector<geometry::Region>& pixel_regions )
+{
+    PLAY_TRACE_SCOPE("expand", "raster");
+
+    expand_instances( jobs, patterns, pixel_regions,
+                      [target_size](const Pattern& pattern, geometry::Region region, geometry::Region& pixels) {
+
+        pixels = geometry::covered_pixels(region, pattern.grid_size, target_size);
+
+        return !geometry::is_empty(pixels);
+    } );
+
+    PLAY_TRACE_COUNTER("pixel regions", pixel_regions.size());
+}
+
+void expand_pixel_rects( data::JobSystem& jobs, std::span<const Pattern> patterns,
+                         simd::uint2 target_size, std::vector<geometry::Rectangle>& pixel_rects )
+{
+    PLAY_TRACE_SCOPE("expand", "raster");
+
+    const auto target_region = geometry::make_region_of_size(target_size);
+
+    expand_instances( jobs, patterns, pixel_rects,
+                      [&](const Pattern& pattern, geometry::Region region, geometry::Rectangle& pixels) {
+
+        pixels = clip( geometry::make_pixel_rectangle(region, pattern.grid_size, target_size), target_region );
+
+        return has_area(pixels);
+    } );
+
+    PLAY_TRACE_COUNTER("pixel rects", pixel_rects.size());
+}
+
+//===------------------------------------------------------------------------===
+// • Rasterizer
+//===------------------------------------------------------------------------===
+
+Rasterizer::Rasterizer(data::JobSystem& jobs)
+    : jobs { jobs }
+{
+}
+
+void Rasterizer::draw(std::span<const Pattern> patterns, const Bitmap& target, LoadAction load_action)
+{
+    PLAY_TRACE_SCOPE("rasterize", "raster");
+
+    clear_regions.clear();
+    pixel_regions.clear();
+    pixel_rects.clear();
+
+    if (LoadAction::clear == load_action) {
+        clear_regions.push_back( geometry::make_region_of_size( size(target) ) );
+    }
+
+    // • Expand instances to pixels once for all bands
+    //
+    if (Coverage::analytic == coverage_mode) {
+        expand_pixel_rects(jobs, patterns, size(target), pixel_rects);
+    } else {
+        expand_pixel_regions(jobs, patterns, size(target), pixel_regions);
+    }
+
+    draw_bands(target);
+}
+
+void Rasterizer::redraw( std::span<const Pattern> patterns, const Bitmap& target,
+                         std::span<const geometry::Region> dirty_regions )
+{
+    PLAY_TRACE_SCOPE("redraw", "raster");
+
+    const auto target_region = geometry::make_region_of_size( size(target) );
+    const auto is_analytic   = Coverage::analytic == coverage_mode;
+
+    clear_regions.clear();
+    pixel_regions.clear();
+    pixel_rects.clear();
+
+    // • Disjoint pieces of the dirty regions, since blending a pixel twice
+    //   would not give the same result as blending it once
+    //
+    for (const auto& dirty : dirty_regions) {
+
+        std::vector<geometry::Region> pieces = { geometry::intersection(dirty, target_region) };
+
+        for (const auto& earlier : clear_regions) {
+
+            std::vector<geometry::Region> outside;
+
+            for (const auto& piece : pieces) {
+                append_difference(piece, earlier, outside);
+            }
+
+            pieces = std::move(outside);
+        }
+
+        for (const auto& piece : pieces) {
+            if (!geometry::is_empty(piece)) {
+                clear_regions.push_back(piece);
+            }
+        }
+    }
+
+    for (const auto& clipped : clear_regions) {
+
+        // • Only the instances that can cover a pixel of the region. Clipping
+        //   a rect to whole pixels leaves the coverage of those inside as is
+        //
+        for (const auto& pattern : patterns) {
+
+            const auto candidate = candidate_region(clipped, size(target), pattern.grid_size);
+
+            for_each_intersecting( patterns.data(), pattern, candidate, [&](InstanceRange instances) {
+
+                for (auto index = instances.first; index < instances.end; ++index) {
+
+                    const auto region = instance_region(patterns.data(), pattern, index);
+
+                    if (is_analytic) {
+
+                        const auto rect = geometry::make_pixel_rectangle(region, pattern.grid_size, size(target));
+                        const auto part = clip(rect, clipped);
+
+                        if (has_area(part)) {
+                            pixel_rects.push_back(part);
+                        }
+
+                        continue;
+                    }
+
+                    const auto covered = geometry::covered_pixels(region, pattern.grid_size, size(target));
+                    const auto pixels  = geometry::intersection(covered, clipped);
+
+                    if (!geometry::is_empty(pixels)) {
+                        pixel_regions.push_back(pixels);
+                    }
+                }
+            } );
+        }
+    }
+
+    draw_bands(target);
+}
+
+void Rasterizer::draw_bands(const Bitmap& target)
+{
+    touched = 0;
+
+    for (const auto& region : clear_regions) {
+        touched += area(region);
+    }
+
+    for (const auto& region : pixel_regions) {
+        touched += area(region);
+    }
+
+    for (const auto& rect : pixel_rects) {
+        touched += area( pixel_bounds(rect) );
+    }
+
+    // • A few bands of rows per worker. Each band visits every region, so
+    //   a single worker draws one band
+    //
+    const auto workers     = jobs.worker_count();
+    const auto band_limit  = (1 < workers) ? workers * bands_per_worker : 1u;
+    const auto band_count  = std::min(band_limit, std::max(1u, target.height));
+    const auto band_height = (target.height + band_count - 1) / band_count;
+    const auto is_analytic = Coverage::analytic == coverage_mode;
+
+    jobs.parallel_for( band_count, 1, [&](size_t first, size_t last) {
+
+        for (auto band = static_cast<uint32_t>(first); band < last; ++band) {
+
+            PLAY_TRACE_SCOPE("band", "raster");
+
+            const auto top    = std::min(band * band_height, target.height);
+            const auto bottom = std::min(top + band_height, target.height);
+
+            clear_band(target, top, bottom);
+
+            if (is_analytic) {
+                blend_band(target, top, bottom);
+            } else {
+                draw_band(target, top, bottom);
+            }
+        }
+    } );
+}
+
+void Rasterizer::clear_band(const Bitmap& target, uint32_t top, uint32_t bottom) const
+{
+    for (const auto& region : clear_regions) {
+
+        const auto first = std::max(top, region.top);
+        const auto last  = std::min(bottom, region.bottom);
+
+        for (auto y = first; y < last; ++y) {
+            fill_row(target, region.left, y, geometry::width(region), black_pixel);
+        }
+    }
+}
+
+void Rasterizer::draw_band(const Bitmap& target, uint32_t top, uint32_t bottom) const
+{
+    // • Fill the part of each instance inside the band
+    //
+    for (const auto& pixels : pixel_regions) {
+
+        const auto first = std::max(top, pixels.top);
+        const auto last  = std::min(bottom, pixels.bottom);
+
+        for (auto y = first; y < last; ++y) {
+            fill_row(target, pixels.left, y, geometry::width(pixels), white_pixel);
+        }
+    }
+}
+
+void Rasterizer::blend_band(const Bitmap& target, uint32_t top, uint32_t bottom) const
+{
+    // • Blend the part of each instance inside the band. Along a row only
+    //   the first and last pixel can be partly covered horizontally
+    //
+    for (const auto& rect : pixel_rects) {
+
+        const auto pixels = pixel_bounds(rect);
+        const auto first  = std::max(top, pixels.top);
+        const auto last   = std::min(bottom, pixels.bottom);
+
+        if (last <= first) {
+            continue;
+        }
+
+        const auto width          = geometry::width(pixels);
+        const auto left_coverage  = geometry::span_coverage(rect.left, rect.right, pixels.left);
+        const auto right_coverage = geometry::span_coverage(rect.left, rect.right, pixels.right - 1);
+
+        for (auto y = first; y < last; ++y) {
+
+            const auto row_coverage = geometry::span_coverage(rect.top, rect.bottom, y);
+
+            blend_row( target, pixels.left, y, 1, left_coverage * row_coverage );
+
+            if (1 < width) {
+                blend_row( target, pixels.left + 1, y, width - 2, row_coverage );
+                blend_row( target, pixels.right - 1, y, 1, right_coverage * row_coverage );
+            }
+        }
+    }
+}
+
+} // namespace raster
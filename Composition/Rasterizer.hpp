@@ -0,0 +1,286 @@
+//
+//  Rasterizer.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Arena.hpp>
+#include <Composition/Pattern.hpp>
+#include <Data/JobSystem.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • namespace raster
+//
+//  CPU reference for pattern_vertex + white_fragment and, with analytic
+//  coverage, culled_coverage_vertex + coverage_fragment (Shaders.metal)
+//
+//  Nested patterns are resolved from the first pattern of each span of
+//  patterns, so a span must start at its table, e.g. patterns(arena)
+//
+//===------------------------------------------------------------------------===
+
+namespace raster
+{
+
+//===------------------------------------------------------------------------===
+// • PixelFormat
+//
+//  - The pixel layouts of BitmapPixelDescription the renderer draws to:
+//    .bgra8Unorm, four bytes in B, G, R, A order (.byteOrder32Little, alpha
+//    first), sRGB encoded; and .rgba16Float, four halves in R, G, B, A
+//    order, linear (see PixelConversion.hpp)
+//===------------------------------------------------------------------------===
+
+enum class PixelFormat
+{
+    bgra8Unorm,
+    rgba16Float
+};
+
+constexpr uint32_t bytes_per_pixel(PixelFormat format)
+{
+    return (PixelFormat::bgra8Unorm == format) ? 4u : 8u;
+}
+
+//===------------------------------------------------------------------------===
+// • Bitmap
+//
+//  - Same layout as BitmapDescription with the BitmapPixelDescription of
+//    `format`: rows padded to a multiple of 64 bytes
+//===------------------------------------------------------------------------===
+
+struct Bitmap
+{
+    uint8_t*    data;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    bytes_per_row;
+    PixelFormat format = PixelFormat::bgra8Unorm;
+};
+
+constexpr uint32_t bytes_per_row(PixelFormat format, uint32_t width)
+{
+    return ((width * bytes_per_pixel(format)) + 63u) & ~63u;
+}
+
+constexpr uint32_t bytes_per_row(uint32_t width)
+{
+    return bytes_per_row(PixelFormat::bgra8Unorm, width);
+}
+
+constexpr size_t buffer_size(PixelFormat format, uint32_t width, uint32_t height)
+{
+    return static_cast<size_t>( bytes_per_row(format, width) ) * height;
+}
+
+constexpr size_t buffer_size(uint32_t width, uint32_t height)
+{
+    return buffer_size(PixelFormat::bgra8Unorm, width, height);
+}
+
+constexpr simd::uint2 size(const Bitmap& bitmap)
+{
+    return { bitmap.width, bitmap.height };
+}
+
+// • Row `y` as .bgra8Unorm pixels
+//
+inline uint32_t* row(const Bitmap& bitmap, uint32_t y)
+{
+    return reinterpret_cast<uint32_t*>( bitmap.data + static_cast<size_t>(y)*bitmap.bytes_per_row );
+}
+
+// • Row `y` as .rgba16Float pixels, four halves each
+//
+inline uint16_t* half_row(const Bitmap& bitmap, uint32_t y)
+{
+    return reinterpret_cast<uint16_t*>( bitmap.data + static_cast<size_t>(y)*bitmap.bytes_per_row );
+}
+
+// • Pixel values as little-endian 32-bit words (.bgra8Unorm) and 64-bit
+//   words (.rgba16Float)
+//
+enum : uint32_t
+{
+    black_pixel = 0xff000000,   // MTLClearColorMake(0.0, 0.0, 0.0, 1.0)
+    white_pixel = 0xffffffff    // white_fragment
+};
+
+enum : uint64_t
+{
+    black_half_pixel = 0x3c00'0000'0000'0000,
+    white_half_pixel = 0x3c00'3c00'3c00'3c00
+};
+
+// • Convert `source` to the format of `target`, of the same size: sRGB
+//   encoding .rgba16Float to .bgra8Unorm, e.g. for an 8-bit preview of an
+//   HDR frame, or decoding the other way. Rows are converted in parallel on
+//   `jobs`. False if the sizes differ
+//
+bool convert(data::JobSystem& jobs, const Bitmap& source, const Bitmap& target);
+
+//===------------------------------------------------------------------------===
+// • Coverage
+//===------------------------------------------------------------------------===
+
+// • Fill `count` pixels starting at `pixels`
+//
+void fill_span(uint32_t* pixels, uint32_t count, uint32_t value);
+
+void fill_span(uint64_t* pixels, uint32_t count, uint64_t value);
+
+// • Fill `count` pixels of row `y` of `target` from `x` with black_pixel or
+//   white_pixel, or the same in .rgba16Float
+//
+void fill_row(const Bitmap& target, uint32_t x, uint32_t y, uint32_t count, uint32_t value);
+
+// • Blend white over `count` pixels with coverage `alpha` (0 to 255):
+//   each channel c becomes c + (255 - c) * alpha / 255, rounded
+//
+void blend_span(uint32_t* pixels, uint32_t count, uint32_t alpha);
+
+// • Covered pixels (geometry::covered_pixels, as the tiled kernels use) of
+//   every visible instance that covers any, in draw order. Runs of instances
+//   are expanded in parallel on `jobs`
+//
+void expand_pixel_regions( data::JobSystem& jobs, std::span<const Pattern> patterns,
+                           simd::uint2 target_size, std::vector<geometry::Region>& pixel_regions );
+
+// • As expand_pixel_regions, for analytic coverage: the rect in pixels
+//   (geometry::make_pixel_rectangle) of every visible instance covering any
+//   part of the target, clipped to it
+//
+void expand_pixel_rects( data::JobSystem& jobs, std::span<const Pattern> patterns,
+                         simd::uint2 target_size, std::vector<geometry::Rectangle>& pixel_rects );
+
+//===------------------------------------------------------------------------===
+// • LoadAction
+//
+//  - As MTLLoadAction: clear the target first, or draw over its contents,
+//    e.g. when a scene arrives in chunks
+//===------------------------------------------------------------------------===
+
+enum class LoadAction
+{
+    clear,
+    load
+};
+
+//===------------------------------------------------------------------------===
+// • Coverage
+//
+//  - binary fills the pixels whose centres an instance covers, as
+//    white_fragment; analytic blends white over each pixel by the fraction
+//    of it the instance covers (geometry::pixel_coverage), as
+//    coverage_fragment, for antialiased edges at the cost of one sample
+//
+//  - Blending happens in the target's values: sRGB encoded for .bgra8Unorm,
+//    with coverage rounded to 8 bits, and linear for .rgba16Float, so the
+//    sRGB preview (see convert) of an HDR frame has lighter edges
+//
+//  - Overlapping edges blend one over the other, so two instances abutting
+//    along an edge both half covering a pixel leave it 3/4 white, where a
+//    supersampled union would fill it
+//===------------------------------------------------------------------------===
+
+enum class Coverage
+{
+    binary,
+    analytic
+};
+
+//===------------------------------------------------------------------------===
+// • Rasterizer
+//
+//  - Clears the target to black (LoadAction::clear) and fills every
+//    instance of every pattern with white, with the chosen Coverage, in
+//    either PixelFormat. Rows are split into bands, a few per worker of
+//    `jobs` so that idle workers can steal them; each band fills the spans
+//    of the instances that cross it
+//
+//  - redraw repeats a draw inside `dirty_regions` (pixels, e.g. from
+//    DirtyRegions) only, over the previous frame. The result is the same as
+//    a full draw when the regions hold every pixel that changed
+//===------------------------------------------------------------------------===
+
+class Rasterizer
+{
+public:
+
+    explicit Rasterizer(data::JobSystem& jobs = data::JobSystem::shared());
+
+    void draw( std::span<const Pattern> patterns, const Bitmap& target,
+               LoadAction load_action = LoadAction::clear );
+
+    void draw(const Arena& arena, const Bitmap& target, LoadAction load_action = LoadAction::clear)
+    {
+        draw( { patterns(arena), arena.patterns.count }, target, load_action );
+    }
+
+    void redraw( std::span<const Pattern> patterns, const Bitmap& target,
+                 std::span<const geometry::Region> dirty_regions );
+
+    void redraw(const Arena& arena, const Bitmap& target, std::span<const geometry::Region> dirty_regions)
+    {
+        redraw( { patterns(arena), arena.patterns.count }, target, dirty_regions );
+    }
+
+    uint32_t thread_count(void) const noexcept
+    {
+        return jobs.worker_count();
+    }
+
+    // • Coverage of the next draw or redraw (binary by default)
+    //
+    Coverage coverage(void) const noexcept
+    {
+        return coverage_mode;
+    }
+
+    void set_coverage(Coverage coverage) noexcept
+    {
+        coverage_mode = coverage;
+    }
+
+    // • Pixels cleared plus pixels filled by the last draw or redraw
+    //
+    uint64_t touched_pixels(void) const noexcept
+    {
+        return touched;
+    }
+
+private:
+
+    void draw_bands(const Bitmap& target);
+    void clear_band(const Bitmap& target, uint32_t top, uint32_t bottom) const;
+    void draw_band(const Bitmap& target, uint32_t top, uint32_t bottom) const;
+    void blend_band(const Bitmap& target, uint32_t top, uint32_t bottom) const;
+
+    std::vector<geometry::Region>       clear_regions;
+    std::vector<geometry::Region>       pixel_regions;
+    std::vector<geometry::Rectangle>    pixel_rects;
+    uint64_t                            touched       = 0;
+    Coverage                            coverage_mode = Coverage::binary;
+    data::JobSystem&                    jobs;
+};
+
+} // namespace raster
@@ -37,10 +37,70 @@ class Renderer {
     let device      : MTLDevice
     let composition : Composition
 
+    //===--------------------------------------------------------------------===
+    // MARK: • Properties
+    //
+    //  - The visible part of the composition, in normalized view coordinates
+    //    (left, top, right, bottom; y down). Instances outside it are culled
+    //    before the draw
+    //
+    var viewport = SIMD4<Float>(0.0, 0.0, 1.0, 1.0) {
+        didSet { composition.invalidate() }
+    }
+
+    //  - Whether to draw by binning instances into tiles and shading each pixel
+    //    once (see TileBinningPass) rather than with the instanced draw. The
+    //    tiled pass covers the whole canvas, ignoring viewport and dirty rects
+    //
+    var isTiled = false {
+        didSet { composition.invalidate() }
+    }
+
+    //  - Whether to antialias instance edges with analytic coverage (see
+    //    coverage_fragment) rather than covering whole pixels. The tiled pass
+    //    stays binary, so isTiled only takes effect without it
+    //
+    var isAntialiased = false {
+        didSet { composition.invalidate() }
+    }
+
+    //  - Whether to draw into a linear .rgba16Float canvas (the master, e.g.
+    //    for HDR export) and present its sRGB encoding (see
+    //    encode_srgb_fragment), rather than drawing .bgra8Unorm directly.
+    //    Analytic edges then blend in linear space
+    //
+    var isHighDynamicRange = false {
+        didSet { composition.invalidate() }
+    }
+
+    //  - Pixel format of the canvas, .rgba16Float when isHighDynamicRange
+    //
+    var canvasPixelFormat: MTLPixelFormat {
+        isHighDynamicRange ? .rgba16Float : pixelFormat
+    }
+
+    //  - Overdraw statistics of the last completed tiled frame
+    //
+    var tileStatistics: TileStatistics {
+        tileBinningPass.statistics
+    }
+
     //===--------------------------------------------------------------------===
     // MARK: • Properties (Private)
     //
-    private let renderPipelineState : MTLRenderPipelineState
+    private let standardPipelineStates : DrawPipelineStates
+    private let linearPipelineStates   : DrawPipelineStates
+    private let encodePipelineState    : MTLRenderPipelineState
+    private let cullPipelineState      : MTLComputePipelineState
+    private let tileBinningPass        : TileBinningPass
+    private let drawArgumentsBuffer    : MTLBuffer
+    private let initialArgumentsBuffer : MTLBuffer
+    private var visibleInstancesBuffer : MTLBuffer?
+    private var dirtyRects             : [MTLScissorRect]
+
+    //  - The canvas of the last frame, in canvasPixelFormat
+    //
+    private(set) var canvasTexture : MTLTexture?
 
     //===--------------------------------------------------------------------===
     // MARK: • Initilization
@@ -53,43 +113,390 @@ class Renderer {
             return nil
         }
 
-        // • Render pipeline
+        // • Render pipelines, for each canvas format
         //
-        guard let renderPipelineState =
-                library.makeRenderPipelineState(vertexFunctionName: "pattern_vertex",
-                                                fragmentFunctionName: "white_fragment",
+        guard let standardPipelineStates = DrawPipelineStates(library: library, pixelFormat: self.pixelFormat),
+              let linearPipelineStates   = DrawPipelineStates(library: library, pixelFormat: .rgba16Float) else {
+            return nil
+        }
+
+        guard let encodePipelineState =
+                library.makeRenderPipelineState(vertexFunctionName: "clear_vertex",
+                                                fragmentFunctionName: "encode_srgb_fragment",
                                                 pixelFormat: self.pixelFormat) else {
             return nil
         }
 
+        // • Culling pipeline
+        //
+        guard let cullPipelineState = library.makeComputePipelineState(functionName: "cull_instances") else {
+            return nil
+        }
+
+        // • Tile binning
+        //
+        guard let tileBinningPass = TileBinningPass(library: library) else {
+            return nil
+        }
+
+        // • Indirect draw arguments, reset from initialArgumentsBuffer before
+        //   each culling pass (see initial_draw_arguments in Culling.hpp)
+        //
+        var initialArguments = MTLDrawPrimitivesIndirectArguments( vertexCount: 4, instanceCount: 0,
+                                                                   vertexStart: 0, baseInstance: 0 )
+
+        let argumentsLength = MemoryLayout<MTLDrawPrimitivesIndirectArguments>.stride
+
+        guard let drawArgumentsBuffer =
+                library.device.makeBuffer(length: argumentsLength, options: .storageModePrivate),
+              let initialArgumentsBuffer =
+                library.device.makeBuffer(bytes: &initialArguments, length: argumentsLength,
+                                          options: .storageModeShared) else {
+            return nil
+        }
+
         // • Assign properties
         //
-        self.colorspace          = colorspace
-        self.device              = library.device
-        self.composition         = composition
-        self.renderPipelineState = renderPipelineState
+        self.colorspace             = colorspace
+        self.device                 = library.device
+        self.composition            = composition
+        self.standardPipelineStates = standardPipelineStates
+        self.linearPipelineStates   = linearPipelineStates
+        self.encodePipelineState    = encodePipelineState
+        self.cullPipelineState      = cullPipelineState
+        self.tileBinningPass        = tileBinningPass
+        self.drawArgumentsBuffer    = drawArgumentsBuffer
+        self.initialArgumentsBuffer = initialArgumentsBuffer
+        self.dirtyRects             = .init( repeating: .init(x: 0, y: 0, width: 0, height: 0),
+                                             count: Composition.maximumDirtyRectCount )
     }
 
     //===--------------------------------------------------------------------===
     // MARK: • Methods
     //
+    //  - Frames are drawn to a canvas that persists between them, and only its
+    //    dirty rects (see DirtyRegions.hpp) are redrawn before it is copied to
+    //    the output (.bgra8Unorm), or sRGB encoded to it when
+    //    isHighDynamicRange. A new canvas size or format redraws everything
+    //
+    //  - With Tracing enabled, records the encoding and, on completion, the
+    //    GPU time of the command buffer
+    //
     @discardableResult
     func draw(to outputTexture: MTLTexture, with commandBuffer: MTLCommandBuffer) -> Bool {
 
-        let clearColor = MTLClearColorMake(0.0, 0.0, 0.0, 1.0)
+        let encodeStart = Tracing.now()
+
+        defer { Tracing.recordInterval("encode frame", category: "render", start: encodeStart) }
+
+        traceGPUTime(of: commandBuffer)
+
+        guard let canvasTexture = drawCanvas(width: outputTexture.width, height: outputTexture.height,
+                                             with: commandBuffer) else {
+            return false
+        }
+
+        // • Encode a linear canvas to the output, one fragment per pixel
+        //
+        if canvasTexture.pixelFormat != outputTexture.pixelFormat {
+
+            guard let renderEncoder = commandBuffer.makeRenderCommandEncoder(to: outputTexture) else {
+                return false
+            }
+
+            renderEncoder.setRenderPipelineState(encodePipelineState)
+            renderEncoder.setFragmentTexture(canvasTexture, index: 0)
+            renderEncoder.drawPrimitives(type: .triangle, vertexStart: 0, vertexCount: 3)
+            renderEncoder.endEncoding()
+
+            return true
+        }
+
+        // • Copy the canvas to the output
+        //
+        guard let blitEncoder = commandBuffer.makeBlitCommandEncoder() else {
+            return false
+        }
+
+        blitEncoder.copy(from: canvasTexture, to: outputTexture)
+        blitEncoder.endEncoding()
+
+        return true
+    }
+
+    //  - Draws the next frame of `exporter` offscreen: the canvas, redrawn as
+    //    for draw(to:with:), is blitted into the exporter's buffer for the
+    //    frame, which its writer encodes while the next frame draws. The
+    //    canvas keeps its format, so canvasPixelFormat must be the
+    //    exporter's. Commits `commandBuffer` and waits for it to complete
+    //
+    @discardableResult
+    func export(to exporter: FrameExporter, with commandBuffer: MTLCommandBuffer) -> Bool {
 
-        guard let renderEncoder = commandBuffer.makeRenderCommandEncoder(to: outputTexture,
-                                                                         clearColor: clearColor) else {
+        guard encodeFrame(for: exporter, with: commandBuffer) else {
             return false
         }
 
-        renderEncoder.setRenderPipelineState(renderPipelineState)
-        renderEncoder.setVertexBuffer(composition.patternBuffer, offset: 0, index: 0)
+        commandBuffer.commit()
+        exporter.endFrame(after: commandBuffer)
+
+        return true
+    }
+
+    //===--------------------------------------------------------------------===
+    // MARK: • Export (Private)
+    //
+    //  - Traced as draw(to:with:) is, up to the commit
+    //
+    private func encodeFrame(for exporter: FrameExporter, with commandBuffer: MTLCommandBuffer) -> Bool {
+
+        let encodeStart = Tracing.now()
+
+        defer { Tracing.recordInterval("encode frame", category: "render", start: encodeStart) }
+
+        traceGPUTime(of: commandBuffer)
+
+        guard exporter.pixelFormat == canvasPixelFormat,
+              let canvasTexture = drawCanvas(width: exporter.width, height: exporter.height,
+                                             with: commandBuffer),
+              let blitEncoder   = commandBuffer.makeBlitCommandEncoder() else {
+            return false
+        }
+
+        // • Straight into the memory the writer reads (see FrameExporter.h)
+        //
+        let frameBuffer = exporter.beginFrame()
+
+        blitEncoder.copy( from: canvasTexture, sourceSlice: 0, sourceLevel: 0,
+                          sourceOrigin: MTLOrigin(x: 0, y: 0, z: 0),
+                          sourceSize: MTLSize(width: exporter.width, height: exporter.height, depth: 1),
+                          to: frameBuffer, destinationOffset: 0,
+                          destinationBytesPerRow: exporter.bytesPerRow,
+                          destinationBytesPerImage: exporter.bytesPerRow * exporter.height )
+        blitEncoder.endEncoding()
+
+        return true
+    }
+
+    //===--------------------------------------------------------------------===
+    // MARK: • Tracing (Private)
+    //
+    private func traceGPUTime(of commandBuffer: MTLCommandBuffer) {
+
+        if Tracing.isEnabled {
+            commandBuffer.addCompletedHandler { commandBuffer in
+                Tracing.recordInterval( "gpu frame", category: "gpu",
+                                        startTime: commandBuffer.gpuStartTime, endTime: commandBuffer.gpuEndTime )
+            }
+        }
+    }
+
+    //===--------------------------------------------------------------------===
+    // MARK: • Dirty Rects (Private)
+    //
+    //  - The canvas, with its dirty rects redrawn for `commandBuffer`
+    //
+    private func drawCanvas(width: Int, height: Int, with commandBuffer: MTLCommandBuffer) -> MTLTexture? {
+
+        guard let canvasTexture = canvas(width: width, height: height) else {
+            return nil
+        }
+
+        let targetSize = SIMD2<UInt32>( UInt32(canvasTexture.width), UInt32(canvasTexture.height) )
+        let dirtyCount = composition.takeDirtyRects(forTargetSize: targetSize, rects: &dirtyRects)
+
+        if 0 < dirtyCount && !redraw(canvasTexture, dirtyCount: dirtyCount, with: commandBuffer) {
+
+            composition.invalidate()
+            return nil
+        }
+
+        return canvasTexture
+    }
+
+    private func canvas(width: Int, height: Int) -> MTLTexture? {
+
+        if let canvasTexture, canvasTexture.width == width && canvasTexture.height == height
+                                && canvasTexture.pixelFormat == canvasPixelFormat {
+            return canvasTexture
+        }
+
+        canvasTexture = device.makeTexture2D( pixelFormat: canvasPixelFormat, width: width, height: height,
+                                              usage: [.renderTarget, .shaderRead, .shaderWrite] )
+
+        composition.invalidate()
+
+        return canvasTexture
+    }
+
+    private func redraw(_ canvasTexture: MTLTexture, dirtyCount: Int,
+                        with commandBuffer: MTLCommandBuffer) -> Bool {
+
+        // • This frame's copy of the arena, at `arenaOffset` in its buffer
+        //
+        var arenaOffset = 0
+
+        guard let arenaBuffer = composition.arenaBuffer(for: commandBuffer, offset: &arenaOffset) else {
+            return false
+        }
+
+        // • Tiled: every pixel of the canvas, once
+        //
+        let targetSize = SIMD2<UInt32>( UInt32(canvasTexture.width), UInt32(canvasTexture.height) )
+
+        if isTiled && !isAntialiased && tileBinningPass.canBin(composition, targetSize: targetSize) {
+            return tileBinningPass.encode( arenaBuffer: arenaBuffer, arenaOffset: arenaOffset,
+                                           composition: composition, to: canvasTexture, with: commandBuffer )
+        }
+
+        let instanceCount = composition.instanceCount
+
+        // • Cull the instances outside the viewport, leaving the indices of the
+        //   visible ones and the arguments for drawing them
+        //
+        if 0 < instanceCount && !cull(arenaBuffer, arenaOffset: arenaOffset, instanceCount: instanceCount,
+                                      with: commandBuffer) {
+            return false
+        }
+
+        guard let renderEncoder = commandBuffer.makeRenderCommandEncoder(loadingContentsOf: canvasTexture) else {
+            return false
+        }
+
+        // • Each dirty rect: clear it, then draw the visible instances of all
+        //   patterns over it with one indirect instanced draw
+        //
+        var targetSizeValue = targetSize
+
+        let pipelineStates = (.rgba16Float == canvasTexture.pixelFormat) ? linearPipelineStates
+                                                                         : standardPipelineStates
+
+        for dirtyRect in dirtyRects.prefix(dirtyCount) {
+
+            renderEncoder.setScissorRect(dirtyRect)
+
+            renderEncoder.setRenderPipelineState(pipelineStates.clear)
+            renderEncoder.drawPrimitives(type: .triangle, vertexStart: 0, vertexCount: 3)
+
+            if 0 < instanceCount, let visibleInstancesBuffer {
+
+                renderEncoder.setRenderPipelineState(isAntialiased ? pipelineStates.coverage : pipelineStates.render)
+                renderEncoder.setVertexBuffer(arenaBuffer, offset: arenaOffset, index: 0)
+                renderEncoder.setVertexBuffer(visibleInstancesBuffer, offset: 0, index: 1)
+
+                if isAntialiased {
+                    renderEncoder.setVertexBytes(&targetSizeValue, length: MemoryLayout<SIMD2<UInt32>>.stride, index: 2)
+                }
+
+                renderEncoder.drawPrimitives( type: .triangleStrip, indirectBuffer: drawArgumentsBuffer,
+                                              indirectBufferOffset: 0 )
+            }
+        }
 
-        renderEncoder.drawPrimitives( type: .triangleStrip, vertexStart: 0, vertexCount: 4,
-                                      instanceCount: composition.instanceCount )
         renderEncoder.endEncoding()
 
         return true
     }
+
+    //===--------------------------------------------------------------------===
+    // MARK: • Culling (Private)
+    //
+    private func cull(_ arenaBuffer: MTLBuffer, arenaOffset: Int, instanceCount: Int,
+                      with commandBuffer: MTLCommandBuffer) -> Bool {
+
+        let encodeStart = Tracing.now()
+
+        defer { Tracing.recordInterval("encode cull", category: "render", start: encodeStart) }
+
+        // • Room for every instance, grown only as the composition grows
+        //
+        let visibleLength = instanceCount * MemoryLayout<UInt32>.stride
+
+        if (visibleInstancesBuffer?.length ?? 0) < visibleLength {
+
+            guard let buffer = device.makeBuffer(length: visibleLength, options: .storageModePrivate) else {
+                return false
+            }
+
+            visibleInstancesBuffer = buffer
+        }
+
+        guard let visibleInstancesBuffer,
+              let blitEncoder = commandBuffer.makeBlitCommandEncoder() else {
+            return false
+        }
+
+        blitEncoder.copy( from: initialArgumentsBuffer, sourceOffset: 0,
+                          to: drawArgumentsBuffer, destinationOffset: 0,
+                          size: initialArgumentsBuffer.length )
+        blitEncoder.endEncoding()
+
+        guard let computeEncoder = commandBuffer.makeComputeCommandEncoder() else {
+            return false
+        }
+
+        var viewport = self.viewport
+
+        computeEncoder.setComputePipelineState(cullPipelineState)
+        computeEncoder.setBuffer(arenaBuffer, offset: arenaOffset, index: 0)
+        computeEncoder.setBytes(&viewport, length: MemoryLayout<SIMD4<Float>>.stride, index: 1)
+        computeEncoder.setBuffer(drawArgumentsBuffer, offset: 0, index: 2)
+        computeEncoder.setBuffer(visibleInstancesBuffer, offset: 0, index: 3)
+
+        // • Whole SIMD groups, so that every lane takes part in the prefix sum
+        //
+        let threadsPerThreadgroup = cullPipelineState.simdGroup1DThreadsSize()
+        let threadgroupWidth      = threadsPerThreadgroup.width
+        let threadgroups          = MTLSize( width: (instanceCount + threadgroupWidth - 1) / threadgroupWidth,
+                                             height: 1, depth: 1 )
+
+        computeEncoder.dispatchThreadgroups(threadgroups, threadsPerThreadgroup: threadsPerThreadgroup)
+        computeEncoder.endEncoding()
+
+        return true
+    }
+}
+
+//===------------------------------------------------------------------------===
+//
+// MARK: - DrawPipelineStates
+//
+//  - The pipelines drawing instances into a canvas of one pixel format
+//
+//===------------------------------------------------------------------------===
+
+private struct DrawPipelineStates {
+
+    let render   : MTLRenderPipelineState
+    let coverage : MTLRenderPipelineState
+    let clear    : MTLRenderPipelineState
+
+    init?(library: MTLLibrary, pixelFormat: MTLPixelFormat) {
+
+        guard let render =
+                library.makeRenderPipelineState(vertexFunctionName: "culled_pattern_vertex",
+                                                fragmentFunctionName: "white_fragment",
+                                                pixelFormat: pixelFormat) else {
+            return nil
+        }
+
+        guard let coverage =
+                library.makeRenderPipelineState(vertexFunctionName: "culled_coverage_vertex",
+                                                fragmentFunctionName: "coverage_fragment",
+                                                pixelFormat: pixelFormat,
+                                                isBlendingEnabled: true) else {
+            return nil
+        }
+
+        guard let clear =
+                library.makeRenderPipelineState(vertexFunctionName: "clear_vertex",
+                                                fragmentFunctionName: "black_fragment",
+                                                pixelFormat: pixelFormat) else {
+            return nil
+        }
+
+        self.render   = render
+        self.coverage = coverage
+        self.clear    = clear
+    }
 }
@@ -0,0 +1,353 @@
+//
+//  Scene.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Composition/Scene.hpp>
+#include <Data/BumpAllocator.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//===------------------------------------------------------------------------===
+// • Validation (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+template <TRIVIAL_LAYOUT Type_>
+SceneStatus validate_vector(const data::vector<Type_>& elements, uint32_t arena_size)
+{
+    if (!data::is_aligned(elements.offset)) {
+        return SceneStatus::misaligned;
+    }
+
+    const auto end = static_cast<uint64_t>(elements.offset)
+                   + static_cast<uint64_t>(elements.capacity)*sizeof(Type_);
+
+    if (elements.offset < data::aligned_size<Arena>() || arena_size < end) {
+        return SceneStatus::out_of_bounds;
+    }
+
+    if (elements.capacity < elements.count) {
+        return SceneStatus::inconsistent;
+    }
+
+    return SceneStatus::valid;
+}
+
+const SceneHeader& header_of(const void* data)
+{
+    return *static_cast<const SceneHeader*>(data);
+}
+
+const Arena& arena_of(const void* data)
+{
+    return *data::offset_by<Arena>( &header_of(data), header_of(data).arena.offset );
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Validation
+//===------------------------------------------------------------------------===
+
+SceneStatus validate_scene(const void* data, size_t size)
+{
+    // • Header
+    //
+    if (size < sizeof(SceneHeader)) {
+        return SceneStatus::truncated;
+    }
+
+    if (!data::is_aligned(data)) {
+        return SceneStatus::misaligned;
+    }
+
+    const auto& header = header_of(data);
+
+    if (scene_magic != header.magic) {
+        return SceneStatus::bad_magic;
+    }
+
+    if (scene_version != header.version) {
+        return SceneStatus::unsupported_version;
+    }
+
+    if (size < header.size) {
+        return SceneStatus::truncated;
+    }
+
+    // • Arena
+    //
+    if (!data::is_aligned(header.arena.offset) || !data::is_aligned(header.arena_size)) {
+        return SceneStatus::misaligned;
+    }
+
+    const auto arena_end = static_cast<uint64_t>(header.arena.offset) + header.arena_size;
+
+    if ( header.arena.offset < data::aligned_size<SceneHeader>()
+         || header.arena_size < data::aligned_size<Arena>()
+         || header.size < arena_end ) {
+
+        return SceneStatus::out_of_bounds;
+    }
+
+    // • Tables
+    //
+    const auto& arena = arena_of(data);
+
+    if (const auto status = validate_vector(arena.patterns, header.arena_size);
+        SceneStatus::valid != status) {
+
+        return status;
+    }
+
+    if (const auto status = validate_vector(arena.first_instances, header.arena_size);
+        SceneStatus::valid != status) {
+
+        return status;
+    }
+
+    if (const auto status = validate_vector(arena.transforms, header.arena_size);
+        SceneStatus::valid != status) {
+
+        return status;
+    }
+
+    if (const auto status = validate_vector(arena.nested_patterns, header.arena_size);
+        SceneStatus::valid != status) {
+
+        return status;
+    }
+
+    if (arena.patterns.count != arena.first_instances.count || arena.patterns.count != arena.transforms.count) {
+        return SceneStatus::inconsistent;
+    }
+
+    return SceneStatus::valid;
+}
+
+SceneStatus validate_records(const void* data, size_t size)
+{
+    if (const auto status = validate_scene(data, size); SceneStatus::valid != status) {
+        return status;
+    }
+
+    const auto& arena     = arena_of(data);
+    const auto  records   = patterns(arena);
+    const auto  first     = first_instances(arena);
+    const auto  transform = transforms(arena);
+
+    const auto  nested    = nested_patterns(arena);
+
+    // • Each nested pattern may only nest one before it
+    //
+    for (uint32_t index = 0; index < arena.nested_patterns.count; ++index) {
+
+        if (PatternError::none != validate(nested[index]) || !is_valid_nesting(arena, nested[index], index)) {
+            return SceneStatus::inconsistent;
+        }
+    }
+
+    uint64_t instance_count = 0;
+
+    for (uint32_t index = 0; index < arena.patterns.count; ++index) {
+
+        if (first[index] != instance_count) {
+            return SceneStatus::inconsistent;
+        }
+
+        if ( !(transform[index] == geometry::make_device_transform(records[index].grid_size)) ) {
+            return SceneStatus::inconsistent;
+        }
+
+        if ( !is_valid_record(records[index])
+             || !is_valid_nesting(arena, records[index], arena.nested_patterns.count) ) {
+            return SceneStatus::inconsistent;
+        }
+
+        instance_count += ::instance_count(records, records[index]);
+
+        if (std::numeric_limits<uint32_t>::max() < instance_count) {
+            return SceneStatus::inconsistent;
+        }
+    }
+
+    if (instance_count != arena.instance_count) {
+        return SceneStatus::inconsistent;
+    }
+
+    return SceneStatus::valid;
+}
+
+//===------------------------------------------------------------------------===
+// • Writing
+//===------------------------------------------------------------------------===
+
+uint32_t scene_size(const Arena& arena)
+{
+    return data::aligned_size<SceneHeader>() + arena_size(arena.patterns.count, arena.nested_patterns.count);
+}
+
+bool write_scene(const Arena& arena, void* memory, uint32_t size)
+{
+    const auto required = scene_size(arena);
+
+    if (size < required) {
+        return false;
+    }
+
+    data::BumpAllocator allocator(memory, required);
+
+    const auto header         = allocator.allocate<SceneHeader>();
+    const auto arena_capacity = arena.patterns.count;
+    const auto nested_count   = arena.nested_patterns.count;
+    const auto arena_offset   = allocator.allocate( arena_size(arena_capacity, nested_count) );
+
+    if (!header || !arena_offset) {
+        return false;
+    }
+
+    const auto scene_arena = make_arena(allocator.data() + *arena_offset, arena_capacity, nested_count);
+
+    if (nullptr == scene_arena || !copy_arena(*scene_arena, arena)) {
+        return false;
+    }
+
+    *allocator.at(*header) = {
+        .magic      = scene_magic,
+        .version    = scene_version,
+        .size       = required,
+        .arena_size = arena_size(arena_capacity, nested_count),
+        .arena      = { *arena_offset },
+        .reserved   = { 0, 0, 0 }
+    };
+
+    return true;
+}
+
+bool write_scene(const Arena& arena, const char* path)
+{
+    const auto size = scene_size(arena);
+
+    std::unique_ptr<void, decltype(&std::free)> memory { std::aligned_alloc(data::alignment, size),
+                                                        &std::free };
+
+    if (nullptr == memory || !write_scene(arena, memory.get(), size)) {
+        return false;
+    }
+
+    const auto file = std::fopen(path, "wb");
+
+    if (nullptr == file) {
+        return false;
+    }
+
+    const auto did_write = (1 == std::fwrite(memory.get(), size, 1, file));
+
+    return 0 == std::fclose(file) && did_write;
+}
+
+//===------------------------------------------------------------------------===
+// • MappedScene
+//===------------------------------------------------------------------------===
+
+std::optional<MappedScene> MappedScene::open(const char* path, SceneStatus* status)
+{
+    const auto report = [status](SceneStatus value) {
+        if (nullptr != status) {
+            *status = value;
+        }
+    };
+
+    const auto descriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+
+    if (descriptor < 0) {
+        return std::nullopt;
+    }
+
+    struct stat file_status;
+
+    if (0 != ::fstat(descriptor, &file_status) || file_status.st_size < 1) {
+
+        ::close(descriptor);
+        report(SceneStatus::truncated);
+
+        return std::nullopt;
+    }
+
+    const auto length  = static_cast<size_t>(file_status.st_size);
+    const auto mapping = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, descriptor, 0);
+
+    // • The mapping keeps the file open
+    //
+    ::close(descriptor);
+
+    if (MAP_FAILED == mapping) {
+        return std::nullopt;
+    }
+
+    const auto validation = validate_scene(mapping, length);
+
+    report(validation);
+
+    if (SceneStatus::valid != validation) {
+
+        ::munmap(mapping, length);
+        return std::nullopt;
+    }
+
+    return MappedScene { mapping, length };
+}
+
+MappedScene::MappedScene(MappedScene&& other) noexcept
+    : mapping { std::exchange(other.mapping, nullptr) },
+      length  { std::exchange(other.length, 0) }
+{
+}
+
+MappedScene& MappedScene::operator = (MappedScene&& other) noexcept
+{
+    if (this != &other) {
+
+        if (nullptr != mapping) {
+            ::munmap(mapping, length);
+        }
+
+        mapping = std::exchange(other.mapping, nullptr);
+        length  = std::exchange(other.length, 0);
+    }
+
+    return *this;
+}
+
+MappedScene::~MappedScene()
+{
+    if (nullptr != mapping) {
+        ::munmap(mapping, length);
+    }
+}
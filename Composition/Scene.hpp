@@ -0,0 +1,159 @@
+//
+//  Scene.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Arena.hpp>
+#include <Data/Layout.hpp>
+
+#include <bit>
+#include <cstddef>
+#include <optional>
+
+//===------------------------------------------------------------------------===
+//
+// • Scene file
+//
+//  - The file is the in-memory arena preceded by a header, so it is used
+//    directly from a read-only mapping without parsing:
+//
+//    [ SceneHeader | Arena | Pattern[count] | uint32_t first_instances[count] |
+//      DeviceTransform transforms[count] | Pattern nested[nested_count] ]
+//
+//  - Every offset is 16-byte aligned. All values are little-endian, so the
+//    file is only mapped on little-endian hosts
+//
+//  - Version 2 added the transforms, and version 3 the row and nesting
+//    fields of Pattern and the nested patterns. Earlier files are rejected,
+//    since a mapped scene is drawn without copying and so cannot be
+//    converted
+//
+//===------------------------------------------------------------------------===
+
+struct SceneHeader
+{
+    uint32_t                magic;
+    uint32_t                version;
+    uint32_t                size;           // of the whole file
+    uint32_t                arena_size;
+    data::Reference<Arena>  arena;          // from the start of the file
+    uint32_t                reserved[3];
+};
+
+static_assert( data::is_trivial_layout<SceneHeader>(), "Unexpected layout" );
+static_assert( data::is_aligned( data::aligned_size<SceneHeader>() ), "Unexpected size" );
+static_assert( std::endian::little == std::endian::native, "Scene files are mapped as little-endian" );
+
+enum : uint32_t
+{
+    scene_magic   = 0x53594c50,    // "PLYS"
+    scene_version = 3
+};
+
+//===------------------------------------------------------------------------===
+// • Validation
+//===------------------------------------------------------------------------===
+
+enum class SceneStatus
+{
+    valid,
+    truncated,
+    bad_magic,
+    unsupported_version,
+    misaligned,
+    out_of_bounds,
+    inconsistent
+};
+
+// • Header, arena and table bounds and alignment. Constant time, so opening
+//   a scene does not depend on its size
+//
+SceneStatus validate_scene(const void* data, size_t size);
+
+// • Additionally checks that every pattern is valid (see validate and
+//   is_valid_record), that first_instances and instance_count agree with
+//   the pattern counts, transforms with the grid sizes, and that nested
+//   references are valid (see is_valid_nesting). Linear in the number of
+//   patterns. Nested references are followed, so run this before drawing
+//   a scene from an untrusted file
+//
+SceneStatus validate_records(const void* data, size_t size);
+
+//===------------------------------------------------------------------------===
+// • Writing
+//===------------------------------------------------------------------------===
+
+// • Bytes needed to write `arena`, whose capacity is trimmed to its count
+//
+uint32_t scene_size(const Arena& arena);
+
+// • Write a scene into `memory` (16-byte aligned, scene_size bytes)
+//
+bool write_scene(const Arena& arena, void* memory, uint32_t size);
+
+bool write_scene(const Arena& arena, const char* path);
+
+//===------------------------------------------------------------------------===
+// • MappedScene
+//
+//  - Read-only, shared mapping of a scene file. Processes mapping the same
+//    file share its pages through the page cache
+//
+//===------------------------------------------------------------------------===
+
+class MappedScene
+{
+public:
+
+    static std::optional<MappedScene> open(const char* path, SceneStatus* status = nullptr);
+
+    MappedScene(const MappedScene&) = delete;
+    MappedScene& operator = (const MappedScene&) = delete;
+
+    MappedScene(MappedScene&& other) noexcept;
+    MappedScene& operator = (MappedScene&& other) noexcept;
+
+    ~MappedScene();
+
+    const SceneHeader& header(void) const noexcept
+    {
+        return *static_cast<const SceneHeader*>(mapping);
+    }
+
+    const Arena& arena(void) const noexcept
+    {
+        return *data::offset_by<Arena>( &header(), header().arena.offset );
+    }
+
+    size_t size(void) const noexcept
+    {
+        return length;
+    }
+
+private:
+
+    MappedScene(void* mapping, size_t length) noexcept
+        : mapping { mapping },
+          length  { length }
+    {
+    }
+
+    void*   mapping;
+    size_t  length;
+};
@@ -17,7 +17,10 @@
 //  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 //
 
+#include <Composition/Arena.hpp>
+#include <Composition/Culling.hpp>
 #include <Composition/Pattern.hpp>
+#include <Composition/Tiles.hpp>
 #include <metal_stdlib>
 
 using namespace geometry;
@@ -33,22 +36,215 @@ using namespace metal;
 }
 
 //===------------------------------------------------------------------------===
-// • pattern_vertex
+// • Clearing a dirty region
+//
+//  - A triangle covering the whole target, limited to the dirty region by the
+//    scissor rect, filled with the clear color of a full draw
+//===------------------------------------------------------------------------===
+
+[[vertex]] float4 clear_vertex(uint vid [[ vertex_id ]])
+{
+    // • (-1, -1), (3, -1), (-1, 3): the target is the square inside it
+    //
+    const auto x = (1 == vid) ? 3.0f : -1.0f;
+    const auto y = (2 == vid) ? 3.0f : -1.0f;
+
+    return { x, y, 0.0f, 1.0f };
+}
+
+[[fragment]] half4 black_fragment(void)
+{
+    return { 0.0h, 0.0h, 0.0h, 1.0h };
+}
+
+//===------------------------------------------------------------------------===
+// • Presenting an .rgba16Float canvas
+//
+//  - clear_vertex over the whole .bgra8Unorm output, reading the canvas
+//    pixel under each fragment and sRGB encoding it (see
+//    pixels::encode_srgb), as the host does for an 8-bit preview
+//===------------------------------------------------------------------------===
+
+static float encode_srgb(float linear)
+{
+    return (linear <= 0.0031308f) ? 12.92f * linear : 1.055f * powr(linear, 1.0f / 2.4f) - 0.055f;
+}
+
+[[fragment]] half4 encode_srgb_fragment(float4                         position [[ position   ]],
+                                        texture2d<half, access::read>  canvas   [[ texture(0) ]])
+{
+    const auto linear = saturate( float4( canvas.read( uint2(position.xy) ) ) );
+
+    return half4( encode_srgb(linear.r), encode_srgb(linear.g), encode_srgb(linear.b), linear.a );
+}
+
 //===------------------------------------------------------------------------===
+// • Arena utilities
+//===------------------------------------------------------------------------===
+
+// • Index of the pattern drawing instance `iid`: the last pattern whose first
+//   instance is not after it, which skips removed patterns (no instances)
+//
+static uint32_t pattern_index(const device Arena& arena, uint32_t iid)
+{
+    const auto first_instances = data::offset_by<uint32_t>(&arena, arena.first_instances.offset);
+
+    uint32_t lower = 0;
+    uint32_t upper = arena.patterns.count;
+
+    while (1 < upper - lower)
+    {
+        const auto middle = (lower + upper) / 2;
 
-[[vertex]] float4 pattern_vertex(constant Pattern& pattern [[ buffer(0)   ]],
-                                 ushort            vid     [[ vertex_id   ]],
-                                 ushort            iid     [[ instance_id ]])
+        if (iid < first_instances[middle]) {
+            upper = middle;
+        } else {
+            lower = middle;
+        }
+    }
+
+    return lower;
+}
+
+// • Displacement of cell `cell` of `pattern`: column and row by one
+//   division
+//
+static int2 cell_offset(const device Pattern& pattern, uint32_t cell)
 {
-    // • Clockwise quad triangle strip
+    const auto column = static_cast<int>(cell % pattern.count);
+    const auto row    = static_cast<int>(cell / pattern.count);
+
+    return pattern.offset * column + pattern.row_offset * row;
+}
+
+// • Region of instance `iid`, with the index of its pattern. Each level of
+//   nesting (see Pattern.hpp) takes one division for the cell and one for
+//   the cell's row, so the cost is bounded by max_pattern_depth
+//
+static geometry::Region instance_region(const device Arena& arena, uint32_t iid, thread uint32_t& index)
+{
+    const auto patterns = data::offset_by<Pattern>(&arena, arena.patterns.offset);
+    const auto first    = data::offset_by<uint32_t>(&arena, arena.first_instances.offset);
+
+    index = pattern_index(arena, iid);
+
+    // • The pattern and those nested in it, with the instances of each of
+    //   their cells
+    //
+    const device Pattern* levels[max_pattern_depth];
+    uint32_t              instances[max_pattern_depth];
+    uint32_t              depth = 0;
+
+    for ( auto level = &patterns[index]; depth < max_pattern_depth;
+          level = data::offset_by<Pattern>(patterns, level->nested) ) {
+
+        levels[depth++] = level;
+
+        if (0 == level->nested) {
+            break;
+        }
+    }
+
+    instances[depth - 1] = 1;
+
+    for (auto level = depth - 1; 0 < level; --level) {
+        instances[level - 1] = instances[level] * levels[level]->count * max(levels[level]->row_count, 1u);
+    }
+
+    // • Cell of each level from the outside in, each relative to the last
     //
-    //  1   3
-    //  | \ |
-    //  0   2
+    auto instance = iid - first[index];
+    auto origin   = int2(0, 0);
+
+    for (uint32_t level = 0; level + 1 < depth; ++level) {
+
+        const device Pattern& pattern = *levels[level];
+
+        const auto cell = instance / instances[level];
+
+        const auto corner = int2( static_cast<int>(pattern.base_region.left), static_cast<int>(pattern.base_region.top) );
+
+        origin  += corner + cell_offset(pattern, cell);
+        instance = instance % instances[level];
+    }
+
+    const device Pattern& leaf = *levels[depth - 1];
+
+    return leaf.base_region + (origin + cell_offset(leaf, instance));
+}
+
+//===------------------------------------------------------------------------===
+// • cull_instances
+//
+//  - One thread per instance of the arena. Each SIMD group counts its visible
+//    instances, reserves that many slots with a single atomic add to the
+//    instance_count of the indirect draw arguments, and writes the indices of
+//    its visible instances to consecutive slots
+//
+//  - Order is kept within a SIMD group but not between groups. Instances are
+//    drawn with the same opaque color, so the image does not depend on it
+//
+//  - draw_arguments must hold initial_draw_arguments() before the pass
+//
+//===------------------------------------------------------------------------===
+
+[[kernel]] void cull_instances(const device Arena&          arena             [[ buffer(0) ]],
+                               constant TextureRect&        viewport          [[ buffer(1) ]],
+                               device atomic_uint*          draw_arguments    [[ buffer(2) ]],
+                               device uint32_t*             visible_instances [[ buffer(3) ]],
+                               uint                         iid               [[ thread_position_in_grid ]])
+{
+    // • Every thread of the group takes part in the SIMD operations, so those
+    //   past the last instance are simply not visible
     //
-    const auto offset  = pattern.offset * iid;
-    const auto region  = pattern.base_region + offset;
-    const auto rect    = geometry::make_device_rect(region, pattern.grid_size);
+    auto is_instance_visible = false;
+
+    if (iid < arena.instance_count)
+    {
+        const auto patterns = data::offset_by<Pattern>(&arena, arena.patterns.offset);
+
+        uint32_t   index  = 0;
+        const auto region = instance_region(arena, iid, index);
+
+        is_instance_visible = is_visible(region, patterns[index].grid_size, viewport);
+    }
+
+    const auto visible = static_cast<uint32_t>(is_instance_visible);
+    const auto slot    = simd_prefix_exclusive_sum(visible);
+    const auto total   = simd_sum(visible);
+
+    uint32_t first = 0;
+
+    if (simd_is_first())
+    {
+        first = atomic_fetch_add_explicit( &draw_arguments[draw_arguments_instance_count_index],
+                                           total, memory_order_relaxed );
+    }
+
+    first = simd_broadcast_first(first);
+
+    if (is_instance_visible) {
+        visible_instances[first + slot] = iid;
+    }
+}
+
+//===------------------------------------------------------------------------===
+// • pattern_vertex
+//===------------------------------------------------------------------------===
+
+// • Clockwise quad triangle strip
+//
+//  1   3
+//  | \ |
+//  0   2
+//
+static float4 instance_vertex(const device Arena& arena, uint32_t vid, uint32_t iid)
+{
+    const auto transforms = data::offset_by<DeviceTransform>(&arena, arena.transforms.offset);
+
+    uint32_t   index  = 0;
+    const auto region = instance_region(arena, iid, index);
+    const auto rect   = geometry::make_device_rect(region, transforms[index]);
 
     const auto is_left = 0 != (vid & 0b10);
     const auto nx      = is_left ? rect.left : rect.right;
@@ -58,3 +254,311 @@ using namespace metal;
 
     return { nx, ny, 0.0f, 1.0f };
 }
+
+[[vertex]] float4 pattern_vertex(const device Arena& arena [[ buffer(0)   ]],
+                                 uint                vid   [[ vertex_id   ]],
+                                 uint                iid   [[ instance_id ]])
+{
+    return instance_vertex(arena, vid, iid);
+}
+
+// • After cull_instances: instance `iid` of the indirect draw is the visible
+//   instance visible_instances[iid]
+//
+[[vertex]] float4 culled_pattern_vertex(const device Arena&    arena             [[ buffer(0)   ]],
+                                        const device uint32_t* visible_instances [[ buffer(1)   ]],
+                                        uint                   vid               [[ vertex_id   ]],
+                                        uint                   iid               [[ instance_id ]])
+{
+    return instance_vertex(arena, vid, visible_instances[iid]);
+}
+
+//===------------------------------------------------------------------------===
+//
+// • Analytic coverage (see raster::Coverage)
+//
+//  - culled_coverage_vertex widens each instance by half a pixel, so that
+//    every pixel it covers any part of gets a fragment, and passes on its
+//    rect in pixels. coverage_fragment returns the fraction of its pixel the
+//    rect covers as alpha, blended over the target (source alpha, one minus
+//    source alpha): antialiased edges from a single sample per pixel
+//
+//===------------------------------------------------------------------------===
+
+struct CoverageVertex
+{
+    float4 position [[ position ]];
+    float4 pixels   [[ flat ]];     // Rectangle in pixels: left, top, right, bottom
+};
+
+static CoverageVertex coverage_vertex(const device Arena& arena, uint2 target_size, uint32_t vid, uint32_t iid)
+{
+    const auto patterns   = data::offset_by<Pattern>(&arena, arena.patterns.offset);
+    const auto transforms = data::offset_by<DeviceTransform>(&arena, arena.transforms.offset);
+
+    uint32_t   index  = 0;
+    const auto region = instance_region(arena, iid, index);
+    const auto rect   = geometry::make_device_rect(region, transforms[index]);
+    const auto pixels = geometry::make_pixel_rectangle(region, patterns[index].grid_size, target_size);
+
+    // • Half a pixel in device coordinates, which span two units
+    //
+    const auto half_pixel = 1.0f / float2(target_size);
+
+    const auto is_left = 0 != (vid & 0b10);
+    const auto nx      = is_left ? rect.left - half_pixel.x : rect.right + half_pixel.x;
+
+    const auto is_top  = 0 != (vid & 0b01);
+    const auto ny      = is_top ? rect.top + half_pixel.y : rect.bottom - half_pixel.y;
+
+    return {
+        .position = { nx, ny, 0.0f, 1.0f },
+        .pixels   = { pixels.left, pixels.top, pixels.right, pixels.bottom }
+    };
+}
+
+[[vertex]] CoverageVertex culled_coverage_vertex(const device Arena&    arena             [[ buffer(0)   ]],
+                                                 const device uint32_t* visible_instances [[ buffer(1)   ]],
+                                                 constant uint2&        target_size       [[ buffer(2)   ]],
+                                                 uint                   vid               [[ vertex_id   ]],
+                                                 uint                   iid               [[ instance_id ]])
+{
+    return coverage_vertex(arena, target_size, vid, visible_instances[iid]);
+}
+
+[[fragment]] half4 coverage_fragment(CoverageVertex in [[ stage_in ]])
+{
+    const Rectangle pixels = { in.pixels.x, in.pixels.y, in.pixels.z, in.pixels.w };
+
+    const auto coverage = geometry::pixel_coverage( pixels, uint2(in.position.xy) );
+
+    return { 1.0h, 1.0h, 1.0h, static_cast<half>(coverage) };
+}
+
+//===------------------------------------------------------------------------===
+//
+// • Tiled mode (see Tiles.hpp)
+//
+//  - bin_count_instances and bin_fill_instances list each instance in the
+//    tiles its covered pixels touch, with scan_tile_counts between them
+//    turning counts into offsets; shade_tiles then writes each pixel once.
+//    Within a tile, instances are listed in no particular order, which the
+//    single fill color does not depend on
+//
+//===------------------------------------------------------------------------===
+
+// • Pixels whose centres the instance covers, in fixed point as on the host
+//   (geometry::covered_pixels), so that every backend places edges alike
+//
+static geometry::Region instance_pixels(const device Arena& arena, uint32_t iid, uint2 target_size)
+{
+    const auto patterns = data::offset_by<Pattern>(&arena, arena.patterns.offset);
+
+    uint32_t   index  = 0;
+    const auto region = instance_region(arena, iid, index);
+
+    return geometry::covered_pixels(region, patterns[index].grid_size, target_size);
+}
+
+// • Add to a sum kept in two words (see TileCounters): a carry out of the
+//   low word adds one to the high word
+//
+static void add_wide(device atomic_uint* counters, uint32_t index, uint32_t value)
+{
+    const auto low = atomic_fetch_add_explicit(&counters[index], value, memory_order_relaxed);
+
+    if (low + value < low) {
+        atomic_fetch_add_explicit(&counters[index + 1], 1, memory_order_relaxed);
+    }
+}
+
+[[kernel]] void bin_count_instances(const device Arena&  arena       [[ buffer(0) ]],
+                                    constant uint2&      target_size [[ buffer(1) ]],
+                                    device atomic_uint*  tile_counts [[ buffer(2) ]],
+                                    device atomic_uint*  counters    [[ buffer(3) ]],
+                                    uint                 iid         [[ thread_position_in_grid ]])
+{
+    if (arena.instance_count <= iid) {
+        return;
+    }
+
+    const auto pixels = instance_pixels(arena, iid, target_size);
+
+    if (geometry::is_empty(pixels)) {
+        return;
+    }
+
+    const auto tiles = tile_counts(target_size);
+    const auto range = tile_range(pixels);
+
+    for (auto y = range.first.y; y <= range.last.y; ++y) {
+        for (auto x = range.first.x; x <= range.last.x; ++x) {
+            atomic_fetch_add_explicit(&tile_counts[y * tiles.x + x], 1, memory_order_relaxed);
+        }
+    }
+
+    atomic_fetch_add_explicit( &counters[tile_counter_instance_count], 1, memory_order_relaxed );
+
+    add_wide( counters, tile_counter_bin_entries, tile_range_count(range) );
+    add_wide( counters, tile_counter_instance_pixels, geometry::width(pixels) * geometry::height(pixels) );
+}
+
+// • One threadgroup: exclusive prefix sum of tile_counts into tile_offsets
+//   (tile_count + 1 of them) and tile_cursors, a block of threads at a time
+//
+[[kernel]] void scan_tile_counts(const device uint32_t* tile_counts  [[ buffer(0) ]],
+                                 device uint32_t*       tile_offsets [[ buffer(1) ]],
+                                 device uint32_t*       tile_cursors [[ buffer(2) ]],
+                                 constant uint32_t&     tile_count   [[ buffer(3) ]],
+                                 uint                   tid          [[ thread_index_in_threadgroup ]],
+                                 uint                   block_size   [[ threads_per_threadgroup ]],
+                                 uint                   simd_lane    [[ thread_index_in_simdgroup ]],
+                                 uint                   simd_group   [[ simdgroup_index_in_threadgroup ]])
+{
+    threadgroup uint32_t simd_offsets[32];
+    threadgroup uint32_t block_total;
+
+    uint32_t carry = 0;
+
+    for (uint32_t base = 0; base < tile_count; base += block_size)
+    {
+        const auto index = base + tid;
+        const auto value = (index < tile_count) ? tile_counts[index] : 0u;
+        const auto total = simd_sum(value);
+
+        if (0 == simd_lane) {
+            simd_offsets[simd_group] = total;
+        }
+
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+
+        // • Offsets of the SIMD groups within the block
+        //
+        if (0 == simd_group)
+        {
+            const auto group_count = (block_size + 31) / 32;
+            const auto group_total = (simd_lane < group_count) ? simd_offsets[simd_lane] : 0u;
+
+            simd_offsets[simd_lane] = simd_prefix_exclusive_sum(group_total);
+
+            if (0 == simd_lane) {
+                block_total = simd_sum(group_total);
+            }
+        }
+
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+
+        if (index < tile_count)
+        {
+            const auto offset = carry + simd_offsets[simd_group] + simd_prefix_exclusive_sum(value);
+
+            tile_offsets[index] = offset;
+            tile_cursors[index] = offset;
+        }
+
+        carry += block_total;
+
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+    }
+
+    if (0 == tid) {
+        tile_offsets[tile_count] = carry;
+    }
+}
+
+[[kernel]] void bin_fill_instances(const device Arena&  arena          [[ buffer(0) ]],
+                                   constant uint2&      target_size    [[ buffer(1) ]],
+                                   device atomic_uint*  tile_cursors   [[ buffer(2) ]],
+                                   device uint32_t*     tile_entries   [[ buffer(3) ]],
+                                   constant uint32_t&   entry_capacity [[ buffer(4) ]],
+                                   device atomic_uint*  counters       [[ buffer(5) ]],
+                                   uint                 iid            [[ thread_position_in_grid ]])
+{
+    if (arena.instance_count <= iid) {
+        return;
+    }
+
+    const auto pixels = instance_pixels(arena, iid, target_size);
+
+    if (geometry::is_empty(pixels)) {
+        return;
+    }
+
+    const auto tiles = tile_counts(target_size);
+    const auto range = tile_range(pixels);
+
+    for (auto y = range.first.y; y <= range.last.y; ++y) {
+        for (auto x = range.first.x; x <= range.last.x; ++x) {
+
+            const auto slot = atomic_fetch_add_explicit( &tile_cursors[y * tiles.x + x], 1,
+                                                         memory_order_relaxed );
+
+            // • Past the capacity only if tile_entry_bound was exceeded; those
+            //   entries are dropped rather than written out of bounds, and
+            //   counted so that the host grows the buffer (TileBinningPass)
+            //
+            if (slot < entry_capacity) {
+                tile_entries[slot] = iid;
+            } else {
+                atomic_fetch_add_explicit(&counters[tile_counter_dropped_entries], 1, memory_order_relaxed);
+            }
+        }
+    }
+}
+
+// • One threadgroup of tile_size x tile_size threads per tile, one thread
+//   per pixel. The threads load the covered pixels of the tile's instances
+//   into threadgroup memory a block at a time, then each tests its pixel
+//   against the block
+//
+[[kernel]] void shade_tiles(const device Arena&          arena          [[ buffer(0) ]],
+                            constant uint2&              target_size    [[ buffer(1) ]],
+                            const device uint32_t*       tile_offsets   [[ buffer(2) ]],
+                            const device uint32_t*       tile_entries   [[ buffer(3) ]],
+                            constant uint32_t&           entry_capacity [[ buffer(4) ]],
+                            device atomic_uint*          counters       [[ buffer(5) ]],
+                            texture2d<half, access::write> output       [[ texture(0) ]],
+                            uint2                        tile           [[ threadgroup_position_in_grid ]],
+                            uint2                        pixel          [[ thread_position_in_grid ]],
+                            uint                         tid            [[ thread_index_in_threadgroup ]])
+{
+    constexpr uint32_t block_size = tile_size * tile_size;
+
+    threadgroup geometry::Region block[block_size];
+
+    const auto tiles = tile_counts(target_size);
+    const auto index = tile.y * tiles.x + tile.x;
+    const auto first = tile_offsets[index];
+    const auto last  = min(tile_offsets[index + 1], entry_capacity);
+
+    auto is_covered = false;
+
+    for (auto base = first; base < last; base += block_size)
+    {
+        const auto count = min(block_size, last - base);
+
+        if (tid < count) {
+            block[tid] = instance_pixels(arena, tile_entries[base + tid], target_size);
+        }
+
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+
+        for (uint32_t entry = 0; entry < count && !is_covered; ++entry) {
+            is_covered = geometry::contains(block[entry], pixel);
+        }
+
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+    }
+
+    const auto is_inside = pixel.x < target_size.x && pixel.y < target_size.y;
+    const auto covered   = simd_sum( static_cast<uint32_t>(is_inside && is_covered) );
+
+    if (simd_is_first()) {
+        atomic_fetch_add_explicit(&counters[tile_counter_covered_pixels], covered, memory_order_relaxed);
+    }
+
+    if (is_inside) {
+        output.write( is_covered ? half4 { 1.0h, 1.0h, 1.0h, 1.0h } : half4 { 0.0h, 0.0h, 0.0h, 1.0h },
+                      pixel );
+    }
+}
@@ -0,0 +1,464 @@
+//
+//  SpanSet.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Composition/SpanSet.hpp>
+#include <Data/Trace.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+//===------------------------------------------------------------------------===
+// • namespace raster
+//===------------------------------------------------------------------------===
+
+namespace raster
+{
+
+namespace
+{
+
+//===------------------------------------------------------------------------===
+// • Combining spans
+//===------------------------------------------------------------------------===
+
+enum class Operation
+{
+    merge,
+    intersect,
+    subtract
+};
+
+constexpr bool is_inside(Operation operation, bool is_in_lhs, bool is_in_rhs)
+{
+    switch (operation) {
+        case Operation::merge:     return is_in_lhs || is_in_rhs;
+        case Operation::intersect: return is_in_lhs && is_in_rhs;
+        case Operation::subtract:  return is_in_lhs && !is_in_rhs;
+    }
+
+    return false;
+}
+
+// • Walk the edges of both rows in order, emitting a span wherever the
+//   result goes from outside to inside and back. Edges of both rows at the
+//   same x are taken together, so the spans emitted are never adjacent
+//
+void combine_row( std::span<const Span> lhs, std::span<const Span> rhs, Operation operation,
+                  std::vector<Span>& result )
+{
+    constexpr auto none = std::numeric_limits<uint32_t>::max();
+
+    size_t lhs_index  = 0;
+    size_t rhs_index  = 0;
+    bool   is_in_lhs  = false;
+    bool   is_in_rhs  = false;
+    bool   was_inside = false;
+    auto   left       = 0u;
+
+    while (lhs_index < lhs.size() || rhs_index < rhs.size()) {
+
+        const auto lhs_edge = (lhs_index < lhs.size()) ? (is_in_lhs ? lhs[lhs_index].right : lhs[lhs_index].left) : none;
+        const auto rhs_edge = (rhs_index < rhs.size()) ? (is_in_rhs ? rhs[rhs_index].right : rhs[rhs_index].left) : none;
+        const auto x        = std::min(lhs_edge, rhs_edge);
+
+        if (lhs_edge == x) {
+            lhs_index += is_in_lhs ? 1 : 0;
+            is_in_lhs  = !is_in_lhs;
+        }
+
+        if (rhs_edge == x) {
+            rhs_index += is_in_rhs ? 1 : 0;
+            is_in_rhs  = !is_in_rhs;
+        }
+
+        const auto inside = is_inside(operation, is_in_lhs, is_in_rhs);
+
+        if (inside != was_inside) {
+
+            if (inside) {
+                left = x;
+            } else {
+                result.push_back( { left, x } );
+            }
+
+            was_inside = inside;
+        }
+    }
+}
+
+// • Each run of rows over which neither set changes bands, combined once
+//
+SpanSet combine(const SpanSet& lhs, const SpanSet& rhs, Operation operation)
+{
+    constexpr auto none = std::numeric_limits<uint32_t>::max();
+
+    const auto lhs_bands = lhs.bands();
+    const auto rhs_bands = rhs.bands();
+
+    SpanSet           result;
+    std::vector<Span> row;
+
+    size_t lhs_index = 0;
+    size_t rhs_index = 0;
+    auto   y         = 0u;
+
+    while (lhs_index < lhs_bands.size() || rhs_index < rhs_bands.size()) {
+
+        const auto lhs_band = (lhs_index < lhs_bands.size()) ? &lhs_bands[lhs_index] : nullptr;
+        const auto rhs_band = (rhs_index < rhs_bands.size()) ? &rhs_bands[rhs_index] : nullptr;
+
+        // • Rows from y to the next band edge of either set
+        //
+        const auto is_in_lhs = nullptr != lhs_band && lhs_band->top <= y;
+        const auto is_in_rhs = nullptr != rhs_band && rhs_band->top <= y;
+
+        const auto lhs_edge  = (nullptr == lhs_band) ? none : (is_in_lhs ? lhs_band->bottom : lhs_band->top);
+        const auto rhs_edge  = (nullptr == rhs_band) ? none : (is_in_rhs ? rhs_band->bottom : rhs_band->top);
+        const auto bottom    = std::min(lhs_edge, rhs_edge);
+
+        if (is_in_lhs || is_in_rhs) {
+
+            row.clear();
+
+            combine_row( is_in_lhs ? lhs.spans(*lhs_band) : std::span<const Span> { },
+                         is_in_rhs ? rhs.spans(*rhs_band) : std::span<const Span> { },
+                         operation, row );
+
+            result.append(y, bottom, row);
+        }
+
+        lhs_index += (is_in_lhs && lhs_edge == bottom) ? 1 : 0;
+        rhs_index += (is_in_rhs && rhs_edge == bottom) ? 1 : 0;
+        y          = bottom;
+    }
+
+    return result;
+}
+
+//===------------------------------------------------------------------------===
+// • Expansion
+//===------------------------------------------------------------------------===
+
+// • Rows per expansion run
+//
+constexpr size_t expansion_grain = 16;
+
+// • Row `y` of `target`: black between the spans, white inside them
+//
+void expand_row(const Bitmap& target, uint32_t y, std::span<const Span> spans)
+{
+    auto x = 0u;
+
+    for (const auto& span : spans) {
+
+        if (target.width <= span.left) {
+            break;
+        }
+
+        const auto right = std::min(span.right, target.width);
+
+        fill_row(target, x, y, span.left - x, black_pixel);
+        fill_row(target, span.left, y, right - span.left, white_pixel);
+
+        x = right;
+    }
+
+    fill_row(target, x, y, target.width - x, black_pixel);
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • SpanSet
+//===------------------------------------------------------------------------===
+
+uint64_t SpanSet::area(void) const noexcept
+{
+    uint64_t pixels = 0;
+
+    for (const auto& band : band_list) {
+
+        uint64_t row = 0;
+
+        for (const auto& span : spans(band)) {
+            row += width(span);
+        }
+
+        pixels += row * (band.bottom - band.top);
+    }
+
+    return pixels;
+}
+
+geometry::Region SpanSet::bounds(void) const noexcept
+{
+    if (band_list.empty()) {
+        return { 0, 0, 0, 0 };
+    }
+
+    auto left  = std::numeric_limits<uint32_t>::max();
+    auto right = 0u;
+
+    for (const auto& band : band_list) {
+        left  = std::min(left,  span_list[band.first].left);
+        right = std::max(right, span_list[band.first + band.count - 1].right);
+    }
+
+    return { left, band_list.front().top, right, band_list.back().bottom };
+}
+
+bool SpanSet::contains(simd::uint2 pixel) const noexcept
+{
+    // • The band whose bottom is the first below the pixel, then the span
+    //   whose right is the first right of it
+    //
+    const auto band = std::upper_bound( band_list.begin(), band_list.end(), pixel.y,
+                                        [](uint32_t y, const SpanBand& band) { return y < band.bottom; } );
+
+    if (band_list.end() == band || pixel.y < band->top) {
+        return false;
+    }
+
+    const auto row  = spans(*band);
+    const auto span = std::upper_bound( row.begin(), row.end(), pixel.x,
+                                        [](uint32_t x, const Span& span) { return x < span.right; } );
+
+    return row.end() != span && span->left <= pixel.x;
+}
+
+void SpanSet::append(uint32_t top, uint32_t bottom, std::span<const Span> spans)
+{
+    if (bottom <= top || spans.empty()) {
+        return;
+    }
+
+    // • Extend the last band when these rows continue it with the same spans
+    //
+    if (!band_list.empty()) {
+
+        auto& last = band_list.back();
+
+        if (last.bottom == top && std::equal( spans.begin(), spans.end(),
+                                              span_list.begin() + last.first, span_list.begin() + last.first + last.count )) {
+            last.bottom = bottom;
+            return;
+        }
+    }
+
+    band_list.push_back( {
+        .top    = top,
+        .bottom = bottom,
+        .first  = static_cast<uint32_t>( span_list.size() ),
+        .count  = static_cast<uint32_t>( spans.size() )
+    } );
+
+    span_list.insert(span_list.end(), spans.begin(), spans.end());
+}
+
+bool operator == (const SpanSet& lhs, const SpanSet& rhs) noexcept
+{
+    const auto equal_bands = [](const SpanBand& lhs, const SpanBand& rhs) {
+        return lhs.top == rhs.top && lhs.bottom == rhs.bottom && lhs.first == rhs.first && lhs.count == rhs.count;
+    };
+
+    return std::equal( lhs.band_list.begin(), lhs.band_list.end(),
+                       rhs.band_list.begin(), rhs.band_list.end(), equal_bands )
+        && std::equal( lhs.span_list.begin(), lhs.span_list.end(),
+                       rhs.span_list.begin(), rhs.span_list.end() );
+}
+
+SpanSet merge(const SpanSet& lhs, const SpanSet& rhs)
+{
+    return combine(lhs, rhs, Operation::merge);
+}
+
+SpanSet intersect(const SpanSet& lhs, const SpanSet& rhs)
+{
+    return combine(lhs, rhs, Operation::intersect);
+}
+
+SpanSet subtract(const SpanSet& lhs, const SpanSet& rhs)
+{
+    return combine(lhs, rhs, Operation::subtract);
+}
+
+void expand(data::JobSystem& jobs, const SpanSet& spans, const Bitmap& target)
+{
+    PLAY_TRACE_SCOPE("expand spans", "raster");
+
+    const auto bands = spans.bands();
+
+    jobs.parallel_for( target.height, expansion_grain, [&](size_t first, size_t last)
+    {
+        // • The first band not above the run, then each in turn
+        //
+        auto band = std::upper_bound( bands.begin(), bands.end(), first,
+                                      [](size_t y, const SpanBand& band) { return y < band.bottom; } );
+
+        for (auto y = static_cast<uint32_t>(first); y < last; ++y) {
+
+            while (bands.end() != band && band->bottom <= y) {
+                ++band;
+            }
+
+            const auto is_inside = bands.end() != band && band->top <= y;
+
+            expand_row( target, y, is_inside ? spans.spans(*band) : std::span<const Span> { } );
+        }
+    } );
+}
+
+//===------------------------------------------------------------------------===
+// • Span file
+//===------------------------------------------------------------------------===
+
+size_t span_file_size(const SpanSet& spans)
+{
+    const auto size = sizeof(SpanHeader) + spans.byte_size();
+
+    return (size + data::alignment - 1) & ~size_t { data::alignment - 1 };
+}
+
+void write_spans(const SpanSet& spans, simd::uint2 target_size, uint8_t* output)
+{
+    const auto bands = spans.bands();
+    const auto rows  = spans.spans();
+
+    const SpanHeader header = {
+        .magic      = span_magic,
+        .version    = span_version,
+        .width      = target_size.x,
+        .height     = target_size.y,
+        .band_count = static_cast<uint32_t>( bands.size() ),
+        .span_count = static_cast<uint32_t>( rows.size() ),
+        .reserved   = { }
+    };
+
+    const auto size = span_file_size(spans);
+
+    std::memcpy(output, &header, sizeof(header));
+    std::memcpy(output + sizeof(header), bands.data(), bands.size_bytes());
+    std::memcpy(output + sizeof(header) + bands.size_bytes(), rows.data(), rows.size_bytes());
+
+    const auto end = sizeof(header) + bands.size_bytes() + rows.size_bytes();
+
+    std::memset(output + end, 0, size - end);
+}
+
+//===------------------------------------------------------------------------===
+// • SpanRasterizer
+//===------------------------------------------------------------------------===
+
+SpanRasterizer::SpanRasterizer(data::JobSystem& jobs)
+    : jobs { jobs }
+{
+}
+
+void SpanRasterizer::draw(std::span<const Pattern> patterns, simd::uint2 target_size, SpanSet& spans)
+{
+    PLAY_TRACE_SCOPE("draw spans", "raster");
+
+    pixel_regions.clear();
+
+    expand_pixel_regions(jobs, patterns, target_size, pixel_regions);
+
+    draw(pixel_regions, spans);
+}
+
+void SpanRasterizer::draw(std::span<const geometry::Region> regions, SpanSet& spans)
+{
+    PLAY_TRACE_SCOPE("sweep spans", "raster");
+
+    spans.clear();
+
+    // • Regions by top, and every row where one starts or ends
+    //
+    sorted_regions.clear();
+    edges.clear();
+
+    for (const auto& region : regions) {
+        if (!geometry::is_empty(region)) {
+            sorted_regions.push_back(region);
+            edges.push_back(region.top);
+            edges.push_back(region.bottom);
+        }
+    }
+
+    std::sort( sorted_regions.begin(), sorted_regions.end(),
+               [](const geometry::Region& lhs, const geometry::Region& rhs) { return lhs.top < rhs.top; } );
+
+    std::sort(edges.begin(), edges.end());
+    edges.erase( std::unique(edges.begin(), edges.end()), edges.end() );
+
+    // • Between consecutive edges the same regions cross every row: merge
+    //   their columns once for all of them
+    //
+    active_regions.clear();
+
+    auto next = sorted_regions.begin();
+
+    for (size_t index = 0; index + 1 < edges.size(); ++index) {
+
+        const auto top    = edges[index];
+        const auto bottom = edges[index + 1];
+
+        std::erase_if( active_regions, [top](const geometry::Region& region) { return region.bottom <= top; } );
+
+        // • The regions starting here, sorted by left and merged into the
+        //   others, which stay sorted
+        //
+        const auto starting = active_regions.size();
+
+        for (; sorted_regions.end() != next && next->top == top; ++next) {
+            active_regions.push_back(*next);
+        }
+
+        if (active_regions.empty()) {
+            continue;
+        }
+
+        const auto by_left = [](const geometry::Region& lhs, const geometry::Region& rhs) {
+            return lhs.left < rhs.left;
+        };
+
+        std::sort(active_regions.begin() + starting, active_regions.end(), by_left);
+        std::inplace_merge(active_regions.begin(), active_regions.begin() + starting, active_regions.end(), by_left);
+
+        row_spans.clear();
+        row_spans.push_back( { active_regions.front().left, active_regions.front().right } );
+
+        for (const auto& region : active_regions) {
+
+            auto& last = row_spans.back();
+
+            if (region.left <= last.right) {
+                last.right = std::max(last.right, region.right);
+            } else {
+                row_spans.push_back( { region.left, region.right } );
+            }
+        }
+
+        spans.append(top, bottom, row_spans);
+    }
+
+    PLAY_TRACE_COUNTER("span bands", spans.bands().size());
+}
+
+} // namespace raster
@@ -0,0 +1,244 @@
+//
+//  SpanSet.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Arena.hpp>
+#include <Composition/Rasterizer.hpp>
+#include <Data/Layout.hpp>
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • namespace raster
+//===------------------------------------------------------------------------===
+
+namespace raster
+{
+
+//===------------------------------------------------------------------------===
+// • Span, SpanBand
+//
+//  - A span is the pixels [left, right) of a row. A band is the rows [top,
+//    bottom) that share the same spans, spans[first] to spans[first +
+//    count - 1]
+//===------------------------------------------------------------------------===
+
+struct Span
+{
+    uint32_t    left;
+    uint32_t    right;
+};
+
+static_assert( data::is_trivial_layout<Span>(), "Unexpected layout" );
+
+constexpr bool operator == (const Span lhs, const Span rhs)
+{
+    return lhs.left == rhs.left && lhs.right == rhs.right;
+}
+
+constexpr uint32_t width(const Span span)
+{
+    return span.right - span.left;
+}
+
+struct SpanBand
+{
+    uint32_t    top;
+    uint32_t    bottom;
+    uint32_t    first;
+    uint32_t    count;
+};
+
+static_assert( data::is_trivial_layout<SpanBand>(), "Unexpected layout" );
+
+//===------------------------------------------------------------------------===
+//
+// • SpanSet
+//
+//  - A set of pixels as bands of spans: the scanlines of a coverage mask,
+//    run-length encoded across x by the spans and across y by the bands. Its
+//    size follows the edges of what it covers rather than the pixels, so
+//    the mask of a sparse composition takes bytes at any resolution
+//
+//  - Canonical: bands are sorted, disjoint and hold at least one span;
+//    spans are sorted, disjoint and not adjacent; adjacent bands differ. So
+//    equal sets have equal bands and spans
+//
+//===------------------------------------------------------------------------===
+
+class SpanSet
+{
+public:
+
+    bool is_empty(void) const noexcept
+    {
+        return band_list.empty();
+    }
+
+    std::span<const SpanBand> bands(void) const noexcept
+    {
+        return band_list;
+    }
+
+    std::span<const Span> spans(void) const noexcept
+    {
+        return span_list;
+    }
+
+    std::span<const Span> spans(const SpanBand& band) const noexcept
+    {
+        return { span_list.data() + band.first, band.count };
+    }
+
+    // • Pixels covered, and the smallest region holding them
+    //
+    uint64_t area(void) const noexcept;
+
+    geometry::Region bounds(void) const noexcept;
+
+    bool contains(simd::uint2 pixel) const noexcept;
+
+    // • Bytes of bands and spans
+    //
+    size_t byte_size(void) const noexcept
+    {
+        return band_list.size()*sizeof(SpanBand) + span_list.size()*sizeof(Span);
+    }
+
+    void clear(void) noexcept
+    {
+        band_list.clear();
+        span_list.clear();
+    }
+
+    // • Append rows [top, bottom) covering `spans`, which must be canonical,
+    //   below every band so far. Empty rows are skipped, and rows equal to
+    //   the last band extend it
+    //
+    void append(uint32_t top, uint32_t bottom, std::span<const Span> spans);
+
+    friend bool operator == (const SpanSet& lhs, const SpanSet& rhs) noexcept;
+
+private:
+
+    std::vector<SpanBand>   band_list;
+    std::vector<Span>       span_list;
+};
+
+// • Pixels in either set, in both, or in `lhs` but not `rhs`. Linear in the
+//   bands and spans of both
+//
+SpanSet merge(const SpanSet& lhs, const SpanSet& rhs);
+SpanSet intersect(const SpanSet& lhs, const SpanSet& rhs);
+SpanSet subtract(const SpanSet& lhs, const SpanSet& rhs);
+
+// • Expand into `target` as Rasterizer draws binary coverage: white inside
+//   the set, black elsewhere, each pixel written once. Rows are expanded in
+//   parallel on `jobs`; spans beyond the target are clipped
+//
+void expand(data::JobSystem& jobs, const SpanSet& spans, const Bitmap& target);
+
+//===------------------------------------------------------------------------===
+//
+// • Span file
+//
+//  - A set written as the bands and spans following a header, so it is used
+//    directly from memory, as a scene is:
+//
+//    [ SpanHeader | SpanBand[band_count] | Span[span_count] ]
+//
+//  - width and height are those of the target the set was made for. Every
+//    offset is 16-byte aligned. All values are little-endian, written and
+//    read without swapping
+//
+//===------------------------------------------------------------------------===
+
+struct SpanHeader
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    band_count;
+    uint32_t    span_count;
+    uint32_t    reserved[2];
+};
+
+static_assert( data::is_trivial_layout<SpanHeader>(), "Unexpected layout" );
+static_assert( data::is_aligned( data::aligned_size<SpanHeader>() ), "Unexpected size" );
+static_assert( std::endian::little == std::endian::native, "Span files are written as little-endian" );
+
+enum : uint32_t
+{
+    span_magic   = 0x53534c50,    // "PLSS"
+    span_version = 1
+};
+
+size_t span_file_size(const SpanSet& spans);
+
+// • Write `spans` of a `target_size` target into `output`, span_file_size
+//   bytes
+//
+void write_spans(const SpanSet& spans, simd::uint2 target_size, uint8_t* output);
+
+//===------------------------------------------------------------------------===
+// • SpanRasterizer
+//
+//  - Binary coverage (as Rasterizer with Coverage::binary) as a SpanSet
+//    rather than pixels: the covered pixels of every visible instance,
+//    through its pattern's grid_size scaled to the target size, swept from
+//    top to bottom into bands. Work follows the instances and their edges,
+//    not the target's pixels
+//
+//  - Instances are expanded in parallel on `jobs`; the sweep is serial
+//
+//===------------------------------------------------------------------------===
+
+class SpanRasterizer
+{
+public:
+
+    explicit SpanRasterizer(data::JobSystem& jobs = data::JobSystem::shared());
+
+    void draw(std::span<const Pattern> patterns, simd::uint2 target_size, SpanSet& spans);
+
+    void draw(const Arena& arena, simd::uint2 target_size, SpanSet& spans)
+    {
+        draw( { patterns(arena), arena.patterns.count }, target_size, spans );
+    }
+
+    // • The union of `regions`, in pixels
+    //
+    void draw(std::span<const geometry::Region> regions, SpanSet& spans);
+
+private:
+
+    std::vector<geometry::Region>   pixel_regions;
+    std::vector<geometry::Region>   sorted_regions;
+    std::vector<uint32_t>           edges;
+    std::vector<geometry::Region>   active_regions;
+    std::vector<Span>               row_spans;
+    data::JobSystem&                jobs;
+};
+
+} // namespace raster
@@ -0,0 +1,280 @@
+//
+//  TileBinning.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <Composition/TileBinning.hpp>
+#include <Composition/PatternQueries.hpp>
+#include <Data/Trace.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <utility>
+
+//===------------------------------------------------------------------------===
+// • namespace raster
+//===------------------------------------------------------------------------===
+
+namespace raster
+{
+
+namespace
+{
+
+uint64_t area(geometry::Region region)
+{
+    return static_cast<uint64_t>( geometry::width(region) ) * geometry::height(region);
+}
+
+// • Fill the pixels of one tile row, from `left` on row `y`, from its
+//   coverage mask (bit x for pixel x of the tile), one span per run of equal
+//   bits
+//
+uint64_t shade_row(const Bitmap& target, uint32_t left, uint32_t y, uint32_t width, uint32_t mask)
+{
+    const auto covered = static_cast<uint64_t>( std::popcount(mask) );
+
+    for (uint32_t x = 0; x < width; ) {
+
+        const auto rest  = mask >> x;
+        const auto run   = (rest & 1u) ? std::countr_one(rest) : std::countr_zero(rest);
+        const auto count = std::min<uint32_t>(run, width - x);
+
+        fill_row(target, left + x, y, count, (rest & 1u) ? white_pixel : black_pixel);
+
+        x += count;
+    }
+
+    return covered;
+}
+
+// • Binning runs per worker, so that idle workers can steal some
+//
+constexpr uint32_t runs_per_worker = 4;
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • TileBinner
+//===------------------------------------------------------------------------===
+
+TileBinner::TileBinner(data::JobSystem& jobs)
+    : target          { 0, 0 },
+      tiles           { 0, 0 },
+      tile_statistics { },
+      runs            { 1 },
+      jobs            { jobs }
+{
+}
+
+bool TileBinner::bin(std::span<const Pattern> patterns, simd::uint2 target_size)
+{
+    PLAY_TRACE_SCOPE("bin", "raster");
+
+    target = target_size;
+    tiles  = tile_counts(target_size);
+
+    const auto tile_total = tiles.x * tiles.y;
+
+    // • Covered pixels of the visible instances, in draw order
+    //
+    expand_pixel_regions(jobs, patterns, target_size, pixel_regions);
+
+    const auto instance_count = static_cast<uint32_t>( pixel_regions.size() );
+
+    // • Count each run's entries per tile
+    //
+    runs = std::min( jobs.worker_count() * runs_per_worker, std::max(1u, instance_count) );
+
+    run_counts.assign(static_cast<size_t>(runs) * tile_total, 0);
+
+    jobs.parallel_for( runs, 1, [this](size_t first, size_t last) {
+
+        for (auto run = first; run < last; ++run) {
+            count_tiles( static_cast<uint32_t>(run) );
+        }
+    } );
+
+    // • Each tile's entries start after those of earlier tiles, and within a
+    //   tile each run's after those of earlier runs. Counts become each
+    //   run's next position. The total, in 64 bits, must fit the offsets
+    //
+    tile_offsets.resize(tile_total + 1);
+
+    uint64_t offset = 0;
+
+    for (uint32_t tile = 0; tile < tile_total; ++tile) {
+
+        tile_offsets[tile] = static_cast<uint32_t>(offset);
+
+        for (uint32_t run = 0; run < runs; ++run) {
+
+            auto& count = run_counts[static_cast<size_t>(run) * tile_total + tile];
+
+            offset += std::exchange( count, static_cast<uint32_t>(offset) );
+        }
+    }
+
+    if (std::numeric_limits<uint32_t>::max() < offset) {
+
+        tiles = { 0, 0 };
+        tile_offsets.assign(1, 0);
+        tile_entries.clear();
+        tile_statistics = { };
+
+        return false;
+    }
+
+    tile_offsets[tile_total] = static_cast<uint32_t>(offset);
+    tile_entries.resize(offset);
+
+    jobs.parallel_for( runs, 1, [this](size_t first, size_t last) {
+
+        for (auto run = first; run < last; ++run) {
+            fill_tiles( static_cast<uint32_t>(run) );
+        }
+    } );
+
+    // • Statistics
+    //
+    uint64_t instance_pixels = 0;
+
+    for (const auto& pixels : pixel_regions) {
+        instance_pixels += area(pixels);
+    }
+
+    PLAY_TRACE_COUNTER("bin entries", offset);
+
+    tile_statistics = {
+        .instance_count  = instance_count,
+        .tile_count      = tile_total,
+        .bin_entries     = offset,
+        .instance_pixels = instance_pixels,
+        .covered_pixels  = 0,
+        .target_pixels   = static_cast<uint64_t>(target_size.x) * target_size.y,
+        .dropped_entries = 0
+    };
+
+    return true;
+}
+
+void TileBinner::count_tiles(uint32_t run)
+{
+    PLAY_TRACE_SCOPE("bin: count", "raster");
+
+    const auto counts = run_counts.data() + static_cast<size_t>(run) * tiles.x * tiles.y;
+
+    for (auto index = run_start(run); index < run_start(run + 1); ++index) {
+
+        const auto range = tile_range(pixel_regions[index]);
+
+        for (auto y = range.first.y; y <= range.last.y; ++y) {
+            for (auto x = range.first.x; x <= range.last.x; ++x) {
+                ++counts[tile_index(x, y)];
+            }
+        }
+    }
+}
+
+void TileBinner::fill_tiles(uint32_t run)
+{
+    PLAY_TRACE_SCOPE("bin: fill", "raster");
+
+    const auto positions = run_counts.data() + static_cast<size_t>(run) * tiles.x * tiles.y;
+
+    for (auto index = run_start(run); index < run_start(run + 1); ++index) {
+
+        const auto range = tile_range(pixel_regions[index]);
+
+        for (auto y = range.first.y; y <= range.last.y; ++y) {
+            for (auto x = range.first.x; x <= range.last.x; ++x) {
+                tile_entries[ positions[tile_index(x, y)]++ ] = index;
+            }
+        }
+    }
+}
+
+std::span<const uint32_t> TileBinner::tile_instances(uint32_t x, uint32_t y) const
+{
+    const auto tile = tile_index(x, y);
+
+    return std::span { tile_entries }.subspan( tile_offsets[tile], tile_offsets[tile + 1] - tile_offsets[tile] );
+}
+
+void TileBinner::draw(const Bitmap& target_bitmap)
+{
+    PLAY_TRACE_SCOPE("shade", "raster");
+
+    // • Each row of tiles is a job
+    //
+    std::vector<uint64_t> covered(tiles.y, 0);
+
+    jobs.parallel_for( tiles.y, 1, [&](size_t first, size_t last) {
+
+        for (auto tile_y = first; tile_y < last; ++tile_y) {
+            covered[tile_y] = shade_tiles( target_bitmap, static_cast<uint32_t>(tile_y) );
+        }
+    } );
+
+    tile_statistics.covered_pixels = 0;
+
+    for (const auto pixels : covered) {
+        tile_statistics.covered_pixels += pixels;
+    }
+}
+
+uint64_t TileBinner::shade_tiles(const Bitmap& target_bitmap, uint32_t tile_y) const
+{
+    uint64_t covered = 0;
+
+    for (uint32_t tile_x = 0; tile_x < tiles.x; ++tile_x) {
+
+        const geometry::Region tile = {
+            .left   = tile_x * tile_size,
+            .top    = tile_y * tile_size,
+            .right  = std::min( (tile_x + 1) * tile_size, target.x ),
+            .bottom = std::min( (tile_y + 1) * tile_size, target.y )
+        };
+
+        // • Coverage of each row of the tile, one bit per pixel
+        //
+        uint32_t masks[tile_size] = { };
+
+        for (const auto index : tile_instances(tile_x, tile_y)) {
+
+            const auto pixels = geometry::intersection(pixel_regions[index], tile);
+            const auto width  = geometry::width(pixels);
+            const auto mask   = ( (width < 32) ? (1u << width) - 1u : ~0u ) << (pixels.left - tile.left);
+
+            for (auto y = pixels.top; y < pixels.bottom; ++y) {
+                masks[y - tile.top] |= mask;
+            }
+        }
+
+        // • Each pixel written once
+        //
+        for (auto y = tile.top; y < tile.bottom; ++y) {
+            covered += shade_row( target_bitmap, tile.left, y, geometry::width(tile), masks[y - tile.top] );
+        }
+    }
+
+    return covered;
+}
+
+} // namespace raster
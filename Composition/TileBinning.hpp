@@ -0,0 +1,166 @@
+//
+//  TileBinning.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Arena.hpp>
+#include <Composition/Rasterizer.hpp>
+#include <Composition/Tiles.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • namespace raster
+//===------------------------------------------------------------------------===
+
+namespace raster
+{
+
+//===------------------------------------------------------------------------===
+// • TileStatistics
+//
+//  - Overdraw of plain instancing against tiled shading. Instancing writes
+//    every instance's pixels after clearing the target; tiled shading writes
+//    each pixel once
+//===------------------------------------------------------------------------===
+
+struct TileStatistics
+{
+    uint64_t    instance_count;     // Instances covering at least one pixel
+    uint64_t    tile_count;
+    uint64_t    bin_entries;        // Sum over tiles of the instances listed
+    uint64_t    instance_pixels;    // Sum of instance areas
+    uint64_t    covered_pixels;     // Pixels covered by at least one instance
+    uint64_t    target_pixels;
+    uint64_t    dropped_entries;    // Past the GPU's entry buffer, see TileCounters
+};
+
+// • Instance pixels per covered pixel: how often instancing fills a pixel
+//   that is filled at all
+//
+constexpr double overdraw(const TileStatistics& statistics)
+{
+    return (0 < statistics.covered_pixels) ? static_cast<double>(statistics.instance_pixels)
+                                           / static_cast<double>(statistics.covered_pixels)
+                                           : 0.0;
+}
+
+// • From the counters of the binning kernels (Shaders.metal)
+//
+constexpr TileStatistics make_tile_statistics(const TileCounters& counters, simd::uint2 target_size)
+{
+    const auto tiles = tile_counts(target_size);
+
+    return {
+        .instance_count  = counters.instance_count,
+        .tile_count      = static_cast<uint64_t>(tiles.x) * tiles.y,
+        .bin_entries     = wide_counter(counters.bin_entries, counters.bin_entries_high),
+        .instance_pixels = wide_counter(counters.instance_pixels, counters.instance_pixels_high),
+        .covered_pixels  = counters.covered_pixels,
+        .target_pixels   = static_cast<uint64_t>(target_size.x) * target_size.y,
+        .dropped_entries = counters.dropped_entries
+    };
+}
+
+//===------------------------------------------------------------------------===
+// • TileBinner
+//
+//  - CPU version of the tiled mode. bin maps each visible instance to pixels
+//    through its pattern's grid_size and lists it in every tile it touches;
+//    draw then shades each tile once. The image is the same as Rasterizer's
+//
+//  - Both steps run on `jobs`. Binning is a counting sort over a few
+//    contiguous runs of instances per worker, so every tile lists its
+//    instances in draw order
+//
+//===------------------------------------------------------------------------===
+
+class TileBinner
+{
+public:
+
+    explicit TileBinner(data::JobSystem& jobs = data::JobSystem::shared());
+
+    // • False, leaving no tiles, if the tiles would list 2^32 entries or
+    //   more, past what their uint32_t offsets can index
+    //
+    bool bin(std::span<const Pattern> patterns, simd::uint2 target_size);
+
+    bool bin(const Arena& arena, simd::uint2 target_size)
+    {
+        return bin( { patterns(arena), arena.patterns.count }, target_size );
+    }
+
+    // • Shade every tile of `target`, whose size must be that given to bin
+    //
+    void draw(const Bitmap& target);
+
+    // • Instances (indices into instance_pixels) listed for tile (x, y)
+    //
+    std::span<const uint32_t> tile_instances(uint32_t x, uint32_t y) const;
+
+    // • Covered pixels of each binned instance, in draw order
+    //
+    std::span<const geometry::Region> instance_pixels(void) const noexcept
+    {
+        return pixel_regions;
+    }
+
+    // • Counts from the last bin, and covered pixels from the last draw
+    //
+    const TileStatistics& statistics(void) const noexcept
+    {
+        return tile_statistics;
+    }
+
+    uint32_t thread_count(void) const noexcept
+    {
+        return jobs.worker_count();
+    }
+
+private:
+
+    uint32_t tile_index(uint32_t x, uint32_t y) const noexcept
+    {
+        return y * tiles.x + x;
+    }
+
+    uint32_t run_start(uint32_t run) const noexcept
+    {
+        return static_cast<uint32_t>( static_cast<uint64_t>( pixel_regions.size() ) * run / runs );
+    }
+
+    void count_tiles(uint32_t run);
+    void fill_tiles(uint32_t run);
+    uint64_t shade_tiles(const Bitmap& target, uint32_t tile_y) const;
+
+    std::vector<geometry::Region>   pixel_regions;
+    std::vector<uint32_t>           run_counts;         // [run][tile]
+    std::vector<uint32_t>           tile_offsets;       // [tile + 1]
+    std::vector<uint32_t>           tile_entries;
+    simd::uint2                     target;
+    simd::uint2                     tiles;
+    TileStatistics                  tile_statistics;
+    uint32_t                        runs;
+    data::JobSystem&                jobs;
+};
+
+} // namespace raster
@@ -0,0 +1,316 @@
+//
+//  TileBinningPass.swift
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+import Foundation
+import Metal
+
+//===------------------------------------------------------------------------===
+//
+// MARK: - TileStatistics
+//
+//  - Overdraw statistics of a tiled pass (see TileCounters in Tiles.hpp)
+//
+//===------------------------------------------------------------------------===
+
+struct TileStatistics {
+
+    var instanceCount  : UInt32 = 0     // Instances covering at least one pixel
+    var binEntries     : UInt64 = 0     // Sum over tiles of the instances listed
+    var instancePixels : UInt64 = 0     // Pixels plain instancing would write
+    var coveredPixels  : UInt32 = 0     // Pixels covered by at least one instance
+    var droppedEntries : UInt32 = 0     // Past the entry buffer, so the pass was redrawn
+
+    var overdraw: Double {
+        (0 < coveredPixels) ? Double(instancePixels) / Double(coveredPixels) : 0.0
+    }
+}
+
+//===------------------------------------------------------------------------===
+//
+// MARK: - TileBinningPass
+//
+//  - Draws the composition by binning its instances into 32x32 tiles and
+//    shading each tile once (bin_count_instances, scan_tile_counts,
+//    bin_fill_instances and shade_tiles in Shaders.metal), so each pixel is
+//    written once however many instances overlap it
+//
+//  - The entry buffer is sized from tile_entry_bound. Should a pass still
+//    drop entries, the next is given room for the bin entries it counted and
+//    the composition is invalidated to redraw. Past 2^32 entries the offsets
+//    can't index them, and canBin is false until the composition or target
+//    size changes
+//
+//===------------------------------------------------------------------------===
+
+class TileBinningPass {
+
+    //  - Bin entries counted by a pass that had no room for them all, for the
+    //    composition generation and target size it drew
+    //
+    private struct RequiredEntries {
+
+        var count      = 0
+        var generation : UInt64 = 0
+        var targetSize = SIMD2<UInt32>(0, 0)
+
+        func count(for composition: Composition, targetSize: SIMD2<UInt32>) -> Int {
+            (composition.generation == generation && self.targetSize == targetSize) ? count : 0
+        }
+    }
+
+    //===--------------------------------------------------------------------===
+    // MARK: • Properties (Read-Only)
+    //
+    //  - Statistics of the last completed pass
+    //
+    private(set) var statistics = TileStatistics()
+
+    //===--------------------------------------------------------------------===
+    // MARK: • Properties (Private)
+    //
+    private static let tileSize     = 32
+    private static let counterSlots = 3     // One per frame in flight
+    private static let counterCount = 8     // UInt32s of a TileCounters (Tiles.hpp)
+
+    private let countPipelineState : MTLComputePipelineState
+    private let scanPipelineState  : MTLComputePipelineState
+    private let fillPipelineState  : MTLComputePipelineState
+    private let shadePipelineState : MTLComputePipelineState
+    private let countersBuffer     : MTLBuffer
+    private var countersSlot       = 0
+    private var tileCountsBuffer   : MTLBuffer?
+    private var tileOffsetsBuffer  : MTLBuffer?
+    private var tileCursorsBuffer  : MTLBuffer?
+    private var tileEntriesBuffer  : MTLBuffer?
+    private var required           = RequiredEntries()
+
+    //===--------------------------------------------------------------------===
+    // MARK: • Initialization
+    //
+    init?(library: MTLLibrary) {
+
+        guard let countPipelineState = library.makeComputePipelineState(functionName: "bin_count_instances"),
+              let scanPipelineState  = library.makeComputePipelineState(functionName: "scan_tile_counts"),
+              let fillPipelineState  = library.makeComputePipelineState(functionName: "bin_fill_instances"),
+              let shadePipelineState =
+                library.makeComputePipelineState( functionName: "shade_tiles",
+                                                  tileWidth: TileBinningPass.tileSize,
+                                                  tileHeight: TileBinningPass.tileSize ) else {
+            return nil
+        }
+
+        let countersLength = TileBinningPass.counterSlots * TileBinningPass.counterCount
+                           * MemoryLayout<UInt32>.stride
+
+        guard let countersBuffer = library.device.makeBuffer(length: countersLength,
+                                                             options: .storageModeShared) else {
+            return nil
+        }
+
+        self.countPipelineState = countPipelineState
+        self.scanPipelineState  = scanPipelineState
+        self.fillPipelineState  = fillPipelineState
+        self.shadePipelineState = shadePipelineState
+        self.countersBuffer     = countersBuffer
+    }
+
+    //===--------------------------------------------------------------------===
+    // MARK: • Methods
+    //
+    //  - False when a pass of the composition at this size needed more
+    //    entries than UInt32 offsets index; draw without tiles then
+    //
+    func canBin(_ composition: Composition, targetSize: SIMD2<UInt32>) -> Bool {
+        required.count(for: composition, targetSize: targetSize) <= Int(UInt32.max)
+    }
+
+    //  - Writes every pixel of `outputTexture`, which needs .shaderWrite usage
+    //
+    func encode( arenaBuffer: MTLBuffer, arenaOffset: Int, composition: Composition,
+                 to outputTexture: MTLTexture, with commandBuffer: MTLCommandBuffer ) -> Bool {
+
+        let tileSize     = TileBinningPass.tileSize
+        let tilesAcross  = (outputTexture.width  + tileSize - 1) / tileSize
+        let tilesDown    = (outputTexture.height + tileSize - 1) / tileSize
+        let tileCount    = tilesAcross * tilesDown
+        let targetSize   = SIMD2<UInt32>( UInt32(outputTexture.width), UInt32(outputTexture.height) )
+        let generation   = composition.generation
+        let entryBound   = max( 1, composition.tileEntryBound(forTargetSize: targetSize),
+                                required.count(for: composition, targetSize: targetSize) )
+
+        guard entryBound <= Int(UInt32.max) else {
+            return false
+        }
+
+        guard reserveBuffers(device: commandBuffer.device, tileCount: tileCount, entryCount: entryBound),
+              let tileCountsBuffer, let tileOffsetsBuffer, let tileCursorsBuffer, let tileEntriesBuffer else {
+            return false
+        }
+
+        // • Reset the counts and this frame's counters
+        //
+        countersSlot = (countersSlot + 1) % TileBinningPass.counterSlots
+
+        let countersLength = TileBinningPass.counterCount * MemoryLayout<UInt32>.stride
+        let countersOffset = countersSlot * countersLength
+
+        guard let blitEncoder = commandBuffer.makeBlitCommandEncoder() else {
+            return false
+        }
+
+        blitEncoder.fill(buffer: tileCountsBuffer, range: 0..<(tileCount * MemoryLayout<UInt32>.stride), value: 0)
+        blitEncoder.fill(buffer: countersBuffer, range: countersOffset..<(countersOffset + countersLength), value: 0)
+        blitEncoder.endEncoding()
+
+        guard let computeEncoder = commandBuffer.makeComputeCommandEncoder() else {
+            return false
+        }
+
+        var targetSizeValue    = targetSize
+        var tileCountValue     = UInt32(tileCount)
+        var entryCapacityValue = UInt32(entryBound)
+
+        // • Count the tiles of each instance
+        //
+        let instanceCount = composition.instanceCount
+
+        if 0 < instanceCount {
+
+            let threadsPerThreadgroup = countPipelineState.simdGroup1DThreadsSize()
+            let threadgroups          = MTLSize( width: (instanceCount + threadsPerThreadgroup.width - 1)
+                                                        / threadsPerThreadgroup.width,
+                                                 height: 1, depth: 1 )
+
+            computeEncoder.setComputePipelineState(countPipelineState)
+            computeEncoder.setBuffer(arenaBuffer, offset: arenaOffset, index: 0)
+            computeEncoder.setBytes(&targetSizeValue, length: MemoryLayout<SIMD2<UInt32>>.stride, index: 1)
+            computeEncoder.setBuffer(tileCountsBuffer, offset: 0, index: 2)
+            computeEncoder.setBuffer(countersBuffer, offset: countersOffset, index: 3)
+            computeEncoder.dispatchThreadgroups(threadgroups, threadsPerThreadgroup: threadsPerThreadgroup)
+        }
+
+        // • Offsets of each tile's list
+        //
+        let scanWidth = min(1024, scanPipelineState.maxTotalThreadsPerThreadgroup) & ~31
+
+        computeEncoder.setComputePipelineState(scanPipelineState)
+        computeEncoder.setBuffer(tileCountsBuffer, offset: 0, index: 0)
+        computeEncoder.setBuffer(tileOffsetsBuffer, offset: 0, index: 1)
+        computeEncoder.setBuffer(tileCursorsBuffer, offset: 0, index: 2)
+        computeEncoder.setBytes(&tileCountValue, length: MemoryLayout<UInt32>.stride, index: 3)
+        computeEncoder.dispatchThreadgroups( MTLSize(width: 1, height: 1, depth: 1),
+                                             threadsPerThreadgroup: MTLSize(width: scanWidth, height: 1, depth: 1) )
+
+        // • List each instance in its tiles
+        //
+        if 0 < instanceCount {
+
+            let threadsPerThreadgroup = fillPipelineState.simdGroup1DThreadsSize()
+            let threadgroups          = MTLSize( width: (instanceCount + threadsPerThreadgroup.width - 1)
+                                                        / threadsPerThreadgroup.width,
+                                                 height: 1, depth: 1 )
+
+            computeEncoder.setComputePipelineState(fillPipelineState)
+            computeEncoder.setBuffer(arenaBuffer, offset: arenaOffset, index: 0)
+            computeEncoder.setBytes(&targetSizeValue, length: MemoryLayout<SIMD2<UInt32>>.stride, index: 1)
+            computeEncoder.setBuffer(tileCursorsBuffer, offset: 0, index: 2)
+            computeEncoder.setBuffer(tileEntriesBuffer, offset: 0, index: 3)
+            computeEncoder.setBytes(&entryCapacityValue, length: MemoryLayout<UInt32>.stride, index: 4)
+            computeEncoder.setBuffer(countersBuffer, offset: countersOffset, index: 5)
+            computeEncoder.dispatchThreadgroups(threadgroups, threadsPerThreadgroup: threadsPerThreadgroup)
+        }
+
+        // • Shade each tile once
+        //
+        computeEncoder.setComputePipelineState(shadePipelineState)
+        computeEncoder.setBuffer(arenaBuffer, offset: arenaOffset, index: 0)
+        computeEncoder.setBytes(&targetSizeValue, length: MemoryLayout<SIMD2<UInt32>>.stride, index: 1)
+        computeEncoder.setBuffer(tileOffsetsBuffer, offset: 0, index: 2)
+        computeEncoder.setBuffer(tileEntriesBuffer, offset: 0, index: 3)
+        computeEncoder.setBytes(&entryCapacityValue, length: MemoryLayout<UInt32>.stride, index: 4)
+        computeEncoder.setBuffer(countersBuffer, offset: countersOffset, index: 5)
+        computeEncoder.setTexture(outputTexture, index: 0)
+        computeEncoder.dispatchThreadgroups( MTLSize(width: tilesAcross, height: tilesDown, depth: 1),
+                                             threadsPerThreadgroup: MTLSize(width: tileSize, height: tileSize,
+                                                                            depth: 1) )
+        computeEncoder.endEncoding()
+
+        // • Statistics, once the counters are final, in the order of
+        //   TileCounters. A pass that dropped entries, or counted more than
+        //   the capacity (its cursors wrapped), is drawn again with room for
+        //   them
+        //
+        let counters = countersBuffer.contents().advanced(by: countersOffset)
+                                                .bindMemory(to: UInt32.self, capacity: TileBinningPass.counterCount)
+
+        func wide(_ index: Int) -> UInt64 {
+            UInt64(counters[index + 1]) << 32 | UInt64(counters[index])
+        }
+
+        commandBuffer.addCompletedHandler { [weak self] _ in
+
+            let statistics = TileStatistics( instanceCount:  counters[0], binEntries:     wide(2),
+                                             instancePixels: wide(4),     coveredPixels:  counters[1],
+                                             droppedEntries: counters[6] )
+
+            Tracing.recordCounter("tile bin entries", value: Int64(statistics.binEntries))
+
+            let isOverflowed = 0 < statistics.droppedEntries || UInt64(entryBound) < statistics.binEntries
+
+            DispatchQueue.main.async {
+
+                self?.statistics = statistics
+
+                if isOverflowed, let self {
+
+                    self.required = RequiredEntries( count: Int( min(statistics.binEntries, UInt64(Int.max)) ),
+                                                     generation: generation, targetSize: targetSize )
+
+                    composition.invalidate()
+                }
+            }
+        }
+
+        return true
+    }
+
+    //===--------------------------------------------------------------------===
+    // MARK: • Buffers (Private)
+    //
+    private func reserveBuffers(device: MTLDevice, tileCount: Int, entryCount: Int) -> Bool {
+
+        let stride = MemoryLayout<UInt32>.stride
+
+        func reserve(_ buffer: inout MTLBuffer?, count: Int) -> Bool {
+
+            if let buffer, count * stride <= buffer.length {
+                return true
+            }
+
+            buffer = device.makeBuffer(length: count * stride, options: .storageModePrivate)
+
+            return nil != buffer
+        }
+
+        return reserve(&tileCountsBuffer,  count: tileCount)
+            && reserve(&tileOffsetsBuffer, count: tileCount + 1)
+            && reserve(&tileCursorsBuffer, count: tileCount)
+            && reserve(&tileEntriesBuffer, count: entryCount)
+    }
+}
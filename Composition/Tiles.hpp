@@ -0,0 +1,154 @@
+//
+//  Tiles.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Composition/Pattern.hpp>
+#include <Graphics/Geometry.hpp>
+#include <Data/Layout.hpp>
+
+//===------------------------------------------------------------------------===
+//
+// • Tiles
+//
+//  - The tiled mode bins each instance into the square screen tiles its
+//    pixels touch, then shades each tile once from its list of instances,
+//    so every pixel is written once however many instances overlap it
+//
+//  - Binning works on covered pixels (raster::covered_pixels and its copy in
+//    Shaders.metal), so a tile lists exactly the instances that write to it
+//
+//===------------------------------------------------------------------------===
+
+enum : uint32_t
+{
+    tile_size = 32
+};
+
+// • Tiles across and down a target
+//
+constexpr simd::uint2 tile_counts(simd::uint2 target_size)
+{
+    return {
+        (target_size.x + tile_size - 1) / tile_size,
+        (target_size.y + tile_size - 1) / tile_size
+    };
+}
+
+// • Tiles (inclusive) that a non-empty region of pixels touches
+//
+struct TileRange
+{
+    simd::uint2 first;
+    simd::uint2 last;
+};
+
+constexpr TileRange tile_range(const geometry::Region pixels)
+{
+    return {
+        .first = { pixels.left / tile_size, pixels.top / tile_size },
+        .last  = { (pixels.right - 1) / tile_size, (pixels.bottom - 1) / tile_size }
+    };
+}
+
+constexpr uint32_t tile_range_count(const TileRange range)
+{
+    return (range.last.x - range.first.x + 1) * (range.last.y - range.first.y + 1);
+}
+
+//===------------------------------------------------------------------------===
+// • TileCounters
+//
+//  - Overdraw statistics as the binning kernels accumulate them, with 32-bit
+//    atomics. Zero before binning. Sums that can pass 2^32 are kept in two
+//    words, the high one counting the carries out of the low one
+//
+//  - dropped_entries counts the entries bin_fill_instances had no room for,
+//    past entry_capacity. The host checks it once the pass completes and
+//    sizes the entry buffer from bin_entries for the next one
+//===------------------------------------------------------------------------===
+
+struct TileCounters
+{
+    uint32_t    instance_count;         // Instances covering at least one pixel
+    uint32_t    covered_pixels;         // Pixels covered by at least one instance
+    uint32_t    bin_entries;            // Sum over tiles of the instances listed
+    uint32_t    bin_entries_high;
+    uint32_t    instance_pixels;        // Sum of instance areas: pixels written by instancing
+    uint32_t    instance_pixels_high;
+    uint32_t    dropped_entries;
+    uint32_t    reserved;
+};
+
+enum : uint32_t
+{
+    tile_counter_instance_count   = 0,  // As a uint32_t array, for atomics
+    tile_counter_covered_pixels   = 1,
+    tile_counter_bin_entries      = 2,  // Then its high word
+    tile_counter_instance_pixels  = 4,  // Then its high word
+    tile_counter_dropped_entries  = 6,
+    tile_counter_count            = 8
+};
+
+// • A sum kept in two words
+//
+constexpr uint64_t wide_counter(uint32_t low, uint32_t high)
+{
+    return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+#if !defined ( __METAL_VERSION__ )
+
+static_assert( data::is_trivial_layout<TileCounters>(), "Unexpected layout" );
+static_assert( tile_counter_count * sizeof(uint32_t) == sizeof(TileCounters), "Unexpected size" );
+
+//===------------------------------------------------------------------------===
+// • Bin capacity (Host)
+//===------------------------------------------------------------------------===
+
+// • An upper bound on the bin entries of `pattern` in a `target_size`
+//   target, from the size of its base region alone, for sizing the GPU's
+//   instance lists before binning. The instances of a nested pattern lie in
+//   their cells, so base_region bounds each of them too
+//
+inline uint64_t tile_entry_bound(const Pattern* table, const Pattern& pattern, simd::uint2 target_size)
+{
+    if (0 == pattern.grid_size.x || 0 == pattern.grid_size.y) {
+        return 0;
+    }
+
+    // • Pixels spanned, rounded up, plus one for the rounding of each edge;
+    //   a span of n pixels touches at most n / tile_size + 2 tiles
+    //
+    const auto span = [](uint64_t extent, uint64_t target, uint64_t grid) -> uint64_t {
+
+        const auto pixels = (extent * target + grid - 1) / grid + 1;
+
+        return pixels / tile_size + 2;
+    };
+
+    const auto tiles = tile_counts(target_size);
+    const auto across = span(geometry::width(pattern.base_region),  target_size.x, pattern.grid_size.x);
+    const auto down   = span(geometry::height(pattern.base_region), target_size.y, pattern.grid_size.y);
+
+    return instance_count(table, pattern) * ( (across < tiles.x) ? across : tiles.x )
+                                          * ( (down   < tiles.y) ? down   : tiles.y );
+}
+
+#endif // !defined ( __METAL_VERSION__ )
@@ -0,0 +1,61 @@
+//
+//  Tracing.h
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#import <Foundation/Foundation.h>
+
+//===------------------------------------------------------------------------===
+//
+#pragma mark - Tracing Declaration
+//
+//  - The trace of Trace.hpp, for Swift. Names are interned, so any string
+//    will do. Built with PLAY_TRACE=0 every method does nothing
+//
+//===------------------------------------------------------------------------===
+
+@interface Tracing : NSObject
+
+@property (class, nonatomic, getter=isEnabled) BOOL enabled;
+
+// • Nanoseconds on the trace clock, to start an interval
+//
++ (uint64_t)now;
+
+// • An interval from `start` (from now) to now
+//
++ (void)recordIntervalNamed:(nonnull NSString*)name
+                   category:(nonnull NSString*)category
+                      start:(uint64_t)start NS_SWIFT_NAME(recordInterval(_:category:start:));
+
+// • An interval in host time (CACurrentMediaTime), e.g. the GPU time of an
+//   MTLCommandBuffer from gpuStartTime to gpuEndTime
+//
++ (void)recordHostTimeIntervalNamed:(nonnull NSString*)name
+                           category:(nonnull NSString*)category
+                          startTime:(CFTimeInterval)startTime
+                            endTime:(CFTimeInterval)endTime NS_SWIFT_NAME(recordInterval(_:category:startTime:endTime:));
+
++ (void)recordCounterNamed:(nonnull NSString*)name
+                     value:(int64_t)value NS_SWIFT_NAME(recordCounter(_:value:));
+
+// • Export (Chrome trace event format)
+//
++ (void)clear;
++ (BOOL)writeChromeTraceToURL:(nonnull NSURL*)url;
+
+@end
@@ -0,0 +1,112 @@
+//
+//  Tracing.mm
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#import "Tracing.h"
+#import <Data/Trace.hpp>
+
+#import <QuartzCore/QuartzCore.h>
+#import <algorithm>
+
+//===------------------------------------------------------------------------===
+//
+#pragma mark - Tracing Implementation
+//
+//===------------------------------------------------------------------------===
+
+@implementation Tracing
+
+//===------------------------------------------------------------------------===
+#pragma mark - Recording
+//===------------------------------------------------------------------------===
+
++ (BOOL)isEnabled {
+
+    return PLAY_TRACE && trace::is_enabled();
+}
+
++ (void)setEnabled:(BOOL)enabled {
+
+    trace::set_enabled(PLAY_TRACE && enabled);
+}
+
++ (uint64_t)now {
+
+    return trace::now();
+}
+
++ (void)recordIntervalNamed:(NSString*)name category:(NSString*)category start:(uint64_t)start {
+
+#if PLAY_TRACE
+    if (trace::is_enabled()) {
+        trace::interval( trace::intern(name.UTF8String), trace::intern(category.UTF8String),
+                         start, trace::now() );
+    }
+#endif
+}
+
++ (void)recordHostTimeIntervalNamed:(NSString*)name
+                           category:(NSString*)category
+                          startTime:(CFTimeInterval)startTime
+                            endTime:(CFTimeInterval)endTime {
+
+#if PLAY_TRACE
+    if (trace::is_enabled() && startTime < endTime) {
+
+        // • Host time to the trace clock, through the present on both
+        //
+        const auto now       = trace::now();
+        const auto host_now  = CACurrentMediaTime();
+        const auto to_trace  = [=](CFTimeInterval time) {
+            return now - static_cast<uint64_t>( std::max(0.0, host_now - time) * 1e9 );
+        };
+
+        trace::interval( trace::intern(name.UTF8String), trace::intern(category.UTF8String),
+                         to_trace(startTime), to_trace(endTime) );
+    }
+#endif
+}
+
++ (void)recordCounterNamed:(NSString*)name value:(int64_t)value {
+
+#if PLAY_TRACE
+    if (trace::is_enabled()) {
+        trace::counter(trace::intern(name.UTF8String), value);
+    }
+#endif
+}
+
+//===------------------------------------------------------------------------===
+#pragma mark - Export
+//===------------------------------------------------------------------------===
+
++ (void)clear {
+
+    trace::clear();
+}
+
++ (BOOL)writeChromeTraceToURL:(NSURL*)url {
+
+    if (!url.isFileURL) {
+        return NO;
+    }
+
+    return trace::write_chrome_trace(url.fileSystemRepresentation);
+}
+
+@end
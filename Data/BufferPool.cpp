@@ -0,0 +1,405 @@
+//
+//  BufferPool.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Data/BufferPool.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+
+//===------------------------------------------------------------------------===
+// • namespace data
+//===------------------------------------------------------------------------===
+
+namespace data
+{
+
+SlabSource host_slab_source(void)
+{
+    return {
+        .allocate = [](uint32_t size) -> std::optional<Slab> {
+
+            auto memory = static_cast<uint8_t*>( std::aligned_alloc(alignment, aligned_size(size)) );
+
+            if (nullptr == memory) {
+                return std::nullopt;
+            }
+
+            return Slab { .contents = memory, .handle = memory };
+        },
+        .release = [](const Slab& slab) {
+            std::free(slab.handle);
+        }
+    };
+}
+
+//===------------------------------------------------------------------------===
+// • BufferPool
+//===------------------------------------------------------------------------===
+
+BufferPool::BufferPool(SlabSource source, uint32_t slab_size)
+    : source     { std::move(source) },
+      slab_bytes { std::bit_ceil( std::clamp<uint32_t>(slab_size, minimum_slab_size, maximum_slab_size) ) }
+{
+    classes.resize( size_class( maximum_class_size() ) + 1 );
+}
+
+BufferPool::~BufferPool()
+{
+    for (const auto& slab : slabs) {
+        if (slab.in_use) {
+            source.release(slab.memory);
+        }
+    }
+}
+
+//===------------------------------------------------------------------------===
+// • Allocation
+//===------------------------------------------------------------------------===
+
+std::optional<PoolAllocation> BufferPool::allocate(uint32_t size)
+{
+    if (UINT32_MAX - alignment < size) {
+        return std::nullopt;
+    }
+
+    // • A slab of its own
+    //
+    if (maximum_class_size() < size) {
+
+        const auto block_size = aligned_size(size);
+        const auto index      = add_slab(block_size, large_class, block_size);
+
+        if (!index) {
+            return std::nullopt;
+        }
+
+        auto& slab = slabs[*index];
+
+        slab.carved         = block_size;
+        slab.live           = 1;
+        slab.live_blocks[0] = 1;
+
+        ++allocation_count;
+        requested_bytes += size;
+        allocated_bytes += block_size;
+
+        return PoolAllocation { .slab = *index, .offset = 0, .size = size };
+    }
+
+    // • A block of the class: a freed one if the slab has any, else the next
+    //   one never handed out
+    //
+    const auto size_class = data::size_class(size);
+    auto&      available  = classes[size_class].available;
+
+    if (available.empty()) {
+
+        // • In 64 bits: blocks_per_slab blocks of the largest classes of a
+        //   large pool don't fit in 32
+        //
+        const auto block_size = class_size(size_class);
+        const auto blocks     = std::bit_ceil( uint64_t { blocks_per_slab } * block_size );
+        const auto slab_size  = static_cast<uint32_t>(
+            std::clamp<uint64_t>( blocks, std::max<uint32_t>(minimum_slab_size, block_size), slab_bytes ) );
+        const auto index      = add_slab(slab_size, size_class, block_size);
+
+        if (!index) {
+            return std::nullopt;
+        }
+
+        available.push_back(*index);
+    }
+
+    const auto index = available.back();
+    auto&      slab  = slabs[index];
+
+    uint32_t offset;
+
+    if (!slab.free_offsets.empty()) {
+        offset = slab.free_offsets.back();
+        slab.free_offsets.pop_back();
+    } else {
+        offset       = slab.carved;
+        slab.carved += slab.block_size;
+    }
+
+    const auto block = offset / slab.block_size;
+
+    slab.live_blocks[block/64] |= uint64_t{1} << (block % 64);
+    ++slab.live;
+
+    if (is_full(slab)) {
+        available.pop_back();
+    }
+
+    ++allocation_count;
+    requested_bytes += size;
+    allocated_bytes += slab.block_size;
+
+    return PoolAllocation { .slab = index, .offset = offset, .size = size };
+}
+
+bool BufferPool::free(const PoolAllocation& allocation)
+{
+    if (nullptr == find(allocation)) {
+        return false;
+    }
+
+    auto&      slab  = slabs[allocation.slab];
+    const auto block = allocation.offset / slab.block_size;
+
+    slab.live_blocks[block/64] &= ~(uint64_t{1} << (block % 64));
+    --slab.live;
+
+    --allocation_count;
+    requested_bytes -= allocation.size;
+    allocated_bytes -= slab.block_size;
+
+    if (large_class == slab.size_class) {
+        release_slab(allocation.slab);
+        return true;
+    }
+
+    if (is_full(slab)) {
+        classes[slab.size_class].available.push_back(allocation.slab);
+    }
+
+    // • An empty slab starts over, handing out its blocks in order again
+    //
+    if (0 == slab.live) {
+        slab.free_offsets.clear();
+        slab.carved = 0;
+    } else {
+        slab.free_offsets.push_back(allocation.offset);
+    }
+
+    return true;
+}
+
+uint8_t* BufferPool::contents(const PoolAllocation& allocation) const noexcept
+{
+    const auto slab = find(allocation);
+
+    return (nullptr != slab && nullptr != slab->memory.contents)
+         ? slab->memory.contents + allocation.offset
+         : nullptr;
+}
+
+void* BufferPool::handle(const PoolAllocation& allocation) const noexcept
+{
+    const auto slab = find(allocation);
+
+    return (nullptr != slab) ? slab->memory.handle : nullptr;
+}
+
+uint32_t BufferPool::capacity(const PoolAllocation& allocation) const noexcept
+{
+    const auto slab = find(allocation);
+
+    return (nullptr != slab) ? slab->block_size : 0;
+}
+
+//===------------------------------------------------------------------------===
+// • Frames
+//===------------------------------------------------------------------------===
+
+std::optional<PoolAllocation> BufferPool::allocate_for_frame(uint32_t size)
+{
+    const auto allocation = allocate(size);
+
+    if (allocation) {
+        open_frame.push_back(*allocation);
+        ++frame_allocations;
+    }
+
+    return allocation;
+}
+
+uint64_t BufferPool::end_frame(void)
+{
+    if (!open_frame.empty()) {
+
+        closed_frames.push_back( { next_frame, std::move(open_frame) } );
+
+        open_frame.clear();
+
+        if (!spare_lists.empty()) {
+            open_frame = std::move(spare_lists.back());
+            spare_lists.pop_back();
+        }
+    }
+
+    return next_frame++;
+}
+
+void BufferPool::release_frames(uint64_t completed)
+{
+    while (!closed_frames.empty() && closed_frames.front().frame < completed) {
+
+        auto& allocations = closed_frames.front().allocations;
+
+        for (const auto& allocation : allocations) {
+            free(allocation);
+        }
+
+        frame_allocations -= static_cast<uint32_t>( allocations.size() );
+
+        // • Keep the list's storage for a later frame
+        //
+        allocations.clear();
+        spare_lists.push_back( std::move(allocations) );
+
+        closed_frames.pop_front();
+    }
+}
+
+//===------------------------------------------------------------------------===
+// • Slabs
+//===------------------------------------------------------------------------===
+
+uint64_t BufferPool::trim(void)
+{
+    uint64_t released = 0;
+
+    for (auto& size_class : classes) {
+
+        auto& available = size_class.available;
+
+        const auto empty = std::stable_partition( available.begin(), available.end(), [&](uint32_t index) {
+            return 0 < slabs[index].live;
+        } );
+
+        for (auto slab = empty; slab != available.end(); ++slab) {
+            released += slabs[*slab].size;
+            release_slab(*slab);
+        }
+
+        available.erase(empty, available.end());
+    }
+
+    return released;
+}
+
+PoolStatistics BufferPool::statistics(void) const noexcept
+{
+    PoolStatistics statistics = {
+        .slab_count             = 0,
+        .empty_slab_count       = 0,
+        .slab_bytes             = 0,
+        .empty_slab_bytes       = 0,
+        .allocation_count       = allocation_count,
+        .frame_allocation_count = frame_allocations,
+        .requested_bytes        = requested_bytes,
+        .allocated_bytes        = allocated_bytes
+    };
+
+    for (const auto& slab : slabs) {
+
+        if (!slab.in_use) {
+            continue;
+        }
+
+        ++statistics.slab_count;
+        statistics.slab_bytes += slab.size;
+
+        if (0 == slab.live) {
+            ++statistics.empty_slab_count;
+            statistics.empty_slab_bytes += slab.size;
+        }
+    }
+
+    return statistics;
+}
+
+//===------------------------------------------------------------------------===
+// • Private
+//===------------------------------------------------------------------------===
+
+std::optional<uint32_t> BufferPool::add_slab(uint32_t size, uint32_t size_class, uint32_t block_size)
+{
+    const auto memory = source.allocate(size);
+
+    if (!memory) {
+        return std::nullopt;
+    }
+
+    uint32_t index;
+
+    if (!free_slots.empty()) {
+        index = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        index = static_cast<uint32_t>( slabs.size() );
+        slabs.emplace_back();
+    }
+
+    auto& slab = slabs[index];
+
+    slab.memory     = *memory;
+    slab.size       = size;
+    slab.size_class = size_class;
+    slab.block_size = block_size;
+    slab.carved     = 0;
+    slab.live       = 0;
+    slab.in_use     = true;
+
+    slab.free_offsets.clear();
+    slab.live_blocks.assign( (size/block_size + 63)/64, 0 );
+
+    return index;
+}
+
+void BufferPool::release_slab(uint32_t index)
+{
+    auto& slab = slabs[index];
+
+    source.release(slab.memory);
+
+    slab.in_use = false;
+    slab.free_offsets = {};
+    slab.live_blocks  = {};
+
+    free_slots.push_back(index);
+}
+
+bool BufferPool::is_full(const SlabState& slab) const noexcept
+{
+    return slab.free_offsets.empty() && slab.size - slab.carved < slab.block_size;
+}
+
+// • The slab of `allocation` if the allocation is in use
+//
+const BufferPool::SlabState* BufferPool::find(const PoolAllocation& allocation) const noexcept
+{
+    if (slabs.size() <= allocation.slab) {
+        return nullptr;
+    }
+
+    const auto& slab = slabs[allocation.slab];
+
+    if (!slab.in_use || slab.carved <= allocation.offset || 0 != allocation.offset % slab.block_size) {
+        return nullptr;
+    }
+
+    const auto block = allocation.offset / slab.block_size;
+
+    return (0 != (slab.live_blocks[block/64] & (uint64_t{1} << (block % 64)))) ? &slab : nullptr;
+}
+
+} // namespace data
@@ -0,0 +1,327 @@
+//
+//  BufferPool.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Data/Layout.hpp>
+
+#include <bit>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • namespace data
+//===------------------------------------------------------------------------===
+
+namespace data
+{
+
+//===------------------------------------------------------------------------===
+// • Size classes
+//
+//  - Sizes round up to a multiple of 16 (aligned_size), one class per step up
+//    to 512 bytes, then four classes per doubling, so a block wastes at most
+//    15 bytes or a fifth of its size. Every class size is a multiple of 16
+//===------------------------------------------------------------------------===
+
+enum : uint32_t
+{
+    linear_class_limit   = 512,
+    linear_class_count   = linear_class_limit / alignment,
+    linear_class_bits    = 9,   // log2 of linear_class_limit
+    classes_per_doubling = 4
+};
+
+constexpr uint32_t size_class(uint32_t size) noexcept
+{
+    const auto aligned = aligned_size( (0 < size) ? size : 1u );
+
+    if (aligned <= linear_class_limit) {
+        return aligned/alignment - 1;
+    }
+
+    const auto doubling = static_cast<uint32_t>( std::bit_width(aligned - 1) ) - 1;
+    const auto step     = (1u << doubling) / classes_per_doubling;
+
+    return linear_class_count + (doubling - linear_class_bits)*classes_per_doubling
+         + (aligned - 1 - (1u << doubling))/step;
+}
+
+constexpr uint32_t class_size(uint32_t size_class) noexcept
+{
+    if (size_class < linear_class_count) {
+        return (size_class + 1)*alignment;
+    }
+
+    const auto doubling = linear_class_bits + (size_class - linear_class_count)/classes_per_doubling;
+    const auto step     = (1u << doubling) / classes_per_doubling;
+
+    return (1u << doubling) + (1 + (size_class - linear_class_count) % classes_per_doubling)*step;
+}
+
+static_assert( 16   == class_size( size_class(1) ) );
+static_assert( 512  == class_size( size_class(500) ) );
+static_assert( 640  == class_size( size_class(513) ) );
+static_assert( 1024 == class_size( size_class(1024) ) );
+static_assert( 1280 == class_size( size_class(1025) ) );
+
+//===------------------------------------------------------------------------===
+// • SlabSource
+//
+//  - Where a BufferPool gets its slabs: `allocate` returns `size` bytes,
+//    16-byte aligned, as the CPU address of their contents (nullptr when the
+//    CPU can't see them, e.g. private GPU storage) and an opaque handle, e.g.
+//    an MTLBuffer (see MetalBufferPool.h). `release` gives one back
+//===------------------------------------------------------------------------===
+
+struct Slab
+{
+    uint8_t*    contents;
+    void*       handle;
+};
+
+struct SlabSource
+{
+    std::function<std::optional<Slab>(uint32_t size)>   allocate;
+    std::function<void(const Slab& slab)>               release;
+};
+
+// • Host memory from aligned_alloc, as a stand-in for buffers on Linux
+//
+SlabSource host_slab_source(void);
+
+//===------------------------------------------------------------------------===
+// • PoolAllocation
+//
+//  - `size` bytes at `offset` in slab `slab` of a pool. The offset is a
+//    multiple of 16, so it can be bound as a buffer offset directly
+//===------------------------------------------------------------------------===
+
+struct PoolAllocation
+{
+    uint32_t    slab;
+    uint32_t    offset;
+    uint32_t    size;
+};
+
+//===------------------------------------------------------------------------===
+// • PoolStatistics
+//===------------------------------------------------------------------------===
+
+struct PoolStatistics
+{
+    uint32_t    slab_count;
+    uint32_t    empty_slab_count;       // Returned to the source by trim
+    uint64_t    slab_bytes;             // Taken from the source, large allocations included
+    uint64_t    empty_slab_bytes;
+    uint32_t    allocation_count;
+    uint32_t    frame_allocation_count; // Still waiting for their frame to complete
+    uint64_t    requested_bytes;
+    uint64_t    allocated_bytes;        // Rounded up to their size classes
+};
+
+// • Fraction of the allocated bytes lost to rounding up to a size class
+//
+constexpr double internal_fragmentation(const PoolStatistics& statistics) noexcept
+{
+    return (0 < statistics.allocated_bytes)
+         ? 1.0 - static_cast<double>(statistics.requested_bytes)/statistics.allocated_bytes
+         : 0.0;
+}
+
+// • Fraction of the slab bytes that are free but stranded in slabs still in
+//   use, where only allocations of the same class can reach them
+//
+constexpr double external_fragmentation(const PoolStatistics& statistics) noexcept
+{
+    const auto stranded = statistics.slab_bytes - statistics.empty_slab_bytes - statistics.allocated_bytes;
+
+    return (0 < statistics.slab_bytes)
+         ? static_cast<double>(stranded)/statistics.slab_bytes
+         : 0.0;
+}
+
+//===------------------------------------------------------------------------===
+//
+// • BufferPool
+//
+//  - Sub-allocates blocks from large slabs, each slab holding blocks of a
+//    single size class, so that many small buffers share a few MTLBuffers.
+//    A slab holds at least blocks_per_slab blocks, so small classes take
+//    small slabs, up to slab_size. Freed blocks go back to their slab; a
+//    slab with no blocks left in use is kept for reuse until trim.
+//    Allocations larger than a quarter of slab_size get a slab of their own,
+//    returned as soon as they're freed
+//
+//  - allocate_for_frame ties an allocation to the frame being built: end_frame
+//    closes it, and release_frames frees every allocation of the frames that
+//    completed at once. Closing one frame per FrameRing commit keeps the
+//    numbering of the two in step, so release_frames(completed_frames())
+//    frees what the GPU is done with
+//
+//  - Blocks aren't zeroed. Bookkeeping lives on the host, never in a slab,
+//    so slabs may be private GPU memory. Not thread safe: a completed
+//    handler should only advance a FrameRing, and the producer release the
+//    frames it completed
+//
+//===------------------------------------------------------------------------===
+
+class BufferPool
+{
+public:
+
+    enum : uint32_t
+    {
+        minimum_slab_size = 64 << 10,
+        default_slab_size = 1  << 20,
+        maximum_slab_size = 1u << 31,
+        blocks_per_slab   = 256
+    };
+
+    // • Slabs of up to `slab_size` bytes, rounded to a power of two between
+    //   minimum_slab_size and maximum_slab_size
+    //
+    explicit BufferPool( SlabSource source = host_slab_source(),
+                         uint32_t slab_size = default_slab_size );
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator = (const BufferPool&) = delete;
+
+    uint32_t slab_size(void) const noexcept
+    {
+        return slab_bytes;
+    }
+
+    // • The largest size carved from a shared slab
+    //
+    uint32_t maximum_class_size(void) const noexcept
+    {
+        return slab_bytes / 4;
+    }
+
+    //===------------------------------------------------------------------===
+    // • Allocation
+    //===------------------------------------------------------------------===
+
+    // • A block of at least `size` bytes, until freed
+    //
+    std::optional<PoolAllocation> allocate(uint32_t size);
+
+    // • False, changing nothing, if `allocation` isn't in use, e.g. it was
+    //   already freed
+    //
+    bool free(const PoolAllocation& allocation);
+
+    // • The CPU address of `allocation`, or nullptr if its slab has none
+    //
+    uint8_t* contents(const PoolAllocation& allocation) const noexcept;
+
+    // • The handle of the slab holding `allocation` (see SlabSource)
+    //
+    void* handle(const PoolAllocation& allocation) const noexcept;
+
+    // • The size of the block holding `allocation`: its size class, or its
+    //   size rounded to 16 for a slab of its own
+    //
+    uint32_t capacity(const PoolAllocation& allocation) const noexcept;
+
+    //===------------------------------------------------------------------===
+    // • Frames
+    //===------------------------------------------------------------------===
+
+    // • A block of at least `size` bytes, freed by release_frames once the
+    //   frame being built completes. Never pass it to free
+    //
+    std::optional<PoolAllocation> allocate_for_frame(uint32_t size);
+
+    // • Close the frame being built, returning its number: zero for the
+    //   first, one more for each after
+    //
+    uint64_t end_frame(void);
+
+    // • Free the allocations of every closed frame before frame `completed`
+    //
+    void release_frames(uint64_t completed);
+
+    //===------------------------------------------------------------------===
+    // • Slabs
+    //===------------------------------------------------------------------===
+
+    // • Return every empty slab to the source, returning the bytes released
+    //
+    uint64_t trim(void);
+
+    PoolStatistics statistics(void) const noexcept;
+
+private:
+
+    enum : uint32_t
+    {
+        large_class = UINT32_MAX
+    };
+
+    struct SlabState
+    {
+        Slab                    memory;
+        uint32_t                size;
+        uint32_t                size_class;
+        uint32_t                block_size;
+        uint32_t                carved;         // Bytes handed out at least once
+        uint32_t                live;           // Blocks in use
+        bool                    in_use;         // The slot holds a slab
+        std::vector<uint32_t>   free_offsets;
+        std::vector<uint64_t>   live_blocks;    // One bit per block
+    };
+
+    struct ClassState
+    {
+        std::vector<uint32_t>   available;      // Slabs with a block free
+    };
+
+    struct FrameAllocations
+    {
+        uint64_t                    frame;
+        std::vector<PoolAllocation> allocations;
+    };
+
+    std::optional<uint32_t> add_slab(uint32_t size, uint32_t size_class, uint32_t block_size);
+    void                    release_slab(uint32_t index);
+    bool                    is_full(const SlabState& slab) const noexcept;
+    const SlabState*        find(const PoolAllocation& allocation) const noexcept;
+
+    SlabSource                      source;
+    uint32_t                        slab_bytes;
+    std::vector<SlabState>          slabs;
+    std::vector<uint32_t>           free_slots;
+    std::vector<ClassState>         classes;
+    uint32_t                        allocation_count = 0;
+    uint64_t                        requested_bytes  = 0;
+    uint64_t                        allocated_bytes  = 0;
+    uint64_t                        next_frame       = 0;
+    std::vector<PoolAllocation>     open_frame;
+    std::deque<FrameAllocations>    closed_frames;
+    uint32_t                        frame_allocations = 0;
+    std::vector<std::vector<PoolAllocation>> spare_lists;
+};
+
+} // namespace data
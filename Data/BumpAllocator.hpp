@@ -0,0 +1,283 @@
+//
+//  BumpAllocator.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Data/Containers.hpp>
+#include <Data/Layout.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+
+//===------------------------------------------------------------------------===
+// • namespace data
+//===------------------------------------------------------------------------===
+
+namespace data
+{
+
+//===------------------------------------------------------------------------===
+//
+// • BumpAllocator
+//
+//  - Lays out References and containers one after another in a single
+//    16-byte aligned block, zero filled. Everything allocated is addressed
+//    by its offset from the start of the block, so the block can be copied
+//    to an MTLBuffer or written to a file without fixups
+//
+//  - Over caller memory (e.g. MTLBuffer contents) the block has a fixed size.
+//    Otherwise the allocator owns the block and doubles it as needed, which
+//    moves the block: offsets stay valid, pointers from at() do not
+//
+//===------------------------------------------------------------------------===
+
+class BumpAllocator
+{
+public:
+
+    // • Fixed block over caller memory, which must be 16-byte aligned
+    //
+    BumpAllocator(void* memory, uint32_t size) noexcept
+        : block    { is_aligned(memory) ? static_cast<uint8_t*>(memory) : nullptr },
+          capacity { is_aligned(memory) ? size & ~0x0fu : 0u },
+          used     { 0 },
+          owned    { false }
+    {
+    }
+
+    // • Owned, growable block
+    //
+    explicit BumpAllocator(uint32_t initial_capacity = 4096) noexcept
+        : block    { nullptr },
+          capacity { 0 },
+          used     { 0 },
+          owned    { true }
+    {
+        reserve(initial_capacity);
+    }
+
+    BumpAllocator(const BumpAllocator&) = delete;
+    BumpAllocator& operator = (const BumpAllocator&) = delete;
+
+    BumpAllocator(BumpAllocator&& other) noexcept
+        : block    { other.block },
+          capacity { other.capacity },
+          used     { other.used },
+          owned    { other.owned }
+    {
+        other.block    = nullptr;
+        other.capacity = 0;
+        other.used     = 0;
+        other.owned    = false;
+    }
+
+    ~BumpAllocator()
+    {
+        if (owned) {
+            std::free(block);
+        }
+    }
+
+    // • The block, and the number of bytes allocated from it
+    //
+    const uint8_t* data(void) const noexcept { return block; }
+    uint8_t*       data(void)       noexcept { return block; }
+
+    uint32_t size(void) const noexcept { return used; }
+
+    // • Discard everything allocated, keeping the block
+    //
+    void reset(void) noexcept
+    {
+        used = 0;
+    }
+
+    // • Raw allocation: offset of `size` zeroed bytes, 16-byte aligned.
+    //   Sizes that don't round up to a multiple of 16 in 32 bits fail
+    //
+    std::optional<uint32_t> allocate(uint32_t size)
+    {
+        if (UINT32_MAX - alignment < size) {
+            return std::nullopt;
+        }
+
+        const auto offset   = used;
+        const auto required = static_cast<uint64_t>(offset) + aligned_size(size);
+
+        if (UINT32_MAX < required || (capacity < required && !reserve(static_cast<uint32_t>(required)))) {
+            return std::nullopt;
+        }
+
+        std::memset(block + offset, 0, required - offset);
+        used = static_cast<uint32_t>(required);
+
+        return offset;
+    }
+
+    // • Typed allocation
+    //
+    template <TrivialLayout Type_>
+    std::optional<Reference<Type_>> allocate(void)
+    {
+        const auto offset = allocate(aligned_size<Type_>());
+
+        if (!offset) {
+            return std::nullopt;
+        }
+
+        return Reference<Type_> { *offset };
+    }
+
+    template <TrivialLayout Type_>
+    std::optional<array<Type_>> allocate_array(uint32_t count)
+    {
+        const auto offset = allocate_elements<Type_>(count);
+
+        if (!offset) {
+            return std::nullopt;
+        }
+
+        return array<Type_> { .offset = *offset, .count = count };
+    }
+
+    template <TrivialLayout Type_>
+    std::optional<array<Type_>> copy_array(std::span<const Type_> elements)
+    {
+        const auto result = allocate_array<Type_>( static_cast<uint32_t>(elements.size()) );
+
+        if (result && !elements.empty()) {
+            std::memcpy(block + result->offset, elements.data(), elements.size_bytes());
+        }
+
+        return result;
+    }
+
+    template <TrivialLayout Type_>
+    std::optional<vector<Type_>> allocate_vector(uint32_t capacity)
+    {
+        const auto offset = allocate_elements<Type_>(capacity);
+
+        if (!offset) {
+            return std::nullopt;
+        }
+
+        return vector<Type_> { .offset = *offset, .count = 0, .capacity = capacity };
+    }
+
+    std::optional<string> copy_string(std::string_view text)
+    {
+        if (UINT32_MAX <= text.size()) {
+            return std::nullopt;
+        }
+
+        const auto length = static_cast<uint32_t>( text.size() );
+        const auto offset = allocate(length + 1);
+
+        if (!offset) {
+            return std::nullopt;
+        }
+
+        std::memcpy(block + *offset, text.data(), length);
+
+        return string { .offset = *offset, .length = length };
+    }
+
+    // • Access to what was allocated, valid until the block next grows
+    //
+    template <TrivialLayout Type_>
+    Type_* at(Reference<Type_> reference) noexcept
+    {
+        return offset_by<Type_>(block, reference.offset);
+    }
+
+    template <TrivialLayout Type_>
+    std::span<Type_> at(array<Type_> elements) noexcept
+    {
+        return view(block, elements);
+    }
+
+    template <TrivialLayout Type_>
+    std::span<Type_> at(vector<Type_> elements) noexcept
+    {
+        return view(block, elements);
+    }
+
+    std::string_view at(string text) const noexcept
+    {
+        return view(block, text);
+    }
+
+private:
+
+    template <TrivialLayout Type_>
+    std::optional<uint32_t> allocate_elements(uint32_t count)
+    {
+        const auto size = static_cast<uint64_t>(count) * sizeof(Type_);
+
+        if (UINT32_MAX < size) {
+            return std::nullopt;
+        }
+
+        return allocate( static_cast<uint32_t>(size) );
+    }
+
+    bool reserve(uint32_t required)
+    {
+        if (required <= capacity) {
+            return true;
+        }
+
+        if (!owned) {
+            return false;
+        }
+
+        const auto doubled      = std::max<uint64_t>( 2*static_cast<uint64_t>(capacity), alignment );
+        const auto new_capacity = static_cast<uint32_t>(
+                                    std::min<uint64_t>( std::max<uint64_t>(doubled, required),
+                                                        UINT32_MAX & ~0x0fu ) );
+
+        auto new_block = static_cast<uint8_t*>( std::aligned_alloc(alignment, new_capacity) );
+
+        if (nullptr == new_block) {
+            return false;
+        }
+
+        if (0 < used) {
+            std::memcpy(new_block, block, used);
+        }
+
+        std::free(block);
+
+        block    = new_block;
+        capacity = new_capacity;
+
+        return true;
+    }
+
+    uint8_t*    block;
+    uint32_t    capacity;
+    uint32_t    used;
+    bool        owned;
+};
+
+} // namespace data
@@ -0,0 +1,181 @@
+//
+//  Containers.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Data/Layout.hpp>
+
+#if !defined ( __METAL_VERSION__ )
+#include <span>
+#include <string_view>
+#endif
+
+//===------------------------------------------------------------------------===
+// • namespace data
+//===------------------------------------------------------------------------===
+
+namespace data
+{
+
+//===------------------------------------------------------------------------===
+//
+// • Offset-addressed containers (Host and Metal)
+//
+//  - Like Reference, each holds the offset of its elements from a root
+//    rather than a pointer, so a block of them can be copied to a buffer
+//    or a file and used as-is. Elements are always 16-byte aligned
+//
+//===------------------------------------------------------------------------===
+
+//===------------------------------------------------------------------------===
+// • array: fixed number of elements
+//===------------------------------------------------------------------------===
+
+template <TRIVIAL_LAYOUT Type_>
+struct array
+{
+    using value_type = Type_;
+
+    uint32_t offset;
+    uint32_t count;
+};
+
+//===------------------------------------------------------------------------===
+// • vector: up to capacity elements, storage reserved up front
+//===------------------------------------------------------------------------===
+
+template <TRIVIAL_LAYOUT Type_>
+struct vector
+{
+    using value_type = Type_;
+
+    uint32_t offset;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+//===------------------------------------------------------------------------===
+// • string: UTF-8, stored with a terminating zero not included in length
+//===------------------------------------------------------------------------===
+
+struct string
+{
+    using value_type = char;
+
+    uint32_t offset;
+    uint32_t length;
+};
+
+#if !defined ( __METAL_VERSION__ )
+
+static_assert( is_referential<array<uint32_t>>(),  "Unexpected reference" );
+static_assert( is_referential<vector<uint32_t>>(), "Unexpected reference" );
+static_assert( is_referential<string>(),           "Unexpected reference" );
+
+static_assert( is_trivial_layout<array<uint32_t>>(),  "Unexpected layout" );
+static_assert( is_trivial_layout<vector<uint32_t>>(), "Unexpected layout" );
+static_assert( is_trivial_layout<string>(),           "Unexpected layout" );
+
+//===------------------------------------------------------------------------===
+//
+// • Views (Host)
+//
+//===------------------------------------------------------------------------===
+
+template <TrivialLayout Type_, TrivialLayout Root_>
+const Type_* resolve(const Root_* root, Reference<Type_> reference)
+{
+    return offset_by<Type_>(root, reference.offset);
+}
+
+template <TrivialLayout Type_, TrivialLayout Root_>
+Type_* resolve(Root_* root, Reference<Type_> reference)
+{
+    return offset_by<Type_>(root, reference.offset);
+}
+
+template <TrivialLayout Type_, TrivialLayout Root_>
+std::span<const Type_> view(const Root_* root, array<Type_> elements)
+{
+    return { offset_by<Type_>(root, elements.offset), elements.count };
+}
+
+template <TrivialLayout Type_, TrivialLayout Root_>
+std::span<Type_> view(Root_* root, array<Type_> elements)
+{
+    return { offset_by<Type_>(root, elements.offset), elements.count };
+}
+
+template <TrivialLayout Type_, TrivialLayout Root_>
+std::span<const Type_> view(const Root_* root, vector<Type_> elements)
+{
+    return { offset_by<Type_>(root, elements.offset), elements.count };
+}
+
+template <TrivialLayout Type_, TrivialLayout Root_>
+std::span<Type_> view(Root_* root, vector<Type_> elements)
+{
+    return { offset_by<Type_>(root, elements.offset), elements.count };
+}
+
+template <TrivialLayout Root_>
+std::string_view view(const Root_* root, string text)
+{
+    return { offset_by<char>(root, text.offset), text.length };
+}
+
+//===------------------------------------------------------------------------===
+// • vector modification (Host)
+//===------------------------------------------------------------------------===
+
+// • Append within the reserved capacity, returning false when full
+//
+template <TrivialLayout Type_, TrivialLayout Root_>
+bool push_back(Root_* root, vector<Type_>& elements, const Type_& value)
+{
+    if (elements.capacity <= elements.count) {
+        return false;
+    }
+
+    offset_by<Type_>(root, elements.offset)[elements.count++] = value;
+
+    return true;
+}
+
+template <TrivialLayout Type_>
+bool pop_back(vector<Type_>& elements)
+{
+    if (0 == elements.count) {
+        return false;
+    }
+
+    --elements.count;
+
+    return true;
+}
+
+template <TrivialLayout Type_>
+void clear(vector<Type_>& elements)
+{
+    elements.count = 0;
+}
+
+#endif // !defined ( __METAL_VERSION__ )
+
+} // namespace data
@@ -0,0 +1,261 @@
+//
+//  FrameRing.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Data/Layout.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+
+//===------------------------------------------------------------------------===
+// • namespace data
+//===------------------------------------------------------------------------===
+
+namespace data
+{
+
+//===------------------------------------------------------------------------===
+//
+// • FrameRing
+//
+//  - Slot indices for Count_ buffers used in turn by frames in flight: the
+//    host fills the slot of frame N+1 while the GPU still reads those of
+//    earlier frames, and waits only when every slot is in flight
+//
+//  - Frames move through three counters, each advanced by one side only:
+//    committed (producer), consumed (consumer) and completed (whoever learns
+//    that the consumer is done with a frame, e.g. an MTLCommandBuffer
+//    completed handler). Frame f uses slot f % Count_
+//
+//  - One producer thread and one consumer thread; no locks. When the GPU is
+//    the consumer, committing a command buffer consumes its frame, so only
+//    acquire, commit and complete are used
+//
+//===------------------------------------------------------------------------===
+
+template <uint32_t Count_>
+class FrameRing
+{
+public:
+
+    static_assert( 0 < Count_, "A ring needs at least one slot" );
+
+    static constexpr uint32_t count = Count_;
+
+    //===------------------------------------------------------------------===
+    // • Producer
+    //===------------------------------------------------------------------===
+
+    // • Slot for the next frame if one is free, i.e. the frame Count_ before
+    //   it has completed
+    //
+    std::optional<uint32_t> try_acquire(void) const noexcept
+    {
+        const auto frame = committed.load(std::memory_order_relaxed);
+
+        if (frame - completed.load(std::memory_order_acquire) < Count_) {
+            return slot(frame);
+        }
+
+        return std::nullopt;
+    }
+
+    // • Slot for the next frame, waiting for one to complete if none is free
+    //
+    uint32_t acquire(void) const noexcept
+    {
+        const auto frame = committed.load(std::memory_order_relaxed);
+
+        for (auto done = completed.load(std::memory_order_acquire); Count_ <= frame - done;
+             done = completed.load(std::memory_order_acquire)) {
+
+            completed.wait(done, std::memory_order_acquire);
+        }
+
+        return slot(frame);
+    }
+
+    // • The acquired slot holds the next frame, which is now in flight
+    //
+    void commit(void) noexcept
+    {
+        committed.fetch_add(1, std::memory_order_release);
+        committed.notify_one();
+    }
+
+    //===------------------------------------------------------------------===
+    // • Consumer
+    //===------------------------------------------------------------------===
+
+    // • Slot of the oldest committed frame not yet consumed, if any
+    //
+    std::optional<uint32_t> try_consume(void) noexcept
+    {
+        const auto frame = consumed.load(std::memory_order_relaxed);
+
+        if (frame == committed.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+
+        consumed.store(frame + 1, std::memory_order_relaxed);
+
+        return slot(frame);
+    }
+
+    // • As try_consume, waiting for a frame to be committed
+    //
+    uint32_t consume(void) noexcept
+    {
+        const auto frame = consumed.load(std::memory_order_relaxed);
+
+        for (auto ready = committed.load(std::memory_order_acquire); frame == ready;
+             ready = committed.load(std::memory_order_acquire)) {
+
+            committed.wait(ready, std::memory_order_acquire);
+        }
+
+        consumed.store(frame + 1, std::memory_order_relaxed);
+
+        return slot(frame);
+    }
+
+    //===------------------------------------------------------------------===
+    // • Completion (any thread, once per committed frame, in order)
+    //===------------------------------------------------------------------===
+
+    // • The oldest frame in flight is done with its slot, which is free for
+    //   the producer again
+    //
+    void complete(void) noexcept
+    {
+        completed.fetch_add(1, std::memory_order_release);
+        completed.notify_one();
+    }
+
+    //===------------------------------------------------------------------===
+    // • State
+    //===------------------------------------------------------------------===
+
+    uint64_t committed_frames(void) const noexcept
+    {
+        return committed.load(std::memory_order_acquire);
+    }
+
+    uint64_t completed_frames(void) const noexcept
+    {
+        return completed.load(std::memory_order_acquire);
+    }
+
+    uint32_t frames_in_flight(void) const noexcept
+    {
+        return static_cast<uint32_t>( committed_frames() - completed_frames() );
+    }
+
+private:
+
+    static constexpr uint32_t slot(uint64_t frame) noexcept
+    {
+        return static_cast<uint32_t>(frame % Count_);
+    }
+
+    // • Each on its own cache line, since different threads advance them
+    //
+    alignas(64) std::atomic<uint64_t> committed = 0;
+    alignas(64) std::atomic<uint64_t> consumed  = 0;
+    alignas(64) std::atomic<uint64_t> completed = 0;
+};
+
+//===------------------------------------------------------------------------===
+//
+// • FrameBuffers
+//
+//  - Host memory for a FrameRing: Count_ blocks of `size` bytes each, every
+//    one 16-byte aligned (see Layout.hpp) so that each can hold an Arena.
+//    A larger power of two `block_alignment`, e.g. the page size, also
+//    rounds the size of each block up to it, so that a block can be wrapped
+//    as a GPU buffer without a copy
+//
+//===------------------------------------------------------------------------===
+
+template <uint32_t Count_>
+class FrameBuffers
+{
+public:
+
+    explicit FrameBuffers(uint32_t size, uint32_t block_alignment = alignment) noexcept
+        : stride { block_size(size, block_alignment) },
+          memory { allocate(stride, block_alignment) }
+    {
+    }
+
+    FrameBuffers(const FrameBuffers&) = delete;
+    FrameBuffers& operator = (const FrameBuffers&) = delete;
+
+    ~FrameBuffers()
+    {
+        std::free(memory);
+    }
+
+    bool is_valid(void) const noexcept
+    {
+        return nullptr != memory;
+    }
+
+    uint32_t size(void) const noexcept
+    {
+        return stride;
+    }
+
+    uint8_t* operator [] (uint32_t slot) const noexcept
+    {
+        return memory + static_cast<size_t>(slot) * stride;
+    }
+
+private:
+
+    // • Zero when `size` rounded up to `block_alignment` takes 2^32 bytes or
+    //   more, which allocate refuses
+    //
+    static uint32_t block_size(uint32_t size, uint32_t block_alignment) noexcept
+    {
+        const auto mask  = uint64_t{ std::max<uint32_t>(block_alignment, alignment) } - 1;
+        const auto bytes = (uint64_t{ size } + mask) & ~mask;
+
+        return (bytes <= UINT32_MAX) ? static_cast<uint32_t>(bytes) : 0;
+    }
+
+    static uint8_t* allocate(uint32_t stride, uint32_t block_alignment) noexcept
+    {
+        if (0 == stride) {
+            return nullptr;
+        }
+
+        return static_cast<uint8_t*>( std::aligned_alloc( std::max<uint32_t>(block_alignment, alignment),
+                                                          static_cast<size_t>(stride) * Count_ ) );
+    }
+
+    uint32_t    stride;
+    uint8_t*    memory;
+};
+
+} // namespace data
@@ -0,0 +1,535 @@
+//
+//  JobSystem.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Data/JobSystem.hpp>
+#include <Data/Trace.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+//===------------------------------------------------------------------------===
+// • namespace data
+//===------------------------------------------------------------------------===
+
+namespace data
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t nanoseconds_since(Clock::time_point start)
+{
+    return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count() );
+}
+
+// • Owner-only counters that other threads may read
+//
+void add(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// • Misses in a row before a worker yields its core, and before it sleeps
+//
+constexpr uint32_t spin_limit  = 64;
+constexpr uint32_t sleep_limit = 256;
+
+void back_off(uint32_t misses)
+{
+    if (misses < spin_limit) {
+#if defined ( __x86_64__ ) || defined ( __i386__ )
+        __builtin_ia32_pause();
+#elif defined ( __aarch64__ )
+        asm volatile ("yield");
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+//
+// • Worker
+//
+//  - The deque is Chase and Lev's ("Dynamic Circular Work-Stealing Deque",
+//    with the C11 orderings of Lê et al.) over a fixed ring: the owner
+//    pushes and pops at the bottom, thieves take from the top. A push onto
+//    a full ring fails and the caller runs the job itself
+//
+//  - Deque ends and statistics are on separate cache lines, since thieves
+//    write top while only the owner writes the rest
+//
+//===------------------------------------------------------------------------===
+
+struct alignas(64) JobSystem::Worker
+{
+    static constexpr int64_t capacity = 1024;
+
+    enum class Steal
+    {
+        empty,
+        lost,
+        taken
+    };
+
+    bool push(detail::Job& job) noexcept
+    {
+        const auto b = bottom.load(std::memory_order_relaxed);
+        const auto t = top.load(std::memory_order_acquire);
+
+        if (capacity <= b - t) {
+            return false;
+        }
+
+        slots[b & (capacity - 1)].store(&job, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    detail::Job* pop(void) noexcept
+    {
+        const auto b = bottom.load(std::memory_order_relaxed) - 1;
+
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        auto t = top.load(std::memory_order_relaxed);
+
+        if (b < t) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto job = slots[b & (capacity - 1)].load(std::memory_order_relaxed);
+
+        // • The last job: race any thief for it
+        //
+        if (t == b) {
+
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                job = nullptr;
+            }
+
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return job;
+    }
+
+    Steal steal(detail::Job*& job) noexcept
+    {
+        auto t = top.load(std::memory_order_acquire);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        const auto b = bottom.load(std::memory_order_acquire);
+
+        if (b <= t) {
+            return Steal::empty;
+        }
+
+        job = slots[t & (capacity - 1)].load(std::memory_order_acquire);
+
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return Steal::lost;
+        }
+
+        return Steal::taken;
+    }
+
+    bool is_empty(void) const noexcept
+    {
+        return bottom.load(std::memory_order_seq_cst) <= top.load(std::memory_order_seq_cst);
+    }
+
+    // • Busy time runs from the outermost job (or caller's call) in, less
+    //   idle time spent inside it waiting on joins
+    //
+    void begin_busy(void) noexcept
+    {
+        if (0 == depth++) {
+            busy_start = Clock::now();
+            busy_idle  = idle.load(std::memory_order_relaxed);
+        }
+    }
+
+    void end_busy(void) noexcept
+    {
+        if (0 == --depth) {
+            add( busy, nanoseconds_since(busy_start) - (idle.load(std::memory_order_relaxed) - busy_idle) );
+        }
+    }
+
+    // • Idle time runs from the first miss to the next job found
+    //
+    void begin_idle(void) noexcept
+    {
+        if (!is_idle) {
+            idle_start = Clock::now();
+            is_idle    = true;
+        }
+    }
+
+    void end_idle(void) noexcept
+    {
+        if (is_idle) {
+            add( idle, nanoseconds_since(idle_start) );
+            is_idle = false;
+        }
+    }
+
+    // • Victim selection (xorshift)
+    //
+    uint32_t next_random(void) noexcept
+    {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+
+        return static_cast<uint32_t>(random >> 32);
+    }
+
+    alignas(64) std::atomic<int64_t>        top    { 0 };
+    alignas(64) std::atomic<int64_t>        bottom { 0 };
+    std::atomic<detail::Job*>               slots[capacity];
+
+    alignas(64) std::atomic<uint64_t>       busy          { 0 };
+    std::atomic<uint64_t>                   idle          { 0 };
+    std::atomic<uint64_t>                   jobs          { 0 };
+    std::atomic<uint64_t>                   steals        { 0 };
+    std::atomic<uint64_t>                   failed_steals { 0 };
+    Clock::time_point                       busy_start;
+    Clock::time_point                       idle_start;
+    uint64_t                                busy_idle = 0;
+    uint64_t                                random    = 0x9E3779B97F4A7C15ull;
+    uint32_t                                index     = 0;
+    uint32_t                                depth     = 0;
+    bool                                    is_idle   = false;
+};
+
+//===------------------------------------------------------------------------===
+// • JobSystem
+//===------------------------------------------------------------------------===
+
+thread_local JobSystem*         JobSystem::current_system = nullptr;
+thread_local JobSystem::Worker* JobSystem::current_worker = nullptr;
+
+JobSystem::JobSystem(uint32_t worker_count)
+    : wake_epoch { 0 },
+      sleepers   { 0 },
+      joiners    { 0 },
+      stopping   { false },
+      workers    { (0 < worker_count) ? worker_count : std::max(1u, std::thread::hardware_concurrency()) }
+{
+    worker_states = std::make_unique<Worker[]>(workers);
+
+    for (uint32_t index = 0; index < workers; ++index) {
+        worker_states[index].index   = index;
+        worker_states[index].random += index * 0xBF58476D1CE4E5B9ull;
+    }
+
+    threads.reserve(workers - 1);
+
+    for (uint32_t index = 1; index < workers; ++index) {
+        threads.emplace_back( [this, index] { run_worker(index); } );
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    stopping.store(true, std::memory_order_seq_cst);
+    wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+    wake_epoch.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+JobSystem& JobSystem::shared(void)
+{
+    static JobSystem system;
+
+    return system;
+}
+
+void JobSystem::run_worker(uint32_t index)
+{
+    auto& worker = worker_states[index];
+
+    current_system = this;
+    current_worker = &worker;
+
+#if PLAY_TRACE
+    trace::set_thread_name( "job worker " + std::to_string(index) );
+#endif
+
+    uint32_t misses = 0;
+
+    while (!stopping.load(std::memory_order_relaxed)) {
+
+        if (const auto job = find_job(worker)) {
+
+            worker.end_idle();
+            run_job(worker, *job);
+
+            misses = 0;
+            continue;
+        }
+
+        worker.begin_idle();
+
+        if (misses < sleep_limit) {
+            back_off(misses++);
+            continue;
+        }
+
+        // • Sleep until a push. Counting this worker as a sleeper before
+        //   looking once more pairs with push looking for sleepers after
+        //   pushing, so a job pushed meanwhile is either seen or wakes it
+        //
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+
+        const auto epoch = wake_epoch.load(std::memory_order_seq_cst);
+
+        if (!stopping.load(std::memory_order_seq_cst) && !has_work()) {
+            wake_epoch.wait(epoch, std::memory_order_seq_cst);
+        }
+
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+        misses = 0;
+    }
+
+    worker.end_idle();
+}
+
+void JobSystem::run_job(Worker& worker, detail::Job& job)
+{
+    const auto pending = job.pending;
+
+    worker.begin_busy();
+
+    job.invoke(job);
+
+    add(worker.jobs, 1);
+
+    // • The job may be gone once pending drops. Looking for joiners after
+    //   pairs with Scope::wait counting itself before looking at pending
+    //
+    pending->fetch_sub(1, std::memory_order_seq_cst);
+
+    if (0 < joiners.load(std::memory_order_seq_cst)) {
+        wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+        wake_epoch.notify_all();
+    }
+
+    worker.end_busy();
+}
+
+detail::Job* JobSystem::find_job(Worker& worker)
+{
+    if (const auto job = worker.pop()) {
+        return job;
+    }
+
+    // • Every other worker once, from a random one
+    //
+    const auto first = worker.next_random() % workers;
+
+    for (uint32_t offset = 0; offset < workers; ++offset) {
+
+        auto& victim = worker_states[(first + offset) % workers];
+
+        if (&victim == &worker) {
+            continue;
+        }
+
+        detail::Job* job = nullptr;
+
+        switch (victim.steal(job)) {
+
+            case Worker::Steal::taken:
+                add(worker.steals, 1);
+                return job;
+
+            case Worker::Steal::lost:
+                add(worker.failed_steals, 1);
+                break;
+
+            case Worker::Steal::empty:
+                break;
+        }
+    }
+
+    return nullptr;
+}
+
+bool JobSystem::has_work(void) const noexcept
+{
+    for (uint32_t index = 0; index < workers; ++index) {
+
+        if (!worker_states[index].is_empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//===------------------------------------------------------------------------===
+// • Statistics
+//===------------------------------------------------------------------------===
+
+WorkerStatistics JobSystem::statistics(uint32_t index) const noexcept
+{
+    const auto& worker = worker_states[index];
+
+    return {
+        .busy_nanoseconds = worker.busy.load(std::memory_order_relaxed),
+        .idle_nanoseconds = worker.idle.load(std::memory_order_relaxed),
+        .jobs             = worker.jobs.load(std::memory_order_relaxed),
+        .steals           = worker.steals.load(std::memory_order_relaxed),
+        .failed_steals    = worker.failed_steals.load(std::memory_order_relaxed)
+    };
+}
+
+void JobSystem::reset_statistics(void) noexcept
+{
+    for (uint32_t index = 0; index < workers; ++index) {
+
+        auto& worker = worker_states[index];
+
+        worker.busy.store(0, std::memory_order_relaxed);
+        worker.idle.store(0, std::memory_order_relaxed);
+        worker.jobs.store(0, std::memory_order_relaxed);
+        worker.steals.store(0, std::memory_order_relaxed);
+        worker.failed_steals.store(0, std::memory_order_relaxed);
+    }
+}
+
+//===------------------------------------------------------------------------===
+// • Scope
+//===------------------------------------------------------------------------===
+
+JobSystem::Scope::Scope(JobSystem& system)
+    : system       { system },
+      worker       { current_worker },
+      outer_worker { current_worker },
+      outer_system { current_system },
+      is_caller    { &system != current_system }
+{
+    if (is_caller) {
+
+        system.caller_mutex.lock();
+
+        worker         = &system.worker_states[0];
+        current_system = &system;
+        current_worker = worker;
+
+        worker->begin_busy();
+    }
+}
+
+JobSystem::Scope::~Scope()
+{
+    if (is_caller) {
+
+        worker->end_idle();
+        worker->end_busy();
+
+        current_system = outer_system;
+        current_worker = outer_worker;
+
+        system.caller_mutex.unlock();
+    }
+}
+
+bool JobSystem::Scope::push(detail::Job& job)
+{
+    if (!worker->push(job)) {
+        return false;
+    }
+
+    // • Wake a sleeper, if any (see run_worker)
+    //
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (0 < system.sleepers.load(std::memory_order_seq_cst)) {
+        system.wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+        system.wake_epoch.notify_one();
+    }
+
+    return true;
+}
+
+void JobSystem::Scope::wait(const std::atomic<uint32_t>& pending)
+{
+    uint32_t misses = 0;
+
+    while (0 != pending.load(std::memory_order_acquire)) {
+
+        if (const auto job = system.find_job(*worker)) {
+
+            worker->end_idle();
+            system.run_job(*worker, *job);
+
+            misses = 0;
+            continue;
+        }
+
+        worker->begin_idle();
+
+        if (misses < sleep_limit) {
+            back_off(misses++);
+            continue;
+        }
+
+        // • Sleep until a push or a job finishing. Counting this wait as a
+        //   joiner before looking at pending once more pairs with run_job
+        //   looking for joiners after dropping it, so the last job is either
+        //   seen done or wakes it; counting it as a sleeper lets push wake it
+        //   to help with new work (see run_worker)
+        //
+        system.sleepers.fetch_add(1, std::memory_order_seq_cst);
+        system.joiners.fetch_add(1, std::memory_order_seq_cst);
+
+        const auto epoch = system.wake_epoch.load(std::memory_order_seq_cst);
+
+        if (0 != pending.load(std::memory_order_seq_cst) && !system.has_work()) {
+            system.wake_epoch.wait(epoch, std::memory_order_seq_cst);
+        }
+
+        system.joiners.fetch_sub(1, std::memory_order_relaxed);
+        system.sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+        misses = 0;
+    }
+
+    worker->end_idle();
+}
+
+} // namespace data
@@ -0,0 +1,282 @@
+//
+//  JobSystem.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • namespace data
+//===------------------------------------------------------------------------===
+
+namespace data
+{
+
+//===------------------------------------------------------------------------===
+//
+// • JobSystem
+//
+//  - A fixed set of workers, each with a deque of jobs. A worker pushes and
+//    pops jobs at the bottom of its own deque, so the work it forked last
+//    is still in its cache, and when that is empty steals the oldest job at
+//    the top of another's. Under recursive splitting the oldest job is the
+//    largest piece left, so one steal moves a lot of work. How that scales
+//    with workers is for job_system_scaling in PlayBenchmarks to measure on
+//    the machine at hand
+//
+//  - fork_join and parallel_for return once their work is done, running
+//    jobs while they wait, so they nest freely. A wait that finds nothing to
+//    run sleeps like an idle worker until a job is pushed or finishes. Jobs
+//    live on the stack of the call that forks them; nothing is allocated per
+//    job. Jobs must not throw
+//
+//  - A thread that is not one of the workers, e.g. the main thread, takes
+//    part as worker 0 while its call runs. Calls from several such threads
+//    take turns
+//
+//===------------------------------------------------------------------------===
+
+//===------------------------------------------------------------------------===
+// • WorkerStatistics
+//
+//  - Accumulated since the system started or reset_statistics. Worker 0
+//    counts time inside calls from threads outside the system
+//===------------------------------------------------------------------------===
+
+struct WorkerStatistics
+{
+    uint64_t    busy_nanoseconds;   // Running jobs
+    uint64_t    idle_nanoseconds;   // Looking for work or asleep
+    uint64_t    jobs;               // Jobs run, own and stolen
+    uint64_t    steals;             // Jobs taken from another worker's deque
+    uint64_t    failed_steals;      // Steals lost to another thief or the owner
+};
+
+namespace detail
+{
+
+// • A job, followed in memory by whatever it runs. `pending` drops by one
+//   once it has run
+//
+struct Job
+{
+    void                  (*invoke)(Job&);
+    std::atomic<uint32_t>*  pending;
+};
+
+template <typename Function_>
+struct FunctionJob : Job
+{
+    Function_*  function;
+
+    FunctionJob(Function_& function, std::atomic<uint32_t>& pending)
+        : Job      { &FunctionJob::run, &pending },
+          function { &function }
+    {
+    }
+
+    static void run(Job& job)
+    {
+        ( *static_cast<FunctionJob&>(job).function )();
+    }
+};
+
+} // namespace detail
+
+class JobSystem
+{
+public:
+
+    // • worker_count threads in all, including worker 0; zero for one per
+    //   hardware thread
+    //
+    explicit JobSystem(uint32_t worker_count = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator = (const JobSystem&) = delete;
+
+    // • One per hardware thread, started on first use
+    //
+    static JobSystem& shared(void);
+
+    uint32_t worker_count(void) const noexcept
+    {
+        return workers;
+    }
+
+    //===------------------------------------------------------------------===
+    // • Fork / join
+    //===------------------------------------------------------------------===
+
+    // • Run both, possibly in parallel, returning when both are done
+    //
+    template <typename First_, typename Second_>
+    void fork_join(First_&& first, Second_&& second);
+
+    // • function(first, last) over runs of [0, count) of at most `grain`
+    //   indices, split in halves so that idle workers steal large runs
+    //
+    template <typename Function_>
+    void parallel_for(size_t count, size_t grain, Function_&& function);
+
+    // • function(std::span<Type_>) over runs of `items`
+    //
+    template <typename Type_, typename Function_>
+    void parallel_for(std::span<Type_> items, size_t grain, Function_&& function)
+    {
+        parallel_for( items.size(), grain, [items, &function](size_t first, size_t last) {
+            function( items.subspan(first, last - first) );
+        } );
+    }
+
+    //===------------------------------------------------------------------===
+    // • Statistics
+    //===------------------------------------------------------------------===
+
+    WorkerStatistics statistics(uint32_t worker) const noexcept;
+
+    void reset_statistics(void) noexcept;
+
+private:
+
+    struct Worker;
+
+    // • The calling thread's worker for the length of a call, taking worker
+    //   0 for a thread outside the system
+    //
+    class Scope
+    {
+    public:
+
+        explicit Scope(JobSystem& system);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator = (const Scope&) = delete;
+
+        // • Push a job that someone may steal; false if the deque is full
+        //
+        bool push(detail::Job& job);
+
+        // • Run jobs, own first, until `pending` is zero, sleeping as an
+        //   idle worker does once enough looks in a row find none
+        //
+        void wait(const std::atomic<uint32_t>& pending);
+
+    private:
+
+        JobSystem&  system;
+        Worker*     worker;
+        Worker*     outer_worker;
+        JobSystem*  outer_system;
+        bool        is_caller;
+    };
+
+    template <typename Function_>
+    void split(size_t first, size_t last, size_t grain, Function_& function);
+
+    void run_worker(uint32_t index);
+    void run_job(Worker& worker, detail::Job& job);
+    detail::Job* find_job(Worker& worker);
+    bool has_work(void) const noexcept;
+
+    static thread_local JobSystem*  current_system;
+    static thread_local Worker*     current_worker;
+
+    std::unique_ptr<Worker[]>   worker_states;
+    std::vector<std::thread>    threads;
+    std::mutex                  caller_mutex;
+    alignas(64)
+    std::atomic<uint32_t>       wake_epoch;
+    std::atomic<uint32_t>       sleepers;
+    std::atomic<uint32_t>       joiners;        // Waits asleep, woken as jobs finish
+    std::atomic<bool>           stopping;
+    uint32_t                    workers;
+};
+
+//===------------------------------------------------------------------------===
+// • JobSystem (Templates)
+//===------------------------------------------------------------------------===
+
+template <typename First_, typename Second_>
+void JobSystem::fork_join(First_&& first, Second_&& second)
+{
+    if (1 == workers) {
+        first();
+        second();
+        return;
+    }
+
+    Scope scope { *this };
+
+    std::atomic<uint32_t> pending { 1 };
+
+    detail::FunctionJob job { second, pending };
+
+    if (!scope.push(job)) {
+        first();
+        second();
+        return;
+    }
+
+    first();
+
+    scope.wait(pending);
+}
+
+template <typename Function_>
+void JobSystem::parallel_for(size_t count, size_t grain, Function_&& function)
+{
+    grain = (0 < grain) ? grain : 1;
+
+    if (count <= grain || 1 == workers) {
+
+        if (0 < count) {
+            function( size_t { 0 }, count );
+        }
+
+        return;
+    }
+
+    split(0, count, grain, function);
+}
+
+template <typename Function_>
+void JobSystem::split(size_t first, size_t last, size_t grain, Function_& function)
+{
+    if (last - first <= grain) {
+        function(first, last);
+        return;
+    }
+
+    const auto middle = first + (last - first)/2;
+
+    fork_join( [&] { split(first, middle, grain, function); },
+               [&] { split(middle, last, grain, function); } );
+}
+
+} // namespace data
@@ -20,6 +20,7 @@
 #pragma once
 
 #if !defined ( __METAL_VERSION__ )
+#include <cstdint>
 #include <type_traits>
 #endif
 
@@ -217,4 +218,26 @@ device Type_* offset_by(device Root_* root, uint32_t offset)
 
 #endif
 
+//===------------------------------------------------------------------------===
+//
+// • Reference (Host and Metal)
+//
+//  - Offset in bytes from a root, e.g. the start of the buffer, to a value
+//    of type value_type. Remains valid when the whole block is copied
+//
+//===------------------------------------------------------------------------===
+
+template <TRIVIAL_LAYOUT Type_>
+struct Reference
+{
+    using value_type = Type_;
+
+    uint32_t offset;
+};
+
+#if !defined ( __METAL_VERSION__ )
+static_assert( is_referential<Reference<uint32_t>>(), "Unexpected reference" );
+static_assert( is_trivial_layout<Reference<uint32_t>>(), "Unexpected layout" );
+#endif
+
 } // namespace data
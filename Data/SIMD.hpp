@@ -0,0 +1,216 @@
+//
+//  SIMD.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#if defined ( __METAL_VERSION__ ) || defined ( __APPLE__ )
+
+//===------------------------------------------------------------------------===
+// • Apple platforms and Metal use the system simd types directly
+//===------------------------------------------------------------------------===
+
+#include <simd/simd.h>
+
+#else // Portable host build
+
+#include <cstdint>
+
+//===------------------------------------------------------------------------===
+//
+// • namespace simd (Portable)
+//
+//  - Only the subset of <simd/simd.h> used by Layout, Geometry and Pattern.
+//    Sizes and alignments match the Apple types so that structures shared
+//    with the Metal shaders have the same layout on every host
+//
+//===------------------------------------------------------------------------===
+
+namespace simd
+{
+
+#if defined ( __clang__ )
+
+//===------------------------------------------------------------------------===
+// • Clang: the same extended vector types <simd/simd.h> is built on
+//===------------------------------------------------------------------------===
+
+typedef int32_t  int2   __attribute__(( ext_vector_type(2) ));
+typedef uint32_t uint2  __attribute__(( ext_vector_type(2) ));
+typedef float    float2 __attribute__(( ext_vector_type(2) ));
+typedef float    float4 __attribute__(( ext_vector_type(4) ));
+
+#else // GCC
+
+//===------------------------------------------------------------------------===
+// • GCC: vector_size types have no named element access, so use aggregates
+//   of the same size and alignment with element-wise constexpr operators,
+//   which the optimizer lowers to the same vector instructions
+//===------------------------------------------------------------------------===
+
+template <typename Scalar_>
+struct alignas(2*sizeof(Scalar_)) vector2
+{
+    using scalar_type = Scalar_;
+
+    Scalar_ x;
+    Scalar_ y;
+
+    constexpr Scalar_& operator [] (int index) noexcept
+    {
+        return (0 == index) ? x : y;
+    }
+
+    constexpr Scalar_ operator [] (int index) const noexcept
+    {
+        return (0 == index) ? x : y;
+    }
+};
+
+template <typename Scalar_>
+struct alignas(4*sizeof(Scalar_)) vector4
+{
+    using scalar_type = Scalar_;
+
+    Scalar_ x;
+    Scalar_ y;
+    Scalar_ z;
+    Scalar_ w;
+
+    constexpr Scalar_& operator [] (int index) noexcept
+    {
+        switch (index) {
+            case 0:  return x;
+            case 1:  return y;
+            case 2:  return z;
+            default: return w;
+        }
+    }
+
+    constexpr Scalar_ operator [] (int index) const noexcept
+    {
+        switch (index) {
+            case 0:  return x;
+            case 1:  return y;
+            case 2:  return z;
+            default: return w;
+        }
+    }
+};
+
+typedef vector2<int32_t>  int2;
+typedef vector2<uint32_t> uint2;
+typedef vector2<float>    float2;
+typedef vector4<float>    float4;
+
+//===------------------------------------------------------------------------===
+// • Element-wise operators
+//
+//  - Scalar operands are splatted, as with the extended vector types. The
+//    scalar parameter is a non-deduced context so that, for example,
+//    int2 * ushort converts the scalar instead of failing deduction
+//===------------------------------------------------------------------------===
+
+template <typename Vector_>
+using scalar_t = typename Vector_::scalar_type;
+
+#define SIMD_VECTOR_OPERATOR(op)                                                        \
+                                                                                        \
+template <typename Scalar_>                                                             \
+constexpr vector2<Scalar_> operator op (vector2<Scalar_> lhs, vector2<Scalar_> rhs)     \
+{                                                                                       \
+    return { Scalar_(lhs.x op rhs.x), Scalar_(lhs.y op rhs.y) };                        \
+}                                                                                       \
+                                                                                        \
+template <typename Scalar_>                                                             \
+constexpr vector2<Scalar_> operator op (vector2<Scalar_> lhs, scalar_t<vector2<Scalar_>> rhs) \
+{                                                                                       \
+    return { Scalar_(lhs.x op rhs), Scalar_(lhs.y op rhs) };                            \
+}                                                                                       \
+                                                                                        \
+template <typename Scalar_>                                                             \
+constexpr vector2<Scalar_> operator op (scalar_t<vector2<Scalar_>> lhs, vector2<Scalar_> rhs) \
+{                                                                                       \
+    return { Scalar_(lhs op rhs.x), Scalar_(lhs op rhs.y) };                            \
+}                                                                                       \
+                                                                                        \
+template <typename Scalar_>                                                             \
+constexpr vector4<Scalar_> operator op (vector4<Scalar_> lhs, vector4<Scalar_> rhs)     \
+{                                                                                       \
+    return { Scalar_(lhs.x op rhs.x), Scalar_(lhs.y op rhs.y),                          \
+             Scalar_(lhs.z op rhs.z), Scalar_(lhs.w op rhs.w) };                        \
+}                                                                                       \
+                                                                                        \
+template <typename Scalar_>                                                             \
+constexpr vector4<Scalar_> operator op (vector4<Scalar_> lhs, scalar_t<vector4<Scalar_>> rhs) \
+{                                                                                       \
+    return { Scalar_(lhs.x op rhs), Scalar_(lhs.y op rhs),                              \
+             Scalar_(lhs.z op rhs), Scalar_(lhs.w op rhs) };                            \
+}                                                                                       \
+                                                                                        \
+template <typename Scalar_>                                                             \
+constexpr vector4<Scalar_> operator op (scalar_t<vector4<Scalar_>> lhs, vector4<Scalar_> rhs) \
+{                                                                                       \
+    return { Scalar_(lhs op rhs.x), Scalar_(lhs op rhs.y),                              \
+             Scalar_(lhs op rhs.z), Scalar_(lhs op rhs.w) };                            \
+}                                                                                       \
+                                                                                        \
+template <typename Vector_, typename Operand_>                                          \
+constexpr Vector_& operator op##= (Vector_& lhs, Operand_ rhs)                          \
+    requires requires { lhs = lhs op rhs; typename Vector_::scalar_type; }              \
+{                                                                                       \
+    return lhs = lhs op rhs;                                                            \
+}
+
+SIMD_VECTOR_OPERATOR(+)
+SIMD_VECTOR_OPERATOR(-)
+SIMD_VECTOR_OPERATOR(*)
+SIMD_VECTOR_OPERATOR(/)
+
+#undef SIMD_VECTOR_OPERATOR
+
+template <typename Scalar_>
+constexpr vector2<Scalar_> operator - (vector2<Scalar_> rhs)
+{
+    return { Scalar_(-rhs.x), Scalar_(-rhs.y) };
+}
+
+template <typename Scalar_>
+constexpr vector4<Scalar_> operator - (vector4<Scalar_> rhs)
+{
+    return { Scalar_(-rhs.x), Scalar_(-rhs.y), Scalar_(-rhs.z), Scalar_(-rhs.w) };
+}
+
+#endif // GCC
+
+//===------------------------------------------------------------------------===
+// • Layout must match <simd/simd.h>
+//===------------------------------------------------------------------------===
+
+static_assert(  8 ==  sizeof(int2),   "Unexpected size" );
+static_assert(  8 == alignof(int2),   "Unexpected alignment" );
+static_assert(  8 ==  sizeof(uint2),  "Unexpected size" );
+static_assert(  8 == alignof(uint2),  "Unexpected alignment" );
+static_assert(  8 ==  sizeof(float2), "Unexpected size" );
+static_assert(  8 == alignof(float2), "Unexpected alignment" );
+static_assert( 16 ==  sizeof(float4), "Unexpected size" );
+static_assert( 16 == alignof(float4), "Unexpected alignment" );
+
+} // namespace simd
+
+#endif // Portable host build
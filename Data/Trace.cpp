@@ -0,0 +1,395 @@
+//
+//  Trace.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Data/Trace.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • namespace trace
+//===------------------------------------------------------------------------===
+
+namespace trace
+{
+
+namespace detail
+{
+
+std::atomic<bool> enabled { false };
+
+} // namespace detail
+
+namespace
+{
+
+//===------------------------------------------------------------------------===
+//
+// • ThreadEvents
+//
+//  - One thread's ring. Only that thread writes; an event is published by
+//    the release store of head that follows it. Slot fields are relaxed
+//    atomics so that an export reading a slot while it is overwritten is
+//    not a data race; such events are recognized by index and dropped
+//
+//  - A thread is registered by its first event or by set_thread_name, but
+//    its slots are allocated only with its first event, so naming a thread
+//    that never records costs no ring
+//
+//===------------------------------------------------------------------------===
+
+struct Slot
+{
+    std::atomic<uint64_t>       timestamp;
+    std::atomic<uint64_t>       value;
+    std::atomic<const char*>    name;
+    std::atomic<const char*>    category;
+    std::atomic<EventType>      type;
+};
+
+struct ThreadEvents
+{
+    explicit ThreadEvents(uint32_t thread_id)
+        : slots     { },
+          head      { 0 },
+          first     { 0 },
+          thread_id { thread_id }
+    {
+    }
+
+    std::unique_ptr<Slot[]>     slots;          // Set by the thread, guarded by the registry
+    alignas(64)
+    std::atomic<uint64_t>       head;
+    std::atomic<uint64_t>       first;          // Events before it were cleared
+    uint32_t                    thread_id;
+    std::string                 thread_name;    // Guarded by the registry
+};
+
+struct Event
+{
+    uint64_t    timestamp;
+    uint64_t    value;
+    const char* name;
+    const char* category;
+    EventType   type;
+    uint32_t    thread_id;
+};
+
+//===------------------------------------------------------------------------===
+// • Registry
+//
+//  - Rings outlive their threads, so that an export still holds the events
+//    of workers that have exited
+//===------------------------------------------------------------------------===
+
+struct Registry
+{
+    std::mutex                                  mutex;
+    std::vector<std::unique_ptr<ThreadEvents>>  threads;
+    std::deque<std::string>                     names;      // Stable addresses
+};
+
+Registry& registry(void)
+{
+    static Registry instance;
+
+    return instance;
+}
+
+ThreadEvents& thread_events(void)
+{
+    thread_local ThreadEvents* events = nullptr;
+
+    if (nullptr == events) {
+
+        auto& shared = registry();
+
+        std::lock_guard lock { shared.mutex };
+
+        const auto thread_id = static_cast<uint32_t>( shared.threads.size() + 1 );
+
+        shared.threads.push_back( std::make_unique<ThreadEvents>(thread_id) );
+
+        events = shared.threads.back().get();
+    }
+
+    return *events;
+}
+
+//===------------------------------------------------------------------------===
+// • JSON
+//===------------------------------------------------------------------------===
+
+void append_string(std::string& json, const char* text)
+{
+    json += '"';
+
+    for (auto character = text; nullptr != character && '\0' != *character; ++character) {
+
+        const auto value = static_cast<unsigned char>(*character);
+
+        if ('"' == value || '\\' == value) {
+            json += '\\';
+            json += *character;
+        } else if (value < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+            json += escaped;
+        } else {
+            json += *character;
+        }
+    }
+
+    json += '"';
+}
+
+void append_microseconds(std::string& json, uint64_t nanoseconds)
+{
+    char text[32];
+    std::snprintf( text, sizeof(text), "%" PRIu64 ".%03" PRIu64, nanoseconds / 1000, nanoseconds % 1000 );
+    json += text;
+}
+
+void append_event(std::string& json, const Event& event, uint64_t origin)
+{
+    json += "{\"name\":";
+    append_string(json, event.name);
+    json += ",\"cat\":";
+    append_string(json, event.category);
+    json += ",\"pid\":1,\"tid\":";
+    json += std::to_string(event.thread_id);
+    json += ",\"ts\":";
+    append_microseconds(json, event.timestamp - origin);
+
+    switch (event.type) {
+
+        case EventType::interval:
+            json += ",\"ph\":\"X\",\"dur\":";
+            append_microseconds(json, event.value);
+            break;
+
+        case EventType::counter:
+            json += ",\"ph\":\"C\",\"args\":{\"value\":";
+            json += std::to_string( static_cast<int64_t>(event.value) );
+            json += '}';
+            break;
+
+        case EventType::instant:
+            json += ",\"ph\":\"i\",\"s\":\"t\"";
+            break;
+    }
+
+    json += '}';
+}
+
+// • Thread names as metadata events
+//
+void append_thread_name(std::string& json, const ThreadEvents& thread)
+{
+    if (thread.thread_name.empty()) {
+        return;
+    }
+
+    if (json.back() == '}') {
+        json += ',';
+    }
+
+    json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+    json += std::to_string(thread.thread_id);
+    json += ",\"args\":{\"name\":";
+    append_string(json, thread.thread_name.c_str());
+    json += "}}";
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Recording
+//===------------------------------------------------------------------------===
+
+void set_enabled(bool is_enabled) noexcept
+{
+    detail::enabled.store(is_enabled, std::memory_order_relaxed);
+}
+
+void record( EventType type, const char* name, const char* category,
+             uint64_t timestamp, uint64_t value ) noexcept
+{
+    auto& events = thread_events();
+
+    // • The ring, with the first event. Without memory, drop the event
+    //
+    if (nullptr == events.slots) {
+
+        std::unique_ptr<Slot[]> slots { new (std::nothrow) Slot[thread_capacity]() };
+
+        if (nullptr == slots) {
+            return;
+        }
+
+        std::lock_guard lock { registry().mutex };
+
+        events.slots = std::move(slots);
+    }
+
+    const auto index = events.head.load(std::memory_order_relaxed);
+    auto&      slot  = events.slots[index & (thread_capacity - 1)];
+
+    slot.timestamp.store(timestamp, std::memory_order_relaxed);
+    slot.value.store(value, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.type.store(type, std::memory_order_relaxed);
+
+    events.head.store(index + 1, std::memory_order_release);
+}
+
+void set_thread_name(std::string_view name)
+{
+    auto& events = thread_events();
+    auto& shared = registry();
+
+    std::lock_guard lock { shared.mutex };
+
+    events.thread_name = name;
+}
+
+const char* intern(std::string_view name)
+{
+    auto& shared = registry();
+
+    std::lock_guard lock { shared.mutex };
+
+    const auto found = std::find(shared.names.begin(), shared.names.end(), name);
+
+    if (found != shared.names.end()) {
+        return found->c_str();
+    }
+
+    return shared.names.emplace_back(name).c_str();
+}
+
+//===------------------------------------------------------------------------===
+// • Export
+//===------------------------------------------------------------------------===
+
+void clear(void)
+{
+    auto& shared = registry();
+
+    std::lock_guard lock { shared.mutex };
+
+    for (const auto& events : shared.threads) {
+        events->first.store( events->head.load(std::memory_order_acquire), std::memory_order_relaxed );
+    }
+}
+
+std::string chrome_trace_json(void)
+{
+    auto& shared = registry();
+
+    std::vector<Event> events;
+    std::string        json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    std::lock_guard lock { shared.mutex };
+
+    for (const auto& thread : shared.threads) {
+
+        if (nullptr == thread->slots) {
+            append_thread_name(json, *thread);
+            continue;
+        }
+
+        // • Read the ring, then keep only the events that cannot have been
+        //   overwritten meanwhile, including by a write still in progress
+        //
+        const auto head  = thread->head.load(std::memory_order_acquire);
+        const auto first = std::max( thread->first.load(std::memory_order_relaxed),
+                                     (thread_capacity < head) ? head - thread_capacity : 0 );
+        const auto start = events.size();
+
+        for (auto index = first; index < head; ++index) {
+
+            const auto& slot = thread->slots[index & (thread_capacity - 1)];
+
+            events.push_back( {
+                .timestamp = slot.timestamp.load(std::memory_order_relaxed),
+                .value     = slot.value.load(std::memory_order_relaxed),
+                .name      = slot.name.load(std::memory_order_relaxed),
+                .category  = slot.category.load(std::memory_order_relaxed),
+                .type      = slot.type.load(std::memory_order_relaxed),
+                .thread_id = thread->thread_id
+            } );
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        const auto later_head = thread->head.load(std::memory_order_relaxed);
+        const auto intact     = (thread_capacity <= later_head) ? later_head + 1 - thread_capacity : 0;
+
+        if (first < intact) {
+            events.erase( events.begin() + start, events.begin() + start + std::min(intact - first, head - first) );
+        }
+
+        append_thread_name(json, *thread);
+    }
+
+    // • Times from the earliest event
+    //
+    uint64_t origin = UINT64_MAX;
+
+    for (const auto& event : events) {
+        origin = std::min(origin, event.timestamp);
+    }
+
+    for (const auto& event : events) {
+
+        if (json.back() == '}') {
+            json += ',';
+        }
+
+        append_event(json, event, origin);
+    }
+
+    json += "]}\n";
+
+    return json;
+}
+
+bool write_chrome_trace(const char* path)
+{
+    const auto json = chrome_trace_json();
+    const auto file = std::fopen(path, "wb");
+
+    if (nullptr == file) {
+        return false;
+    }
+
+    const auto is_written = json.size() == std::fwrite(json.data(), 1, json.size(), file);
+
+    return (0 == std::fclose(file)) && is_written;
+}
+
+} // namespace trace
@@ -0,0 +1,194 @@
+//
+//  Trace.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+//===------------------------------------------------------------------------===
+//
+// • Trace
+//
+//  - Timed intervals, counters and instants, recorded by each thread into a
+//    ring of its own without locks and exported in the Chrome trace event
+//    format (chrome://tracing, Perfetto)
+//
+//  - Recording is off until set_enabled(true); while off, each event point
+//    costs one relaxed load. Built with PLAY_TRACE=0, the PLAY_TRACE_ macros
+//    expand to nothing
+//
+//  - Names and categories are kept as pointers, so they must outlive the
+//    trace: string literals, or strings from intern
+//
+//  - Each thread keeps its latest thread_capacity events, in a ring
+//    allocated with its first; older ones are overwritten
+//
+//===------------------------------------------------------------------------===
+
+#if !defined ( PLAY_TRACE )
+#define PLAY_TRACE 1
+#endif
+
+//===------------------------------------------------------------------------===
+// • namespace trace
+//===------------------------------------------------------------------------===
+
+namespace trace
+{
+
+constexpr uint32_t thread_capacity = 1u << 14;
+
+enum class EventType : uint32_t
+{
+    interval,
+    counter,
+    instant
+};
+
+namespace detail
+{
+
+extern std::atomic<bool> enabled;
+
+} // namespace detail
+
+//===------------------------------------------------------------------------===
+// • Recording
+//===------------------------------------------------------------------------===
+
+// • Nanoseconds on the steady clock, the time base of every event
+//
+inline uint64_t now(void) noexcept
+{
+    return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch() ).count() );
+}
+
+inline bool is_enabled(void) noexcept
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+void set_enabled(bool is_enabled) noexcept;
+
+// • Append an event to the calling thread's ring. `value` is the duration of
+//   an interval or the value of a counter
+//
+void record( EventType type, const char* name, const char* category,
+             uint64_t timestamp, uint64_t value ) noexcept;
+
+inline void interval(const char* name, const char* category, uint64_t start, uint64_t end) noexcept
+{
+    record(EventType::interval, name, category, start, end - start);
+}
+
+inline void counter(const char* name, int64_t value) noexcept
+{
+    record(EventType::counter, name, "counter", now(), static_cast<uint64_t>(value));
+}
+
+inline void instant(const char* name, const char* category) noexcept
+{
+    record(EventType::instant, name, category, now(), 0);
+}
+
+// • Name of the calling thread in the trace. Its ring is allocated with its
+//   first event, not here
+//
+void set_thread_name(std::string_view name);
+
+// • A copy of `name` that lives as long as the process
+//
+const char* intern(std::string_view name);
+
+//===------------------------------------------------------------------------===
+// • Scope: an interval from construction to destruction
+//===------------------------------------------------------------------------===
+
+class Scope
+{
+public:
+
+    Scope(const char* name, const char* category) noexcept
+        : name     { name },
+          category { category },
+          start    { is_enabled() ? now() : 0 }
+    {
+    }
+
+    ~Scope()
+    {
+        if (0 != start) {
+            interval(name, category, start, now());
+        }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator = (const Scope&) = delete;
+
+private:
+
+    const char* name;
+    const char* category;
+    uint64_t    start;
+};
+
+//===------------------------------------------------------------------------===
+// • Export
+//===------------------------------------------------------------------------===
+
+// • Forget every event recorded so far
+//
+void clear(void);
+
+std::string chrome_trace_json(void);
+
+bool write_chrome_trace(const char* path);
+
+} // namespace trace
+
+//===------------------------------------------------------------------------===
+// • Event points
+//===------------------------------------------------------------------------===
+
+#if PLAY_TRACE
+
+#define PLAY_TRACE_CONCATENATE_(first_, second_)    first_##second_
+#define PLAY_TRACE_CONCATENATE(first_, second_)     PLAY_TRACE_CONCATENATE_(first_, second_)
+
+#define PLAY_TRACE_SCOPE(name_, category_) \
+    const trace::Scope PLAY_TRACE_CONCATENATE(trace_scope_, __LINE__) { name_, category_ }
+
+#define PLAY_TRACE_COUNTER(name_, value_) \
+    do { if (trace::is_enabled()) { trace::counter( name_, static_cast<int64_t>(value_) ); } } while (false)
+
+#define PLAY_TRACE_INSTANT(name_, category_) \
+    do { if (trace::is_enabled()) { trace::instant(name_, category_); } } while (false)
+
+#else
+
+#define PLAY_TRACE_SCOPE(name_, category_)      do { } while (false)
+#define PLAY_TRACE_COUNTER(name_, value_)       do { } while (false)
+#define PLAY_TRACE_INSTANT(name_, category_)    do { } while (false)
+
+#endif // PLAY_TRACE
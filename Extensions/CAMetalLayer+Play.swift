@@ -32,6 +32,6 @@ extension CAMetalLayer {
         self.colorspace           = renderer.colorspace
         self.pixelFormat          = renderer.pixelFormat
         self.maximumDrawableCount = maximumDrawableCount
-        self.framebufferOnly      = true
+        self.framebufferOnly      = false     // Renderer copies its canvas to the drawable
     }
 }
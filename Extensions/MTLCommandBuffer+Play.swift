@@ -60,6 +60,17 @@ extension MTLCommandBuffer {
         makeRenderCommandEncoder(to: texture, slice: 0, clearColor: clearColor)
     }
 
+    func makeRenderCommandEncoder(loadingContentsOf texture: MTLTexture) -> MTLRenderCommandEncoder? {
+
+        let renderDescriptor = MTLRenderPassDescriptor()
+
+        renderDescriptor.colorAttachments[0].texture     = texture
+        renderDescriptor.colorAttachments[0].loadAction  = .load
+        renderDescriptor.colorAttachments[0].storeAction = .store
+
+        return makeRenderCommandEncoder(descriptor: renderDescriptor)
+    }
+
     //===--------------------------------------------------------------------===
     // MARK: • Blit commands for Indirect Command Buffers
     //
@@ -76,9 +76,13 @@ extension MTLLibrary {
         return try? self.device.makeRenderPipelineState(descriptor: renderDescriptor)
     }
 
+    //  - With isBlendingEnabled, the fragment color is blended over the target
+    //    by its alpha (source alpha, one minus source alpha)
+    //
     func makeRenderPipelineState( vertexFunctionName: String,
                                   fragmentFunctionName: String,
-                                  pixelFormat: MTLPixelFormat ) -> MTLRenderPipelineState? {
+                                  pixelFormat: MTLPixelFormat,
+                                  isBlendingEnabled: Bool = false ) -> MTLRenderPipelineState? {
 
 
         guard let vertexFunction   = self.makeFunction(name: vertexFunctionName),
@@ -93,6 +97,17 @@ extension MTLLibrary {
         renderDescriptor.vertexFunction                  = vertexFunction
         renderDescriptor.fragmentFunction                = fragmentFunction
 
+        if isBlendingEnabled {
+
+            let colorAttachment = renderDescriptor.colorAttachments[0]!
+
+            colorAttachment.isBlendingEnabled           = true
+            colorAttachment.sourceRGBBlendFactor        = .sourceAlpha
+            colorAttachment.destinationRGBBlendFactor   = .oneMinusSourceAlpha
+            colorAttachment.sourceAlphaBlendFactor      = .one
+            colorAttachment.destinationAlphaBlendFactor = .oneMinusSourceAlpha
+        }
+
         return try? self.device.makeRenderPipelineState(descriptor: renderDescriptor)
     }
 
@@ -20,7 +20,7 @@
 #pragma once
 
 #include <Data/Layout.hpp>
-#include <simd/simd.h>
+#include <Data/SIMD.hpp>
 
 #if !defined ( __METAL_VERSION__ )
 #include <type_traits>
@@ -100,6 +100,40 @@ constexpr Region operator + (const Region rgn, simd::int2 offset)
     };
 }
 
+constexpr bool is_empty(const Region rgn)
+{
+    return rgn.right <= rgn.left || rgn.bottom <= rgn.top;
+}
+
+// • Empty intersections keep right >= left and bottom >= top, so that width
+//   and height are zero rather than wrapping
+//
+constexpr Region intersection(const Region lhs, const Region rhs)
+{
+    const auto left = (lhs.left < rhs.left) ? rhs.left : lhs.left;
+    const auto top  = (lhs.top  < rhs.top)  ? rhs.top  : lhs.top;
+
+    const auto right  = (lhs.right  < rhs.right)  ? lhs.right  : rhs.right;
+    const auto bottom = (lhs.bottom < rhs.bottom) ? lhs.bottom : rhs.bottom;
+
+    return {
+        .left   = left,
+        .top    = top,
+        .right  = (right  < left) ? left : right,
+        .bottom = (bottom < top)  ? top  : bottom
+    };
+}
+
+constexpr Region bounding_region(const Region lhs, const Region rhs)
+{
+    return {
+        .left   = (lhs.left   < rhs.left)   ? lhs.left   : rhs.left,
+        .top    = (lhs.top    < rhs.top)    ? lhs.top    : rhs.top,
+        .right  = (lhs.right  < rhs.right)  ? rhs.right  : lhs.right,
+        .bottom = (lhs.bottom < rhs.bottom) ? rhs.bottom : lhs.bottom
+    };
+}
+
 //===------------------------------------------------------------------------===
 // Rectangle
 //===------------------------------------------------------------------------===
@@ -298,6 +332,37 @@ constexpr bool operator == (const DeviceRect lhs, const DeviceRect rhs)
         && lhs.bottom == rhs.bottom;
 }
 
+//===------------------------------------------------------------------------===
+//
+// DeviceTransform
+//
+//  - Grid coordinates to device coordinates with one multiply-add each,
+//    device = coordinate * scale + bias, for a grid whose size is fixed, e.g.
+//    that of a Pattern. The divides are done once by make_device_transform
+//
+//===------------------------------------------------------------------------===
+
+struct DeviceTransform
+{
+    simd::float2    scale;
+    simd::float2    bias;
+};
+
+static_assert( 16 ==  sizeof(DeviceTransform), "Unexpected size" );
+static_assert(  8 == alignof(DeviceTransform), "Unexpected alignment" );
+
+#if !defined ( __METAL_VERSION__ )
+static_assert( data::is_trivial_layout<DeviceTransform>(), "Unexpected layout" );
+#endif
+
+constexpr bool operator == (const DeviceTransform lhs, const DeviceTransform rhs)
+{
+    return lhs.scale.x == rhs.scale.x
+        && lhs.scale.y == rhs.scale.y
+        && lhs.bias.x  == rhs.bias.x
+        && lhs.bias.y  == rhs.bias.y;
+}
+
 //===------------------------------------------------------------------------===
 // • simd type conversion
 //===------------------------------------------------------------------------===
@@ -501,6 +566,123 @@ constexpr DeviceRect make_device_rect(const TextureRect tr)
     };
 }
 
+//===------------------------------------------------------------------------===
+// • DeviceTransform
+//===------------------------------------------------------------------------===
+
+constexpr DeviceTransform make_device_transform(simd::uint2 size)
+{
+    return {
+        .scale = {  2.0f / static_cast<float>(size.x), -2.0f / static_cast<float>(size.y) },
+        .bias  = { -1.0f, 1.0f }
+    };
+}
+
+// • The same rect as make_device_rect(rgn, size) to within the rounding of
+//   the reciprocals, and bit for bit that of BatchPrecision::fast
+//
+constexpr DeviceRect make_device_rect(const Region rgn, const DeviceTransform transform)
+{
+    return {
+        .left   = static_cast<float>(rgn.left)   * transform.scale.x + transform.bias.x,
+        .top    = static_cast<float>(rgn.top)    * transform.scale.y + transform.bias.y,
+        .right  = static_cast<float>(rgn.right)  * transform.scale.x + transform.bias.x,
+        .bottom = static_cast<float>(rgn.bottom) * transform.scale.y + transform.bias.y
+    };
+}
+
+//===------------------------------------------------------------------------===
+//
+// • Pixel coverage (fixed point)
+//
+//  - Pixels of a `target_size` target whose centres a region of a
+//    `grid_size` grid covers, with the top-left rule: a centre on a left or
+//    top edge is covered, one on a right or bottom edge is not
+//
+//  - An edge at grid coordinate c lies at pixel c * target / grid, and pixel
+//    p's centre at p + 1/2, so the first pixel at or after the edge is the
+//    least p with (2p + 1) * grid >= 2c * target. Integer arithmetic in
+//    units of 1 / (2 * grid) pixel places every edge exactly, the same on
+//    every backend, where float rounding can move an edge near a centre by
+//    one pixel. Extents must be below 2^31
+//
+//===------------------------------------------------------------------------===
+
+constexpr uint32_t first_pixel_at(uint32_t coordinate, uint32_t grid_extent, uint32_t target_extent)
+{
+    if (0 == grid_extent || grid_extent <= coordinate) {
+        return (0 == grid_extent) ? 0 : target_extent;
+    }
+
+    const auto edge = 2 * static_cast<uint64_t>(coordinate) * target_extent;
+    const auto unit = 2 * static_cast<uint64_t>(grid_extent);
+
+    if (edge <= grid_extent) {
+        return 0;
+    }
+
+    return static_cast<uint32_t>( (edge - grid_extent + unit - 1) / unit );
+}
+
+constexpr Region covered_pixels(const Region rgn, simd::uint2 grid_size, simd::uint2 target_size)
+{
+    const auto left   = first_pixel_at(rgn.left,   grid_size.x, target_size.x);
+    const auto top    = first_pixel_at(rgn.top,    grid_size.y, target_size.y);
+    const auto right  = first_pixel_at(rgn.right,  grid_size.x, target_size.x);
+    const auto bottom = first_pixel_at(rgn.bottom, grid_size.y, target_size.y);
+
+    return {
+        .left   = left,
+        .top    = top,
+        .right  = (right  < left) ? left : right,
+        .bottom = (bottom < top)  ? top  : bottom
+    };
+}
+
+//===------------------------------------------------------------------------===
+//
+// • Pixel coverage (analytic)
+//
+//  - The fraction of pixel (x, y), the unit square at (x, y), that a rect in
+//    pixels covers: the product of the overlaps along each axis, which is
+//    exact for axis-aligned edges. One evaluation per pixel gives the
+//    antialiased edge a box-filtered supersample would approach
+//
+//===------------------------------------------------------------------------===
+
+// • A region of a `grid_size` grid in pixels of a `target_size` target
+//
+constexpr Rectangle make_pixel_rectangle(const Region rgn, simd::uint2 grid_size, simd::uint2 target_size)
+{
+    const auto scale_x = static_cast<float>(target_size.x) / static_cast<float>(grid_size.x);
+    const auto scale_y = static_cast<float>(target_size.y) / static_cast<float>(grid_size.y);
+
+    return {
+        .left   = static_cast<float>(rgn.left)   * scale_x,
+        .top    = static_cast<float>(rgn.top)    * scale_y,
+        .right  = static_cast<float>(rgn.right)  * scale_x,
+        .bottom = static_cast<float>(rgn.bottom) * scale_y
+    };
+}
+
+// • Overlap of [first, last) with the pixel [pixel, pixel + 1)
+//
+constexpr float span_coverage(float first, float last, uint32_t pixel)
+{
+    const auto lower = static_cast<float>(pixel);
+    const auto upper = lower + 1.0f;
+
+    const auto start = (first < lower) ? lower : first;
+    const auto end   = (upper < last)  ? upper : last;
+
+    return (start < end) ? end - start : 0.0f;
+}
+
+constexpr float pixel_coverage(const Rectangle rect, simd::uint2 pixel)
+{
+    return span_coverage(rect.left, rect.right, pixel.x) * span_coverage(rect.top, rect.bottom, pixel.y);
+}
+
 //===------------------------------------------------------------------------===
 // • Size to fit
 //===------------------------------------------------------------------------===
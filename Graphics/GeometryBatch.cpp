@@ -0,0 +1,669 @@
+//
+//  GeometryBatch.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Graphics/GeometryBatch.hpp>
+
+#include <algorithm>
+
+#if defined ( __x86_64__ ) || defined ( __i386__ )
+#define GEOMETRY_BATCH_AVX2 1
+#include <immintrin.h>
+#elif defined ( __aarch64__ ) && defined ( __ARM_NEON )
+#define GEOMETRY_BATCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+//===------------------------------------------------------------------------===
+// • namespace geometry
+//===------------------------------------------------------------------------===
+
+namespace geometry
+{
+
+namespace
+{
+
+//===------------------------------------------------------------------------===
+//
+// • Lane constants
+//
+//  - Every rect type is four floats: left, top, right, bottom. Device
+//    coordinates flip y, so x lanes add and y lanes subtract
+//
+//===------------------------------------------------------------------------===
+
+struct Lanes
+{
+    float values[4];
+};
+
+constexpr Lanes device_bias  = { {  -1.0f,  1.0f, -1.0f,  1.0f } };
+constexpr Lanes device_sign  = { {   1.0f, -1.0f,  1.0f, -1.0f } };
+constexpr Lanes rectangle_bias = { {   1.0f,  1.0f,  1.0f,  1.0f } };
+
+template <typename Source_, typename Destination_>
+size_t batch_count(std::span<Source_> source, std::span<Destination_> destination)
+{
+    return std::min(source.size(), destination.size());
+}
+
+//===------------------------------------------------------------------------===
+//
+// • Scalar
+//
+//===------------------------------------------------------------------------===
+
+namespace scalar
+{
+
+void make_rectangles(const Region* regions, Rectangle* rects, size_t first, size_t count)
+{
+    for (auto index = first; index < count; ++index) {
+        rects[index] = make_rectangle(regions[index]);
+    }
+}
+
+void make_texture_rects( const Region* regions, simd::uint2 size, TextureRect* rects,
+                         size_t first, size_t count, BatchPrecision precision )
+{
+    if (BatchPrecision::exact == precision) {
+
+        for (auto index = first; index < count; ++index) {
+            rects[index] = make_texture_rect(regions[index], size);
+        }
+
+        return;
+    }
+
+    const auto scale = 1.0f / make_float2(size);
+
+    for (auto index = first; index < count; ++index) {
+
+        const auto rect = make_rectangle(regions[index]);
+
+        rects[index] = {
+            .left   = rect.left   * scale.x,
+            .top    = rect.top    * scale.y,
+            .right  = rect.right  * scale.x,
+            .bottom = rect.bottom * scale.y
+        };
+    }
+}
+
+void make_device_rects( const Region* regions, simd::uint2 size, DeviceRect* rects,
+                        size_t first, size_t count, BatchPrecision precision )
+{
+    if (BatchPrecision::exact == precision) {
+
+        for (auto index = first; index < count; ++index) {
+            rects[index] = make_device_rect(regions[index], size);
+        }
+
+        return;
+    }
+
+    const auto transform = make_device_transform(size);
+
+    for (auto index = first; index < count; ++index) {
+        rects[index] = make_device_rect(regions[index], transform);
+    }
+}
+
+void make_rectangles( const DeviceRect* device_rects, simd::uint2 size, Rectangle* rects,
+                      size_t first, size_t count )
+{
+    for (auto index = first; index < count; ++index) {
+        rects[index] = make_rectangle(device_rects[index], size);
+    }
+}
+
+void size_to_fit(simd::float2 aspect, const Rectangle* rects, Rectangle* fitted, size_t first, size_t count)
+{
+    for (auto index = first; index < count; ++index) {
+        fitted[index] = geometry::size_to_fit(aspect, rects[index]);
+    }
+}
+
+} // namespace scalar
+
+#if defined ( GEOMETRY_BATCH_AVX2 )
+
+//===------------------------------------------------------------------------===
+//
+// • AVX2: two rects per register
+//
+//===------------------------------------------------------------------------===
+
+namespace avx2
+{
+
+#define AVX2_FUNCTION __attribute__(( target("avx2") ))
+
+AVX2_FUNCTION inline __m256 broadcast(const Lanes& lanes)
+{
+    return _mm256_broadcast_ps( reinterpret_cast<const __m128*>(lanes.values) );
+}
+
+AVX2_FUNCTION inline __m256 broadcast(simd::float2 value)
+{
+    return _mm256_setr_ps( value.x, value.y, value.x, value.y, value.x, value.y, value.x, value.y );
+}
+
+// • Exact uint32 to float, as static_cast<float>: both 16-bit halves convert
+//   exactly and their sum is rounded once
+//
+AVX2_FUNCTION inline __m256 load_region_pair(const Region* regions)
+{
+    const auto value = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(regions) );
+    const auto high  = _mm256_cvtepi32_ps( _mm256_srli_epi32(value, 16) );
+    const auto low   = _mm256_cvtepi32_ps( _mm256_and_si256(value, _mm256_set1_epi32(0xffff)) );
+
+    return _mm256_add_ps( _mm256_mul_ps(high, _mm256_set1_ps(65536.0f)), low );
+}
+
+template <typename Rect_>
+AVX2_FUNCTION inline __m256 load_pair(const Rect_* rects)
+{
+    return _mm256_loadu_ps( reinterpret_cast<const float*>(rects) );
+}
+
+template <typename Rect_>
+AVX2_FUNCTION inline void store_pair(Rect_* rects, __m256 value)
+{
+    _mm256_storeu_ps( reinterpret_cast<float*>(rects), value );
+}
+
+AVX2_FUNCTION size_t make_rectangles(const Region* regions, Rectangle* rects, size_t count)
+{
+    size_t index = 0;
+
+    for ( ; index + 2 <= count; index += 2) {
+        store_pair( rects + index, load_region_pair(regions + index) );
+    }
+
+    return index;
+}
+
+AVX2_FUNCTION size_t make_texture_rects( const Region* regions, simd::uint2 size, TextureRect* rects,
+                                         size_t count, BatchPrecision precision )
+{
+    const auto extent = broadcast( make_float2(size) );
+    const auto scale  = _mm256_div_ps( _mm256_set1_ps(1.0f), extent );
+    const auto exact  = (BatchPrecision::exact == precision);
+
+    size_t index = 0;
+
+    for ( ; index + 2 <= count; index += 2) {
+
+        const auto value = load_region_pair(regions + index);
+
+        store_pair( rects + index, exact ? _mm256_div_ps(value, extent) : _mm256_mul_ps(value, scale) );
+    }
+
+    return index;
+}
+
+AVX2_FUNCTION size_t make_device_rects( const Region* regions, simd::uint2 size, DeviceRect* rects,
+                                        size_t count, BatchPrecision precision )
+{
+    const auto extent = broadcast( make_float2(size) );
+    const auto two    = _mm256_set1_ps(2.0f);
+    const auto bias   = broadcast(device_bias);
+    const auto sign   = broadcast(device_sign);
+
+    if (BatchPrecision::exact == precision) {
+
+        // • bias ± (2*value) / extent, as in make_device_rect
+        //
+        size_t index = 0;
+
+        for ( ; index + 2 <= count; index += 2) {
+
+            const auto value    = load_region_pair(regions + index);
+            const auto quotient = _mm256_div_ps( _mm256_mul_ps(two, value), extent );
+
+            store_pair( rects + index, _mm256_add_ps(bias, _mm256_mul_ps(sign, quotient)) );
+        }
+
+        return index;
+    }
+
+    // • bias + value * (±2 / extent), as make_device_rect with the
+    //   DeviceTransform of `size`
+    //
+    const auto scale = _mm256_mul_ps( sign, _mm256_div_ps(two, extent) );
+
+    size_t index = 0;
+
+    for ( ; index + 2 <= count; index += 2) {
+
+        const auto value = load_region_pair(regions + index);
+
+        store_pair( rects + index, _mm256_add_ps(bias, _mm256_mul_ps(value, scale)) );
+    }
+
+    return index;
+}
+
+AVX2_FUNCTION size_t make_rectangles( const DeviceRect* device_rects, simd::uint2 size, Rectangle* rects,
+                                      size_t count )
+{
+    // • (0.5*extent) * (1 ± value), as in make_rectangle
+    //
+    const auto half_extent = _mm256_mul_ps( _mm256_set1_ps(0.5f), broadcast( make_float2(size) ) );
+    const auto bias        = broadcast(rectangle_bias);
+    const auto sign        = broadcast(device_sign);
+
+    size_t index = 0;
+
+    for ( ; index + 2 <= count; index += 2) {
+
+        const auto value = load_pair(device_rects + index);
+
+        store_pair( rects + index,
+                    _mm256_mul_ps(half_extent, _mm256_add_ps(bias, _mm256_mul_ps(sign, value))) );
+    }
+
+    return index;
+}
+
+AVX2_FUNCTION size_t size_to_fit(simd::float2 aspect, const Rectangle* rects, Rectangle* fitted, size_t count)
+{
+    const auto aspect4 = broadcast(aspect);
+    const auto half    = _mm256_set1_ps(0.5f);
+
+    size_t index = 0;
+
+    for ( ; index + 2 <= count; index += 2) {
+
+        // • Lanes are [ left, top, right, bottom ] per rect
+        //
+        const auto value  = load_pair(rects + index);
+        const auto origin = _mm256_permute_ps( value, _MM_SHUFFLE(1, 0, 1, 0) );
+        const auto corner = _mm256_permute_ps( value, _MM_SHUFFLE(3, 2, 3, 2) );
+        const auto size   = _mm256_sub_ps(corner, origin);
+
+        // • fit_scale = size / aspect, constrained in width if x < y
+        //
+        const auto fit_scale = _mm256_div_ps(size, aspect4);
+        const auto fit_x     = _mm256_permute_ps( fit_scale, _MM_SHUFFLE(0, 0, 0, 0) );
+        const auto fit_y     = _mm256_permute_ps( fit_scale, _MM_SHUFFLE(1, 1, 1, 1) );
+        const auto in_width  = _mm256_cmp_ps(fit_x, fit_y, _CMP_LT_OQ);
+
+        // • Both candidate extents: [ aspect.x*fit_y, aspect.y*fit_x ]
+        //
+        const auto extent = _mm256_mul_ps( aspect4, _mm256_permute_ps(fit_scale, _MM_SHUFFLE(0, 1, 0, 1)) );
+        const auto center = _mm256_add_ps( origin, _mm256_mul_ps(half, size) );
+        const auto start  = _mm256_sub_ps( center, _mm256_mul_ps(half, extent) );
+        const auto end    = _mm256_add_ps( start, extent );
+
+        const auto centered = _mm256_blend_ps(start, end, 0b11001100);
+        const auto vertical = _mm256_blend_ps(value, centered, 0b10101010);
+        const auto across   = _mm256_blend_ps(value, centered, 0b01010101);
+
+        store_pair( fitted + index, _mm256_blendv_ps(across, vertical, in_width) );
+    }
+
+    return index;
+}
+
+#undef AVX2_FUNCTION
+
+} // namespace avx2
+
+bool has_avx2(void)
+{
+    static const bool value = __builtin_cpu_supports("avx2");
+
+    return value;
+}
+
+#endif // GEOMETRY_BATCH_AVX2
+
+#if defined ( GEOMETRY_BATCH_NEON )
+
+//===------------------------------------------------------------------------===
+//
+// • NEON: one rect per register
+//
+//===------------------------------------------------------------------------===
+
+namespace neon
+{
+
+inline float32x4_t broadcast(const Lanes& lanes)
+{
+    return vld1q_f32(lanes.values);
+}
+
+inline float32x4_t broadcast(simd::float2 value)
+{
+    const float lanes[4] = { value.x, value.y, value.x, value.y };
+
+    return vld1q_f32(lanes);
+}
+
+inline float32x4_t load_region(const Region* region)
+{
+    return vcvtq_f32_u32( vld1q_u32( reinterpret_cast<const uint32_t*>(region) ) );
+}
+
+template <typename Rect_>
+inline float32x4_t load(const Rect_* rect)
+{
+    return vld1q_f32( reinterpret_cast<const float*>(rect) );
+}
+
+template <typename Rect_>
+inline void store(Rect_* rect, float32x4_t value)
+{
+    vst1q_f32( reinterpret_cast<float*>(rect), value );
+}
+
+size_t make_rectangles(const Region* regions, Rectangle* rects, size_t count)
+{
+    for (size_t index = 0; index < count; ++index) {
+        store( rects + index, load_region(regions + index) );
+    }
+
+    return count;
+}
+
+size_t make_texture_rects( const Region* regions, simd::uint2 size, TextureRect* rects,
+                           size_t count, BatchPrecision precision )
+{
+    const auto extent = broadcast( make_float2(size) );
+    const auto scale  = vdivq_f32( vdupq_n_f32(1.0f), extent );
+    const auto exact  = (BatchPrecision::exact == precision);
+
+    for (size_t index = 0; index < count; ++index) {
+
+        const auto value = load_region(regions + index);
+
+        store( rects + index, exact ? vdivq_f32(value, extent) : vmulq_f32(value, scale) );
+    }
+
+    return count;
+}
+
+size_t make_device_rects( const Region* regions, simd::uint2 size, DeviceRect* rects,
+                          size_t count, BatchPrecision precision )
+{
+    const auto extent = broadcast( make_float2(size) );
+    const auto two    = vdupq_n_f32(2.0f);
+    const auto bias   = broadcast(device_bias);
+    const auto sign   = broadcast(device_sign);
+
+    if (BatchPrecision::exact == precision) {
+
+        for (size_t index = 0; index < count; ++index) {
+
+            const auto value    = load_region(regions + index);
+            const auto quotient = vdivq_f32( vmulq_f32(two, value), extent );
+
+            store( rects + index, vaddq_f32(bias, vmulq_f32(sign, quotient)) );
+        }
+
+        return count;
+    }
+
+    const auto scale = vmulq_f32( sign, vdivq_f32(two, extent) );
+
+    for (size_t index = 0; index < count; ++index) {
+        store( rects + index, vaddq_f32(bias, vmulq_f32(load_region(regions + index), scale)) );
+    }
+
+    return count;
+}
+
+size_t make_rectangles(const DeviceRect* device_rects, simd::uint2 size, Rectangle* rects, size_t count)
+{
+    const auto half_extent = vmulq_f32( vdupq_n_f32(0.5f), broadcast( make_float2(size) ) );
+    const auto bias        = broadcast(rectangle_bias);
+    const auto sign        = broadcast(device_sign);
+
+    for (size_t index = 0; index < count; ++index) {
+
+        const auto value = load(device_rects + index);
+
+        store( rects + index, vmulq_f32(half_extent, vaddq_f32(bias, vmulq_f32(sign, value))) );
+    }
+
+    return count;
+}
+
+size_t size_to_fit(simd::float2 aspect, const Rectangle* rects, Rectangle* fitted, size_t count)
+{
+    const uint32_t odd_lanes[4]  = { 0, ~0u, 0, ~0u };
+    const uint32_t even_lanes[4] = { ~0u, 0, ~0u, 0 };
+
+    const auto aspect4 = broadcast(aspect);
+    const auto half    = vdupq_n_f32(0.5f);
+    const auto odd     = vld1q_u32(odd_lanes);
+    const auto even    = vld1q_u32(even_lanes);
+
+    for (size_t index = 0; index < count; ++index) {
+
+        const auto value  = load(rects + index);
+        const auto origin = vcombine_f32( vget_low_f32(value), vget_low_f32(value) );
+        const auto corner = vcombine_f32( vget_high_f32(value), vget_high_f32(value) );
+        const auto size   = vsubq_f32(corner, origin);
+
+        const auto fit_scale = vdivq_f32(size, aspect4);
+        const auto in_width  = vcltq_f32( vdupq_laneq_f32(fit_scale, 0), vdupq_laneq_f32(fit_scale, 1) );
+
+        const auto extent = vmulq_f32( aspect4, vrev64q_f32(fit_scale) );
+        const auto center = vaddq_f32( origin, vmulq_f32(half, size) );
+        const auto start  = vsubq_f32( center, vmulq_f32(half, extent) );
+        const auto end    = vaddq_f32( start, extent );
+
+        const auto centered = vcombine_f32( vget_low_f32(start), vget_high_f32(end) );
+        const auto vertical = vbslq_f32(odd, centered, value);
+        const auto across   = vbslq_f32(even, centered, value);
+
+        store( fitted + index, vbslq_f32(in_width, vertical, across) );
+    }
+
+    return count;
+}
+
+} // namespace neon
+
+#endif // GEOMETRY_BATCH_NEON
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Region conversion
+//===------------------------------------------------------------------------===
+
+void make_rectangles(std::span<const Region> regions, std::span<Rectangle> rects)
+{
+    const auto count = batch_count(regions, rects);
+
+    size_t first = 0;
+
+#if defined ( GEOMETRY_BATCH_AVX2 )
+    if (has_avx2()) {
+        first = avx2::make_rectangles(regions.data(), rects.data(), count);
+    }
+#elif defined ( GEOMETRY_BATCH_NEON )
+    first = neon::make_rectangles(regions.data(), rects.data(), count);
+#endif
+
+    scalar::make_rectangles(regions.data(), rects.data(), first, count);
+}
+
+void make_texture_rects( std::span<const Region> regions, simd::uint2 size,
+                         std::span<TextureRect> rects, BatchPrecision precision )
+{
+    const auto count = batch_count(regions, rects);
+
+    size_t first = 0;
+
+#if defined ( GEOMETRY_BATCH_AVX2 )
+    if (has_avx2()) {
+        first = avx2::make_texture_rects(regions.data(), size, rects.data(), count, precision);
+    }
+#elif defined ( GEOMETRY_BATCH_NEON )
+    first = neon::make_texture_rects(regions.data(), size, rects.data(), count, precision);
+#endif
+
+    scalar::make_texture_rects(regions.data(), size, rects.data(), first, count, precision);
+}
+
+void make_device_rects( std::span<const Region> regions, simd::uint2 size,
+                        std::span<DeviceRect> rects, BatchPrecision precision )
+{
+    const auto count = batch_count(regions, rects);
+
+    size_t first = 0;
+
+#if defined ( GEOMETRY_BATCH_AVX2 )
+    if (has_avx2()) {
+        first = avx2::make_device_rects(regions.data(), size, rects.data(), count, precision);
+    }
+#elif defined ( GEOMETRY_BATCH_NEON )
+    first = neon::make_device_rects(regions.data(), size, rects.data(), count, precision);
+#endif
+
+    scalar::make_device_rects(regions.data(), size, rects.data(), first, count, precision);
+}
+
+//===------------------------------------------------------------------------===
+// • DeviceRect conversion
+//===------------------------------------------------------------------------===
+
+void make_rectangles( std::span<const DeviceRect> device_rects, simd::uint2 size,
+                      std::span<Rectangle> rects )
+{
+    const auto count = batch_count(device_rects, rects);
+
+    size_t first = 0;
+
+#if defined ( GEOMETRY_BATCH_AVX2 )
+    if (has_avx2()) {
+        first = avx2::make_rectangles(device_rects.data(), size, rects.data(), count);
+    }
+#elif defined ( GEOMETRY_BATCH_NEON )
+    first = neon::make_rectangles(device_rects.data(), size, rects.data(), count);
+#endif
+
+    scalar::make_rectangles(device_rects.data(), size, rects.data(), first, count);
+}
+
+//===------------------------------------------------------------------------===
+// • Size to fit
+//===------------------------------------------------------------------------===
+
+void size_to_fit(simd::float2 aspect, std::span<const Rectangle> rects, std::span<Rectangle> fitted)
+{
+    const auto count = batch_count(rects, fitted);
+
+    size_t first = 0;
+
+#if defined ( GEOMETRY_BATCH_AVX2 )
+    if (has_avx2()) {
+        first = avx2::size_to_fit(aspect, rects.data(), fitted.data(), count);
+    }
+#elif defined ( GEOMETRY_BATCH_NEON )
+    first = neon::size_to_fit(aspect, rects.data(), fitted.data(), count);
+#endif
+
+    scalar::size_to_fit(aspect, rects.data(), fitted.data(), first, count);
+}
+
+//===------------------------------------------------------------------------===
+// • Parallel conversion
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+// • Elements per run, enough to hide the cost of a job
+//
+constexpr size_t parallel_grain = 16384;
+
+template <typename Source_, typename Destination_, typename Convert_>
+void convert_in_parallel( data::JobSystem& jobs, std::span<Source_> source,
+                          std::span<Destination_> destination, Convert_&& convert )
+{
+    jobs.parallel_for( batch_count(source, destination), parallel_grain, [&](size_t first, size_t last) {
+        convert( source.subspan(first, last - first), destination.subspan(first, last - first) );
+    } );
+}
+
+} // namespace
+
+void make_rectangles( data::JobSystem& jobs, std::span<const Region> regions,
+                      std::span<Rectangle> rects )
+{
+    convert_in_parallel( jobs, regions, rects, [](auto source, auto destination) {
+        make_rectangles(source, destination);
+    } );
+}
+
+void make_texture_rects( data::JobSystem& jobs, std::span<const Region> regions, simd::uint2 size,
+                         std::span<TextureRect> rects, BatchPrecision precision )
+{
+    convert_in_parallel( jobs, regions, rects, [size, precision](auto source, auto destination) {
+        make_texture_rects(source, size, destination, precision);
+    } );
+}
+
+void make_device_rects( data::JobSystem& jobs, std::span<const Region> regions, simd::uint2 size,
+                        std::span<DeviceRect> rects, BatchPrecision precision )
+{
+    convert_in_parallel( jobs, regions, rects, [size, precision](auto source, auto destination) {
+        make_device_rects(source, size, destination, precision);
+    } );
+}
+
+void make_rectangles( data::JobSystem& jobs, std::span<const DeviceRect> device_rects,
+                      simd::uint2 size, std::span<Rectangle> rects )
+{
+    convert_in_parallel( jobs, device_rects, rects, [size](auto source, auto destination) {
+        make_rectangles(source, size, destination);
+    } );
+}
+
+void size_to_fit( data::JobSystem& jobs, simd::float2 aspect, std::span<const Rectangle> rects,
+                  std::span<Rectangle> fitted )
+{
+    convert_in_parallel( jobs, rects, fitted, [aspect](auto source, auto destination) {
+        size_to_fit(aspect, source, destination);
+    } );
+}
+
+//===------------------------------------------------------------------------===
+// • Implementation
+//===------------------------------------------------------------------------===
+
+const char* batch_implementation(void)
+{
+#if defined ( GEOMETRY_BATCH_AVX2 )
+    return has_avx2() ? "avx2" : "scalar";
+#elif defined ( GEOMETRY_BATCH_NEON )
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace geometry
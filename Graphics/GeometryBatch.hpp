@@ -0,0 +1,117 @@
+//
+//  GeometryBatch.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Graphics/Geometry.hpp>
+#include <Data/JobSystem.hpp>
+
+#include <span>
+
+//===------------------------------------------------------------------------===
+// • namespace geometry
+//===------------------------------------------------------------------------===
+
+namespace geometry
+{
+
+//===------------------------------------------------------------------------===
+//
+// • Batch conversion (Host)
+//
+//  - Span versions of the Geometry.hpp conversions using AVX2 (when the CPU
+//    has it) or NEON, with a scalar fallback. Each converts
+//    min(source.size(), destination.size()) elements
+//
+//  - BatchPrecision::exact performs the same operations in the same order as
+//    the scalar functions, so results match them bit for bit provided
+//    floating point contraction is off (-ffp-contract=off, as PlayCore sets)
+//
+//  - BatchPrecision::fast multiplies by reciprocals hoisted out of the loop
+//    instead of dividing, which can differ in the last bit. Device rects
+//    then match make_device_rect with make_device_transform(size) bit for
+//    bit
+//
+//===------------------------------------------------------------------------===
+
+enum class BatchPrecision
+{
+    exact,
+    fast
+};
+
+//===------------------------------------------------------------------------===
+// • Region conversion
+//===------------------------------------------------------------------------===
+
+void make_rectangles(std::span<const Region> regions, std::span<Rectangle> rects);
+
+void make_texture_rects( std::span<const Region> regions, simd::uint2 size,
+                         std::span<TextureRect> rects,
+                         BatchPrecision precision = BatchPrecision::exact );
+
+void make_device_rects( std::span<const Region> regions, simd::uint2 size,
+                        std::span<DeviceRect> rects,
+                        BatchPrecision precision = BatchPrecision::exact );
+
+//===------------------------------------------------------------------------===
+// • DeviceRect conversion
+//===------------------------------------------------------------------------===
+
+void make_rectangles( std::span<const DeviceRect> device_rects, simd::uint2 size,
+                      std::span<Rectangle> rects );
+
+//===------------------------------------------------------------------------===
+// • Size to fit
+//===------------------------------------------------------------------------===
+
+void size_to_fit( simd::float2 aspect, std::span<const Rectangle> rects,
+                  std::span<Rectangle> fitted );
+
+//===------------------------------------------------------------------------===
+// • Parallel conversion
+//
+//  - The same conversions split into runs across the workers of `jobs`.
+//    Results are identical to the single-threaded versions
+//===------------------------------------------------------------------------===
+
+void make_rectangles( data::JobSystem& jobs, std::span<const Region> regions,
+                      std::span<Rectangle> rects );
+
+void make_texture_rects( data::JobSystem& jobs, std::span<const Region> regions, simd::uint2 size,
+                         std::span<TextureRect> rects,
+                         BatchPrecision precision = BatchPrecision::exact );
+
+void make_device_rects( data::JobSystem& jobs, std::span<const Region> regions, simd::uint2 size,
+                        std::span<DeviceRect> rects,
+                        BatchPrecision precision = BatchPrecision::exact );
+
+void make_rectangles( data::JobSystem& jobs, std::span<const DeviceRect> device_rects,
+                      simd::uint2 size, std::span<Rectangle> rects );
+
+void size_to_fit( data::JobSystem& jobs, simd::float2 aspect, std::span<const Rectangle> rects,
+                  std::span<Rectangle> fitted );
+
+//===------------------------------------------------------------------------===
+// • Which implementation the batch functions use ("avx2", "neon" or "scalar")
+//===------------------------------------------------------------------------===
+
+const char* batch_implementation(void);
+
+} // namespace geometry
@@ -0,0 +1,501 @@
+//
+//  PixelConversion.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Graphics/PixelConversion.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#if defined ( __x86_64__ ) || defined ( __i386__ )
+#define PIXEL_CONVERSION_AVX2 1
+#include <immintrin.h>
+#elif defined ( __aarch64__ ) && defined ( __ARM_NEON )
+#define PIXEL_CONVERSION_NEON 1
+#include <arm_neon.h>
+#endif
+
+//===------------------------------------------------------------------------===
+// • namespace pixels
+//===------------------------------------------------------------------------===
+
+namespace pixels
+{
+
+namespace
+{
+
+template <typename Source_, typename Destination_>
+size_t batch_count(std::span<Source_> source, std::span<Destination_> destination)
+{
+    return std::min(source.size(), destination.size());
+}
+
+//===------------------------------------------------------------------------===
+//
+// • Tables
+//
+//  - encode: the 8-bit value of every half from 0 to one (0x3c00), sRGB
+//    encoded, then the same linear for alpha. Halves are clamped to that
+//    range as signed 16-bit integers, which orders the non-negative ones
+//    and puts every negative one below zero. Three bytes of padding let
+//    AVX2 gather 32 bits at the last entry
+//
+//  - decode: the half of every 8-bit sRGB value, then of every linear
+//    alpha, and one of padding for the same reason
+//
+//===------------------------------------------------------------------------===
+
+constexpr uint32_t half_one     = 0x3c00;
+constexpr uint32_t alpha_offset = half_one + 1;
+
+struct Tables
+{
+    uint8_t     encode[2 * alpha_offset + 3];
+    uint16_t    decode[2 * 256 + 1];
+};
+
+const Tables& tables(void)
+{
+    static const auto value = [] {
+
+        Tables tables = { };
+
+        for (uint32_t half = 0; half <= half_one; ++half) {
+
+            const auto linear = make_float( static_cast<uint16_t>(half) );
+
+            tables.encode[half]                = static_cast<uint8_t>( std::lround( 255.0f * encode_srgb(linear) ) );
+            tables.encode[alpha_offset + half] = static_cast<uint8_t>( std::lround( 255.0f * linear ) );
+        }
+
+        for (uint32_t value = 0; value < 256; ++value) {
+            tables.decode[value]       = make_half( decode_srgb( static_cast<float>(value) / 255.0f ) );
+            tables.decode[256 + value] = make_half( static_cast<float>(value) / 255.0f );
+        }
+
+        return tables;
+    }();
+
+    return value;
+}
+
+constexpr uint32_t encode_index(uint16_t half)
+{
+    return std::clamp<int32_t>( static_cast<int16_t>(half), 0, half_one );
+}
+
+//===------------------------------------------------------------------------===
+//
+// • Scalar
+//
+//===------------------------------------------------------------------------===
+
+namespace scalar
+{
+
+void make_halves(const float* values, uint16_t* halves, size_t first, size_t count)
+{
+    for (auto index = first; index < count; ++index) {
+        halves[index] = make_half(values[index]);
+    }
+}
+
+void make_floats(const uint16_t* halves, float* values, size_t first, size_t count)
+{
+    for (auto index = first; index < count; ++index) {
+        values[index] = make_float(halves[index]);
+    }
+}
+
+void encode_bgra8(const uint16_t* rgba_halves, uint32_t* bgra_pixels, size_t first, size_t count)
+{
+    const auto& encode = tables().encode;
+
+    for (auto index = first; index < count; ++index) {
+
+        const auto rgba = rgba_halves + 4 * index;
+
+        bgra_pixels[index] = static_cast<uint32_t>( encode[encode_index(rgba[2])] )
+                           | static_cast<uint32_t>( encode[encode_index(rgba[1])] ) << 8
+                           | static_cast<uint32_t>( encode[encode_index(rgba[0])] ) << 16
+                           | static_cast<uint32_t>( encode[alpha_offset + encode_index(rgba[3])] ) << 24;
+    }
+}
+
+void decode_bgra8(const uint32_t* bgra_pixels, uint16_t* rgba_halves, size_t first, size_t count)
+{
+    const auto& decode = tables().decode;
+
+    for (auto index = first; index < count; ++index) {
+
+        const auto pixel = bgra_pixels[index];
+        const auto rgba  = rgba_halves + 4 * index;
+
+        rgba[0] = decode[(pixel >> 16) & 0xff];
+        rgba[1] = decode[(pixel >> 8) & 0xff];
+        rgba[2] = decode[pixel & 0xff];
+        rgba[3] = decode[256 + (pixel >> 24)];
+    }
+}
+
+void blend_white(uint16_t* halves, float coverage, size_t first, size_t count)
+{
+    for (auto index = first; index < count; ++index) {
+
+        const auto channel = make_float(halves[index]);
+
+        halves[index] = make_half( channel + (1.0f - channel) * coverage );
+    }
+}
+
+} // namespace scalar
+
+#if defined ( PIXEL_CONVERSION_AVX2 )
+
+//===------------------------------------------------------------------------===
+//
+// • AVX2 + F16C: eight halves, or four pixels, per step
+//
+//===------------------------------------------------------------------------===
+
+namespace avx2
+{
+
+#define AVX2_FUNCTION __attribute__(( target("avx2,f16c") ))
+
+AVX2_FUNCTION size_t make_halves(const float* values, uint16_t* halves, size_t count)
+{
+    size_t index = 0;
+
+    for ( ; index + 8 <= count; index += 8) {
+
+        const auto half8 = _mm256_cvtps_ph( _mm256_loadu_ps(values + index), _MM_FROUND_TO_NEAREST_INT );
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>(halves + index), half8 );
+    }
+
+    return index;
+}
+
+AVX2_FUNCTION size_t make_floats(const uint16_t* halves, float* values, size_t count)
+{
+    size_t index = 0;
+
+    for ( ; index + 8 <= count; index += 8) {
+
+        const auto half8 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(halves + index) );
+
+        _mm256_storeu_ps( values + index, _mm256_cvtph_ps(half8) );
+    }
+
+    return index;
+}
+
+AVX2_FUNCTION size_t encode_bgra8(const uint16_t* rgba_halves, uint32_t* bgra_pixels, size_t count)
+{
+    const auto table = reinterpret_cast<const int*>( tables().encode );
+
+    // • R, G, B, A halves to B, G, R, A within each pixel, clamped to the
+    //   table and offset to the alpha part for A
+    //
+    const auto to_bgra = _mm256_setr_epi8( 4, 5, 2, 3, 0, 1, 6, 7, 12, 13, 10, 11, 8, 9, 14, 15,
+                                           4, 5, 2, 3, 0, 1, 6, 7, 12, 13, 10, 11, 8, 9, 14, 15 );
+    const auto zero    = _mm256_setzero_si256();
+    const auto one     = _mm256_set1_epi16(half_one);
+    const auto alpha   = _mm256_setr_epi16( 0, 0, 0, alpha_offset, 0, 0, 0, alpha_offset,
+                                            0, 0, 0, alpha_offset, 0, 0, 0, alpha_offset );
+    const auto byte    = _mm256_set1_epi32(0xff);
+    const auto order   = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    size_t index = 0;
+
+    for ( ; index + 4 <= count; index += 4) {
+
+        auto halves = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(rgba_halves + 4 * index) );
+
+        halves = _mm256_shuffle_epi8(halves, to_bgra);
+        halves = _mm256_min_epi16( _mm256_max_epi16(halves, zero), one );
+        halves = _mm256_add_epi16(halves, alpha);
+
+        // • Pixels 0 and 1, then 2 and 3, one lookup per channel
+        //
+        const auto low  = _mm256_cvtepu16_epi32( _mm256_castsi256_si128(halves) );
+        const auto high = _mm256_cvtepu16_epi32( _mm256_extracti128_si256(halves, 1) );
+
+        const auto low_bytes  = _mm256_and_si256( _mm256_i32gather_epi32(table, low, 1), byte );
+        const auto high_bytes = _mm256_and_si256( _mm256_i32gather_epi32(table, high, 1), byte );
+
+        // • Packing works within 128-bit lanes, leaving pixels 0, 2, 0, 2
+        //   in the first and 1, 3, 1, 3 in the second
+        //
+        const auto words  = _mm256_packus_epi32(low_bytes, high_bytes);
+        const auto bytes  = _mm256_packus_epi16(words, words);
+        const auto pixels = _mm256_permutevar8x32_epi32(bytes, order);
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>(bgra_pixels + index), _mm256_castsi256_si128(pixels) );
+    }
+
+    return index;
+}
+
+AVX2_FUNCTION size_t decode_bgra8(const uint32_t* bgra_pixels, uint16_t* rgba_halves, size_t count)
+{
+    const auto table = reinterpret_cast<const int*>( tables().decode );
+
+    // • B, G, R, A bytes to R, G, B, A, offset to the alpha part for A
+    //
+    const auto to_rgba = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const auto alpha   = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+    const auto word    = _mm256_set1_epi32(0xffff);
+
+    size_t index = 0;
+
+    for ( ; index + 4 <= count; index += 4) {
+
+        auto bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>(bgra_pixels + index) );
+
+        bytes = _mm_shuffle_epi8(bytes, to_rgba);
+
+        const auto low  = _mm256_add_epi32( _mm256_cvtepu8_epi32(bytes), alpha );
+        const auto high = _mm256_add_epi32( _mm256_cvtepu8_epi32( _mm_srli_si128(bytes, 8) ), alpha );
+
+        const auto low_halves  = _mm256_and_si256( _mm256_i32gather_epi32(table, low, 2), word );
+        const auto high_halves = _mm256_and_si256( _mm256_i32gather_epi32(table, high, 2), word );
+
+        // • Packing leaves pixels 0, 2 in the first lane and 1, 3 in the
+        //   second
+        //
+        const auto halves = _mm256_permute4x64_epi64( _mm256_packus_epi32(low_halves, high_halves),
+                                                      _MM_SHUFFLE(3, 1, 2, 0) );
+
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>(rgba_halves + 4 * index), halves );
+    }
+
+    return index;
+}
+
+AVX2_FUNCTION size_t blend_white(uint16_t* halves, float coverage, size_t count)
+{
+    const auto one    = _mm256_set1_ps(1.0f);
+    const auto weight = _mm256_set1_ps(coverage);
+
+    size_t index = 0;
+
+    for ( ; index + 8 <= count; index += 8) {
+
+        const auto address = reinterpret_cast<__m128i*>(halves + index);
+        const auto channel = _mm256_cvtph_ps( _mm_loadu_si128(address) );
+        const auto blended = _mm256_add_ps( channel, _mm256_mul_ps( _mm256_sub_ps(one, channel), weight ) );
+
+        _mm_storeu_si128( address, _mm256_cvtps_ph(blended, _MM_FROUND_TO_NEAREST_INT) );
+    }
+
+    return index;
+}
+
+#undef AVX2_FUNCTION
+
+} // namespace avx2
+
+bool has_avx2(void)
+{
+    static const bool value = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+
+    return value;
+}
+
+#endif // PIXEL_CONVERSION_AVX2
+
+#if defined ( PIXEL_CONVERSION_NEON )
+
+//===------------------------------------------------------------------------===
+//
+// • NEON: four halves per step
+//
+//===------------------------------------------------------------------------===
+
+namespace neon
+{
+
+size_t make_halves(const float* values, uint16_t* halves, size_t count)
+{
+    size_t index = 0;
+
+    for ( ; index + 4 <= count; index += 4) {
+        vst1_u16( halves + index, vreinterpret_u16_f16( vcvt_f16_f32( vld1q_f32(values + index) ) ) );
+    }
+
+    return index;
+}
+
+size_t make_floats(const uint16_t* halves, float* values, size_t count)
+{
+    size_t index = 0;
+
+    for ( ; index + 4 <= count; index += 4) {
+        vst1q_f32( values + index, vcvt_f32_f16( vreinterpret_f16_u16( vld1_u16(halves + index) ) ) );
+    }
+
+    return index;
+}
+
+size_t blend_white(uint16_t* halves, float coverage, size_t count)
+{
+    const auto one    = vdupq_n_f32(1.0f);
+    const auto weight = vdupq_n_f32(coverage);
+
+    size_t index = 0;
+
+    for ( ; index + 4 <= count; index += 4) {
+
+        const auto channel = vcvt_f32_f16( vreinterpret_f16_u16( vld1_u16(halves + index) ) );
+        const auto blended = vaddq_f32( channel, vmulq_f32( vsubq_f32(one, channel), weight ) );
+
+        vst1_u16( halves + index, vreinterpret_u16_f16( vcvt_f16_f32(blended) ) );
+    }
+
+    return index;
+}
+
+} // namespace neon
+
+#endif // PIXEL_CONVERSION_NEON
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • sRGB
+//===------------------------------------------------------------------------===
+
+float encode_srgb(float linear)
+{
+    return (linear <= 0.0031308f) ? 12.92f * linear : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+}
+
+float decode_srgb(float encoded)
+{
+    return (encoded <= 0.04045f) ? encoded / 12.92f : std::pow( (encoded + 0.055f) / 1.055f, 2.4f );
+}
+
+uint8_t encode_srgb8(uint16_t half)
+{
+    return tables().encode[encode_index(half)];
+}
+
+//===------------------------------------------------------------------------===
+// • Batch conversion
+//===------------------------------------------------------------------------===
+
+void make_halves(std::span<const float> values, std::span<uint16_t> halves)
+{
+    const auto count = batch_count(values, halves);
+
+    size_t first = 0;
+
+#if defined ( PIXEL_CONVERSION_AVX2 )
+    if (has_avx2()) {
+        first = avx2::make_halves(values.data(), halves.data(), count);
+    }
+#elif defined ( PIXEL_CONVERSION_NEON )
+    first = neon::make_halves(values.data(), halves.data(), count);
+#endif
+
+    scalar::make_halves(values.data(), halves.data(), first, count);
+}
+
+void make_floats(std::span<const uint16_t> halves, std::span<float> values)
+{
+    const auto count = batch_count(halves, values);
+
+    size_t first = 0;
+
+#if defined ( PIXEL_CONVERSION_AVX2 )
+    if (has_avx2()) {
+        first = avx2::make_floats(halves.data(), values.data(), count);
+    }
+#elif defined ( PIXEL_CONVERSION_NEON )
+    first = neon::make_floats(halves.data(), values.data(), count);
+#endif
+
+    scalar::make_floats(halves.data(), values.data(), first, count);
+}
+
+void encode_bgra8(std::span<const uint16_t> rgba_halves, std::span<uint32_t> bgra_pixels)
+{
+    const auto count = std::min(rgba_halves.size() / 4, bgra_pixels.size());
+
+    size_t first = 0;
+
+#if defined ( PIXEL_CONVERSION_AVX2 )
+    if (has_avx2()) {
+        first = avx2::encode_bgra8(rgba_halves.data(), bgra_pixels.data(), count);
+    }
+#endif
+
+    scalar::encode_bgra8(rgba_halves.data(), bgra_pixels.data(), first, count);
+}
+
+void decode_bgra8(std::span<const uint32_t> bgra_pixels, std::span<uint16_t> rgba_halves)
+{
+    const auto count = std::min(bgra_pixels.size(), rgba_halves.size() / 4);
+
+    size_t first = 0;
+
+#if defined ( PIXEL_CONVERSION_AVX2 )
+    if (has_avx2()) {
+        first = avx2::decode_bgra8(bgra_pixels.data(), rgba_halves.data(), count);
+    }
+#endif
+
+    scalar::decode_bgra8(bgra_pixels.data(), rgba_halves.data(), first, count);
+}
+
+void blend_white(std::span<uint16_t> halves, float coverage)
+{
+    size_t first = 0;
+
+#if defined ( PIXEL_CONVERSION_AVX2 )
+    if (has_avx2()) {
+        first = avx2::blend_white(halves.data(), coverage, halves.size());
+    }
+#elif defined ( PIXEL_CONVERSION_NEON )
+    first = neon::blend_white(halves.data(), coverage, halves.size());
+#endif
+
+    scalar::blend_white(halves.data(), coverage, first, halves.size());
+}
+
+//===------------------------------------------------------------------------===
+// • Implementation
+//===------------------------------------------------------------------------===
+
+const char* conversion_implementation(void)
+{
+#if defined ( PIXEL_CONVERSION_AVX2 )
+    return has_avx2() ? "avx2+f16c" : "scalar";
+#elif defined ( PIXEL_CONVERSION_NEON )
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace pixels
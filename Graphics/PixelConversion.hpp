@@ -0,0 +1,148 @@
+//
+//  PixelConversion.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <span>
+
+//===------------------------------------------------------------------------===
+// • namespace pixels
+//===------------------------------------------------------------------------===
+
+namespace pixels
+{
+
+//===------------------------------------------------------------------------===
+//
+// • Half floats
+//
+//  - IEEE 754 binary16 as stored by .rgba16Float. make_half rounds to
+//    nearest even, and both directions quiet NaNs, as F16C and NEON
+//    conversions do, so the batch versions below match them bit for bit
+//
+//===------------------------------------------------------------------------===
+
+constexpr uint16_t make_half(float value)
+{
+    auto       bits = std::bit_cast<uint32_t>(value);
+    const auto sign = static_cast<uint16_t>( (bits >> 16) & 0x8000u );
+
+    bits &= 0x7fffffffu;
+
+    // • Infinity and NaN, and finite values of 65536 and up
+    //
+    if (0x47800000u <= bits) {
+        return sign | ( (0x7f800000u < bits) ? 0x7e00u | ((bits >> 13) & 0x3ffu) : 0x7c00u );
+    }
+
+    // • Below 2^-14 the half is subnormal: adding 0.5 leaves the rounded
+    //   mantissa in the low bits
+    //
+    if (bits < 0x38800000u) {
+        return sign | static_cast<uint16_t>( std::bit_cast<uint32_t>( std::bit_cast<float>(bits) + 0.5f )
+                                             - 0x3f000000u );
+    }
+
+    // • Rebias the exponent and round the dropped 13 bits to nearest even.
+    //   A carry out of the mantissa rounds up to the next exponent, and from
+    //   65520 up to infinity
+    //
+    bits += 0xc8000fffu + ((bits >> 13) & 1u);
+
+    return sign | static_cast<uint16_t>(bits >> 13);
+}
+
+constexpr float make_float(uint16_t half)
+{
+    const auto sign     = static_cast<uint32_t>(half & 0x8000u) << 16;
+    const auto exponent = (half >> 10) & 0x1fu;
+    const auto mantissa = static_cast<uint32_t>(half & 0x3ffu);
+
+    if (0x1f == exponent) {
+        return std::bit_cast<float>( sign | 0x7f800000u | (mantissa << 13) | ((0 != mantissa) ? 0x400000u : 0u) );
+    }
+
+    if (0 == exponent) {
+
+        const auto magnitude = static_cast<float>(mantissa) * 0x1p-24f;
+
+        return (0 != sign) ? -magnitude : magnitude;
+    }
+
+    return std::bit_cast<float>( sign | ((exponent + 112) << 23) | (mantissa << 13) );
+}
+
+//===------------------------------------------------------------------------===
+//
+// • sRGB
+//
+//  - The transfer function of CGColorSpace.sRGB, which the renderer's canvas
+//    and layer use. .rgba16Float pixels hold linear values; .bgra8Unorm
+//    pixels hold sRGB-encoded ones, with alpha linear in both
+//
+//===------------------------------------------------------------------------===
+
+float encode_srgb(float linear);
+float decode_srgb(float encoded);
+
+// • 8-bit sRGB for a half (linear), rounded to nearest. Values at or below
+//   zero (and negative NaNs) give 0; at or above one (and other NaNs), 255
+//
+uint8_t encode_srgb8(uint16_t half);
+
+//===------------------------------------------------------------------------===
+//
+// • Batch conversion (Host)
+//
+//  - Using F16C with AVX2 (when the CPU has both) or NEON, with a scalar
+//    fallback; every implementation gives the same bits. Each converts
+//    min(source.size(), destination.size()) elements, counting pixels for
+//    the pixel conversions
+//
+//  - Encoding to .bgra8Unorm looks up each half in a table of its 8-bit
+//    sRGB value (30 KB with the alpha part, which stays in cache); AVX2
+//    gathers eight lookups at a time, NEON looks them up one by one
+//
+//===------------------------------------------------------------------------===
+
+void make_halves(std::span<const float> values, std::span<uint16_t> halves);
+
+void make_floats(std::span<const uint16_t> halves, std::span<float> values);
+
+// • .rgba16Float pixels (four halves each, linear) to .bgra8Unorm (sRGB)
+//
+void encode_bgra8(std::span<const uint16_t> rgba_halves, std::span<uint32_t> bgra_pixels);
+
+// • .bgra8Unorm pixels (sRGB) to .rgba16Float (linear)
+//
+void decode_bgra8(std::span<const uint32_t> bgra_pixels, std::span<uint16_t> rgba_halves);
+
+// • Blend white over every channel of `halves` by `coverage`, as the source
+//   alpha blend of coverage_fragment: c + (1 - c) * coverage
+//
+void blend_white(std::span<uint16_t> halves, float coverage);
+
+// • Which implementation the batch functions use ("avx2+f16c", "neon" or
+//   "scalar")
+//
+const char* conversion_implementation(void);
+
+} // namespace pixels
@@ -0,0 +1,472 @@
+//
+//  RegionSoA.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Graphics/RegionSoA.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+//===------------------------------------------------------------------------===
+// • Lanes (Private)
+//
+//  - GCC/Clang vector extensions, lane_width regions per step. These lower to
+//    AVX2 where SWEEP_FUNCTION can clone for it, and to pairs of SSE2 or NEON
+//    registers otherwise. Comparisons yield 0 or -1 per element
+//
+//===------------------------------------------------------------------------===
+
+#if defined ( __x86_64__ ) && defined ( __ELF__ )
+#define SWEEP_FUNCTION __attribute__(( target_clones("avx2", "default") ))
+#else
+#define SWEEP_FUNCTION
+#endif
+
+namespace
+{
+
+using uint32x8 = uint32_t __attribute__(( vector_size(32) ));
+using int32x8  = int32_t  __attribute__(( vector_size(32) ));
+using uint64x4 = uint64_t __attribute__(( vector_size(32) ));
+using uint8x32 = uint8_t  __attribute__(( vector_size(32) ));
+
+static_assert( sizeof(uint32x8) == geometry::RegionSoA::lane_alignment, "Unexpected lane size" );
+
+inline uint32x8& at(uint32_t* lane, size_t index)
+{
+    return *reinterpret_cast<uint32x8*>(lane + index);
+}
+
+inline const uint32x8& at(const uint32_t* lane, size_t index)
+{
+    return *reinterpret_cast<const uint32x8*>(lane + index);
+}
+
+// • Lane pointers hoisted out of the loops, as stores through `hits` could
+//   otherwise alias them
+//
+struct Lanes
+{
+    uint32_t* __restrict left;
+    uint32_t* __restrict top;
+    uint32_t* __restrict right;
+    uint32_t* __restrict bottom;
+};
+
+inline size_t whole_lanes(size_t count)
+{
+    return count & ~static_cast<size_t>(geometry::RegionSoA::lane_width - 1);
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • namespace geometry
+//===------------------------------------------------------------------------===
+
+namespace geometry
+{
+
+//===------------------------------------------------------------------------===
+// • Construction
+//===------------------------------------------------------------------------===
+
+RegionSoA::RegionSoA(size_t count)
+{
+    resize(count);
+}
+
+RegionSoA::RegionSoA(std::span<const Region> regions)
+{
+    if (!reallocate(regions.size())) {
+        return;
+    }
+
+    count = regions.size();
+
+    for (size_t index = 0; index < count; ++index) {
+        set(index, regions[index]);
+    }
+}
+
+RegionSoA::RegionSoA(const RegionSoA& other)
+{
+    *this = other;
+}
+
+RegionSoA::RegionSoA(RegionSoA&& other) noexcept
+    : storage       { std::move(other.storage) },
+      count         { std::exchange(other.count, 0) },
+      lane_capacity { std::exchange(other.lane_capacity, 0) }
+{
+}
+
+RegionSoA& RegionSoA::operator = (const RegionSoA& other)
+{
+    if (this != &other) {
+
+        count = 0;
+
+        if (lane_capacity < other.count && !reallocate(other.count)) {
+            return *this;
+        }
+
+        for (uint32_t index = 0; 0 < other.count && index < 4; ++index) {
+            std::memcpy(lane(index), other.lane(index), other.count*sizeof(uint32_t));
+        }
+
+        count = other.count;
+    }
+
+    return *this;
+}
+
+RegionSoA& RegionSoA::operator = (RegionSoA&& other) noexcept
+{
+    if (this != &other) {
+
+        storage       = std::move(other.storage);
+        count         = std::exchange(other.count, 0);
+        lane_capacity = std::exchange(other.lane_capacity, 0);
+    }
+
+    return *this;
+}
+
+//===------------------------------------------------------------------------===
+// • Size
+//===------------------------------------------------------------------------===
+
+bool RegionSoA::reallocate(size_t new_capacity)
+{
+    const auto capacity = padded( std::max<size_t>(new_capacity, lane_width) );
+    const auto bytes    = 4 * capacity * sizeof(uint32_t);
+
+    Storage replacement { static_cast<uint32_t*>( std::aligned_alloc(lane_alignment, bytes) ), &std::free };
+
+    if (nullptr == replacement) {
+        return false;
+    }
+
+    std::memset(replacement.get(), 0, bytes);
+
+    for (uint32_t index = 0; 0 < count && index < 4; ++index) {
+        std::memcpy(replacement.get() + index*capacity, lane(index), count*sizeof(uint32_t));
+    }
+
+    storage       = std::move(replacement);
+    lane_capacity = capacity;
+
+    return true;
+}
+
+bool RegionSoA::reserve(size_t new_capacity)
+{
+    return new_capacity <= lane_capacity || reallocate(new_capacity);
+}
+
+bool RegionSoA::resize(size_t new_count)
+{
+    if (!reserve(new_count)) {
+        return false;
+    }
+
+    // • New regions are empty
+    //
+    for (uint32_t index = 0; count < new_count && index < 4; ++index) {
+        std::memset(lane(index) + count, 0, (new_count - count)*sizeof(uint32_t));
+    }
+
+    count = new_count;
+
+    return true;
+}
+
+bool RegionSoA::push_back(Region region)
+{
+    if (lane_capacity == count && !reallocate(2 * count)) {
+        return false;
+    }
+
+    set(count++, region);
+
+    return true;
+}
+
+//===------------------------------------------------------------------------===
+// • AoS conversion
+//===------------------------------------------------------------------------===
+
+void RegionSoA::store(std::span<Region> regions) const
+{
+    const auto store_count = std::min(count, regions.size());
+
+    for (size_t index = 0; index < store_count; ++index) {
+        regions[index] = (*this)[index];
+    }
+}
+
+//===------------------------------------------------------------------------===
+// • Hit testing
+//===------------------------------------------------------------------------===
+
+SWEEP_FUNCTION
+size_t RegionSoA::contains(simd::uint2 point, std::span<uint8_t> hits) const
+{
+    const auto test_count = std::min(count, hits.size());
+    const auto lanes_end  = whole_lanes(test_count);
+    const Lanes lanes     = { lane(0), lane(1), lane(2), lane(3) };
+    const auto hit_data   = hits.data();
+
+    int32x8 total = {};
+
+    for (size_t index = 0; index < lanes_end; index += lane_width) {
+
+        const auto hit = (at(lanes.left, index) <= point.x) & (point.x < at(lanes.right,  index))
+                       & (at(lanes.top,  index) <= point.y) & (point.y < at(lanes.bottom, index));
+
+        // • The low byte of each element, which is 0 or 1
+        //
+        const auto hit_words = __builtin_bit_cast( uint8x32, -hit );
+        const auto hit_bytes = __builtin_shufflevector(hit_words, hit_words, 0, 4, 8, 12, 16, 20, 24, 28);
+
+        std::memcpy(hit_data + index, &hit_bytes, sizeof(hit_bytes));
+
+        total -= hit;
+    }
+
+    size_t hit_count = 0;
+
+    for (uint32_t element = 0; element < lane_width; ++element) {
+        hit_count += static_cast<uint32_t>(total[element]);
+    }
+
+    for (auto index = lanes_end; index < test_count; ++index) {
+
+        hits[index] = geometry::contains((*this)[index], point) ? 1 : 0;
+        hit_count  += hits[index];
+    }
+
+    return hit_count;
+}
+
+SWEEP_FUNCTION
+size_t RegionSoA::count_containing(simd::uint2 point) const
+{
+    const auto lanes_end = whole_lanes(count);
+    const Lanes lanes    = { lane(0), lane(1), lane(2), lane(3) };
+
+    int32x8 total = {};
+
+    for (size_t index = 0; index < lanes_end; index += lane_width) {
+
+        total -= (at(lanes.left, index) <= point.x) & (point.x < at(lanes.right,  index))
+               & (at(lanes.top,  index) <= point.y) & (point.y < at(lanes.bottom, index));
+    }
+
+    size_t hit_count = 0;
+
+    for (uint32_t element = 0; element < lane_width; ++element) {
+        hit_count += static_cast<uint32_t>(total[element]);
+    }
+
+    for (auto index = lanes_end; index < count; ++index) {
+        hit_count += geometry::contains((*this)[index], point) ? 1 : 0;
+    }
+
+    return hit_count;
+}
+
+SWEEP_FUNCTION
+std::optional<size_t> RegionSoA::last_containing(simd::uint2 point) const
+{
+    const auto lanes_end = whole_lanes(count);
+    const Lanes lanes    = { lane(0), lane(1), lane(2), lane(3) };
+
+    for (auto index = count; lanes_end < index; --index) {
+        if (geometry::contains((*this)[index - 1], point)) {
+            return index - 1;
+        }
+    }
+
+    for (auto index = lanes_end; 0 < index; index -= lane_width) {
+
+        const auto first  = index - lane_width;
+        const int32x8 hit = (at(lanes.left, first) <= point.x) & (point.x < at(lanes.right,  first))
+                          & (at(lanes.top,  first) <= point.y) & (point.y < at(lanes.bottom, first));
+
+        int32_t any_hit = 0;
+
+        for (uint32_t element = 0; element < lane_width; ++element) {
+            any_hit |= hit[element];
+        }
+
+        if (0 == any_hit) {
+            continue;
+        }
+
+        for (uint32_t element = lane_width; 0 < element; --element) {
+            if (0 != hit[element - 1]) {
+                return first + element - 1;
+            }
+        }
+    }
+
+    return std::nullopt;
+}
+
+//===------------------------------------------------------------------------===
+// • In-place operations
+//===------------------------------------------------------------------------===
+
+SWEEP_FUNCTION
+void RegionSoA::translate(simd::int2 offset)
+{
+    // • Unsigned wrap-around, as Region + int2
+    //
+    const auto dx = static_cast<uint32_t>(offset.x);
+    const auto dy = static_cast<uint32_t>(offset.y);
+
+    const auto lanes_end = whole_lanes(count);
+    const Lanes lanes    = { lane(0), lane(1), lane(2), lane(3) };
+
+    for (size_t index = 0; index < lanes_end; index += lane_width) {
+
+        at(lanes.left,   index) += dx;
+        at(lanes.top,    index) += dy;
+        at(lanes.right,  index) += dx;
+        at(lanes.bottom, index) += dy;
+    }
+
+    for (auto index = lanes_end; index < count; ++index) {
+        set(index, (*this)[index] + offset);
+    }
+}
+
+SWEEP_FUNCTION
+void RegionSoA::intersect(Region clip)
+{
+    const auto lanes_end = whole_lanes(count);
+    const Lanes lanes    = { lane(0), lane(1), lane(2), lane(3) };
+
+    for (size_t index = 0; index < lanes_end; index += lane_width) {
+
+        auto& left   = at(lanes.left,   index);
+        auto& top    = at(lanes.top,    index);
+        auto& right  = at(lanes.right,  index);
+        auto& bottom = at(lanes.bottom, index);
+
+        left = (left < clip.left) ? clip.left : left;
+        top  = (top  < clip.top)  ? clip.top  : top;
+
+        const uint32x8 clipped_right  = (right  < clip.right)  ? right  : clip.right;
+        const uint32x8 clipped_bottom = (bottom < clip.bottom) ? bottom : clip.bottom;
+
+        right  = (clipped_right  < left) ? left : clipped_right;
+        bottom = (clipped_bottom < top)  ? top  : clipped_bottom;
+    }
+
+    for (auto index = lanes_end; index < count; ++index) {
+        set(index, intersection((*this)[index], clip));
+    }
+}
+
+//===------------------------------------------------------------------------===
+// • Reductions
+//===------------------------------------------------------------------------===
+
+SWEEP_FUNCTION
+Region RegionSoA::bounds(void) const
+{
+    if (0 == count) {
+        return { 0, 0, 0, 0 };
+    }
+
+    auto result = (*this)[0];
+
+    const auto lanes_end = whole_lanes(count);
+    const Lanes lanes    = { lane(0), lane(1), lane(2), lane(3) };
+
+    if (0 < lanes_end) {
+
+        auto left   = at(lanes.left,   0);
+        auto top    = at(lanes.top,    0);
+        auto right  = at(lanes.right,  0);
+        auto bottom = at(lanes.bottom, 0);
+
+        for (size_t index = lane_width; index < lanes_end; index += lane_width) {
+
+            const auto& next_left   = at(lanes.left,   index);
+            const auto& next_top    = at(lanes.top,    index);
+            const auto& next_right  = at(lanes.right,  index);
+            const auto& next_bottom = at(lanes.bottom, index);
+
+            left   = (next_left   < left)   ? next_left   : left;
+            top    = (next_top    < top)    ? next_top    : top;
+            right  = (right  < next_right)  ? next_right  : right;
+            bottom = (bottom < next_bottom) ? next_bottom : bottom;
+        }
+
+        for (uint32_t element = 0; element < lane_width; ++element) {
+            result = bounding_region( result, { left[element], top[element], right[element], bottom[element] } );
+        }
+    }
+
+    for (auto index = lanes_end; index < count; ++index) {
+        result = bounding_region(result, (*this)[index]);
+    }
+
+    return result;
+}
+
+SWEEP_FUNCTION
+uint64_t RegionSoA::total_area(void) const
+{
+    const auto lanes_end = whole_lanes(count);
+    const Lanes lanes    = { lane(0), lane(1), lane(2), lane(3) };
+
+    uint64x4 total = {};
+
+    for (size_t index = 0; index < lanes_end; index += lane_width) {
+
+        // • Even and odd elements as 32 x 32 -> 64 bit products
+        //
+        const auto width  = __builtin_bit_cast( uint64x4, at(lanes.right,  index) - at(lanes.left, index) );
+        const auto height = __builtin_bit_cast( uint64x4, at(lanes.bottom, index) - at(lanes.top,  index) );
+
+        total += (width & 0xffffffff) * (height & 0xffffffff) + (width >> 32) * (height >> 32);
+    }
+
+    uint64_t area = 0;
+
+    for (uint32_t element = 0; element < lane_width / 2; ++element) {
+        area += total[element];
+    }
+
+    for (auto index = lanes_end; index < count; ++index) {
+
+        const auto region = (*this)[index];
+
+        area += static_cast<uint64_t>( width(region) ) * height(region);
+    }
+
+    return area;
+}
+
+} // namespace geometry
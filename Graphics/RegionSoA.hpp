@@ -0,0 +1,164 @@
+//
+//  RegionSoA.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <Graphics/Geometry.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <span>
+
+//===------------------------------------------------------------------------===
+// • namespace geometry
+//===------------------------------------------------------------------------===
+
+namespace geometry
+{
+
+//===------------------------------------------------------------------------===
+//
+// • RegionSoA (Host)
+//
+//  - Regions stored as four separate lanes (left, top, right, bottom) so that
+//    bulk operations run a whole SIMD register of regions at a time. Each
+//    lane is aligned to lane_alignment and padded to a multiple of
+//    lane_width elements
+//
+//  - The GPU reads Region (AoS), so conversion is a transpose: construct
+//    from a span of Region and store() straight into the destination, e.g.
+//    the contents of an MTLBuffer, with no intermediate copy
+//
+//===------------------------------------------------------------------------===
+
+class RegionSoA
+{
+public:
+
+    enum : uint32_t
+    {
+        lane_width     = 8,
+        lane_alignment = lane_width * sizeof(uint32_t)
+    };
+
+    RegionSoA(void) noexcept = default;
+
+    explicit RegionSoA(size_t count);
+    explicit RegionSoA(std::span<const Region> regions);
+
+    RegionSoA(const RegionSoA& other);
+    RegionSoA(RegionSoA&& other) noexcept;
+
+    RegionSoA& operator = (const RegionSoA& other);
+    RegionSoA& operator = (RegionSoA&& other) noexcept;
+
+    // • Size
+    //
+    size_t size(void) const noexcept
+    {
+        return count;
+    }
+
+    size_t capacity(void) const noexcept
+    {
+        return lane_capacity;
+    }
+
+    bool empty(void) const noexcept
+    {
+        return 0 == count;
+    }
+
+    // • These return false, leaving the regions unchanged, if memory runs
+    //   out. The constructors leave the container empty in that case
+    //
+    bool reserve(size_t new_capacity);
+    bool resize(size_t new_count);
+    bool push_back(Region region);
+
+    // • Elements
+    //
+    Region operator [] (size_t index) const noexcept
+    {
+        return { lane(0)[index], lane(1)[index], lane(2)[index], lane(3)[index] };
+    }
+
+    void set(size_t index, Region region) noexcept
+    {
+        lane(0)[index] = region.left;
+        lane(1)[index] = region.top;
+        lane(2)[index] = region.right;
+        lane(3)[index] = region.bottom;
+    }
+
+    std::span<const uint32_t> left(void)   const noexcept { return { lane(0), count }; }
+    std::span<const uint32_t> top(void)    const noexcept { return { lane(1), count }; }
+    std::span<const uint32_t> right(void)  const noexcept { return { lane(2), count }; }
+    std::span<const uint32_t> bottom(void) const noexcept { return { lane(3), count }; }
+
+    // • AoS conversion: store min(size(), regions.size()) regions
+    //
+    void store(std::span<Region> regions) const;
+
+    // • Hit testing. contains() sets hits[i] to 1 if region i contains
+    //   `point` and 0 otherwise, for min(size(), hits.size()) regions, and
+    //   returns the number of hits. last_containing() finds the last
+    //   (topmost) region containing `point`
+    //
+    size_t contains(simd::uint2 point, std::span<uint8_t> hits) const;
+    size_t count_containing(simd::uint2 point) const;
+
+    std::optional<size_t> last_containing(simd::uint2 point) const;
+
+    // • In-place operations, as operator + and intersection() per region
+    //
+    void translate(simd::int2 offset);
+    void intersect(Region clip);
+
+    // • Reductions. bounds() of no regions is the empty region at the origin
+    //
+    Region   bounds(void) const;
+    uint64_t total_area(void) const;
+
+private:
+
+    using Storage = std::unique_ptr<uint32_t, decltype(&std::free)>;
+
+    static size_t padded(size_t count) noexcept
+    {
+        return (count + lane_width - 1) & ~static_cast<size_t>(lane_width - 1);
+    }
+
+    // • Lanes are consecutive in one allocation: left, top, right, bottom
+    //
+    uint32_t* lane(uint32_t index) const noexcept
+    {
+        return storage.get() + index*lane_capacity;
+    }
+
+    bool reallocate(size_t new_capacity);
+
+    Storage     storage       { nullptr, &std::free };
+    size_t      count         = 0;
+    size_t      lane_capacity = 0;
+};
+
+} // namespace geometry
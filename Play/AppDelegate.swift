@@ -59,6 +59,7 @@ class AppDelegate : NSObject, NSApplicationDelegate {
         fileMenu.addItem( withTitle: "Close Window", action:#selector(closeWindow), keyEquivalent:"w" )
         fileMenu.addItem( .separator() )
         fileMenu.addItem(withTitle: "Export...", action: #selector(exportImage), keyEquivalent: "e")
+        fileMenu.addItem(withTitle: "Record Trace", action: #selector(toggleTrace(_:)), keyEquivalent: "t")
 
         let fileMenuItem = NSMenuItem()
         fileMenuItem.submenu = fileMenu
@@ -134,6 +135,44 @@ class AppDelegate : NSObject, NSApplicationDelegate {
         window?.close()
     }
 
+    //  - Start recording a trace, or stop and write it to Documents for
+    //    chrome://tracing or Perfetto
+    //
+    @objc private func toggleTrace(_ sender: NSMenuItem) {
+
+        guard Tracing.isEnabled else {
+
+            Tracing.clear()
+            Tracing.isEnabled = true
+
+            sender.state = Tracing.isEnabled ? .on : .off
+            return
+        }
+
+        Tracing.isEnabled = false
+        sender.state      = .off
+
+        guard let documentsDirectoryURL = try? FileManager.default.url(for: .documentDirectory,
+                                                                       in: .userDomainMask,
+                                                                       appropriateFor: nil,
+                                                                       create: false) else {
+            return
+        }
+
+        DispatchQueue.global().async {
+
+            let formatter = DateFormatter()
+
+            formatter.locale     = .init(identifier: "en_US_POSIX")
+            formatter.dateFormat = "yyyy-MM-dd' at 'h.mm.ss a"
+
+            let date      = formatter.string(from: Date.now)
+            let outputURL = documentsDirectoryURL.appending(component: "Play Trace " + date + ".json")
+
+            Tracing.writeChromeTrace(to: outputURL)
+        }
+    }
+
     @objc private func exportImage() {
 
         //  - Currently exporting square images - catch when I chnage that
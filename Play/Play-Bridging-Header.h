@@ -18,3 +18,5 @@
 //
 
 #import <Composition/Composition.h>
+#import <Composition/FrameExporter.h>
+#import <Composition/Tracing.h>
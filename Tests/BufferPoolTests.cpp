@@ -0,0 +1,303 @@
+//
+//  BufferPoolTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Data/BufferPool.hpp>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace data;
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+// • Host slabs, counted. Or, without contents, only the sizes asked for, so
+//   that a pool of the largest slabs needs no memory
+//
+struct CountingSource
+{
+    uint32_t              live_slabs = 0;
+    std::vector<uint32_t> sizes;
+
+    SlabSource make(bool has_contents)
+    {
+        auto host = host_slab_source();
+
+        return {
+            .allocate = [this, host, has_contents](uint32_t size) -> std::optional<Slab> {
+
+                sizes.push_back(size);
+
+                if (!has_contents) {
+                    ++live_slabs;
+                    return Slab { .contents = nullptr, .handle = this };
+                }
+
+                const auto slab = host.allocate(size);
+
+                if (slab) {
+                    ++live_slabs;
+                }
+
+                return slab;
+            },
+            .release = [this, host, has_contents](const Slab& slab) {
+
+                --live_slabs;
+
+                if (has_contents) {
+                    host.release(slab);
+                }
+            }
+        };
+    }
+};
+
+// • An allocation still in use, filled with `tag`
+//
+struct Live
+{
+    PoolAllocation  allocation;
+    uint8_t         tag;
+    bool            is_frame;
+    uint64_t        frame;
+};
+
+bool is_intact(const BufferPool& pool, const Live& live)
+{
+    const auto contents = pool.contents(live.allocation);
+
+    if (nullptr == contents) {
+        return false;
+    }
+
+    for (uint32_t index = 0; index < live.allocation.size; index += 7) {
+        if (live.tag != contents[index]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Tests
+//===------------------------------------------------------------------------===
+
+TEST(buffer_pool_size_classes)
+{
+    for (uint32_t size = 1; size < (1u << 22); size += (size < 4096) ? 1 : 97) {
+
+        const auto size_class = data::size_class(size);
+        const auto block_size = class_size(size_class);
+
+        CHECK( size <= block_size );
+        CHECK( 0 == block_size % alignment );
+        CHECK( 0 == size_class || class_size(size_class - 1) < aligned_size(size) );
+
+        // • At most a fifth lost past the linear classes
+        //
+        CHECK( size <= linear_class_limit || (block_size - aligned_size(size))*5 <= block_size );
+    }
+}
+
+// • Random allocations, frees, frames and trims against a model of what's
+//   in use, for each slab size
+//
+TEST(buffer_pool_random_operations)
+{
+    std::mt19937   generator { 1 };
+    CountingSource counting;
+
+    for (uint32_t trial = 0; trial < 100; ++trial) {
+
+        BufferPool        pool { counting.make(true), 1u << (16 + trial % 5) };
+        std::vector<Live> live;
+        uint64_t          requested = 0;
+        uint64_t          frame     = 0;
+        uint64_t          completed = 0;
+
+        for (uint32_t operation = 0; operation < 2000; ++operation) {
+
+            const auto choice = generator() % 100;
+
+            if (choice < 45) {
+
+                const auto size       = (0 == generator() % 4) ? generator() % (1u << 19) : generator() % 600;
+                const bool is_frame   = (0 == generator() % 3);
+                const auto allocation = is_frame ? pool.allocate_for_frame(size) : pool.allocate(size);
+
+                if (!CHECK( allocation )) {
+                    continue;
+                }
+
+                CHECK( 0 == allocation->offset % alignment );
+                CHECK( size <= pool.capacity(*allocation) );
+
+                const auto tag = static_cast<uint8_t>( generator() );
+
+                std::memset(pool.contents(*allocation), tag, size);
+
+                live.push_back( { *allocation, tag, is_frame, frame } );
+                requested += size;
+
+            } else if (choice < 85) {
+
+                if (live.empty()) {
+                    continue;
+                }
+
+                const auto index = generator() % live.size();
+
+                if (live[index].is_frame) {
+                    continue;
+                }
+
+                CHECK( is_intact(pool, live[index]) );
+                CHECK( pool.free(live[index].allocation) );
+                CHECK( !pool.free(live[index].allocation) );
+
+                requested  -= live[index].allocation.size;
+                live[index] = live.back();
+                live.pop_back();
+
+            } else if (choice < 92) {
+
+                CHECK( frame == pool.end_frame() );
+                ++frame;
+
+            } else if (choice < 97) {
+
+                if (completed < frame) {
+                    completed += 1 + generator() % (frame - completed);
+                }
+
+                for (const auto& allocation : live) {
+                    if (allocation.is_frame && allocation.frame < completed) {
+                        CHECK( is_intact(pool, allocation) );
+                    }
+                }
+
+                pool.release_frames(completed);
+
+                std::erase_if( live, [&](const Live& allocation) {
+
+                    const auto is_released = allocation.is_frame && allocation.frame < completed;
+
+                    if (is_released) {
+                        requested -= allocation.allocation.size;
+                    }
+
+                    return is_released;
+                } );
+
+            } else {
+
+                pool.trim();
+
+                CHECK( 0 == pool.statistics().empty_slab_count );
+            }
+
+            const auto statistics = pool.statistics();
+
+            CHECK( live.size() == statistics.allocation_count );
+            CHECK( requested == statistics.requested_bytes );
+            CHECK( counting.live_slabs == statistics.slab_count );
+            CHECK( statistics.allocated_bytes + statistics.empty_slab_bytes <= statistics.slab_bytes );
+        }
+
+        for (const auto& allocation : live) {
+            CHECK( is_intact(pool, allocation) );
+        }
+    }
+
+    CHECK( 0 == counting.live_slabs );
+}
+
+// • Every class of a pool of the largest slabs gets a slab that holds its
+//   blocks: blocks_per_slab of the largest classes overflow 32 bits
+//
+TEST(buffer_pool_maximum_slab_size)
+{
+    CountingSource counting;
+    BufferPool     pool { counting.make(false), BufferPool::maximum_slab_size };
+
+    CHECK( BufferPool::maximum_slab_size == pool.slab_size() );
+
+    for (uint32_t size_class = 0; size_class <= data::size_class( pool.maximum_class_size() ); ++size_class) {
+
+        const auto size = class_size(size_class);
+
+        counting.sizes.clear();
+
+        // • Enough blocks to fill the first slab and start another
+        //
+        for (uint32_t block = 0; block < 5; ++block) {
+
+            const auto allocation = pool.allocate(size);
+
+            if (!CHECK( allocation )) {
+                break;
+            }
+
+            CHECK( size == pool.capacity(*allocation) );
+            CHECK( pool.capacity(*allocation) <= pool.slab_size() );
+        }
+
+        for (const auto slab_size : counting.sizes) {
+            CHECK( size <= slab_size );
+            CHECK( slab_size <= pool.slab_size() );
+        }
+    }
+
+    // • The largest class, four to a slab, in a pool of its own
+    //
+    BufferPool largest_pool { counting.make(false), BufferPool::maximum_slab_size };
+
+    const auto largest = largest_pool.maximum_class_size();
+
+    counting.sizes.clear();
+
+    std::vector<PoolAllocation> allocations;
+
+    for (uint32_t block = 0; block < 5; ++block) {
+        allocations.push_back( largest_pool.allocate(largest).value_or( PoolAllocation { } ) );
+    }
+
+    CHECK( 2 == counting.sizes.size() );
+    CHECK( allocations[0].slab == allocations[3].slab );
+    CHECK( allocations[3].slab != allocations[4].slab );
+    CHECK( 3*largest == allocations[3].offset );
+
+    // • One past the largest class gets a slab of its own
+    //
+    const auto large = largest_pool.allocate(largest + 1);
+
+    CHECK( large && 0 == large->offset );
+    CHECK( aligned_size(largest + 1) == counting.sizes.back() );
+}
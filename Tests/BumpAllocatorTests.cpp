@@ -0,0 +1,70 @@
+//
+//  BumpAllocatorTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Data/BumpAllocator.hpp>
+
+#include <string_view>
+
+//===------------------------------------------------------------------------===
+// • Tests
+//
+//  - Sizes within 15 bytes of 2^32 round up past it: they must fail, not
+//    wrap to an empty allocation
+//
+//===------------------------------------------------------------------------===
+
+TEST(bump_allocator_size_limit)
+{
+    alignas(16) uint8_t memory[256] = { };
+
+    data::BumpAllocator fixed { memory, sizeof(memory) };
+
+    CHECK( !fixed.allocate(UINT32_MAX) );
+    CHECK( !fixed.allocate(UINT32_MAX - 14) );
+    CHECK( 0 == fixed.size() );
+
+    CHECK( 0 == fixed.allocate(100) );
+    CHECK( 112 == fixed.size() );
+
+    // • Owned blocks fail before growing
+    //
+    data::BumpAllocator owned { 64 };
+
+    CHECK( !owned.allocate(UINT32_MAX - 1) );
+    CHECK( !owned.allocate_array<uint8_t>(UINT32_MAX) );
+    CHECK( 0 == owned.size() );
+}
+
+TEST(bump_allocator_string_limit)
+{
+    data::BumpAllocator owned { 64 };
+
+    // • length + 1 == UINT32_MAX; the characters are never read
+    //
+    const std::string_view text { "", UINT32_MAX - 1 };
+
+    CHECK( !owned.copy_string(text) );
+    CHECK( 0 == owned.size() );
+
+    const auto copied = owned.copy_string("play");
+
+    CHECK( copied && "play" == owned.at(*copied) );
+}
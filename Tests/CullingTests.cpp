@@ -0,0 +1,180 @@
+//
+//  CullingTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Composition/Culling.hpp>
+#include <Composition/PatternQueries.hpp>
+
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//
+//  - Random lattices anywhere in the grid, some nesting a tile. Host
+//    culling must find exactly the instances that testing each one on its
+//    own finds, in draw order
+//
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t    pattern_count = 300;
+constexpr simd::uint2 grid_size     = { 1920, 1080 };
+constexpr simd::uint2 tile_size     = { 24, 24 };
+
+struct FreeArena
+{
+    void operator () (Arena* arena) const noexcept
+    {
+        std::free(arena);
+    }
+};
+
+using ArenaPointer = std::unique_ptr<Arena, FreeArena>;
+
+ArenaPointer make_scene(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, grid_size.x };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, grid_size.y };
+    std::uniform_int_distribution<uint32_t> extent       { 1, 40 };
+    std::uniform_int_distribution<int32_t>  step         { -30, 30 };
+    std::uniform_int_distribution<uint32_t> count        { 1, 40 };
+    std::uniform_int_distribution<uint32_t> choice       { 0, 3 };
+
+    const auto memory = std::aligned_alloc( 16, arena_size(pattern_count, 1) );
+    const auto arena  = make_arena(memory, pattern_count, 1);
+
+    const auto tile = append_nested( *arena, {
+        .grid_size   = tile_size,
+        .base_region = { 2, 2, 6, 5 },
+        .offset      = { 6, 0 },
+        .count       = 4,
+        .row_count   = 3,
+        .row_offset  = { 0, 7 },
+        .nested      = 0,
+        .reserved    = 0
+    } );
+
+    // • Lattices that leave the grid are rejected (see validate); draw
+    //   others until pattern_count fit
+    //
+    while (arena->patterns.count < pattern_count) {
+
+        const auto left     = x_coordinate(generator);
+        const auto top      = y_coordinate(generator);
+        const auto is_tiled = tile && 0 == choice(generator);
+
+        const auto base_region = is_tiled
+                               ? geometry::Region { left, top, left + tile_size.x, top + tile_size.y }
+                               : geometry::Region { left, top, left + extent(generator), top + extent(generator) };
+
+        append( *arena, {
+            .grid_size   = grid_size,
+            .base_region = base_region,
+            .offset      = { step(generator), step(generator) },
+            .count       = count(generator),
+            .row_count   = 1 + choice(generator),
+            .row_offset  = { step(generator), step(generator) },
+            .nested      = is_tiled ? *tile : 0,
+            .reserved    = 0
+        } );
+    }
+
+    return ArenaPointer { arena };
+}
+
+// • As cull_instances in Shaders.metal: every instance of the arena
+//
+std::vector<uint32_t> cull_every_instance(const Arena& arena, geometry::TextureRect viewport)
+{
+    std::vector<uint32_t> visible_instances;
+
+    const auto records = patterns(arena);
+    const auto first   = first_instances(arena);
+
+    for (uint32_t iid = 0; iid < arena.instance_count; ++iid) {
+
+        const auto  index   = pattern_index(arena, iid);
+        const auto& pattern = records[index];
+
+        if (is_visible(instance_region(records, pattern, iid - first[index]), pattern.grid_size, viewport)) {
+            visible_instances.push_back(iid);
+        }
+    }
+
+    return visible_instances;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Tests
+//===------------------------------------------------------------------------===
+
+TEST(culling_matches_every_instance)
+{
+    std::mt19937 generator { 11 };
+
+    const auto arena = make_scene(generator);
+
+    CHECK( pattern_count == arena->patterns.count );
+
+    // • The whole view, zoomed in, across each edge, outside it, and a
+    //   viewport of a fraction of a grid unit
+    //
+    const geometry::TextureRect viewports[] = {
+        geometry::full_texture_rect(),
+        { 0.4375f, 0.4375f, 0.5625f, 0.5625f },
+        { -0.25f, 0.1f, 0.2f, 0.3f },
+        { 0.8f, 0.7f, 1.5f, 1.25f },
+        { 1.1f, 0.0f, 2.0f, 1.0f },
+        { 0.5f, 0.5f, 0.5001f, 0.5001f }
+    };
+
+    std::vector<uint32_t> visible;
+
+    for (const auto& viewport : viewports) {
+
+        const auto expected  = cull_every_instance(*arena, viewport);
+        const auto arguments = cull_instances(*arena, viewport, visible);
+
+        CHECK( expected == visible );
+        CHECK( visible.size() == arguments.instance_count );
+        CHECK( 4 == arguments.vertex_count );
+    }
+}
+
+TEST(culling_empty_viewport)
+{
+    std::mt19937 generator { 12 };
+
+    const auto arena = make_scene(generator);
+
+    std::vector<uint32_t> visible { 1, 2, 3 };
+
+    const auto arguments = cull_instances(*arena, { 0.6f, 0.2f, 0.4f, 0.8f }, visible);
+
+    CHECK( visible.empty() );
+    CHECK( 0 == arguments.instance_count );
+}
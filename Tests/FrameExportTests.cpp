@@ -0,0 +1,66 @@
+//
+//  FrameExportTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Composition/FrameExport.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//===------------------------------------------------------------------------===
+// • Tests
+//
+//  - The image data of a PNG is one IDAT chunk, of at most 2^31 - 1 bytes.
+//    Larger frames are refused before their buffers are allocated, rather
+//    than written with a truncated chunk length
+//
+//===------------------------------------------------------------------------===
+
+TEST(frame_exporter_png_limit)
+{
+    const auto descriptor = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+    if (!CHECK( 0 <= descriptor )) {
+        return;
+    }
+
+    {
+        raster::FrameExporter largest { descriptor, { 30000, 30000 }, raster::PixelFormat::bgra8Unorm,
+                                        raster::FrameEncoding::png };
+
+        CHECK( !largest.is_valid() );
+    }
+
+    {
+        raster::FrameExporter exporter { descriptor, { 64, 48 }, raster::PixelFormat::bgra8Unorm,
+                                         raster::FrameEncoding::png };
+
+        CHECK( exporter.is_valid() );
+
+        exporter.begin_frame();
+        exporter.end_frame();
+
+        CHECK( exporter.finish() );
+        CHECK( 1 == exporter.frames_written() );
+        CHECK( raster::png_size(64, 48) == exporter.bytes_written() );
+    }
+
+    ::close(descriptor);
+}
@@ -0,0 +1,178 @@
+//
+//  FrameRingTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Data/FrameRing.hpp>
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//
+//  - A producer, a consumer and a third thread completing frames, as an
+//    MTLCommandBuffer completed handler would. Every word of a slot holds
+//    its frame, so a slot written while still in flight shows up, both to
+//    the consumer and to the completer checking it again before freeing it
+//
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint64_t frame_count = 20000;
+constexpr uint32_t slot_words  = 64;
+
+using Slot = std::array<std::atomic<uint64_t>, slot_words>;
+
+void write_slot(Slot& slot, uint64_t frame)
+{
+    for (auto& word : slot) {
+        word.store(frame, std::memory_order_relaxed);
+    }
+}
+
+bool is_slot(const Slot& slot, uint64_t frame)
+{
+    for (const auto& word : slot) {
+        if (frame != word.load(std::memory_order_relaxed)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <uint32_t Count_>
+void run_frames(void)
+{
+    data::FrameRing<Count_>    ring;
+    std::array<Slot, Count_>   slots { };
+    std::atomic<uint64_t>      consumed_frames = 0;
+    std::atomic<uint32_t>      corrupted       = 0;
+    std::atomic<uint32_t>      overfull        = 0;
+
+    // • Alternately spins on try_consume and waits in consume
+    //
+    std::thread consumer { [&] {
+        for (uint64_t frame = 0; frame < frame_count; ++frame) {
+
+            auto slot = ring.try_consume();
+
+            while (0 == frame % 2 && !slot) {
+                std::this_thread::yield();
+                slot = ring.try_consume();
+            }
+
+            if (!slot) {
+                slot = ring.consume();
+            }
+
+            if (frame % Count_ != *slot || !is_slot(slots[*slot], frame)) {
+                ++corrupted;
+            }
+
+            consumed_frames.store(frame + 1, std::memory_order_release);
+        }
+    } };
+
+    std::thread completer { [&] {
+        for (uint64_t frame = 0; frame < frame_count; ++frame) {
+
+            while (consumed_frames.load(std::memory_order_acquire) <= frame) {
+                std::this_thread::yield();
+            }
+
+            if (!is_slot(slots[frame % Count_], frame)) {
+                ++corrupted;
+            }
+
+            ring.complete();
+        }
+    } };
+
+    // • Produce, alternately spinning on try_acquire and waiting in acquire
+    //
+    for (uint64_t frame = 0; frame < frame_count; ++frame) {
+
+        auto slot = ring.try_acquire();
+
+        while (0 == frame % 2 && !slot) {
+            std::this_thread::yield();
+            slot = ring.try_acquire();
+        }
+
+        if (!slot) {
+            slot = ring.acquire();
+        }
+
+        if (Count_ <= ring.frames_in_flight()) {
+            ++overfull;
+        }
+
+        write_slot(slots[*slot], frame);
+
+        ring.commit();
+    }
+
+    consumer.join();
+    completer.join();
+
+    CHECK( 0 == corrupted );
+    CHECK( 0 == overfull );
+    CHECK( frame_count == ring.committed_frames() );
+    CHECK( frame_count == ring.completed_frames() );
+    CHECK( 0 == ring.frames_in_flight() );
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Tests
+//===------------------------------------------------------------------------===
+
+TEST(frame_ring_single_slot)
+{
+    run_frames<1>();
+}
+
+TEST(frame_ring_three_slots)
+{
+    run_frames<3>();
+}
+
+TEST(frame_buffers_block_alignment)
+{
+    data::FrameBuffers<3> buffers { 5000, 4096 };
+
+    CHECK( buffers.is_valid() );
+    CHECK( 8192 == buffers.size() );
+
+    for (uint32_t slot = 0; slot < 3; ++slot) {
+        CHECK( 0 == reinterpret_cast<uintptr_t>( buffers[slot] ) % 4096 );
+    }
+
+    // • Rounded up past 2^32 bytes
+    //
+    data::FrameBuffers<1> largest { UINT32_MAX - 100, 4096 };
+
+    CHECK( !largest.is_valid() );
+}
@@ -0,0 +1,119 @@
+//
+//  JobSystemTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Data/JobSystem.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+double thread_cpu_seconds(void)
+{
+    timespec time;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+
+    return static_cast<double>(time.tv_sec) + 1e-9 * static_cast<double>(time.tv_nsec);
+}
+
+// • Fork / join down to n < 2, some leaves sleeping, so that waits find
+//   nothing to run while their jobs are elsewhere
+//
+uint64_t fibonacci(data::JobSystem& jobs, uint32_t n)
+{
+    if (n < 2) {
+
+        if (0 == n) {
+            std::this_thread::sleep_for( std::chrono::microseconds { 50 } );
+        }
+
+        return n;
+    }
+
+    uint64_t first  = 0;
+    uint64_t second = 0;
+
+    jobs.fork_join( [&] { first  = fibonacci(jobs, n - 1); },
+                    [&] { second = fibonacci(jobs, n - 2); } );
+
+    return first + second;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Tests
+//===------------------------------------------------------------------------===
+
+// • A wait whose job another worker runs for a long time sleeps rather
+//   than spinning, and wakes when the job finishes
+//
+TEST(job_system_wait_sleeps)
+{
+    data::JobSystem jobs { 2 };
+
+    constexpr auto job_time = std::chrono::milliseconds { 200 };
+
+    std::atomic<bool> is_started = false;
+    std::atomic<bool> is_done    = false;
+
+    const auto start_cpu = thread_cpu_seconds();
+    const auto start     = std::chrono::steady_clock::now();
+
+    jobs.fork_join( [&] {
+        while (!is_started.load()) {
+            std::this_thread::yield();
+        }
+    }, [&] {
+        is_started = true;
+        std::this_thread::sleep_for(job_time);
+        is_done = true;
+    } );
+
+    const auto cpu_seconds = thread_cpu_seconds() - start_cpu;
+
+    CHECK( is_done );
+    CHECK( job_time <= std::chrono::steady_clock::now() - start );
+    CHECK( cpu_seconds < 0.05 );
+}
+
+// • Nested joins on more workers than cores, every wait likely to sleep at
+//   some point; a lost wakeup hangs (see the CTest timeout)
+//
+TEST(job_system_nested_joins)
+{
+    for (const uint32_t worker_count : { 2u, 3u, 8u }) {
+
+        data::JobSystem jobs { worker_count };
+
+        for (uint32_t repetition = 0; repetition < 4; ++repetition) {
+            CHECK( 610 == fibonacci(jobs, 15) );
+        }
+    }
+}
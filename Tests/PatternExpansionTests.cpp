@@ -0,0 +1,281 @@
+//
+//  PatternExpansionTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Composition/PatternExpansion.hpp>
+
+#include <array>
+#include <iterator>
+#include <limits>
+#include <random>
+
+//===------------------------------------------------------------------------===
+// • Compile time
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr std::array scene = {
+    Pattern {
+        .grid_size   = { 64, 64 },
+        .base_region = { 1, 2, 3, 4 },
+        .offset      = { 4, 0 },
+        .count       = 3,
+        .row_count   = 1,
+        .row_offset  = { 0, 0 },
+        .nested      = 0,
+        .reserved    = 0
+    },
+    Pattern {
+        .grid_size   = { 64, 64 },
+        .base_region = { 40, 40, 42, 41 },
+        .offset      = { -8, 0 },
+        .count       = 2,
+        .row_count   = 2,
+        .row_offset  = { 1, 10 },
+        .nested      = 0,
+        .reserved    = 0
+    }
+};
+
+constexpr auto table = bake_instances<instance_count(scene)>(scene);
+
+static_assert( 7 == table.size() );
+static_assert( geometry::Region { 1, 2, 3, 4 }     == table[0] );
+static_assert( geometry::Region { 9, 2, 11, 4 }    == table[2] );
+static_assert( geometry::Region { 32, 40, 34, 41 } == table[4] );
+static_assert( geometry::Region { 33, 50, 35, 51 } == table[6] );
+
+// • One pattern for each error, each a step past a valid one
+//
+constexpr Pattern make_pattern(simd::int2 offset, uint32_t count)
+{
+    return {
+        .grid_size   = { 100, 100 },
+        .base_region = { 10, 10, 20, 20 },
+        .offset      = offset,
+        .count       = count,
+        .row_count   = 1,
+        .row_offset  = { 0, 0 },
+        .nested      = 0,
+        .reserved    = 0
+    };
+}
+
+static_assert( PatternError::none             == validate( make_pattern({ 10, 0 }, 9) ) );
+static_assert( PatternError::no_instances     == validate( make_pattern({ 10, 0 }, 0) ) );
+static_assert( PatternError::outside_grid     == validate( make_pattern({ 10, 0 }, 10) ) );
+static_assert( PatternError::none             == validate( make_pattern({ -10, 0 }, 2) ) );
+static_assert( PatternError::coordinates_wrap == validate( make_pattern({ -10, 0 }, 3) ) );
+static_assert( PatternError::offset_overflows == validate( make_pattern({ 1 << 30, 0 }, 3) ) );
+
+constexpr Pattern make_lattice(uint32_t count, uint32_t row_count, geometry::Region base_region)
+{
+    auto pattern = make_pattern({ 0, 0 }, count);
+
+    pattern.row_count   = row_count;
+    pattern.base_region = base_region;
+
+    return pattern;
+}
+
+static_assert( PatternError::empty_region       == validate( make_lattice(1, 1, { 10, 10, 10, 20 }) ) );
+static_assert( PatternError::too_many_instances == validate( make_lattice(1u << 16, 1u << 16, { 10, 10, 20, 20 }) ) );
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//
+//  - validate checks only the corners of the lattice. Checking every cell
+//    exactly, in 64 bits, must find the same error, and the regions of a
+//    valid pattern must be its cells without any wraparound
+//
+//===------------------------------------------------------------------------===
+
+struct ExactCell
+{
+    bool    is_overflow;
+    int64_t left;
+    int64_t top;
+    int64_t right;
+    int64_t bottom;
+};
+
+ExactCell exact_cell(const Pattern& pattern, int64_t column, int64_t row)
+{
+    constexpr auto int32_min = static_cast<int64_t>( std::numeric_limits<int32_t>::min() );
+    constexpr auto int32_max = static_cast<int64_t>( std::numeric_limits<int32_t>::max() );
+
+    const auto fits = [](int64_t value) { return int32_min <= value && value <= int32_max; };
+
+    const auto dx = column * pattern.offset.x;
+    const auto dy = column * pattern.offset.y;
+    const auto rx = row * pattern.row_offset.x;
+    const auto ry = row * pattern.row_offset.y;
+
+    const auto& base = pattern.base_region;
+
+    return {
+        .is_overflow = !(fits(dx) && fits(dy) && fits(rx) && fits(ry) && fits(dx + rx) && fits(dy + ry)),
+        .left        = base.left   + dx + rx,
+        .top         = base.top    + dy + ry,
+        .right       = base.right  + dx + rx,
+        .bottom      = base.bottom + dy + ry
+    };
+}
+
+PatternError validate_every_cell(const Pattern& pattern)
+{
+    if (0 == pattern.count) {
+        return PatternError::no_instances;
+    }
+
+    if (geometry::is_empty(pattern.base_region)) {
+        return PatternError::empty_region;
+    }
+
+    constexpr auto uint32_max = static_cast<int64_t>( std::numeric_limits<uint32_t>::max() );
+
+    auto is_overflow = false;
+    auto is_wrapped  = false;
+    auto is_outside  = false;
+
+    for (int64_t row = 0; row < rows(pattern); ++row) {
+        for (int64_t column = 0; column < pattern.count; ++column) {
+
+            const auto cell = exact_cell(pattern, column, row);
+
+            is_overflow = is_overflow || cell.is_overflow;
+            is_wrapped  = is_wrapped || cell.left < 0 || cell.top < 0
+                                     || uint32_max < cell.right || uint32_max < cell.bottom;
+            is_outside  = is_outside || pattern.grid_size.x < cell.right || pattern.grid_size.y < cell.bottom;
+        }
+    }
+
+    return is_overflow ? PatternError::offset_overflows
+         : is_wrapped  ? PatternError::coordinates_wrap
+         : is_outside  ? PatternError::outside_grid
+         :               PatternError::none;
+}
+
+// • Coordinates and offsets clustered near zero and the limits where
+//   validation changes its answer
+//
+Pattern make_random_pattern(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> small       { 0, 64 };
+    std::uniform_int_distribution<uint32_t> choice      { 0, 3 };
+    std::uniform_int_distribution<int32_t>  step        { -40, 40 };
+    std::uniform_int_distribution<uint32_t> count       { 0, 12 };
+
+    const auto coordinate = [&](void) -> uint32_t {
+        switch (choice(generator)) {
+            case 0:  return small(generator);
+            case 1:  return (1u << 31) + small(generator);
+            case 2:  return std::numeric_limits<uint32_t>::max() - 64 + small(generator);
+            default: return 200 + small(generator);
+        }
+    };
+
+    const auto offset = [&](void) -> int32_t {
+        switch (choice(generator)) {
+            case 0:  return (1 << 29) + step(generator);
+            case 1:  return -(1 << 29) + step(generator);
+            default: return step(generator);
+        }
+    };
+
+    const auto left = coordinate();
+    const auto top  = coordinate();
+
+    return {
+        .grid_size   = { coordinate(), coordinate() },
+        .base_region = { left, top, left + small(generator), top + small(generator) },
+        .offset      = { offset(), offset() },
+        .count       = count(generator),
+        .row_count   = count(generator),
+        .row_offset  = { offset(), offset() },
+        .nested      = 0,
+        .reserved    = 0
+    };
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Tests
+//===------------------------------------------------------------------------===
+
+TEST(pattern_validate_every_cell)
+{
+    std::mt19937 generator { 14 };
+
+    uint32_t error_counts[7] = { };
+
+    for (uint32_t trial = 0; trial < 200000; ++trial) {
+
+        const auto pattern = make_random_pattern(generator);
+        const auto error   = validate(pattern);
+
+        if (!CHECK( validate_every_cell(pattern) == error )) {
+            break;
+        }
+
+        ++error_counts[ static_cast<uint32_t>(error) ];
+
+        if (PatternError::none != error) {
+            continue;
+        }
+
+        // • Instances of a valid pattern are its exact cells
+        //
+        std::array<geometry::Region, 12*12> regions;
+
+        const auto written = expand(pattern, regions);
+
+        CHECK( cell_count(pattern) == written );
+
+        for (uint32_t index = 0; index < written; ++index) {
+
+            const auto cell = exact_cell(pattern, index % pattern.count, index / pattern.count);
+
+            CHECK( cell.left == regions[index].left && cell.top == regions[index].top
+                   && cell.right == regions[index].right && cell.bottom == regions[index].bottom );
+        }
+    }
+
+    // • Enough of each answer to mean something, but too_many_instances,
+    //   which takes more cells than a test can check one by one
+    //
+    for (uint32_t error = 0; error < std::size(error_counts); ++error) {
+        CHECK( static_cast<uint32_t>(PatternError::too_many_instances) == error || 1000 < error_counts[error] );
+    }
+}
+
+TEST(pattern_expand_partial)
+{
+    const auto pattern = make_pattern({ 10, 0 }, 9);
+
+    std::array<geometry::Region, 4> regions;
+
+    CHECK( 4 == expand(pattern, regions) );
+    CHECK( (geometry::Region { 40, 10, 50, 20 }) == regions[3] );
+    CHECK( 0 == expand(pattern, std::span<geometry::Region> { }) );
+}
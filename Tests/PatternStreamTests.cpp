@@ -0,0 +1,176 @@
+//
+//  PatternStreamTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Composition/PatternStream.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+Pattern make_pattern(uint32_t index)
+{
+    return {
+        .grid_size   = { 640, 360 },
+        .base_region = { index, 0, index + 1, 1 },
+        .offset      = { 0, 2 },
+        .count       = 1 + index % 7,
+        .row_count   = 1,
+        .row_offset  = { 0, 0 },
+        .nested      = 0,
+        .reserved    = 0
+    };
+}
+
+std::vector<Pattern> make_patterns(uint32_t count)
+{
+    std::vector<Pattern> patterns;
+
+    for (uint32_t index = 0; index < count; ++index) {
+        patterns.push_back( make_pattern(index) );
+    }
+
+    return patterns;
+}
+
+// • Read a stream back from the start of `file`
+//
+std::pair<PatternStreamStatistics, std::vector<Pattern>> read_back(FILE* file, uint32_t chunk_patterns)
+{
+    std::vector<Pattern> patterns;
+
+    ::lseek(::fileno(file), 0, SEEK_SET);
+
+    PatternStreamReader reader { ::fileno(file), chunk_patterns };
+
+    const auto statistics = reader.read( [&patterns](std::span<const Pattern> chunk) {
+        patterns.insert(patterns.end(), chunk.begin(), chunk.end());
+    } );
+
+    return { statistics, patterns };
+}
+
+} // namespace
+
+// • Byte for byte, found by argument-dependent lookup from std::equal
+//
+static bool operator == (const Pattern& left, const Pattern& right)
+{
+    return 0 == std::memcmp(&left, &right, sizeof(Pattern));
+}
+
+//===------------------------------------------------------------------------===
+// • Tests
+//===------------------------------------------------------------------------===
+
+TEST(pattern_stream_round_trip)
+{
+    const auto patterns = make_patterns(1000);
+    const auto file     = std::tmpfile();
+
+    CHECK( write_pattern_stream(::fileno(file), patterns) );
+
+    const auto [ statistics, read ] = read_back(file, 64);
+
+    CHECK( PatternStreamStatus::complete == statistics.status );
+    CHECK( std::equal(patterns.begin(), patterns.end(), read.begin(), read.end()) );
+
+    std::fclose(file);
+}
+
+TEST(pattern_stream_nested_record)
+{
+    auto patterns = make_patterns(100);
+
+    patterns[70].nested = 1;
+
+    // • The writer refuses the nested pattern
+    //
+    const auto file = std::tmpfile();
+
+    CHECK( !write_pattern_stream(::fileno(file), patterns) );
+
+    // • A stream written elsewhere with one is read up to it
+    //
+    patterns[70].nested = 0;
+
+    CHECK( write_pattern_stream(::fileno(file), patterns) );
+
+    const auto nested_offset = static_cast<off_t>( sizeof(PatternStreamHeader) + 70*pattern_stream_record_size
+                                                   + offsetof(Pattern, nested) );
+    const uint32_t nested    = 1;
+
+    CHECK( sizeof(nested) == ::pwrite(::fileno(file), &nested, sizeof(nested), nested_offset) );
+
+    const auto [ statistics, read ] = read_back(file, 16);
+
+    CHECK( PatternStreamStatus::invalid_record == statistics.status );
+    CHECK( 70 == read.size() );
+    CHECK( std::equal(read.begin(), read.end(), patterns.begin()) );
+
+    std::fclose(file);
+}
+
+// • A consumer that throws with the prefetch thread waiting for a free
+//   chunk stops it rather than leave it waiting forever
+//
+TEST(pattern_stream_consumer_throws)
+{
+    const auto patterns = make_patterns(1000);
+    const auto file     = std::tmpfile();
+
+    CHECK( write_pattern_stream(::fileno(file), patterns) );
+
+    ::lseek(::fileno(file), 0, SEEK_SET);
+
+    PatternStreamReader reader { ::fileno(file), 16, 2 };
+
+    uint32_t chunk_count = 0;
+    auto     is_thrown   = false;
+
+    try {
+        reader.read( [&chunk_count](std::span<const Pattern>) {
+
+            if (2 == ++chunk_count) {
+                throw std::runtime_error { "consumer failed" };
+            }
+        } );
+    } catch (const std::runtime_error&) {
+        is_thrown = true;
+    }
+
+    CHECK( is_thrown );
+    CHECK( 2 == chunk_count );
+
+    std::fclose(file);
+}
@@ -0,0 +1,315 @@
+//
+//  PixelConversionTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Graphics/PixelConversion.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr bool is_nan(uint16_t half)
+{
+    return 0x7c00 < (half & 0x7fff);
+}
+
+// • 8-bit linear alpha of a half, as the scalar tables clamp it
+//
+uint8_t encode_alpha8(uint16_t half)
+{
+    const auto clamped = std::clamp<int32_t>( static_cast<int16_t>(half), 0, 0x3c00 );
+
+    return static_cast<uint8_t>( std::lround( 255.0f * pixels::make_float( static_cast<uint16_t>(clamped) ) ) );
+}
+
+uint32_t encode_pixel(const uint16_t* rgba)
+{
+    return static_cast<uint32_t>( pixels::encode_srgb8(rgba[2]) )
+         | static_cast<uint32_t>( pixels::encode_srgb8(rgba[1]) ) << 8
+         | static_cast<uint32_t>( pixels::encode_srgb8(rgba[0]) ) << 16
+         | static_cast<uint32_t>( encode_alpha8(rgba[3]) ) << 24;
+}
+
+// • Lengths around the eight halves (or four pixels) of each vector step,
+//   so every batch ends with a tail of odd length
+//
+constexpr size_t max_length = 37;
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Tests
+//
+//  - The batch conversions run the vector loop, then the scalar tail: each
+//    result must match the scalar conversion of that element bit for bit
+//
+//===------------------------------------------------------------------------===
+
+TEST(pixel_half_round_trip)
+{
+    std::vector<uint16_t> halves ( 65536 );
+    std::vector<float>    values ( halves.size() );
+    std::vector<uint16_t> returned ( halves.size() );
+
+    for (uint32_t half = 0; half < halves.size(); ++half) {
+        halves[half] = static_cast<uint16_t>(half);
+    }
+
+    pixels::make_floats(halves, values);
+    pixels::make_halves(values, returned);
+
+    bool matches = true;
+
+    for (uint32_t half = 0; half < halves.size(); ++half) {
+
+        const auto value    = pixels::make_float(halves[half]);
+        const auto expected = is_nan(halves[half]) ? halves[half] | 0x0200 : halves[half];
+
+        matches = matches
+               && std::bit_cast<uint32_t>(value) == std::bit_cast<uint32_t>(values[half])
+               && expected == pixels::make_half(value)
+               && expected == returned[half];
+    }
+
+    CHECK( matches );
+
+    // • Subnormals: the smallest, the largest, and ties to even below them
+    //
+    CHECK( 0x1p-24f == pixels::make_float(0x0001) );
+    CHECK( 0x3ffp-24f == pixels::make_float(0x03ff) );
+    CHECK( 0x0001 == pixels::make_half(0x1p-24f) );
+    CHECK( 0x0000 == pixels::make_half(0x1p-25f) );
+    CHECK( 0x0001 == pixels::make_half( std::nextafter(0x1p-25f, 1.0f) ) );
+    CHECK( 0x0002 == pixels::make_half(0x1.8p-24f) );
+    CHECK( 0x0002 == pixels::make_half(0x1.4p-23f) );
+    CHECK( 0x8001 == pixels::make_half(-0x1p-24f) );
+    CHECK( 0x0400 == pixels::make_half(0x1p-14f) );
+
+    // • 65520 is halfway past the largest half: it rounds to infinity
+    //
+    CHECK( 0x7bff == pixels::make_half(65504.0f) );
+    CHECK( 0x7bff == pixels::make_half(65519.0f) );
+    CHECK( 0x7c00 == pixels::make_half(65520.0f) );
+    CHECK( 0xfc00 == pixels::make_half(-65520.0f) );
+
+    // • NaNs stay NaN, quiet, with their sign
+    //
+    CHECK( 0x7e00 == pixels::make_half( std::bit_cast<float>(0x7f800001u) ) );
+    CHECK( 0xfe00 == pixels::make_half( std::bit_cast<float>(0xff800001u) ) );
+    CHECK( std::isnan( pixels::make_float(0x7c01) ) );
+}
+
+TEST(pixel_float_sweep)
+{
+    // • One float in every 4099, with every length of batch
+    //
+    std::vector<float>    values;
+    std::vector<uint16_t> halves;
+
+    for (uint64_t bits = 0; bits <= UINT32_MAX; bits += 4099) {
+        values.push_back( std::bit_cast<float>( static_cast<uint32_t>(bits) ) );
+    }
+
+    values.push_back(65520.0f);
+    halves.resize( values.size() );
+
+    size_t first  = 0;
+    size_t length = 1;
+
+    while (first < values.size()) {
+
+        const auto count = std::min(length, values.size() - first);
+
+        pixels::make_halves( std::span(values).subspan(first, count), std::span(halves).subspan(first, count) );
+
+        first += count;
+        length = length % max_length + 1;
+    }
+
+    bool matches = true;
+
+    for (size_t index = 0; index < values.size(); ++index) {
+        matches = matches && pixels::make_half(values[index]) == halves[index];
+    }
+
+    CHECK( matches );
+}
+
+TEST(pixel_batch_tails)
+{
+    std::printf("pixel conversion: %s\n", pixels::conversion_implementation());
+
+    std::mt19937 generator { 2024 };
+
+    std::uniform_int_distribution<uint32_t> random_bits;
+
+    for (size_t length = 1; length <= max_length; ++length) {
+
+        // • Offset by one element, so the vector loads aren't aligned
+        //
+        std::vector<uint16_t> halves ( 4 * length + 1 );
+        std::vector<float>    values ( length + 1 );
+        std::vector<uint32_t> bgra ( length + 1 );
+
+        for (auto& half : halves) {
+            half = static_cast<uint16_t>( random_bits(generator) );
+        }
+
+        for (auto& value : values) {
+            value = std::bit_cast<float>( random_bits(generator) );
+        }
+
+        for (auto& pixel : bgra) {
+            pixel = random_bits(generator);
+        }
+
+        // • make_halves and make_floats
+        //
+        std::vector<uint16_t> made_halves ( length );
+        std::vector<float>    made_values ( length );
+
+        pixels::make_halves( std::span(values).subspan(1), made_halves );
+        pixels::make_floats( std::span(halves).subspan(1, length), made_values );
+
+        for (size_t index = 0; index < length; ++index) {
+            CHECK( pixels::make_half(values[1 + index]) == made_halves[index] );
+            CHECK( std::bit_cast<uint32_t>( pixels::make_float(halves[1 + index]) )
+                   == std::bit_cast<uint32_t>(made_values[index]) );
+        }
+
+        // • encode_bgra8
+        //
+        std::vector<uint32_t> encoded ( length );
+
+        pixels::encode_bgra8( std::span(halves).subspan(1), encoded );
+
+        for (size_t index = 0; index < length; ++index) {
+            CHECK( encode_pixel(&halves[1 + 4 * index]) == encoded[index] );
+        }
+
+        // • decode_bgra8: sRGB color, linear alpha
+        //
+        std::vector<uint16_t> decoded ( 4 * length );
+
+        pixels::decode_bgra8( std::span(bgra).subspan(1), decoded );
+
+        for (size_t index = 0; index < length; ++index) {
+
+            const auto pixel = bgra[1 + index];
+            const auto rgba  = &decoded[4 * index];
+
+            const auto srgb = [] (uint32_t value) {
+                return pixels::make_half( pixels::decode_srgb( static_cast<float>(value & 0xff) / 255.0f ) );
+            };
+
+            CHECK( srgb(pixel >> 16) == rgba[0] );
+            CHECK( srgb(pixel >> 8) == rgba[1] );
+            CHECK( srgb(pixel) == rgba[2] );
+            CHECK( pixels::make_half( static_cast<float>(pixel >> 24) / 255.0f ) == rgba[3] );
+        }
+
+        // • blend_white, on finite halves in [0, 1]
+        //
+        std::vector<uint16_t> blended ( length + 1 );
+
+        for (auto& half : blended) {
+            half = static_cast<uint16_t>( random_bits(generator) % 0x3c01 );
+        }
+
+        const auto original = blended;
+        const auto coverage = 0.375f;
+
+        pixels::blend_white( std::span(blended).subspan(1), coverage );
+
+        CHECK( original[0] == blended[0] );
+
+        for (size_t index = 1; index <= length; ++index) {
+
+            const auto channel = pixels::make_float(original[index]);
+
+            CHECK( pixels::make_half( channel + (1.0f - channel) * coverage ) == blended[index] );
+        }
+    }
+}
+
+TEST(pixel_encode_negative_and_nan)
+{
+    // • Each value in every channel, at every position of a vector step and
+    //   of the tail: seven pixels are one step of four and a tail of three
+    //
+    struct Case
+    {
+        uint16_t    half;
+        uint8_t     encoded;
+    };
+
+    const Case cases[] = {
+        { 0x8000, 0 },      // -0
+        { 0x8001, 0 },      // Smallest negative subnormal
+        { 0xbc00, 0 },      // -1
+        { 0xfbff, 0 },      // Largest negative
+        { 0xfc00, 0 },      // -Infinity
+        { 0xfe00, 0 },      // Negative NaN
+        { 0xffff, 0 },      // Negative NaN, every payload bit
+        { 0x0000, 0 },
+        { 0x3c00, 255 },    // 1
+        { 0x4000, 255 },    // 2
+        { 0x7c00, 255 },    // Infinity
+        { 0x7e00, 255 },    // NaN
+        { 0x7c01, 255 },    // NaN, signaling
+    };
+
+    constexpr size_t pixel_count = 7;
+
+    for (const auto& test_case : cases) {
+        for (size_t position = 0; position < pixel_count; ++position) {
+            for (uint32_t channel = 0; channel < 4; ++channel) {
+
+                std::vector<uint16_t> halves ( 4 * pixel_count, 0x3800 );   // 0.5
+                std::vector<uint32_t> bgra ( pixel_count );
+
+                halves[4 * position + channel] = test_case.half;
+
+                pixels::encode_bgra8(halves, bgra);
+
+                // • Red, green, blue, alpha land in bytes 2, 1, 0 and 3
+                //
+                const uint32_t shift[] = { 16, 8, 0, 24 };
+
+                CHECK( test_case.encoded == ((bgra[position] >> shift[channel]) & 0xff) );
+                CHECK( encode_pixel(&halves[4 * position]) == bgra[position] );
+            }
+        }
+    }
+
+    CHECK( 0 == pixels::encode_srgb8(0xbc00) );
+    CHECK( 0 == pixels::encode_srgb8(0xfe00) );
+    CHECK( 255 == pixels::encode_srgb8(0x7e00) );
+}
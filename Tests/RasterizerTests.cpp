@@ -0,0 +1,179 @@
+//
+//  RasterizerTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Composition/DirtyRegions.hpp>
+#include <Composition/Rasterizer.hpp>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//
+//  - Random patterns, some moved between two frames. The second frame,
+//    redrawn over the first inside the dirty regions, must match a full
+//    draw of it byte for byte, with either coverage and in either format
+//
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr simd::uint2 grid_size   = { 640, 360 };
+constexpr simd::uint2 target_size = { 317, 181 };
+
+Pattern make_pattern(std::mt19937& generator)
+{
+    std::uniform_int_distribution<uint32_t> x_coordinate { 0, grid_size.x - 32 };
+    std::uniform_int_distribution<uint32_t> y_coordinate { 0, grid_size.y - 32 };
+    std::uniform_int_distribution<uint32_t> extent       { 1, 12 };
+    std::uniform_int_distribution<int32_t>  step         { -3, 3 };
+    std::uniform_int_distribution<uint32_t> count        { 1, 6 };
+
+    const auto left = x_coordinate(generator);
+    const auto top  = y_coordinate(generator);
+
+    return {
+        .grid_size   = grid_size,
+        .base_region = { left, top, left + extent(generator), top + extent(generator) },
+        .offset      = { step(generator), step(generator) },
+        .count       = count(generator),
+        .row_count   = count(generator),
+        .row_offset  = { step(generator), 4 + step(generator) },
+        .nested      = 0,
+        .reserved    = 0
+    };
+}
+
+struct Frame
+{
+    std::vector<uint8_t> pixels;
+    raster::Bitmap       bitmap;
+
+    explicit Frame(raster::PixelFormat format)
+        : pixels( raster::buffer_size(format, target_size.x, target_size.y) ),
+          bitmap { pixels.data(), target_size.x, target_size.y, raster::bytes_per_row(format, target_size.x),
+                   format }
+    {
+    }
+
+    bool operator == (const Frame& other) const
+    {
+        return pixels == other.pixels;
+    }
+};
+
+// • Draw `before`, change some patterns and redraw the regions that
+//   `dirty_regions` picks for the change, in every coverage and format.
+//   Checks each redraw against a full draw
+//
+template <typename DirtyRegions_>
+void check_redraw(uint32_t seed, uint32_t changes, DirtyRegions_&& dirty_regions)
+{
+    std::mt19937 generator { seed };
+    std::uniform_int_distribution<uint32_t> which { 0, 99 };
+
+    std::vector<Pattern> before(100);
+
+    for (auto& pattern : before) {
+        pattern = make_pattern(generator);
+    }
+
+    auto after = before;
+
+    DirtyRegions dirty;
+
+    for (uint32_t change = 0; change < changes; ++change) {
+
+        auto& pattern = after[ which(generator) ];
+
+        dirty.add(pattern);
+        pattern = make_pattern(generator);
+        dirty.add(pattern);
+    }
+
+    std::vector<geometry::Region> regions;
+
+    dirty.pixel_regions(target_size, regions);
+    dirty_regions(regions);
+
+    for (const auto format : { raster::PixelFormat::bgra8Unorm, raster::PixelFormat::rgba16Float }) {
+        for (const auto coverage : { raster::Coverage::binary, raster::Coverage::analytic }) {
+
+            raster::Rasterizer rasterizer;
+            Frame              incremental { format };
+            Frame              full        { format };
+
+            rasterizer.set_coverage(coverage);
+            rasterizer.draw(before, incremental.bitmap);
+            rasterizer.redraw(after, incremental.bitmap, regions);
+            rasterizer.draw(after, full.bitmap);
+
+            CHECK(incremental == full);
+        }
+    }
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Tests
+//===------------------------------------------------------------------------===
+
+// • Nothing changed, nothing dirty: the previous frame stands
+//
+TEST(redraw_empty_regions)
+{
+    check_redraw(3, 0, [](std::vector<geometry::Region>& regions) {
+        CHECK(regions.empty());
+    });
+}
+
+// • Every pattern may have changed
+//
+TEST(redraw_full_frame)
+{
+    for (uint32_t seed = 0; seed < 8; ++seed) {
+        check_redraw(seed, 100, [](std::vector<geometry::Region>& regions) {
+            regions.assign( 1, geometry::make_region_of_size(target_size) );
+        });
+    }
+}
+
+// • The dirty regions, each also repeated, shifted to overlap itself, and
+//   one spilling past the target, so overlapping pixels are redrawn once
+//
+TEST(redraw_overlapping_regions)
+{
+    for (uint32_t seed = 0; seed < 32; ++seed) {
+        check_redraw(seed, 1 + seed % 8, [](std::vector<geometry::Region>& regions) {
+
+            const auto count = regions.size();
+
+            for (size_t index = 0; index < count; ++index) {
+                regions.push_back( regions[index] + simd::int2 { 2, 1 } );
+            }
+
+            regions.push_back( { target_size.x - 10, target_size.y - 10, target_size.x + 10, target_size.y + 10 } );
+        });
+    }
+}
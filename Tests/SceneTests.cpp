@@ -0,0 +1,109 @@
+//
+//  SceneTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Composition/Scene.hpp>
+
+#include <cstdlib>
+#include <memory>
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//
+//  - Patterns that validate rejects, e.g. with an empty grid, whose device
+//    transform is infinite, must stay out of arenas and scene files alike
+//
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+using Storage = std::unique_ptr<void, decltype(&std::free)>;
+
+constexpr Pattern valid_pattern = {
+    .grid_size   = { 64, 32 },
+    .base_region = { 1, 1, 5, 3 },
+    .offset      = { 6, 0 },
+    .count       = 4,
+    .row_count   = 2,
+    .row_offset  = { 0, 4 },
+    .nested      = 0,
+    .reserved    = 0
+};
+
+Pattern without_grid(Pattern pattern)
+{
+    pattern.grid_size = { 0, 0 };
+
+    return pattern;
+}
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Tests
+//===------------------------------------------------------------------------===
+
+TEST(arena_rejects_invalid_patterns)
+{
+    Storage memory { std::aligned_alloc( 16, arena_size(4) ), &std::free };
+
+    const auto arena = make_arena(memory.get(), 4);
+
+    CHECK( !append(*arena, without_grid(valid_pattern)) );
+    CHECK( 0 == arena->patterns.count );
+
+    CHECK( append(*arena, valid_pattern) );
+    CHECK( !update(*arena, 0, without_grid(valid_pattern)) );
+    CHECK( valid_pattern.grid_size.x == patterns(*arena)[0].grid_size.x );
+    CHECK( 8 == arena->instance_count );
+}
+
+TEST(scene_rejects_invalid_patterns)
+{
+    Storage memory { std::aligned_alloc( 16, arena_size(4) ), &std::free };
+
+    const auto arena = make_arena(memory.get(), 4);
+
+    append(*arena, valid_pattern);
+    append(*arena, valid_pattern);
+
+    // • A removed record keeps its index without instances, and is valid
+    //
+    remove(*arena, 0);
+
+    const auto size = scene_size(*arena);
+
+    Storage scene { std::aligned_alloc(16, size), &std::free };
+
+    CHECK( write_scene(*arena, scene.get(), size) );
+    CHECK( SceneStatus::valid == validate_records(scene.get(), size) );
+
+    // • An empty grid, with the transform it makes so that only validate
+    //   can tell
+    //
+    const auto header = static_cast<SceneHeader*>( scene.get() );
+    auto&      stored = *data::offset_by<Arena>(header, header->arena.offset);
+
+    patterns(stored)[1]   = without_grid(valid_pattern);
+    transforms(stored)[1] = geometry::make_device_transform({ 0, 0 });
+
+    CHECK( SceneStatus::inconsistent == validate_records(scene.get(), size) );
+}
@@ -0,0 +1,244 @@
+//
+//  SpanSetTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Composition/SpanSet.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace raster;
+
+//===------------------------------------------------------------------------===
+// • Data (Private)
+//
+//  - Small random sets as one bool per pixel: the brute force each set
+//    operation is checked against
+//
+//===------------------------------------------------------------------------===
+
+namespace
+{
+
+constexpr uint32_t mask_width  = 24;
+constexpr uint32_t mask_height = 16;
+
+using Mask = std::vector<bool>;
+
+Mask random_mask(std::mt19937& generator)
+{
+    Mask mask ( mask_width * mask_height );
+
+    // • A few rectangles, some of them empty, then a sprinkle of pixels
+    //
+    std::uniform_int_distribution<uint32_t> random_x { 0, mask_width };
+    std::uniform_int_distribution<uint32_t> random_y { 0, mask_height };
+    std::uniform_int_distribution<uint32_t> random_count { 0, 4 };
+
+    const auto rectangle_count = random_count(generator);
+
+    for (uint32_t rectangle = 0; rectangle < rectangle_count; ++rectangle) {
+
+        const auto x = std::minmax( random_x(generator), random_x(generator) );
+        const auto y = std::minmax( random_y(generator), random_y(generator) );
+
+        for (auto row = y.first; row < y.second; ++row) {
+            for (auto column = x.first; column < x.second; ++column) {
+                mask[row * mask_width + column] = true;
+            }
+        }
+    }
+
+    const auto pixel_count = random_count(generator);
+
+    for (uint32_t pixel = 0; pixel < pixel_count; ++pixel) {
+        mask[ random_y(generator) % mask_height * mask_width + random_x(generator) % mask_width ] = true;
+    }
+
+    return mask;
+}
+
+// • The canonical set of `mask`, one row at a time
+//
+SpanSet make_spans(const Mask& mask)
+{
+    SpanSet spans;
+
+    std::vector<Span> row;
+
+    for (uint32_t y = 0; y < mask_height; ++y) {
+
+        row.clear();
+
+        for (uint32_t x = 0; x < mask_width; ++x) {
+
+            if (!mask[y * mask_width + x]) {
+                continue;
+            }
+
+            if (!row.empty() && row.back().right == x) {
+                ++row.back().right;
+            } else {
+                row.push_back( { x, x + 1 } );
+            }
+        }
+
+        spans.append(y, y + 1, row);
+    }
+
+    return spans;
+}
+
+template <typename Operation>
+Mask combine(const Mask& lhs, const Mask& rhs, Operation operation)
+{
+    Mask mask ( lhs.size() );
+
+    for (size_t pixel = 0; pixel < mask.size(); ++pixel) {
+        mask[pixel] = operation( lhs[pixel], rhs[pixel] );
+    }
+
+    return mask;
+}
+
+// • Every pixel of the mask, and a margin past it, against `contains`
+//
+bool contains_mask(const SpanSet& spans, const Mask& mask)
+{
+    bool matches = true;
+
+    for (uint32_t y = 0; y < mask_height + 2; ++y) {
+        for (uint32_t x = 0; x < mask_width + 2; ++x) {
+
+            const auto is_inside = x < mask_width && y < mask_height && mask[y * mask_width + x];
+
+            matches = matches && is_inside == spans.contains( { x, y } );
+        }
+    }
+
+    return matches && !spans.contains( { UINT32_MAX, UINT32_MAX } );
+}
+
+constexpr uint32_t set_count = 200;
+
+} // namespace
+
+//===------------------------------------------------------------------------===
+// • Tests
+//
+//  - Each result must hold exactly the pixels of the brute force, and equal
+//    the set made from the brute force's mask: canonical sets are equal
+//    exactly when they hold the same pixels
+//
+//===------------------------------------------------------------------------===
+
+TEST(span_set_operations)
+{
+    std::mt19937 generator { 2024 };
+
+    for (uint32_t index = 0; index < set_count; ++index) {
+
+        const auto lhs_mask = random_mask(generator);
+        const auto rhs_mask = random_mask(generator);
+
+        const auto lhs = make_spans(lhs_mask);
+        const auto rhs = make_spans(rhs_mask);
+
+        CHECK( contains_mask(lhs, lhs_mask) );
+        CHECK( contains_mask(rhs, rhs_mask) );
+
+        const auto merged_mask      = combine( lhs_mask, rhs_mask, [](bool l, bool r) { return l || r; } );
+        const auto intersected_mask = combine( lhs_mask, rhs_mask, [](bool l, bool r) { return l && r; } );
+        const auto subtracted_mask  = combine( lhs_mask, rhs_mask, [](bool l, bool r) { return l && !r; } );
+
+        const auto merged      = merge(lhs, rhs);
+        const auto intersected = intersect(lhs, rhs);
+        const auto subtracted  = subtract(lhs, rhs);
+
+        CHECK( contains_mask(merged, merged_mask) );
+        CHECK( contains_mask(intersected, intersected_mask) );
+        CHECK( contains_mask(subtracted, subtracted_mask) );
+
+        CHECK( make_spans(merged_mask) == merged );
+        CHECK( make_spans(intersected_mask) == intersected );
+        CHECK( make_spans(subtracted_mask) == subtracted );
+
+        CHECK( std::count(merged_mask.begin(), merged_mask.end(), true) == static_cast<int64_t>( merged.area() ) );
+
+        // • The same pixels by another route
+        //
+        CHECK( merge(rhs, lhs) == merged );
+        CHECK( intersect(rhs, lhs) == intersected );
+        CHECK( merge(subtracted, intersected) == lhs );
+        CHECK( merge(lhs, lhs) == lhs );
+        CHECK( intersect(lhs, lhs) == lhs );
+        CHECK( subtract(lhs, lhs).is_empty() );
+        CHECK( lhs == rhs || lhs_mask != rhs_mask );
+        CHECK( lhs != rhs || lhs_mask == rhs_mask );
+    }
+}
+
+TEST(span_set_expand)
+{
+    std::mt19937 generator { 2025 };
+
+    data::JobSystem jobs { 2 };
+
+    // • Narrower than the mask, so spans are clipped, and taller than it
+    //
+    constexpr uint32_t width  = mask_width - 5;
+    constexpr uint32_t height = mask_height + 3;
+
+    std::vector<uint8_t> pixels ( buffer_size(width, height) );
+
+    const Bitmap target = {
+        .data          = pixels.data(),
+        .width         = width,
+        .height        = height,
+        .bytes_per_row = bytes_per_row(width)
+    };
+
+    for (uint32_t index = 0; index < set_count; ++index) {
+
+        const auto mask  = random_mask(generator);
+        const auto spans = make_spans(mask);
+
+        std::fill(pixels.begin(), pixels.end(), 0x55);
+
+        expand(jobs, spans, target);
+
+        bool matches = true;
+
+        for (uint32_t y = 0; y < height; ++y) {
+
+            const auto row = reinterpret_cast<const uint32_t*>( pixels.data() + y * target.bytes_per_row );
+
+            for (uint32_t x = 0; x < width; ++x) {
+
+                const auto is_inside = y < mask_height && mask[y * mask_width + x];
+
+                matches = matches && (is_inside ? white_pixel : black_pixel) == row[x];
+            }
+        }
+
+        CHECK( matches );
+    }
+}
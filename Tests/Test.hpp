@@ -0,0 +1,89 @@
+//
+//  Test.hpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+//===------------------------------------------------------------------------===
+//
+// • Test harness
+//
+//  - Each test is a plain function registered with TEST(name) and run by
+//    PlayTests, optionally selected by name on the command line. CTest
+//    runs each test on its own (see CMakeLists.txt)
+//
+//  - CHECK(condition) reports a failed condition and lets the test go on,
+//    so one run shows every failure
+//
+//===------------------------------------------------------------------------===
+
+namespace test
+{
+
+struct Test
+{
+    const char* name;
+    void      (*run)(void);
+};
+
+inline std::vector<Test>& registry(void)
+{
+    static std::vector<Test> tests;
+
+    return tests;
+}
+
+// • Failed checks of the test running
+//
+inline uint32_t& failures(void)
+{
+    static uint32_t count = 0;
+
+    return count;
+}
+
+struct Registration
+{
+    Registration(const char* name, void (*run)(void))
+    {
+        registry().push_back( { name, run } );
+    }
+};
+
+inline bool check(bool condition, const char* expression, const char* file, int line)
+{
+    if (!condition) {
+        ++failures();
+        std::printf("  %s:%d: CHECK(%s) failed\n", file, line, expression);
+    }
+
+    return condition;
+}
+
+} // namespace test
+
+#define TEST(function_)                                                                \
+    static void function_(void);                                                       \
+    static const test::Registration function_##_registration { #function_, function_ }; \
+    static void function_(void)
+
+#define CHECK(condition_) test::check( static_cast<bool>(condition_), #condition_, __FILE__, __LINE__ )
@@ -0,0 +1,58 @@
+//
+//  TraceTests.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <Data/Trace.hpp>
+
+#include <thread>
+
+//===------------------------------------------------------------------------===
+// • Tests
+//===------------------------------------------------------------------------===
+
+// • A thread named but never recording, like an idle job worker, appears
+//   in the trace by name alone; one recording later still gets its events
+//
+TEST(trace_thread_names)
+{
+    trace::set_enabled(true);
+
+    std::thread idle { [] {
+        trace::set_thread_name("idle thread");
+    } };
+
+    std::thread busy { [] {
+        trace::set_thread_name("busy thread");
+        trace::instant("busy event", "test");
+    } };
+
+    idle.join();
+    busy.join();
+
+    trace::set_enabled(false);
+
+    const auto json = trace::chrome_trace_json();
+
+    CHECK( std::string::npos != json.find("\"idle thread\"") );
+    CHECK( std::string::npos != json.find("\"busy thread\"") );
+    CHECK( std::string::npos != json.find("\"busy event\"") );
+
+    trace::clear();
+}
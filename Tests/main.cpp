@@ -0,0 +1,65 @@
+//
+//  main.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include <cstring>
+
+// • PlayTests [name ...]: run every test, or those named. Exits 1 if any
+//   check failed, and 2 if a name matches no test
+//
+int main(int argc, const char* argv[])
+{
+    uint32_t failed   = 0;
+    uint32_t selected = 0;
+
+    for (const auto& test : test::registry()) {
+
+        auto is_selected = (argc < 2);
+
+        for (int index = 1; index < argc; ++index) {
+            is_selected = is_selected || 0 == std::strcmp(test.name, argv[index]);
+        }
+
+        if (!is_selected) {
+            continue;
+        }
+
+        ++selected;
+
+        std::printf("%s\n", test.name);
+
+        test::failures() = 0;
+        test.run();
+
+        if (0 < test::failures()) {
+            std::printf("  %u failed checks\n", test::failures());
+            ++failed;
+        }
+    }
+
+    if (argc - 1 > static_cast<int>(selected)) {
+        std::fprintf(stderr, "No test of some of the names given\n");
+        return 2;
+    }
+
+    std::printf("%u of %u tests failed\n", failed, selected);
+
+    return (0 < failed) ? 1 : 0;
+}
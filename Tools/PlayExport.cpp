@@ -0,0 +1,207 @@
+//
+//  PlayExport.cpp
+//
+//  Copyright © 2024 Robert Guequierre
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <Composition/FrameExport.hpp>
+#include <Composition/Scene.hpp>
+#include <Composition/SpanSet.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+
+std::optional<MappedScene> open_scene(const char* path)
+{
+    auto scene = MappedScene::open(path);
+
+    if (!scene || SceneStatus::valid != validate_records( &scene->header(), scene->size() )) {
+        std::fprintf(stderr, "Unable to read scene %s\n", path);
+        return std::nullopt;
+    }
+
+    return scene;
+}
+
+// • Each scene is drawn into the next free buffer while earlier frames are
+//   written
+//
+int export_frames( std::span<const char* const> scene_paths, simd::uint2 size, raster::PixelFormat format,
+                   raster::FrameEncoding encoding, raster::Coverage coverage, int descriptor )
+{
+    raster::FrameExporter exporter { descriptor, size, format, encoding };
+
+    if (!exporter.is_valid()) {
+        std::fprintf(stderr, "Unable to export %ux%u frames\n", size.x, size.y);
+        return 2;
+    }
+
+    raster::Rasterizer rasterizer;
+
+    rasterizer.set_coverage(coverage);
+
+    auto status = 0;
+
+    for (const auto path : scene_paths) {
+
+        const auto scene = open_scene(path);
+
+        if (!scene) {
+            status = 1;
+            break;
+        }
+
+        rasterizer.draw( scene->arena(), exporter.begin_frame() );
+        exporter.end_frame();
+    }
+
+    if (!exporter.finish()) {
+        std::fprintf(stderr, "Unable to write frames\n");
+        status = 1;
+    }
+
+    return status;
+}
+
+// • Spans are small, so each is written as soon as it is drawn
+//
+int export_spans(std::span<const char* const> scene_paths, simd::uint2 size, int descriptor)
+{
+    if (0 == size.x || 0 == size.y) {
+        std::fprintf(stderr, "Unable to export %ux%u spans\n", size.x, size.y);
+        return 2;
+    }
+
+    raster::SpanRasterizer rasterizer;
+    raster::SpanSet        spans;
+    std::vector<uint8_t>   file;
+
+    for (const auto path : scene_paths) {
+
+        const auto scene = open_scene(path);
+
+        if (!scene) {
+            return 1;
+        }
+
+        rasterizer.draw(scene->arena(), size, spans);
+
+        file.resize( raster::span_file_size(spans) );
+        raster::write_spans(spans, size, file.data());
+
+        if (!raster::write_all(descriptor, file.data(), file.size())) {
+            std::fprintf(stderr, "Unable to write spans\n");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+} // namespace
+
+// • PlayExport [--size WIDTHxHEIGHT] [--raw | --spans] [--antialiased]
+//   [--hdr] [--output path] scene ...: draw each scene file as a frame with
+//   the CPU rasterizer and write the frames, as PNG unless --raw, to
+//   --output or standard output. The frames are 1920x1080 by default. --hdr
+//   draws .rgba16Float frames: raw frames keep the halves, PNG gets their
+//   8-bit sRGB preview. --spans writes the binary coverage of each frame as
+//   a span file (see SpanSet.hpp) instead of its pixels
+//
+int main(int argc, const char* argv[])
+{
+    simd::uint2 size        = { 1920, 1080 };
+    auto        encoding    = raster::FrameEncoding::png;
+    auto        coverage    = raster::Coverage::binary;
+    auto        format      = raster::PixelFormat::bgra8Unorm;
+    auto        is_spans    = false;
+    const char* output_path = nullptr;
+
+    std::vector<const char*> scene_paths;
+
+    for (int index = 1; index < argc; ++index) {
+
+        const auto is_option = [&](const char* option) {
+            return 0 == std::strcmp(argv[index], option) && index + 1 < argc;
+        };
+
+        if (is_option("--size")) {
+
+            // • Into scalars: simd vector elements have no address
+            //
+            uint32_t width  = 0;
+            uint32_t height = 0;
+
+            if (2 != std::sscanf(argv[++index], "%ux%u", &width, &height)) {
+                std::fprintf(stderr, "Invalid size %s\n", argv[index]);
+                return 2;
+            }
+
+            size = { width, height };
+        } else if (is_option("--output")) {
+            output_path = argv[++index];
+        } else if (0 == std::strcmp(argv[index], "--raw")) {
+            encoding = raster::FrameEncoding::raw;
+        } else if (0 == std::strcmp(argv[index], "--antialiased")) {
+            coverage = raster::Coverage::analytic;
+        } else if (0 == std::strcmp(argv[index], "--spans")) {
+            is_spans = true;
+        } else if (0 == std::strcmp(argv[index], "--hdr")) {
+            format = raster::PixelFormat::rgba16Float;
+        } else {
+            scene_paths.push_back(argv[index]);
+        }
+    }
+
+    // • Spans are binary coverage, not pixels
+    //
+    const auto has_frame_options = raster::FrameEncoding::raw == encoding || raster::Coverage::analytic == coverage
+                                || raster::PixelFormat::rgba16Float == format;
+
+    if (scene_paths.empty() || (is_spans && has_frame_options)) {
+        std::fprintf(stderr, "usage: PlayExport [--size WIDTHxHEIGHT] [--raw | --spans] [--antialiased] "
+                             "[--hdr] [--output path] scene ...\n");
+        return 2;
+    }
+
+    const auto descriptor = (nullptr == output_path || 0 == std::strcmp(output_path, "-"))
+                          ? STDOUT_FILENO
+                          : ::open(output_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (descriptor < 0) {
+        std::fprintf(stderr, "Unable to open %s\n", output_path);
+        return 2;
+    }
+
+    auto status = is_spans ? export_spans(scene_paths, size, descriptor)
+                           : export_frames(scene_paths, size, format, encoding, coverage, descriptor);
+
+    if (STDOUT_FILENO != descriptor && 0 != ::close(descriptor) && 0 == status) {
+        status = 1;
+    }
+
+    return status;
+}